@@ -0,0 +1,109 @@
+#include "AABBSoA.h"
+#include <limits>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+using namespace rabbit;
+namespace
+{
+    const double INF = std::numeric_limits<double>::infinity();
+}
+
+const std::size_t AABBSoA::BLOCK_SIZE;
+const std::size_t AABBSoA::PADDING;
+
+AABBSoA::AABBSoA():
+    m_xMin(PADDING, INF), m_xMax(PADDING, INF),
+    m_yMin(PADDING, INF), m_yMax(PADDING, INF),
+    m_zMin(PADDING, INF), m_zMax(PADDING, INF),
+    m_size(0)
+{
+}
+
+void AABBSoA::Reserve(std::size_t n)
+{
+    for(std::vector<double>* v : {&m_xMin, &m_xMax, &m_yMin, &m_yMax, &m_zMin, &m_zMax})
+    {
+        v->reserve(n + PADDING);
+    }
+}
+
+void AABBSoA::PushBack(const Bounds& bounds)
+{
+    // Overwrite the first padding box and add a new one at the end
+    m_xMin[m_size] = bounds.xMin; m_xMin.push_back(INF);
+    m_xMax[m_size] = bounds.xMax; m_xMax.push_back(INF);
+    m_yMin[m_size] = bounds.yMin; m_yMin.push_back(INF);
+    m_yMax[m_size] = bounds.yMax; m_yMax.push_back(INF);
+    m_zMin[m_size] = bounds.zMin; m_zMin.push_back(INF);
+    m_zMax[m_size] = bounds.zMax; m_zMax.push_back(INF);
+    ++m_size;
+}
+
+uint64_t AABBSoA::CullBlock(const Vec3& point, double maxDistSq, std::size_t first, std::size_t count)const
+{
+    uint64_t mask = 0;
+    const double* xMin = m_xMin.data() + first;
+    const double* xMax = m_xMax.data() + first;
+    const double* yMin = m_yMin.data() + first;
+    const double* yMax = m_yMax.data() + first;
+    const double* zMin = m_zMin.data() + first;
+    const double* zMax = m_zMax.data() + first;
+
+#if defined(__AVX512F__)
+    const __m512d px = _mm512_set1_pd(point.X());
+    const __m512d py = _mm512_set1_pd(point.Y());
+    const __m512d pz = _mm512_set1_pd(point.Z());
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d bound = _mm512_set1_pd(maxDistSq);
+    for(std::size_t i = 0; i < count; i += 8)
+    {
+        // Distance along each axis is max(min - p, p - max, 0)
+        const __m512d dx = _mm512_max_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(xMin + i), px),
+                                                       _mm512_sub_pd(px, _mm512_loadu_pd(xMax + i))), zero);
+        const __m512d dy = _mm512_max_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(yMin + i), py),
+                                                       _mm512_sub_pd(py, _mm512_loadu_pd(yMax + i))), zero);
+        const __m512d dz = _mm512_max_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(zMin + i), pz),
+                                                       _mm512_sub_pd(pz, _mm512_loadu_pd(zMax + i))), zero);
+        const __m512d distSq = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)),
+                                             _mm512_mul_pd(dz, dz));
+        const __mmask8 lanes = _mm512_cmp_pd_mask(distSq, bound, _CMP_LT_OQ);
+        mask |= static_cast<uint64_t>(lanes) << i;
+    }
+#elif defined(__AVX2__)
+    const __m256d px = _mm256_set1_pd(point.X());
+    const __m256d py = _mm256_set1_pd(point.Y());
+    const __m256d pz = _mm256_set1_pd(point.Z());
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d bound = _mm256_set1_pd(maxDistSq);
+    for(std::size_t i = 0; i < count; i += 4)
+    {
+        // Distance along each axis is max(min - p, p - max, 0)
+        const __m256d dx = _mm256_max_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(xMin + i), px),
+                                                       _mm256_sub_pd(px, _mm256_loadu_pd(xMax + i))), zero);
+        const __m256d dy = _mm256_max_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(yMin + i), py),
+                                                       _mm256_sub_pd(py, _mm256_loadu_pd(yMax + i))), zero);
+        const __m256d dz = _mm256_max_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(zMin + i), pz),
+                                                       _mm256_sub_pd(pz, _mm256_loadu_pd(zMax + i))), zero);
+        const __m256d distSq = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+                                             _mm256_mul_pd(dz, dz));
+        const int lanes = _mm256_movemask_pd(_mm256_cmp_pd(distSq, bound, _CMP_LT_OQ));
+        mask |= static_cast<uint64_t>(lanes) << i;
+    }
+#else
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        const double dx = std::max(std::max(xMin[i] - point.X(), point.X() - xMax[i]), 0.0);
+        const double dy = std::max(std::max(yMin[i] - point.Y(), point.Y() - yMax[i]), 0.0);
+        const double dz = std::max(std::max(zMin[i] - point.Z(), point.Z() - zMax[i]), 0.0);
+        if(dx*dx + dy*dy + dz*dz < maxDistSq)
+        {
+            mask |= uint64_t(1) << i;
+        }
+    }
+#endif
+
+    // Lanes past count were tested against boxes outside the block
+    return count < BLOCK_SIZE ? mask & ((uint64_t(1) << count) - 1) : mask;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Bounds.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rabbit
+{
+
+/**
+* @brief A list of axis aligned bounding boxes stored as structure of arrays, i.e. all
+* the xMin values are contiguous, then all the xMax values and so on. Only the bounds
+* are kept, which is all that is needed to calculate the distance from a point to a box.
+* The layout lets CullBlock test several boxes per instruction: 8 with AVX-512, 4 with
+* AVX2, falling back to plain scalar code otherwise. Which one is used is decided at
+* compile time, see RABBIT_USE_NATIVE_ARCH in the top level CMakeLists.txt.
+*/
+class AABBSoA
+{
+public:
+
+    /**
+    * Largest number of boxes CullBlock can test in one call
+    */
+    static const std::size_t BLOCK_SIZE = 64;
+
+    AABBSoA();
+
+    void Reserve(std::size_t n);
+    void PushBack(const Bounds& bounds);
+    std::size_t Size()const{return m_size;}
+
+    /**
+    * @return Squared distance between point and the box at index i, zero if the point is inside
+    */
+    double CalcShortestDistanceSqFrom(std::size_t i, const Vec3& point)const;
+
+    /**
+    * Tests the boxes [first, first + count) against a point.
+    * @param maxDistSq Square of the distance threshold
+    * @param count Number of boxes to test, at most BLOCK_SIZE
+    * @return Bit i is set if the squared distance between point and box first + i
+    * is smaller than maxDistSq
+    */
+    uint64_t CullBlock(const Vec3& point, double maxDistSq, std::size_t first, std::size_t count)const;
+
+private:
+
+    // The arrays always end with PADDING boxes at infinity, which never pass the
+    // distance test, so the kernel can read whole SIMD registers past the last box.
+    static const std::size_t PADDING = 8;
+
+    std::vector<double> m_xMin;
+    std::vector<double> m_xMax;
+    std::vector<double> m_yMin;
+    std::vector<double> m_yMax;
+    std::vector<double> m_zMin;
+    std::vector<double> m_zMax;
+    std::size_t m_size; ///< Number of boxes, not counting the padding
+};
+
+/**
+* @return Index of the lowest set bit of mask. mask must not be zero.
+*/
+inline unsigned LowestSetBit(uint64_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+inline double AABBSoA::CalcShortestDistanceSqFrom(std::size_t i, const Vec3& point)const
+{
+    const double dx = std::max(std::max(m_xMin[i] - point.X(), point.X() - m_xMax[i]), 0.0);
+    const double dy = std::max(std::max(m_yMin[i] - point.Y(), point.Y() - m_yMax[i]), 0.0);
+    const double dz = std::max(std::max(m_zMin[i] - point.Z(), point.Z() - m_zMax[i]), 0.0);
+    return dx*dx + dy*dy + dz*dz;
+}
+
+}
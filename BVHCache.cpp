@@ -0,0 +1,281 @@
+#include "BVHCache.h"
+#include "BinaryMeshFormat.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+#include <unistd.h>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+
+    // Finalizer of splitmix64, every bit of the input affects every bit of the output
+    uint64_t Mix(uint64_t h)
+    {
+        h = (h ^ (h >> 30))*0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 27))*0x94D049BB133111EBull;
+        return h ^ (h >> 31);
+    }
+
+    uint64_t Combine(uint64_t h, uint64_t value)
+    {
+        return Mix(h ^ value);
+    }
+
+    uint64_t Combine(uint64_t h, double value)
+    {
+        // Adding zero turns -0.0 into 0.0
+        const double normalised = value + 0.0;
+        uint64_t bits;
+        std::memcpy(&bits, &normalised, sizeof(bits));
+        return Combine(h, bits);
+    }
+
+    uint64_t HashParams(const BVHBuildParams& params)
+    {
+        uint64_t h = Combine(0, static_cast<uint64_t>(params.SplitMethod));
+        h = Combine(h, static_cast<uint64_t>(params.MaxTrisPerLeaf));
+        h = Combine(h, static_cast<uint64_t>(params.NumBins));
+        h = Combine(h, params.TraversalCost);
+        return Combine(h, params.IntersectionCost);
+    }
+
+    bool IsSameParams(const BVHCacheHeader& header, const BVHBuildParams& params)
+    {
+        return header.SplitMethod == static_cast<uint32_t>(params.SplitMethod) &&
+               header.MaxTrisPerLeaf == params.MaxTrisPerLeaf &&
+               header.NumBins == params.NumBins &&
+               header.TraversalCost == params.TraversalCost &&
+               header.IntersectionCost == params.IntersectionCost;
+    }
+
+    // Rounds a block size up so that the next block is 8 byte aligned
+    uint64_t Align(uint64_t numBytes)
+    {
+        return (numBytes + 7) & ~uint64_t(7);
+    }
+
+    void Write(std::ofstream& outfile, const void* data, std::size_t numBytes, const std::string& fileName)
+    {
+        outfile.write(static_cast<const char*>(data), static_cast<std::streamsize>(numBytes));
+        if(outfile.fail())
+        {
+            throw std::runtime_error("Unable to write BVH cache file:" + fileName);
+        }
+    }
+
+    std::atomic<unsigned> s_numTemporaryFiles(0); ///< Makes the temporary files of the threads of a process unique
+}
+
+const char rabbit::BVH_CACHE_MAGIC[8] = {'R', 'A', 'B', 'B', 'I', 'T', 'B', 'C'};
+
+BVHCache::BVHCache(const std::string& directory):
+    m_directory(directory),
+    m_numHits(0),
+    m_numMisses(0),
+    m_numFailedStores(0){}
+
+uint64_t BVHCache::HashMesh(std::size_t numTriangles, const std::function<Tri(std::size_t)>& getTriangle)
+{
+    uint64_t h = Combine(0, static_cast<uint64_t>(numTriangles));
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        const Tri t = getTriangle(i);
+        for(const Vec3* p : {&t.P0(), &t.P1(), &t.P2()})
+        {
+            h = Combine(h, p->X());
+            h = Combine(h, p->Y());
+            h = Combine(h, p->Z());
+        }
+    }
+    return h;
+}
+
+std::string BVHCache::GetFileName(uint64_t meshHash, const BVHBuildParams& params)const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bvh",
+                  static_cast<unsigned long long>(Combine(meshHash, HashParams(params))));
+    return m_directory + "/" + name;
+}
+
+bool BVHCache::Load(uint64_t meshHash,
+                    std::size_t numTriangles,
+                    const BVHBuildParams& params,
+                    std::unique_ptr<LinearBVH>& bvh,
+                    TriangleSoA& triangles)
+{
+    std::unique_ptr<MappedFile> file;
+    try
+    {
+        file.reset(new MappedFile(GetFileName(meshHash, params)));
+    }
+    catch(const std::runtime_error&)
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    // The mapping is page aligned, so the header and blocks are suitably aligned
+    const std::size_t fileSize = file->GetSize();
+    const BVHCacheHeader* header = reinterpret_cast<const BVHCacheHeader*>(file->GetData());
+    if(!IsLittleEndian() ||
+       fileSize < sizeof(BVHCacheHeader) ||
+       std::memcmp(header->Magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC)) != 0 ||
+       header->Version != BVH_CACHE_VERSION ||
+       header->MeshHash != meshHash ||
+       header->NumTriangles != numTriangles ||
+       !IsSameParams(*header, params))
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    // Counts are checked against the file size first, so the sizes below can not overflow
+    const uint64_t nodeBytes = header->NumNodes*sizeof(LinearBVHNode);
+    const uint64_t triIndexBytes = numTriangles*sizeof(uint32_t);
+    const uint64_t triangleBytes = numTriangles*9*sizeof(double);
+    if(header->NumNodes > fileSize/sizeof(LinearBVHNode) ||
+       numTriangles > fileSize/(9*sizeof(double)) ||
+       header->NodeOffset > fileSize || header->NodeOffset % 8 != 0 ||
+       header->TriIndexOffset > fileSize || header->TriIndexOffset % 8 != 0 ||
+       header->TriangleOffset > fileSize || header->TriangleOffset % 8 != 0 ||
+       header->NodeOffset + nodeBytes > fileSize ||
+       header->TriIndexOffset + triIndexBytes > fileSize ||
+       header->TriangleOffset + triangleBytes > fileSize)
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    const LinearBVHNode* nodes = reinterpret_cast<const LinearBVHNode*>(file->GetData() + header->NodeOffset);
+    const uint32_t* triIndices = reinterpret_cast<const uint32_t*>(file->GetData() + header->TriIndexOffset);
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        if(triIndices[i] >= numTriangles)
+        {
+            ++m_numMisses;
+            return false;
+        }
+    }
+
+    std::unique_ptr<LinearBVH> loaded;
+    try
+    {
+        loaded.reset(new LinearBVH(std::vector<LinearBVHNode>(nodes, nodes + header->NumNodes),
+                                   std::vector<uint32_t>(triIndices, triIndices + numTriangles)));
+    }
+    catch(const std::runtime_error&)
+    {
+        ++m_numMisses;
+        return false;
+    }
+
+    const double* coords = reinterpret_cast<const double*>(file->GetData() + header->TriangleOffset);
+    const double* const p0[3] = {coords, coords + numTriangles, coords + 2*numTriangles};
+    const double* const p0p1[3] = {coords + 3*numTriangles, coords + 4*numTriangles, coords + 5*numTriangles};
+    const double* const p0p2[3] = {coords + 6*numTriangles, coords + 7*numTriangles, coords + 8*numTriangles};
+    triangles.Append(numTriangles, p0, p0p1, p0p2);
+    bvh = std::move(loaded);
+    ++m_numHits;
+    return true;
+}
+
+void BVHCache::Store(uint64_t meshHash,
+                     const BVHBuildParams& params,
+                     const LinearBVH& bvh,
+                     const TriangleSoA& triangles)
+{
+    if(!IsLittleEndian())
+    {
+        throw std::runtime_error("BVH cache files can only be written on little endian machines");
+    }
+
+    const std::vector<LinearBVHNode>& nodes = bvh.GetNodes();
+    const std::vector<uint32_t>& triIndices = bvh.GetTriIndices();
+    const std::size_t numTriangles = triangles.Size();
+    if(triIndices.size() != numTriangles)
+    {
+        throw std::runtime_error("The BVH and the triangles to be cached do not match");
+    }
+
+    BVHCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.Magic, BVH_CACHE_MAGIC, sizeof(header.Magic));
+    header.Version = BVH_CACHE_VERSION;
+    header.SplitMethod = static_cast<uint32_t>(params.SplitMethod);
+    header.MaxTrisPerLeaf = params.MaxTrisPerLeaf;
+    header.NumBins = params.NumBins;
+    header.TraversalCost = params.TraversalCost;
+    header.IntersectionCost = params.IntersectionCost;
+    header.MeshHash = meshHash;
+    header.NumTriangles = numTriangles;
+    header.NumNodes = nodes.size();
+    header.NodeOffset = sizeof(BVHCacheHeader);
+    header.TriIndexOffset = header.NodeOffset + nodes.size()*sizeof(LinearBVHNode);
+    header.TriangleOffset = header.TriIndexOffset + Align(numTriangles*sizeof(uint32_t));
+
+    // Readers either see the old file or the complete new one
+    const std::string fileName = GetFileName(meshHash, params);
+    const std::string temporaryFileName = fileName + "." + std::to_string(getpid()) +
+                                          "." + std::to_string(s_numTemporaryFiles++);
+    try
+    {
+        std::ofstream outfile(temporaryFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if(outfile.fail())
+        {
+            throw std::runtime_error("Unable to open BVH cache file for writing:" + temporaryFileName);
+        }
+
+        const char padding[8] = {0};
+        Write(outfile, &header, sizeof(header), temporaryFileName);
+        Write(outfile, nodes.data(), nodes.size()*sizeof(LinearBVHNode), temporaryFileName);
+        Write(outfile, triIndices.data(), triIndices.size()*sizeof(uint32_t), temporaryFileName);
+        Write(outfile, padding, Align(numTriangles*sizeof(uint32_t)) - numTriangles*sizeof(uint32_t), temporaryFileName);
+
+        const double* const coords[9] = {triangles.GetP0(0), triangles.GetP0(1), triangles.GetP0(2),
+                                         triangles.GetP0P1(0), triangles.GetP0P1(1), triangles.GetP0P1(2),
+                                         triangles.GetP0P2(0), triangles.GetP0P2(1), triangles.GetP0P2(2)};
+        for(const double* array : coords)
+        {
+            Write(outfile, array, numTriangles*sizeof(double), temporaryFileName);
+        }
+        outfile.close();
+        if(outfile.fail())
+        {
+            throw std::runtime_error("Unable to write BVH cache file:" + temporaryFileName);
+        }
+    }
+    catch(const std::runtime_error&)
+    {
+        std::remove(temporaryFileName.c_str());
+        throw;
+    }
+
+    if(std::rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+    {
+        std::remove(temporaryFileName.c_str());
+        throw std::runtime_error("Unable to write BVH cache file:" + fileName);
+    }
+}
+
+bool BVHCache::TryStore(uint64_t meshHash,
+                        const BVHBuildParams& params,
+                        const LinearBVH& bvh,
+                        const TriangleSoA& triangles)
+{
+    try
+    {
+        Store(meshHash, params, bvh, triangles);
+        return true;
+    }
+    catch(const std::runtime_error&)
+    {
+        ++m_numFailedStores;
+        return false;
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "BVHTree.h"
+#include "LinearBVH.h"
+#include "Triangle.h"
+#include "TriangleSoA.h"
+#include "Vec3.h"
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace rabbit
+{
+
+/**
+* @brief Header at the start of a BVH cache file. Everything in the file is little
+* endian. The header is followed by
+*  - the node block: NumNodes LinearBVHNode, starting at NodeOffset,
+*  - the index block: NumTriangles uint32_t triangle indices in leaf order, starting at TriIndexOffset,
+*  - the triangle block: nine arrays of NumTriangles doubles, x, y and z of P0, of P0P1 and
+*    of P0P2 of the triangles in leaf order, starting at TriangleOffset.
+* All blocks are 8 byte aligned so they can be read straight out of the mapped file.
+*/
+struct BVHCacheHeader
+{
+    char Magic[8];              ///< BVH_CACHE_MAGIC
+    uint32_t Version;           ///< BVH_CACHE_VERSION of the writer
+    uint32_t SplitMethod;       ///< BVHBuildParams the hierarchy was built with
+    uint32_t MaxTrisPerLeaf;
+    uint32_t NumBins;
+    double TraversalCost;
+    double IntersectionCost;
+    uint64_t MeshHash;          ///< BVHCache::HashMesh of the mesh the hierarchy was built for
+    uint64_t NumTriangles;
+    uint64_t NumNodes;
+    uint64_t NodeOffset;        ///< Byte offsets of the blocks from the start of the file
+    uint64_t TriIndexOffset;
+    uint64_t TriangleOffset;
+    uint64_t Reserved;          ///< Zero
+};
+static_assert(sizeof(BVHCacheHeader) == 96, "BVHCacheHeader is expected to be 96 bytes");
+
+extern const char BVH_CACHE_MAGIC[8];
+const uint32_t BVH_CACHE_VERSION = 1;
+
+/**
+* @brief A directory of files holding the hierarchies and reordered triangles built by
+* TriMeshProxQueryV4, so that a process which is started again on the same mesh can
+* map them back in instead of building them again.
+*
+* Each file is named after a hash of the content of the mesh and of the BVHBuildParams,
+* so any change to the mesh simply misses the cache. Files of other versions, of other
+* meshes which happen to share the file name, or which are damaged are treated as misses
+* as well and overwritten. Files are written to a temporary name first and then renamed,
+* so several processes can share a directory.
+*/
+class BVHCache : boost::noncopyable
+{
+public:
+
+    /**
+    * @param directory Directory holding the cache files. It has to exist.
+    */
+    explicit BVHCache(const std::string& directory);
+
+    /**
+    * @return A 64 bit hash of the number of triangles and the coordinates of all their vertices
+    */
+    static uint64_t HashMesh(std::size_t numTriangles,
+                             const std::function<Triangle<Vec3>(std::size_t)>& getTriangle);
+
+    /**
+    * @return Name of the file caching the hierarchy of a mesh with the given hash
+    */
+    std::string GetFileName(uint64_t meshHash, const BVHBuildParams& params)const;
+
+    /**
+    * Reads back a hierarchy stored before.
+    * @param bvh Set to the hierarchy on success
+    * @param triangles The triangles in leaf order are appended on success
+    * @return false if there is no valid cache file for the mesh
+    */
+    bool Load(uint64_t meshHash,
+              std::size_t numTriangles,
+              const BVHBuildParams& params,
+              std::unique_ptr<LinearBVH>& bvh,
+              TriangleSoA& triangles);
+
+    /**
+    * Writes the hierarchy of a mesh and its triangles in leaf order. Throws on failure.
+    */
+    void Store(uint64_t meshHash,
+               const BVHBuildParams& params,
+               const LinearBVH& bvh,
+               const TriangleSoA& triangles);
+
+    /**
+    * As Store, but a cache file which can not be written, e.g. in a read only or full
+    * directory or on a big endian machine, is counted instead of thrown. The cache is an
+    * optimisation, so a process which can not write it just builds the hierarchy next time.
+    * @return false if the file could not be written
+    */
+    bool TryStore(uint64_t meshHash,
+                  const BVHBuildParams& params,
+                  const LinearBVH& bvh,
+                  const TriangleSoA& triangles);
+
+    const std::string& GetDirectory()const{return m_directory;}
+    unsigned GetNumHits()const{return m_numHits;}
+    unsigned GetNumMisses()const{return m_numMisses;}
+    unsigned GetNumFailedStores()const{return m_numFailedStores;}
+
+private:
+
+    std::string m_directory;
+    std::atomic<unsigned> m_numHits;   ///< Number of successful calls to Load
+    std::atomic<unsigned> m_numMisses; ///< Number of failed calls to Load
+    std::atomic<unsigned> m_numFailedStores; ///< Number of failed calls to TryStore
+};
+
+}
@@ -0,0 +1,315 @@
+#include "BVHTree.h"
+#include <algorithm>
+
+using namespace rabbit;
+namespace
+{
+    typedef BVHTree::Node Node;
+
+    // Below this depth nodes are always split at the median. Median splits halve the
+    // number of triangles, so at most 32 more levels are needed for 2^32 triangles.
+    const unsigned MAX_SAH_DEPTH = 24;
+
+    void Enclose(Bounds& bounds, const Bounds& b)
+    {
+        bounds.xMin = std::min(bounds.xMin, b.xMin);
+        bounds.xMax = std::max(bounds.xMax, b.xMax);
+
+        bounds.yMin = std::min(bounds.yMin, b.yMin);
+        bounds.yMax = std::max(bounds.yMax, b.yMax);
+
+        bounds.zMin = std::min(bounds.zMin, b.zMin);
+        bounds.zMax = std::max(bounds.zMax, b.zMax);
+    }
+
+    // Bounds enclosing the AABBs of the triangles indices[begin, end)
+    Bounds CalculateBounds(const std::vector<AABB<Vec3>>& aabbs,
+                           const std::vector<int>& indices,
+                           unsigned begin,
+                           unsigned end)
+    {
+        Bounds bounds = aabbs[indices[begin]].GetBounds();
+        for(unsigned i = begin + 1; i < end; ++i)
+        {
+            Enclose(bounds, aabbs[indices[i]].GetBounds());
+        }
+        return bounds;
+    }
+
+    // Bounds enclosing the centers of the AABBs of the triangles indices[begin, end)
+    Bounds CalculateCentroidBounds(const std::vector<AABB<Vec3>>& aabbs,
+                                   const std::vector<int>& indices,
+                                   unsigned begin,
+                                   unsigned end)
+    {
+        const Vec3 c = aabbs[indices[begin]].Center();
+        Bounds bounds(c.X(), c.X(), c.Y(), c.Y(), c.Z(), c.Z());
+        for(unsigned i = begin + 1; i < end; ++i)
+        {
+            const Vec3 center = aabbs[indices[i]].Center();
+            bounds.xMin = std::min(bounds.xMin, center.X());
+            bounds.xMax = std::max(bounds.xMax, center.X());
+
+            bounds.yMin = std::min(bounds.yMin, center.Y());
+            bounds.yMax = std::max(bounds.yMax, center.Y());
+
+            bounds.zMin = std::min(bounds.zMin, center.Z());
+            bounds.zMax = std::max(bounds.zMax, center.Z());
+        }
+        return bounds;
+    }
+
+    double CenterAlongAxis(const AABB<Vec3>& aabb, int axis)
+    {
+        const Vec3 center = aabb.Center();
+        return axis == 0 ? center.X() : (axis == 1 ? center.Y() : center.Z());
+    }
+
+    double MinAlongAxis(const Bounds& b, int axis)
+    {
+        return axis == 0 ? b.xMin : (axis == 1 ? b.yMin : b.zMin);
+    }
+
+    double MaxAlongAxis(const Bounds& b, int axis)
+    {
+        return axis == 0 ? b.xMax : (axis == 1 ? b.yMax : b.zMax);
+    }
+
+    double SurfaceArea(const Bounds& b)
+    {
+        const double dx = b.xMax - b.xMin;
+        const double dy = b.yMax - b.yMin;
+        const double dz = b.zMax - b.zMin;
+        return 2.0*(dx*dy + dy*dz + dz*dx);
+    }
+
+    /**
+    * @brief Triangles whose centers fall into the same slab of the centroid
+    * bounds along the split axis are accumulated into one bin.
+    */
+    struct SAHBin
+    {
+        SAHBin():count(0){}
+
+        Bounds bounds;  ///< Bounds enclosing the AABBs of the triangles in the bin
+        unsigned count; ///< Number of triangles in the bin
+    };
+
+    unsigned BinIndex(double center, double minCenter, double scale, unsigned numBins)
+    {
+        const unsigned bin = static_cast<unsigned>((center - minCenter)*scale);
+        return std::min(bin, numBins - 1);
+    }
+}
+
+const unsigned BVHTree::MAX_DEPTH;
+
+BVHTree::BVHTree(const std::vector<AABB<Vec3>>& aabbs, const BVHBuildParams& params):
+    m_params(params),
+    m_root(nullptr),
+    m_depth(0),
+    m_sahCost(0.0)
+{
+    m_params.MaxTrisPerLeaf = std::max(m_params.MaxTrisPerLeaf, 1u);
+    m_params.NumBins = std::max(m_params.NumBins, 2u);
+
+    if(aabbs.empty())
+    {
+        return;
+    }
+
+    std::vector<int> indices(aabbs.size());
+    for(unsigned i = 0; i < indices.size(); ++i)
+    {
+        indices[i] = static_cast<int>(i);
+    }
+
+    m_nodes.reserve(2*aabbs.size()/m_params.MaxTrisPerLeaf + 1);
+    m_root = BuildNode(aabbs, indices, 0, static_cast<unsigned>(indices.size()), nullptr, 1);
+
+    const double rootArea = SurfaceArea(m_root->Data().aabb.GetBounds());
+    m_sahCost = CalculateSAHCost(m_root);
+    if(rootArea > 0.0)
+    {
+        m_sahCost /= rootArea;
+    }
+}
+
+Node* BVHTree::CreateNode(const Bounds& bounds, Node* parent)
+{
+    m_nodes.emplace_back(new Node(NodeData(AABB<Vec3>(bounds)), parent));
+    return m_nodes.back().get();
+}
+
+Node* BVHTree::BuildNode(const std::vector<AABB<Vec3>>& aabbs,
+                         std::vector<int>& indices,
+                         unsigned begin,
+                         unsigned end,
+                         Node* parent,
+                         unsigned depth)
+{
+    m_depth = std::max(m_depth, depth);
+    Node* node = CreateNode(CalculateBounds(aabbs, indices, begin, end), parent);
+
+    const unsigned numTris = end - begin;
+    unsigned mid = begin;
+    if(m_params.SplitMethod == BVHSplitMethod::SAH && depth < MAX_SAH_DEPTH)
+    {
+        mid = SAHSplit(aabbs, indices, begin, end, node->Data().aabb.GetBounds());
+    }
+    else if(numTris > m_params.MaxTrisPerLeaf)
+    {
+        mid = MedianSplit(aabbs, indices, begin, end);
+    }
+
+    if(mid == end)
+    {
+        // The SAH split could not separate the triangles, but there are too many for one leaf
+        mid = MedianSplit(aabbs, indices, begin, end);
+    }
+
+    if(mid == begin)
+    {
+        node->Data().triIndices.assign(indices.begin() + begin, indices.begin() + end);
+        return node;
+    }
+
+    Node* left = BuildNode(aabbs, indices, begin, mid, node, depth + 1);
+    Node* right = BuildNode(aabbs, indices, mid, end, node, depth + 1);
+    node->SetChildren(left, right);
+    return node;
+}
+
+unsigned BVHTree::MedianSplit(const std::vector<AABB<Vec3>>& aabbs,
+                              std::vector<int>& indices,
+                              unsigned begin,
+                              unsigned end)const
+{
+    // Split at the median of the triangle centers along the axis in which
+    // the centers are spread out the most.
+    const int axis = AABB<Vec3>(CalculateCentroidBounds(aabbs, indices, begin, end)).GetLargestDim().second;
+    const unsigned mid = begin + (end - begin)/2;
+    std::nth_element(indices.begin() + begin, indices.begin() + mid, indices.begin() + end,
+                     [&aabbs, axis](int a, int b)
+    {
+        return CenterAlongAxis(aabbs[a], axis) < CenterAlongAxis(aabbs[b], axis);
+    });
+    return mid;
+}
+
+unsigned BVHTree::SAHSplit(const std::vector<AABB<Vec3>>& aabbs,
+                           std::vector<int>& indices,
+                           unsigned begin,
+                           unsigned end,
+                           const Bounds& nodeBounds)const
+{
+    const unsigned numTris = end - begin;
+    const unsigned numBins = m_params.NumBins;
+    const Bounds centroidBounds = CalculateCentroidBounds(aabbs, indices, begin, end);
+
+    // All costs below are multiplied by the surface area of the node, which saves
+    // a division per candidate and keeps degenerate (zero area) nodes well defined.
+    const double leafCost = m_params.IntersectionCost*numTris*SurfaceArea(nodeBounds);
+    double bestCost = std::numeric_limits<double>::max();
+    int bestAxis = -1;
+    unsigned bestBin = 0;
+
+    std::vector<SAHBin> bins(numBins);
+    std::vector<double> rightCost(numBins);
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        const double minCenter = MinAlongAxis(centroidBounds, axis);
+        const double extent = MaxAlongAxis(centroidBounds, axis) - minCenter;
+        if(extent <= 0.0)
+        {
+            continue;
+        }
+        const double scale = numBins/extent;
+
+        std::fill(bins.begin(), bins.end(), SAHBin());
+        for(unsigned i = begin; i < end; ++i)
+        {
+            const AABB<Vec3>& aabb = aabbs[indices[i]];
+            SAHBin& bin = bins[BinIndex(CenterAlongAxis(aabb, axis), minCenter, scale, numBins)];
+            if(bin.count == 0)
+            {
+                bin.bounds = aabb.GetBounds();
+            }
+            else
+            {
+                Enclose(bin.bounds, aabb.GetBounds());
+            }
+            ++bin.count;
+        }
+
+        // Sweep from the right to get the cost of everything right of each bin boundary ...
+        Bounds accumulated;
+        unsigned count = 0;
+        for(unsigned b = numBins - 1; b > 0; --b)
+        {
+            if(bins[b].count > 0)
+            {
+                if(count == 0) accumulated = bins[b].bounds;
+                else Enclose(accumulated, bins[b].bounds);
+                count += bins[b].count;
+            }
+            rightCost[b] = count*SurfaceArea(accumulated);
+        }
+
+        // ... and from the left to combine it with the cost of everything left of it.
+        count = 0;
+        for(unsigned b = 0; b + 1 < numBins; ++b)
+        {
+            if(bins[b].count > 0)
+            {
+                if(count == 0) accumulated = bins[b].bounds;
+                else Enclose(accumulated, bins[b].bounds);
+                count += bins[b].count;
+            }
+            if(count == 0 || count == numTris)
+            {
+                continue;
+            }
+
+            const double cost = m_params.TraversalCost*SurfaceArea(nodeBounds) +
+                                m_params.IntersectionCost*(count*SurfaceArea(accumulated) + rightCost[b + 1]);
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+            }
+        }
+    }
+
+    const bool canBeLeaf = numTris <= m_params.MaxTrisPerLeaf;
+    if(bestAxis < 0)
+    {
+        return canBeLeaf ? begin : end;
+    }
+    if(canBeLeaf && leafCost <= bestCost)
+    {
+        return begin;
+    }
+
+    const double minCenter = MinAlongAxis(centroidBounds, bestAxis);
+    const double scale = numBins/(MaxAlongAxis(centroidBounds, bestAxis) - minCenter);
+    auto it = std::partition(indices.begin() + begin, indices.begin() + end,
+                             [&](int i)
+    {
+        return BinIndex(CenterAlongAxis(aabbs[i], bestAxis), minCenter, scale, numBins) <= bestBin;
+    });
+    return static_cast<unsigned>(it - indices.begin());
+}
+
+double BVHTree::CalculateSAHCost(const Node* node)const
+{
+    const double area = SurfaceArea(node->Data().aabb.GetBounds());
+    if(IsLeaf(node))
+    {
+        return area*m_params.IntersectionCost*node->Data().triIndices.size();
+    }
+    return area*m_params.TraversalCost +
+           CalculateSAHCost(node->GetLeft()) +
+           CalculateSAHCost(node->GetRight());
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "BNode.h"
+#include "NodeData.h"
+#include "AABB.h"
+#include "Vec3.h"
+#include <boost/noncopyable.hpp>
+#include <memory>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief Strategy used to partition the triangles of a node between its two children
+*/
+enum class BVHSplitMethod
+{
+    Median, ///< Split at the median triangle center along the axis of largest spread
+    SAH     ///< Binned surface area heuristic. Slower to build, but gives better trees
+};
+
+/**
+* @brief Parameters controlling the construction of a BVHTree
+*/
+struct BVHBuildParams
+{
+    explicit BVHBuildParams(unsigned maxTrisPerLeaf = 4,
+                            BVHSplitMethod splitMethod = BVHSplitMethod::SAH,
+                            unsigned numBins = 16,
+                            double traversalCost = 1.0,
+                            double intersectionCost = 4.0):
+        MaxTrisPerLeaf(maxTrisPerLeaf),
+        SplitMethod(splitMethod),
+        NumBins(numBins),
+        TraversalCost(traversalCost),
+        IntersectionCost(intersectionCost){}
+
+    unsigned MaxTrisPerLeaf;    ///< Largest number of triangles a leaf is allowed to hold
+    BVHSplitMethod SplitMethod; ///< How nodes are split
+    unsigned NumBins;           ///< Number of bins per axis used by the SAH split
+    double TraversalCost;       ///< SAH cost of testing a point against the AABB of a node
+    double IntersectionCost;    ///< SAH cost of testing a point against a triangle
+};
+
+/**
+* @brief Bounding volume hierarchy built from the axis aligned bounding boxes
+* of the triangles in a mesh. Every node of the tree is a BNode<NodeData> whose
+* AABB completely encloses the AABBs of all the nodes below it. Only the leaves
+* hold triangle indices, which index into the vector of AABBs the tree was built from.
+* The tree owns all of its nodes.
+*/
+class BVHTree : boost::noncopyable
+{
+public:
+    typedef BNode<NodeData> Node;
+
+    /**
+    * The builder never produces trees deeper than this, so the tree can be
+    * traversed with a fixed size stack.
+    */
+    static const unsigned MAX_DEPTH = 64;
+
+    /**
+    * @param aabbs Bounding boxes of the triangles, one per triangle in the mesh
+    * @param params Controls the shape of the tree
+    */
+    BVHTree(const std::vector<AABB<Vec3>>& aabbs, const BVHBuildParams& params = BVHBuildParams());
+
+    /**
+    * @return The root of the tree, nullptr if the tree was built from an empty list of AABBs
+    */
+    const Node* GetRoot()const{return m_root;}
+
+    unsigned GetNumNodes()const{return static_cast<unsigned>(m_nodes.size());}
+
+    /**
+    * @return Number of levels in the tree. A tree consisting of the root only has a depth of 1.
+    * Never larger than MAX_DEPTH.
+    */
+    unsigned GetDepth()const{return m_depth;}
+
+    static bool IsLeaf(const Node* node){return node->GetLeft() == nullptr;}
+
+    /**
+    * @return The surface area heuristic cost of the tree, i.e. the expected cost of
+    * visiting every node whose AABB contains a uniformly distributed point, using the
+    * traversal and intersection costs from BVHBuildParams. Trees with lower costs need
+    * fewer triangle tests per query.
+    */
+    double GetSAHCost()const{return m_sahCost;}
+
+private:
+
+    // Recursively builds the subtree for the triangles indices[begin, end)
+    Node* BuildNode(const std::vector<AABB<Vec3>>& aabbs,
+                    std::vector<int>& indices,
+                    unsigned begin,
+                    unsigned end,
+                    Node* parent,
+                    unsigned depth);
+
+    Node* CreateNode(const Bounds& bounds, Node* parent);
+
+    // Partitions indices[begin, end) at the median triangle center. Returns the split position.
+    unsigned MedianSplit(const std::vector<AABB<Vec3>>& aabbs,
+                         std::vector<int>& indices,
+                         unsigned begin,
+                         unsigned end)const;
+
+    // Partitions indices[begin, end) at the bin boundary with the lowest SAH cost. Returns
+    // the split position, or begin if making a leaf is cheaper than any split.
+    unsigned SAHSplit(const std::vector<AABB<Vec3>>& aabbs,
+                      std::vector<int>& indices,
+                      unsigned begin,
+                      unsigned end,
+                      const Bounds& nodeBounds)const;
+
+    // SAH cost of the subtree under node, not yet normalised by the area of the root
+    double CalculateSAHCost(const Node* node)const;
+
+    BVHBuildParams m_params;
+    std::vector<std::unique_ptr<Node>> m_nodes; ///< Storage for all the nodes of the tree
+    Node* m_root;   ///< Root of the tree
+    unsigned m_depth; ///< Depth of the tree
+    double m_sahCost; ///< SAH cost of the finished tree
+};
+
+}
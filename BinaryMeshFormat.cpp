@@ -0,0 +1,114 @@
+#include "BinaryMeshFormat.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+
+    BinaryMeshHeader MakeHeader(std::size_t numVertices, std::size_t numTriangles, bool indexed)
+    {
+        BinaryMeshHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.Magic, BINARY_MESH_MAGIC, sizeof(header.Magic));
+        header.Version = BINARY_MESH_VERSION;
+        header.NumVertices = numVertices;
+        header.NumTriangles = numTriangles;
+        header.VertexOffset = sizeof(BinaryMeshHeader);
+        header.IndexOffset = indexed ? header.VertexOffset + numVertices*3*sizeof(double) : 0;
+        return header;
+    }
+
+    void OpenForWriting(std::ofstream& outfile, const std::string& fileName)
+    {
+        if(!IsLittleEndian())
+        {
+            throw std::runtime_error("Binary mesh files can only be written on little endian machines");
+        }
+        outfile.open(fileName.c_str(), std::ios::binary | std::ios::trunc);
+        if(outfile.fail())
+        {
+            throw std::runtime_error("Unable to open mesh file for writing:" + fileName);
+        }
+    }
+
+    void Write(std::ofstream& outfile, const void* data, std::size_t numBytes, const std::string& fileName)
+    {
+        outfile.write(static_cast<const char*>(data), static_cast<std::streamsize>(numBytes));
+        if(outfile.fail())
+        {
+            throw std::runtime_error("Unable to write mesh file:" + fileName);
+        }
+    }
+}
+
+const char rabbit::BINARY_MESH_MAGIC[8] = {'R', 'A', 'B', 'B', 'I', 'T', 'M', 'B'};
+
+bool rabbit::IsLittleEndian()
+{
+    const uint32_t one = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &one, 1);
+    return firstByte == 1;
+}
+
+void rabbit::WriteBinaryMesh(const std::string& fileName, const std::vector<Tri>& triangles)
+{
+    std::ofstream outfile;
+    OpenForWriting(outfile, fileName);
+    const BinaryMeshHeader header = MakeHeader(triangles.size()*3, triangles.size(), false);
+    Write(outfile, &header, sizeof(header), fileName);
+    for(const Tri& t : triangles)
+    {
+        const double coords[9] = {t.P0().X(), t.P0().Y(), t.P0().Z(),
+                                  t.P1().X(), t.P1().Y(), t.P1().Z(),
+                                  t.P2().X(), t.P2().Y(), t.P2().Z()};
+        Write(outfile, coords, sizeof(coords), fileName);
+    }
+}
+
+void rabbit::WriteBinaryMesh(const std::string& fileName,
+                             const double* vertices,
+                             std::size_t numVertices,
+                             const uint32_t* indices,
+                             std::size_t numTriangles)
+{
+    std::ofstream outfile;
+    OpenForWriting(outfile, fileName);
+    const BinaryMeshHeader header = MakeHeader(numVertices, numTriangles, true);
+    Write(outfile, &header, sizeof(header), fileName);
+    Write(outfile, vertices, numVertices*3*sizeof(double), fileName);
+    Write(outfile, indices, numTriangles*3*sizeof(uint32_t), fileName);
+}
+
+void rabbit::ConvertTextMeshToBinary(const std::string& textFileName, const std::string& binaryFileName)
+{
+    std::ifstream infile(textFileName.c_str());
+    if(infile.fail())
+    {
+        throw std::runtime_error("Unable to open mesh file:" + textFileName);
+    }
+
+    // The triangles are streamed straight through, the header is written
+    // again with the right counts once they are known
+    std::ofstream outfile;
+    OpenForWriting(outfile, binaryFileName);
+    BinaryMeshHeader header = MakeHeader(0, 0, false);
+    Write(outfile, &header, sizeof(header), binaryFileName);
+
+    std::size_t numTriangles = 0;
+    double coords[9];
+    while(infile >> coords[0] >> coords[1] >> coords[2]
+                 >> coords[3] >> coords[4] >> coords[5]
+                 >> coords[6] >> coords[7] >> coords[8])
+    {
+        Write(outfile, coords, sizeof(coords), binaryFileName);
+        ++numTriangles;
+    }
+
+    header = MakeHeader(numTriangles*3, numTriangles, false);
+    outfile.seekp(0);
+    Write(outfile, &header, sizeof(header), binaryFileName);
+}
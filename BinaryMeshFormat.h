@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Triangle.h"
+#include "Vec3.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief Header at the start of a binary mesh file. Everything in the file is little
+* endian. The header is followed by
+*  - the vertex block: NumVertices vertices, each as three doubles x, y, z, starting
+*    at VertexOffset,
+*  - the optional index block: NumTriangles triplets of uint32_t vertex indices,
+*    starting at IndexOffset. If there is no index block (IndexOffset is zero), the
+*    vertices are the triangles themselves, three consecutive vertices per triangle.
+* Both blocks are 8 byte aligned so they can be used in place once the file is mapped
+* into memory, see MappedMeshBuildingPolicy.
+*/
+struct BinaryMeshHeader
+{
+    char Magic[8];          ///< BINARY_MESH_MAGIC
+    uint32_t Version;       ///< BINARY_MESH_VERSION of the writer
+    uint32_t Flags;         ///< Reserved, zero
+    uint64_t NumVertices;
+    uint64_t NumTriangles;
+    uint64_t VertexOffset;  ///< Byte offset of the vertex block from the start of the file
+    uint64_t IndexOffset;   ///< Byte offset of the index block, zero if there is none
+    uint64_t Reserved[2];   ///< Zero
+};
+static_assert(sizeof(BinaryMeshHeader) == 64, "BinaryMeshHeader is expected to be 64 bytes");
+
+extern const char BINARY_MESH_MAGIC[8];
+const uint32_t BINARY_MESH_VERSION = 1;
+
+/**
+* @return true if the machine stores integers and doubles little endian, which is
+* required for reading and writing binary mesh files
+*/
+bool IsLittleEndian();
+
+/**
+* Writes a triangle soup, i.e. a file without an index block. Throws on failure.
+*/
+void WriteBinaryMesh(const std::string& fileName, const std::vector<Triangle<Vec3>>& triangles);
+
+/**
+* Writes an indexed mesh. Throws on failure.
+* @param vertices numVertices*3 coordinates
+* @param indices numTriangles*3 indices into vertices
+*/
+void WriteBinaryMesh(const std::string& fileName,
+                     const double* vertices,
+                     std::size_t numVertices,
+                     const uint32_t* indices,
+                     std::size_t numTriangles);
+
+/**
+* Converts a mesh in the text format read by TriangularMeshBuilingPolicy into
+* a binary mesh file without an index block.
+*/
+void ConvertTextMeshToBinary(const std::string& textFileName, const std::string& binaryFileName);
+
+}
@@ -0,0 +1,118 @@
+#include "CompactTriangleMesh.h"
+#include "Mesh.h"
+#include "MappedMeshBuildingPolicy.h"
+#include <algorithm>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+}
+
+CompactTriangleMesh::CompactTriangleMesh(VertexPrecision precision):
+    m_numTriangles(0),
+    m_precision(precision){}
+
+CompactTriangleMesh::CompactTriangleMesh(std::shared_ptr<IMeshBuildingPolicy<Tri>> buildingPolicy,
+                                         VertexPrecision precision):
+    m_numTriangles(0),
+    m_precision(precision)
+{
+    const MappedMeshBuildingPolicy* mapped = dynamic_cast<const MappedMeshBuildingPolicy*>(buildingPolicy.get());
+    if(mapped)
+    {
+        mapped->CheckIndices();
+        const std::size_t numTriangles = mapped->GetNumTriangles();
+        Reserve(numTriangles);
+        for(std::size_t i = 0; i < numTriangles; ++i)
+        {
+            PushBack(mapped->GetVertex(i, zero), mapped->GetVertex(i, one), mapped->GetVertex(i, two));
+        }
+        return;
+    }
+
+    buildingPolicy->VisitPolygons([this](const Tri& t)
+    {
+        PushBack(t.P0(), t.P1(), t.P2());
+    });
+
+    // The number of triangles was not known up front. One array at a time, so this
+    // costs at most one more coordinate array.
+    for(unsigned i = 0; i < 9; ++i)
+    {
+        m_doubleCoords[i].shrink_to_fit();
+        m_floatCoords[i].shrink_to_fit();
+    }
+}
+
+CompactTriangleMesh::CompactTriangleMesh(const Mesh<Tri>& mesh, VertexPrecision precision):
+    m_numTriangles(0),
+    m_precision(precision)
+{
+    const std::vector<Tri>& triangles = mesh.GetPolygons();
+    Reserve(triangles.size());
+    for(const Tri& t : triangles)
+    {
+        PushBack(t.P0(), t.P1(), t.P2());
+    }
+}
+
+void CompactTriangleMesh::Reserve(std::size_t numTriangles)
+{
+    for(unsigned i = 0; i < 9; ++i)
+    {
+        if(m_precision == VertexPrecision::Double)
+        {
+            m_doubleCoords[i].reserve(numTriangles);
+        }
+        else
+        {
+            m_floatCoords[i].reserve(numTriangles);
+        }
+    }
+}
+
+void CompactTriangleMesh::PushBack(const Vec3& p0, const Vec3& p1, const Vec3& p2)
+{
+    const Vec3* verts[3] = {&p0, &p1, &p2};
+    for(unsigned v = 0; v < 3; ++v)
+    {
+        const double coords[3] = {verts[v]->X(), verts[v]->Y(), verts[v]->Z()};
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            if(m_precision == VertexPrecision::Double)
+            {
+                m_doubleCoords[3*v + axis].push_back(coords[axis]);
+            }
+            else
+            {
+                m_floatCoords[3*v + axis].push_back(static_cast<float>(coords[axis]));
+            }
+        }
+    }
+    ++m_numTriangles;
+}
+
+AABB<Vec3> CompactTriangleMesh::CalculateAABB(std::size_t i)const
+{
+    const Vec3 p0 = GetVertex(i, zero);
+    const Vec3 p1 = GetVertex(i, one);
+    const Vec3 p2 = GetVertex(i, two);
+    const Vec3 lower(std::min(std::min(p0.X(), p1.X()), p2.X()),
+                     std::min(std::min(p0.Y(), p1.Y()), p2.Y()),
+                     std::min(std::min(p0.Z(), p1.Z()), p2.Z()));
+    const Vec3 upper(std::max(std::max(p0.X(), p1.X()), p2.X()),
+                     std::max(std::max(p0.Y(), p1.Y()), p2.Y()),
+                     std::max(std::max(p0.Z(), p1.Z()), p2.Z()));
+    return AABB<Vec3>((upper + lower)*0.5, (upper - lower)*0.5);
+}
+
+std::size_t CompactTriangleMesh::GetMemoryUsage()const
+{
+    std::size_t numBytes = 0;
+    for(unsigned i = 0; i < 9; ++i)
+    {
+        numBytes += m_doubleCoords[i].capacity()*sizeof(double) + m_floatCoords[i].capacity()*sizeof(float);
+    }
+    return numBytes;
+}
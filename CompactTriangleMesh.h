@@ -0,0 +1,109 @@
+#pragma once
+
+#include "IMeshBuildingPolicy.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include "AABB.h"
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace rabbit
+{
+
+template<typename PolygonType> class Mesh;
+
+/**
+* @brief Precision in which CompactTriangleMesh keeps the vertex coordinates
+*/
+enum class VertexPrecision
+{
+    Double, ///< 72 bytes per triangle, coordinates are kept exactly
+    Float   ///< 36 bytes per triangle, coordinates are rounded to float
+};
+
+/**
+* @brief A triangular mesh which only keeps the coordinates of the vertices, as
+* structure of arrays: all the x coordinates of the first vertices are contiguous,
+* then all their y coordinates and so on. A Triangle<Vec3> additionally stores its
+* three edges and its normal, so this takes less than half the memory in double
+* precision and less than a quarter in float.
+*
+* Edges and normals are derived when a triangle is looked at through GetTriangle.
+* Query methods that only need the triangles while preprocessing (TriMeshProxQueryV2,
+* TriMeshProxQueryV4) lose nothing by being built from a compact mesh, while
+* TriMeshProxQueryV1 pays for the derivation on every query.
+*/
+class CompactTriangleMesh : boost::noncopyable
+{
+public:
+
+    /**
+    * Creates an empty mesh, to be filled with PushBack
+    */
+    explicit CompactTriangleMesh(VertexPrecision precision = VertexPrecision::Double);
+
+    /**
+    * Loads the triangles with a building policy, one at a time through
+    * IMeshBuildingPolicy::VisitPolygons, so only policies which can not visit them one by
+    * one hold all of them while loading. The vertex block of a MappedMeshBuildingPolicy
+    * is copied straight out of the mapped file.
+    */
+    CompactTriangleMesh(std::shared_ptr<IMeshBuildingPolicy<Triangle<Vec3>>> buildingPolicy,
+                        VertexPrecision precision = VertexPrecision::Double);
+
+    /**
+    * Copies the vertices of the triangles of mesh
+    */
+    CompactTriangleMesh(const Mesh<Triangle<Vec3>>& mesh,
+                        VertexPrecision precision = VertexPrecision::Double);
+
+    void Reserve(std::size_t numTriangles);
+    void PushBack(const Vec3& p0, const Vec3& p1, const Vec3& p2);
+
+    std::size_t GetNumTriangles()const{return m_numTriangles;}
+    VertexPrecision GetPrecision()const{return m_precision;}
+
+    /**
+    * @return Vertex id of triangle i
+    */
+    Vec3 GetVertex(std::size_t i, ids id)const;
+
+    /**
+    * @return Triangle i with its edges and normal calculated from the vertices
+    */
+    Triangle<Vec3> GetTriangle(std::size_t i)const;
+
+    AABB<Vec3> CalculateAABB(std::size_t i)const;
+
+    /**
+    * @return Number of bytes used by the vertex coordinates
+    */
+    std::size_t GetMemoryUsage()const;
+
+private:
+
+    // Coordinate axis of vertex id lives in array 3*id + axis
+    std::vector<double> m_doubleCoords[9]; ///< Used in double precision
+    std::vector<float> m_floatCoords[9];   ///< Used in float precision
+    std::size_t m_numTriangles;
+    VertexPrecision m_precision;
+};
+
+inline Vec3 CompactTriangleMesh::GetVertex(std::size_t i, ids id)const
+{
+    const unsigned first = 3*static_cast<unsigned>(id);
+    if(m_precision == VertexPrecision::Double)
+    {
+        return Vec3(m_doubleCoords[first][i], m_doubleCoords[first + 1][i], m_doubleCoords[first + 2][i]);
+    }
+    return Vec3(m_floatCoords[first][i], m_floatCoords[first + 1][i], m_floatCoords[first + 2][i]);
+}
+
+inline Triangle<Vec3> CompactTriangleMesh::GetTriangle(std::size_t i)const
+{
+    return Triangle<Vec3>(GetVertex(i, zero), GetVertex(i, one), GetVertex(i, two));
+}
+
+}
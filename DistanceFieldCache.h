@@ -0,0 +1,329 @@
+#pragma once
+
+#include "IProximityQueries.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief Parameters of a DistanceFieldCache
+*/
+struct DistanceFieldParams
+{
+    DistanceFieldParams(double voxelSize,
+                        double maxDist,
+                        unsigned brickSize = 8,
+                        std::size_t maxMemory = 64*1024*1024):
+        VoxelSize(voxelSize),
+        MaxDist(maxDist),
+        BrickSize(brickSize),
+        MaxMemory(maxMemory){}
+
+    double VoxelSize;      ///< Spacing of the samples along each axis
+    double MaxDist;        ///< Distances are calculated up to this value, larger ones are reported as MaxDist
+    unsigned BrickSize;    ///< Number of samples along each axis of a brick, at least 2
+    std::size_t MaxMemory; ///< Bytes the samples may take before the least recently used bricks are evicted
+};
+
+/**
+* @brief Counts of how DistanceFieldCache answered its queries
+*/
+struct DistanceFieldStats
+{
+    DistanceFieldStats():NumQueries(0), NumHits(0), NumMisses(0), NumBricksEvicted(0){}
+
+    std::size_t NumQueries;       ///< Number of queries answered
+    std::size_t NumHits;          ///< Queries interpolated from a brick which was already cached
+    std::size_t NumMisses;        ///< Queries interpolated from a brick which had to be calculated first
+    std::size_t NumBricksEvicted; ///< Bricks dropped to stay within DistanceFieldParams::MaxMemory
+
+    /**
+    * @return Number of queries answered by the query method, because the error bound was
+    * too tight or the distance too close to DistanceFieldParams::MaxDist
+    */
+    std::size_t GetNumExact()const{return NumQueries - NumHits - NumMisses;}
+
+    /**
+    * @return Fraction of the queries which were hits, zero if there were none
+    */
+    double GetHitRate()const{return NumQueries != 0 ? double(NumHits)/NumQueries : 0.0;}
+};
+
+/**
+* @brief Sparse distance field in front of a query method, for answering many distance
+* queries in the same region of space. Space is divided into cubic bricks of
+* BrickSize^3 samples of the distance to the mesh, VoxelSize apart. A brick is calculated
+* by the query method the first time a query falls into it and kept in a hash map keyed
+* by its integer coordinates. Later queries in the brick are answered by trilinear
+* interpolation between the eight samples around the point.
+*
+* The distance to a mesh changes by at most the distance moved, so the interpolated value
+* differs from the exact distance by at most the sum of the distances from the point to
+* the eight samples, weighted as in the interpolation. That bound is at most
+* GetMaxErrorBound(), sqrt(3)/2*VoxelSize, at the center of a cell and zero at the samples.
+* Each query states the error it accepts and is passed on to the query method whenever the
+* bound for the point is larger. Cells with a sample further away than MaxDist are not
+* interpolated either.
+*
+* Once the samples take more than MaxMemory bytes, the least recently used bricks are
+* evicted. Like ProximityTracker, the cache has state, so each thread needs its own.
+* @tparam ProximityQueryMethod Any class deriving from IProximityQueries over Triangle<Vec3>
+*/
+template<typename ProximityQueryMethod>
+class DistanceFieldCache
+{
+public:
+
+    /**
+    * @param method Query method used to calculate the samples and answer the queries which
+    * can not be interpolated. Must outlive this object.
+    */
+    DistanceFieldCache(const ProximityQueryMethod& method, const DistanceFieldParams& params);
+
+    /**
+    * @param point Point of interest
+    * @param maxError Largest difference to the exact distance the caller accepts
+    * @return Distance between point and the mesh, or MaxDist if it is further away
+    */
+    double CalculateDistance(const Vec3& point, double maxError);
+
+    /**
+    * @return Error bound which holds for every interpolated distance. Queries accepting
+    * this error are interpolated unless they are close to MaxDist.
+    */
+    double GetMaxErrorBound()const{return 0.5*std::sqrt(3.0)*m_params.VoxelSize;}
+
+    std::size_t GetNumBricks()const{return m_bricks.size();}
+
+    /**
+    * @return Number of bytes used by the samples
+    */
+    std::size_t GetMemoryUsage()const{return m_bricks.size()*GetBrickMemory();}
+
+    /**
+    * Drops all the bricks, e.g. after the mesh changed
+    */
+    void Clear();
+
+    const DistanceFieldStats& GetStats()const{return m_stats;}
+    void ResetStats(){m_stats = DistanceFieldStats();}
+
+private:
+
+    /**
+    * @brief Samples of a brick, x fastest, then y, then z
+    */
+    struct Brick
+    {
+        std::vector<double> Samples;       ///< Distances, infinity where further away than MaxDist
+        std::list<uint64_t>::iterator Lru; ///< Position of the brick in m_lru
+    };
+
+    struct BrickKeyHash
+    {
+        std::size_t operator()(uint64_t key)const
+        {
+            const uint64_t h = key*0x9E3779B97F4A7C15ull;
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    static const int64_t MAX_BRICK_COORD = (int64_t(1) << 20) - 1; ///< Bricks are keyed by 21 bits per axis
+
+    std::size_t GetBrickMemory()const{return m_numSamples*sizeof(double);}
+
+    // Finds the brick with the given key, calculating it if it is not cached
+    const Brick& GetBrick(uint64_t key, const int64_t brickCoords[3], bool& calculated);
+
+    // Calculates the samples of the brick at brickCoords
+    void FillBrick(const int64_t brickCoords[3], std::vector<double>& samples)const;
+
+    double CalculateExactDistance(const Vec3& point, double distThreshold)const;
+
+    const ProximityQueryMethod& m_method; ///< Method calculating the samples
+    DistanceFieldParams m_params;
+    std::size_t m_numSamples;             ///< Samples per brick
+    std::unordered_map<uint64_t, Brick, BrickKeyHash> m_bricks;
+    std::list<uint64_t> m_lru;            ///< Keys of the cached bricks, most recently used first
+    DistanceFieldStats m_stats;
+};
+
+template<typename ProximityQueryMethod>
+DistanceFieldCache<ProximityQueryMethod>::DistanceFieldCache(const ProximityQueryMethod& method,
+                                                             const DistanceFieldParams& params):
+    m_method(method),
+    m_params(params),
+    m_numSamples(static_cast<std::size_t>(params.BrickSize)*params.BrickSize*params.BrickSize)
+{
+    if(!(params.VoxelSize > 0.0) || !(params.MaxDist > 0.0) || params.BrickSize < 2)
+    {
+        throw std::runtime_error("Distance field needs a positive voxel size and distance, and bricks of at least 2 samples");
+    }
+}
+
+template<typename ProximityQueryMethod>
+double DistanceFieldCache<ProximityQueryMethod>::CalculateDistance(const Vec3& point, double maxError)
+{
+    ++m_stats.NumQueries;
+
+    // Cell of the point, its position within the cell and the brick holding the cell
+    const double p[3] = {point.X(), point.Y(), point.Z()};
+    const int64_t cellsPerBrick = m_params.BrickSize - 1;
+    int64_t brickCoords[3];
+    int64_t local[3];
+    double frac[3];
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        const double cell = std::floor(p[axis]/m_params.VoxelSize);
+        frac[axis] = p[axis]/m_params.VoxelSize - cell;
+        if(!(std::fabs(cell) < double(cellsPerBrick*MAX_BRICK_COORD)))
+        {
+            return CalculateExactDistance(point, m_params.MaxDist);
+        }
+        const int64_t c = static_cast<int64_t>(cell);
+        brickCoords[axis] = c >= 0 ? c/cellsPerBrick : -((-c + cellsPerBrick - 1)/cellsPerBrick);
+        local[axis] = c - brickCoords[axis]*cellsPerBrick;
+    }
+
+    // Weighted distances to the corners bound the interpolation error
+    double bound = 0.0;
+    for(unsigned corner = 0; corner < 8; ++corner)
+    {
+        double weight = 1.0;
+        double distSq = 0.0;
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            const bool upper = ((corner >> axis) & 1) != 0;
+            const double d = upper ? 1.0 - frac[axis] : frac[axis];
+            weight *= 1.0 - d;
+            distSq += d*d;
+        }
+        bound += weight*std::sqrt(distSq);
+    }
+    if(bound*m_params.VoxelSize > maxError || GetBrickMemory() > m_params.MaxMemory)
+    {
+        return CalculateExactDistance(point, m_params.MaxDist);
+    }
+
+    uint64_t key = 0;
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        key = (key << 21) | static_cast<uint64_t>(brickCoords[axis] + MAX_BRICK_COORD);
+    }
+    bool calculated = false;
+    const Brick& brick = GetBrick(key, brickCoords, calculated);
+
+    const std::size_t n = m_params.BrickSize;
+    const double* s = &brick.Samples[(local[2]*n + local[1])*n + local[0]];
+    const double c[8] = {s[0], s[1], s[n], s[n + 1], s[n*n], s[n*n + 1], s[n*n + n], s[n*n + n + 1]};
+    if(std::find(c, c + 8, std::numeric_limits<double>::infinity()) != c + 8)
+    {
+        return CalculateExactDistance(point, m_params.MaxDist);
+    }
+
+    if(calculated)
+    {
+        ++m_stats.NumMisses;
+    }
+    else
+    {
+        ++m_stats.NumHits;
+    }
+    const double x0 = c[0] + (c[1] - c[0])*frac[0];
+    const double x1 = c[2] + (c[3] - c[2])*frac[0];
+    const double x2 = c[4] + (c[5] - c[4])*frac[0];
+    const double x3 = c[6] + (c[7] - c[6])*frac[0];
+    const double y0 = x0 + (x1 - x0)*frac[1];
+    const double y1 = x2 + (x3 - x2)*frac[1];
+    return y0 + (y1 - y0)*frac[2];
+}
+
+template<typename ProximityQueryMethod>
+void DistanceFieldCache<ProximityQueryMethod>::Clear()
+{
+    m_bricks.clear();
+    m_lru.clear();
+}
+
+template<typename ProximityQueryMethod>
+const typename DistanceFieldCache<ProximityQueryMethod>::Brick&
+DistanceFieldCache<ProximityQueryMethod>::GetBrick(uint64_t key, const int64_t brickCoords[3], bool& calculated)
+{
+    auto it = m_bricks.find(key);
+    if(it != m_bricks.end())
+    {
+        m_lru.splice(m_lru.begin(), m_lru, it->second.Lru);
+        calculated = false;
+        return it->second;
+    }
+
+    while(GetMemoryUsage() + GetBrickMemory() > m_params.MaxMemory)
+    {
+        m_bricks.erase(m_lru.back());
+        m_lru.pop_back();
+        ++m_stats.NumBricksEvicted;
+    }
+
+    Brick& brick = m_bricks[key];
+    FillBrick(brickCoords, brick.Samples);
+    m_lru.push_front(key);
+    brick.Lru = m_lru.begin();
+    calculated = true;
+    return brick;
+}
+
+template<typename ProximityQueryMethod>
+void DistanceFieldCache<ProximityQueryMethod>::FillBrick(const int64_t brickCoords[3], std::vector<double>& samples)const
+{
+    const unsigned n = m_params.BrickSize;
+    const double h = m_params.VoxelSize;
+    const double origin[3] = {double(brickCoords[0]*(n - 1))*h,
+                              double(brickCoords[1]*(n - 1))*h,
+                              double(brickCoords[2]*(n - 1))*h};
+    samples.resize(m_numSamples);
+
+    // Neighbouring samples are h apart, so the previous distance plus h bounds the next
+    // one and lets the query method discard most of the mesh, as in ProximityTracker
+    double previous = std::numeric_limits<double>::infinity();
+    std::size_t i = 0;
+    for(unsigned z = 0; z < n; ++z)
+    {
+        for(unsigned y = 0; y < n; ++y)
+        {
+            for(unsigned x = 0; x < n; ++x, ++i)
+            {
+                const Vec3 sample(origin[0] + x*h, origin[1] + y*h, origin[2] + z*h);
+                const double bound = x != 0 ? previous + h*(1.0 + 1e-9) + 1e-9 : m_params.MaxDist;
+                ClosestPointResult<Vec3> res(Vec3(), m_params.MaxDist, -1);
+                if(bound < m_params.MaxDist)
+                {
+                    res = m_method.CalculateClosestPointImpl(sample, bound);
+                }
+                if(!res.Found())
+                {
+                    res = m_method.CalculateClosestPointImpl(sample, m_params.MaxDist);
+                }
+                previous = res.Found() ? res.Dist : std::numeric_limits<double>::infinity();
+                samples[i] = previous;
+            }
+        }
+    }
+}
+
+template<typename ProximityQueryMethod>
+double DistanceFieldCache<ProximityQueryMethod>::CalculateExactDistance(const Vec3& point, double distThreshold)const
+{
+    return m_method.CalculateClosestPointImpl(point, distThreshold).Dist;
+}
+
+}
@@ -0,0 +1,339 @@
+#include "DynamicAABBTree.h"
+#include <cstdlib>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    // A fat AABB more than this many times the fattening away from a moved AABB is
+    // tightened again, so AABBs that shrink do not keep overly large fat AABBs
+    const double MAX_FATTENING_MULTIPLE = 4.0;
+
+    Bounds Union(const Bounds& a, const Bounds& b)
+    {
+        return Bounds(std::min(a.xMin, b.xMin), std::max(a.xMax, b.xMax),
+                      std::min(a.yMin, b.yMin), std::max(a.yMax, b.yMax),
+                      std::min(a.zMin, b.zMin), std::max(a.zMax, b.zMax));
+    }
+
+    double SurfaceArea(const Bounds& b)
+    {
+        const double dx = b.xMax - b.xMin;
+        const double dy = b.yMax - b.yMin;
+        const double dz = b.zMax - b.zMin;
+        return 2.0*(dx*dy + dy*dz + dz*dx);
+    }
+
+    bool Contains(const Bounds& outer, const Bounds& inner)
+    {
+        return outer.xMin <= inner.xMin && inner.xMax <= outer.xMax &&
+               outer.yMin <= inner.yMin && inner.yMax <= outer.yMax &&
+               outer.zMin <= inner.zMin && inner.zMax <= outer.zMax;
+    }
+
+    // Grows b on every side by fattening times its largest extent
+    Bounds Fatten(const Bounds& b, double fattening)
+    {
+        const double extent = std::max(std::max(b.xMax - b.xMin, b.yMax - b.yMin), b.zMax - b.zMin);
+        const double margin = fattening*extent;
+        return Bounds(b.xMin - margin, b.xMax + margin,
+                      b.yMin - margin, b.yMax + margin,
+                      b.zMin - margin, b.zMax + margin);
+    }
+}
+
+DynamicAABBTree::DynamicAABBTree(const DynamicAABBTreeParams& params):
+    m_params(params),
+    m_root(NULL_NODE),
+    m_freeList(NULL_NODE),
+    m_numProxies(0)
+{
+    if(!(m_params.Fattening >= 0.0))
+    {
+        m_params.Fattening = 0.0;
+    }
+}
+
+int DynamicAABBTree::AllocateNode()
+{
+    int node = m_freeList;
+    if(node == NULL_NODE)
+    {
+        node = static_cast<int>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+    else
+    {
+        m_freeList = m_nodes[node].Parent;
+    }
+
+    Node& n = m_nodes[node];
+    n.Parent = NULL_NODE;
+    n.Child1 = NULL_NODE;
+    n.Child2 = NULL_NODE;
+    n.Height = 0;
+    n.UserData = -1;
+    return node;
+}
+
+void DynamicAABBTree::FreeNode(int node)
+{
+    m_nodes[node].Parent = m_freeList;
+    m_nodes[node].Height = -1;
+    m_freeList = node;
+}
+
+void DynamicAABBTree::CheckProxy(int proxy)const
+{
+    if(proxy < 0 || static_cast<std::size_t>(proxy) >= m_nodes.size() || m_nodes[proxy].Height != 0)
+    {
+        throw std::runtime_error("Invalid DynamicAABBTree proxy");
+    }
+}
+
+int DynamicAABBTree::Insert(const Bounds& bounds, int userData)
+{
+    const int leaf = AllocateNode();
+    m_nodes[leaf].Box = Fatten(bounds, m_params.Fattening);
+    m_nodes[leaf].UserData = userData;
+    InsertLeaf(leaf);
+    ++m_numProxies;
+
+    // Traverse keeps one pending node per level on a fixed size stack
+    if(GetHeight() > static_cast<int>(BVHTree::MAX_DEPTH))
+    {
+        Remove(leaf);
+        throw std::runtime_error("DynamicAABBTree is too deep");
+    }
+    return leaf;
+}
+
+void DynamicAABBTree::Remove(int proxy)
+{
+    CheckProxy(proxy);
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --m_numProxies;
+}
+
+bool DynamicAABBTree::Move(int proxy, const Bounds& bounds)
+{
+    CheckProxy(proxy);
+    const Bounds& fat = m_nodes[proxy].Box;
+    if(Contains(fat, bounds) && Contains(Fatten(bounds, MAX_FATTENING_MULTIPLE*m_params.Fattening), fat))
+    {
+        return false;
+    }
+
+    RemoveLeaf(proxy);
+    m_nodes[proxy].Box = Fatten(bounds, m_params.Fattening);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void DynamicAABBTree::Clear()
+{
+    m_nodes.clear();
+    m_root = NULL_NODE;
+    m_freeList = NULL_NODE;
+    m_numProxies = 0;
+}
+
+void DynamicAABBTree::InsertLeaf(int leaf)
+{
+    if(m_root == NULL_NODE)
+    {
+        m_root = leaf;
+        m_nodes[leaf].Parent = NULL_NODE;
+        return;
+    }
+
+    // Descend to the sibling that increases the surface area of the tree the least. Every
+    // node on the way grows to enclose the leaf, which is paid for below it as well.
+    const Bounds leafBox = m_nodes[leaf].Box;
+    int sibling = m_root;
+    while(!m_nodes[sibling].IsLeaf())
+    {
+        const Node& node = m_nodes[sibling];
+        const double combinedArea = SurfaceArea(Union(node.Box, leafBox));
+        const double cost = 2.0*combinedArea;
+        const double inheritanceCost = 2.0*(combinedArea - SurfaceArea(node.Box));
+
+        double childCosts[2];
+        const int children[2] = {node.Child1, node.Child2};
+        for(unsigned i = 0; i < 2; ++i)
+        {
+            const Node& child = m_nodes[children[i]];
+            const double area = SurfaceArea(Union(child.Box, leafBox));
+            childCosts[i] = (child.IsLeaf() ? area : area - SurfaceArea(child.Box)) + inheritanceCost;
+        }
+
+        if(cost < childCosts[0] && cost < childCosts[1])
+        {
+            break;
+        }
+        sibling = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    // Put a new parent in place of the sibling
+    const int oldParent = m_nodes[sibling].Parent;
+    const int newParent = AllocateNode();
+    Node& parent = m_nodes[newParent];
+    parent.Parent = oldParent;
+    parent.Box = Union(leafBox, m_nodes[sibling].Box);
+    parent.Height = m_nodes[sibling].Height + 1;
+    parent.Child1 = sibling;
+    parent.Child2 = leaf;
+    m_nodes[sibling].Parent = newParent;
+    m_nodes[leaf].Parent = newParent;
+
+    if(oldParent == NULL_NODE)
+    {
+        m_root = newParent;
+    }
+    else if(m_nodes[oldParent].Child1 == sibling)
+    {
+        m_nodes[oldParent].Child1 = newParent;
+    }
+    else
+    {
+        m_nodes[oldParent].Child2 = newParent;
+    }
+
+    Refit(oldParent);
+}
+
+void DynamicAABBTree::RemoveLeaf(int leaf)
+{
+    if(leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    // The sibling takes the place of the parent
+    const int parent = m_nodes[leaf].Parent;
+    const int grandParent = m_nodes[parent].Parent;
+    const int sibling = m_nodes[parent].Child1 == leaf ? m_nodes[parent].Child2 : m_nodes[parent].Child1;
+    m_nodes[sibling].Parent = grandParent;
+    FreeNode(parent);
+
+    if(grandParent == NULL_NODE)
+    {
+        m_root = sibling;
+        return;
+    }
+    if(m_nodes[grandParent].Child1 == parent)
+    {
+        m_nodes[grandParent].Child1 = sibling;
+    }
+    else
+    {
+        m_nodes[grandParent].Child2 = sibling;
+    }
+    Refit(grandParent);
+}
+
+void DynamicAABBTree::Refit(int node)
+{
+    while(node != NULL_NODE)
+    {
+        node = Balance(node);
+
+        Node& n = m_nodes[node];
+        const Node& child1 = m_nodes[n.Child1];
+        const Node& child2 = m_nodes[n.Child2];
+        n.Height = 1 + std::max(child1.Height, child2.Height);
+        n.Box = Union(child1.Box, child2.Box);
+        node = n.Parent;
+    }
+}
+
+int DynamicAABBTree::Balance(int a)
+{
+    // Node a has children b and c. If c is at least two levels taller than b, c takes the
+    // place of a, a becomes a child of c, and the shorter child of c moves over to a. The
+    // taller child of c stays with c. Likewise the other way round.
+    Node& nodeA = m_nodes[a];
+    if(nodeA.IsLeaf())
+    {
+        return a;
+    }
+
+    const int balance = m_nodes[nodeA.Child2].Height - m_nodes[nodeA.Child1].Height;
+    if(balance >= -1 && balance <= 1)
+    {
+        return a;
+    }
+
+    // c is the taller child, b the other one
+    const bool secondTaller = balance > 1;
+    const int b = secondTaller ? nodeA.Child1 : nodeA.Child2;
+    const int c = secondTaller ? nodeA.Child2 : nodeA.Child1;
+    Node& nodeB = m_nodes[b];
+    Node& nodeC = m_nodes[c];
+    const bool firstOfCTaller = m_nodes[nodeC.Child1].Height > m_nodes[nodeC.Child2].Height;
+    const int taller = firstOfCTaller ? nodeC.Child1 : nodeC.Child2;
+    const int shorter = firstOfCTaller ? nodeC.Child2 : nodeC.Child1;
+
+    // c takes the place of a
+    nodeC.Parent = nodeA.Parent;
+    if(nodeC.Parent == NULL_NODE)
+    {
+        m_root = c;
+    }
+    else if(m_nodes[nodeC.Parent].Child1 == a)
+    {
+        m_nodes[nodeC.Parent].Child1 = c;
+    }
+    else
+    {
+        m_nodes[nodeC.Parent].Child2 = c;
+    }
+
+    // a keeps b and gets the shorter child of c
+    nodeA.Parent = c;
+    nodeA.Child1 = b;
+    nodeA.Child2 = shorter;
+    m_nodes[shorter].Parent = a;
+    nodeA.Box = Union(nodeB.Box, m_nodes[shorter].Box);
+    nodeA.Height = 1 + std::max(nodeB.Height, m_nodes[shorter].Height);
+
+    nodeC.Child1 = a;
+    nodeC.Child2 = taller;
+    nodeC.Box = Union(nodeA.Box, m_nodes[taller].Box);
+    nodeC.Height = 1 + std::max(nodeA.Height, m_nodes[taller].Height);
+    return c;
+}
+
+int DynamicAABBTree::GetMaxBalance()const
+{
+    int maxBalance = 0;
+    for(const Node& node : m_nodes)
+    {
+        if(node.Height > 0)
+        {
+            maxBalance = std::max(maxBalance, std::abs(m_nodes[node.Child2].Height - m_nodes[node.Child1].Height));
+        }
+    }
+    return maxBalance;
+}
+
+double DynamicAABBTree::GetAreaRatio()const
+{
+    if(m_root == NULL_NODE)
+    {
+        return 0.0;
+    }
+
+    double totalArea = 0.0;
+    for(const Node& node : m_nodes)
+    {
+        if(node.Height >= 0)
+        {
+            totalArea += SurfaceArea(node.Box);
+        }
+    }
+    const double rootArea = SurfaceArea(m_nodes[m_root].Box);
+    return rootArea > 0.0 ? totalArea/rootArea : totalArea;
+}
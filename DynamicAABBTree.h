@@ -0,0 +1,218 @@
+#pragma once
+
+#include "BVHTree.h"
+#include "Bounds.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief Parameters of a DynamicAABBTree
+*/
+struct DynamicAABBTreeParams
+{
+    explicit DynamicAABBTreeParams(double fattening = 0.1):
+        Fattening(fattening){}
+
+    double Fattening; ///< Every side of a stored AABB is pushed out by this fraction of its largest extent
+};
+
+/**
+* @brief Bounding volume hierarchy over AABBs which are inserted, moved and removed one at
+* a time (Catto, Box2D b2DynamicTree). Every inserted AABB becomes a leaf, or proxy, whose
+* sibling is chosen by the increase of the surface area of the tree. After every insertion
+* and removal the ancestors of the leaf are rebalanced with tree rotations, which lift the
+* taller grandchild of any node whose children differ in height by more than one. This
+* keeps the tree close to balanced, about 1.3*log2(N) high in practice, so insertion and
+* removal cost O(log N).
+*
+* The AABBs stored are fattened, i.e. grown on every side. Moving a proxy within its fat
+* AABB leaves the tree untouched, so small moves cost next to nothing. Queries are
+* conservative, as the fat AABBs enclose the actual ones.
+*
+* Nodes are kept in one array and reused through a free list, so proxies are plain indices
+* which stay valid until the proxy is removed.
+*/
+class DynamicAABBTree
+{
+public:
+
+    static const int NULL_NODE = -1;
+
+    explicit DynamicAABBTree(const DynamicAABBTreeParams& params = DynamicAABBTreeParams());
+
+    /**
+    * Inserts an AABB. Throws if the tree would become deeper than BVHTree::MAX_DEPTH,
+    * which balancing rules out for any number of proxies fitting into an int.
+    * @param userData Returned by GetUserData, e.g. the index of a triangle
+    * @return The proxy of the AABB
+    */
+    int Insert(const Bounds& bounds, int userData);
+
+    /**
+    * Removes a proxy. Throws if proxy is not a proxy of the tree.
+    */
+    void Remove(int proxy);
+
+    /**
+    * Moves a proxy to new bounds. Throws if proxy is not a proxy of the tree.
+    * @return true if the bounds left the fat AABB of the proxy, which was then
+    * reinserted. False if the tree is unchanged.
+    */
+    bool Move(int proxy, const Bounds& bounds);
+
+    /**
+    * Removes all the proxies
+    */
+    void Clear();
+
+    int GetUserData(int proxy)const{return m_nodes[proxy].UserData;}
+    const Bounds& GetFatBounds(int proxy)const{return m_nodes[proxy].Box;}
+    std::size_t GetNumProxies()const{return m_numProxies;}
+
+    /**
+    * @return Number of levels in the tree, zero if it is empty
+    */
+    int GetHeight()const{return m_root == NULL_NODE ? 0 : m_nodes[m_root].Height + 1;}
+
+    /**
+    * @return The largest difference between the heights of the two children of any node.
+    * Leaves may be inserted next to whole subtrees, so this is not bounded by one.
+    */
+    int GetMaxBalance()const;
+
+    /**
+    * @return Sum of the surface areas of all the nodes over that of the root, which grows
+    * as the tree gets worse at separating its proxies
+    */
+    double GetAreaRatio()const;
+
+    /**
+    * Visits the proxies whose fat AABBs are closer to point than bound, nearest subtree
+    * first, see LinearBVH::Traverse.
+    * @param bound Nodes at or beyond this distance are skipped. The visitor may lower it
+    * while the traversal runs, e.g. once a closer triangle has been found.
+    * @param visitor Callable as visitor(int userData, double& bound)
+    */
+    template<typename ProxyVisitor>
+    void Traverse(const Vec3& point, double& bound, ProxyVisitor&& visitor)const;
+
+private:
+
+    struct Node
+    {
+        bool IsLeaf()const{return Child1 == NULL_NODE;}
+
+        Bounds Box;   ///< Fat AABB of a leaf, or the union of the boxes of the children
+        int Parent;   ///< Parent node, or the next free node while the node is unused
+        int Child1;   ///< First child, NULL_NODE for leaves
+        int Child2;   ///< Second child, NULL_NODE for leaves
+        int Height;   ///< Zero for leaves, -1 for unused nodes
+        int UserData; ///< Given to Insert, leaves only
+    };
+
+    int AllocateNode();
+    void FreeNode(int node);
+
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+
+    // Recalculates the boxes and heights of node and its ancestors, rebalancing on the way
+    void Refit(int node);
+
+    // Rotates the taller grandchild of node up if the heights of its children differ by more
+    // than one. Returns the node that took its place.
+    int Balance(int node);
+
+    // Throws unless proxy is a leaf of the tree
+    void CheckProxy(int proxy)const;
+
+    static double SquaredDistance(const Bounds& box, const Vec3& point);
+
+    DynamicAABBTreeParams m_params;
+    std::vector<Node> m_nodes; ///< Used and unused nodes
+    int m_root;                ///< Root node, NULL_NODE if the tree is empty
+    int m_freeList;            ///< First unused node, NULL_NODE if there is none
+    std::size_t m_numProxies;  ///< Number of leaves
+};
+
+inline double DynamicAABBTree::SquaredDistance(const Bounds& box, const Vec3& point)
+{
+    const double px = point.X();
+    const double py = point.Y();
+    const double pz = point.Z();
+    const double dx = px < box.xMin ? box.xMin - px : (px > box.xMax ? px - box.xMax : 0.0);
+    const double dy = py < box.yMin ? box.yMin - py : (py > box.yMax ? py - box.yMax : 0.0);
+    const double dz = pz < box.zMin ? box.zMin - pz : (pz > box.zMax ? pz - box.zMax : 0.0);
+    return dx*dx + dy*dy + dz*dz;
+}
+
+template<typename ProxyVisitor>
+void DynamicAABBTree::Traverse(const Vec3& point, double& bound, ProxyVisitor&& visitor)const
+{
+    if(m_root == NULL_NODE)
+    {
+        return;
+    }
+
+    // Far children still to be visited, with their squared distance at the time they were
+    // pushed. At most one is pending per level of the tree.
+    struct StackEntry
+    {
+        int node;
+        double distSq;
+    };
+    StackEntry stack[BVHTree::MAX_DEPTH];
+    unsigned stackSize = 0;
+
+    const Node* nodes = m_nodes.data();
+    int current = m_root;
+    double currentDistSq = SquaredDistance(nodes[current].Box, point);
+    while(true)
+    {
+        if(currentDistSq < bound*bound)
+        {
+            const Node& node = nodes[current];
+            if(node.IsLeaf())
+            {
+                visitor(node.UserData, bound);
+            }
+            else
+            {
+                int nearChild = node.Child1;
+                int farChild = node.Child2;
+                double nearDistSq = SquaredDistance(nodes[nearChild].Box, point);
+                double farDistSq = SquaredDistance(nodes[farChild].Box, point);
+                if(farDistSq < nearDistSq)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearDistSq, farDistSq);
+                }
+
+                if(farDistSq < bound*bound)
+                {
+                    stack[stackSize].node = farChild;
+                    stack[stackSize].distSq = farDistSq;
+                    ++stackSize;
+                }
+                current = nearChild;
+                currentDistSq = nearDistSq;
+                continue;
+            }
+        }
+
+        if(stackSize == 0)
+        {
+            break;
+        }
+        --stackSize;
+        current = stack[stackSize].node;
+        currentDistSq = stack[stackSize].distSq;
+    }
+}
+
+}
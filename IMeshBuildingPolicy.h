@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/noncopyable.hpp>
+#include <functional>
 #include <vector>
 
 namespace rabbit
@@ -22,6 +23,23 @@ public:
 	*/
     virtual void GeneratePolygons(std::vector<PolygonType>& polygons) = 0;
 
+	/**
+	* Passes the polygons to visitor one at a time, in the order GeneratePolygons would
+	* add them. Consumers which keep something other than the polygons themselves, such
+	* as CompactTriangleMesh, use this, so that concrete classes which can produce the
+	* polygons one by one never hold all of them at once. By default the polygons are
+	* generated with GeneratePolygons first.
+	*/
+    virtual void VisitPolygons(const std::function<void(const PolygonType&)>& visitor)
+    {
+        std::vector<PolygonType> polygons;
+        GeneratePolygons(polygons);
+        for(const PolygonType& polygon : polygons)
+        {
+            visitor(polygon);
+        }
+    }
+
     virtual ~IMeshBuildingPolicy(){}
 };
 
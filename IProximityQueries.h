@@ -1,5 +1,11 @@
 #pragma once
+#include "Ray.h"
+#include <cstddef>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <tuple>
+#include <utility>
 
 namespace rabbit
 {
@@ -7,10 +13,68 @@ namespace rabbit
 template<typename PolygonType>
 class Mesh;
 
+/**
+* @brief Result of a closest point query against a mesh
+* @tparam VertType struct used for representing a point.
+*/
+template<typename VertType>
+struct ClosestPointResult
+{
+    ClosestPointResult():Dist(0.0),PolygonIndex(-1){}
+
+    ClosestPointResult(const VertType& point, double dist, int polygonIndex):
+        Point(point),Dist(dist),PolygonIndex(polygonIndex){}
+
+    bool Found()const{return PolygonIndex >= 0;}
+
+    VertType Point;   ///< Point on the mesh closest to the query point. Legal only if Found()
+    double Dist;      ///< Distance to Point. Set to the distance threshold if nothing was found
+    int PolygonIndex; ///< Index of the closest polygon in the mesh, -1 if nothing was found
+};
+
+/**
+* @brief Caller provided output arrays for a batch of closest point queries, see
+* IProximityQueries::CalculateClosestPoints. Each array must have room for one entry
+* per query point. Arrays which are not needed can be left as nullptr.
+* @tparam VertType struct used for representing a point.
+*/
+template<typename VertType>
+struct ClosestPointBatchResults
+{
+    ClosestPointBatchResults(VertType* closestPoints = nullptr,
+                             double* distances = nullptr,
+                             bool* foundPoints = nullptr,
+                             int* polygonIndices = nullptr):
+        ClosestPoints(closestPoints),
+        Distances(distances),
+        FoundPoints(foundPoints),
+        PolygonIndices(polygonIndices){}
+
+    VertType* ClosestPoints; ///< Closest point on the mesh to each query point
+    double* Distances;       ///< Distance between each query point and its closest point
+    bool* FoundPoints;       ///< true if a point was found within the threshold
+    int* PolygonIndices;     ///< Index of the closest polygon, -1 if no point was found
+
+    /**
+    * @return The same output arrays, advanced by offset entries. Useful for splitting
+    * a batch into smaller ones.
+    */
+    ClosestPointBatchResults<VertType> Offset(std::size_t offset)const
+    {
+        return ClosestPointBatchResults<VertType>(ClosestPoints ? ClosestPoints + offset : nullptr,
+                                                  Distances ? Distances + offset : nullptr,
+                                                  FoundPoints ? FoundPoints + offset : nullptr,
+                                                  PolygonIndices ? PolygonIndices + offset : nullptr);
+    }
+};
+
 /**
 * @brief A simple interface for proximity queries methods. All proximity
 * query methods are expected to derive from this base class and provide
 * the implementation for closest point query.
+* Queries are const and do not modify any state, neither in the base nor in the
+* query methods, so a single object can be queried from many threads at once.
+* See ParallelProximityQueries for running a batch of queries on a thread pool.
 * @tparam PolygonType Type of polygon comprising the mesh.
 * @tparam ProximityQueryMethod Several different algorithms are possible for a given polygon type
 */
@@ -31,20 +95,235 @@ public:
 			  tuple::double minimum distance between point and the polygon
 	*/
     template <typename VertType>
-	std::tuple<VertType, double, bool> CalculateClosestPoint(const VertType& point, double distThreshold);
+	std::tuple<VertType, double, bool> CalculateClosestPoint(const VertType& point, double distThreshold)const;
+
+	/**
+	* As CalculateClosestPoint, but the distance is negative for points inside the mesh. Only
+	* available for query methods implementing CalculateSignedClosestPointImpl, currently
+	* TriMeshProxQueryV4, and only meaningful for closed meshes, see TrianglePseudonormals.
+	* @return The closest point with its signed distance. If nothing was found within the
+	* threshold, Dist is the threshold and tells nothing about the side of the point.
+	*/
+    template <typename VertType>
+    ClosestPointResult<VertType> CalculateSignedClosestPoint(const VertType& point, double distThreshold)const;
+
+	/**
+	* Runs CalculateClosestPoint for each of the points in a contiguous array. Dispatch to the
+	* query method is resolved at compile time and done once per batch.
+	* @param points Array of numPoints query points
+	* @param distThreshold Threshold shared by all the points
+	* @param results Output arrays, entry i holds the result for points[i]
+	*/
+    template <typename VertType>
+    void CalculateClosestPoints(const VertType* points,
+                                std::size_t numPoints,
+                                double distThreshold,
+                                const ClosestPointBatchResults<VertType>& results)const;
+
+	/**
+	* As above, but with a separate threshold per point.
+	* @param distThresholds Array of numPoints thresholds, one for each query point
+	*/
+    template <typename VertType>
+    void CalculateClosestPoints(const VertType* points,
+                                std::size_t numPoints,
+                                const double* distThresholds,
+                                const ClosestPointBatchResults<VertType>& results)const;
+
+	/**
+	* Finds the k polygons closest to point within the specified threshold. Only available for
+	* query methods implementing CalculateKClosestPointsImpl, currently TriMeshProxQueryV1 and
+	* TriMeshProxQueryV4.
+	* @param point Point of interest
+	* @param distThreshold Polygons further away than this value are ignored
+	* @param k Maximum number of polygons to find
+	* @param results Caller provided array with room for k entries. On return the first entries
+	* hold the closest point on each of the polygons found, sorted by increasing distance.
+	* Of polygons at the same distance as the last one returned, which are included is unspecified.
+	* @return Number of polygons found, at most k
+	*/
+    template <typename VertType>
+    std::size_t CalculateKClosestPoints(const VertType& point,
+                                        double distThreshold,
+                                        std::size_t k,
+                                        ClosestPointResult<VertType>* results)const;
+
+	/**
+	* Finds all the polygons closer to point than radius. Only available for query methods
+	* implementing CalculatePolygonsWithinRadiusImpl and IsAnyPolygonWithinRadiusImpl,
+	* currently TriMeshProxQueryV1 and TriMeshProxQueryV4.
+	* @param point Point of interest
+	* @param radius Polygons at this distance or further away are ignored
+	* @param sink Called with the closest point on each polygon found, the distance to it and
+	* the index of the polygon, in no particular order. Anything callable as a
+	* std::function<void(const ClosestPointResult<VertType>&)>.
+	* @return Number of polygons found
+	*/
+    template <typename VertType, typename ResultSink>
+    std::size_t CalculatePolygonsWithinRadius(const VertType& point, double radius, ResultSink&& sink)const;
+
+	/**
+	* As above, but stops as soon as a single polygon is found
+	* @return true if any polygon is closer to point than radius
+	*/
+    template <typename VertType>
+    bool IsAnyPolygonWithinRadius(const VertType& point, double radius)const;
+
+	/**
+	* Finds the first polygon hit by a ray. Only available for query methods implementing
+	* CastRayImpl and IsRayBlockedImpl, currently TriMeshProxQueryV1 and TriMeshProxQueryV4.
+	* @param maxDist Hits at or beyond this distance along the ray are ignored
+	* @return The closest hit, see RayCastResult
+	*/
+    template <typename VertType>
+    RayCastResult<VertType> CastRay(const Ray<VertType>& ray,
+                                    double maxDist = std::numeric_limits<double>::max())const;
+
+	/**
+	* As above, but stops as soon as any polygon is hit, e.g. for visibility tests
+	* @return true if the ray hits a polygon before maxDist
+	*/
+    template <typename VertType>
+    bool IsRayBlocked(const Ray<VertType>& ray,
+                      double maxDist = std::numeric_limits<double>::max())const;
+
+	/**
+	* Runs CastRay for each of the rays in a contiguous array. Dispatch to the query method
+	* is resolved at compile time and done once per batch.
+	* @param results Output array, entry i holds the result for rays[i]
+	*/
+    template <typename VertType>
+    void CastRays(const Ray<VertType>* rays,
+                  std::size_t numRays,
+                  double maxDist,
+                  RayCastResult<VertType>* results)const;
 
 protected:
 	// The destructor is protected to disallow a user holding a handle onto a pointer to this object
     ~IProximityQueries(){}
 
-    std::shared_ptr<Mesh<PolygonType>> m_mesh; ///< Polygonal mesh of interest
+    // Writes the result of a single query to entry i of the output arrays
+    template <typename VertType>
+    static void StoreResult(const ClosestPointResult<VertType>& res,
+                            std::size_t i,
+                            const ClosestPointBatchResults<VertType>& results);
+
+    std::shared_ptr<Mesh<PolygonType>> m_mesh; ///< Polygonal mesh of interest. Null for methods which
+                                               ///< were given the mesh in another form, e.g. CompactTriangleMesh
 };
 
 template<typename PolygonType, typename ProximityQueryMethod>
 template <typename VertType> std::tuple<VertType, double, bool>
-IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint(const VertType& point, double distThreshold)
+IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint(const VertType& point, double distThreshold)const
+{
+    const ClosestPointResult<VertType> res =
+            static_cast<const ProximityQueryMethod*>(this)->CalculateClosestPointImpl(point, distThreshold);
+	return std::make_tuple(res.Point, res.Dist, res.Found());
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+ClosestPointResult<VertType> IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateSignedClosestPoint(const VertType& point,
+                                                                                                               double distThreshold)const
+{
+    return static_cast<const ProximityQueryMethod*>(this)->CalculateSignedClosestPointImpl(point, distThreshold);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+void IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoints(const VertType* points,
+                                                                                  std::size_t numPoints,
+                                                                                  double distThreshold,
+                                                                                  const ClosestPointBatchResults<VertType>& results)const
+{
+    const ProximityQueryMethod* method = static_cast<const ProximityQueryMethod*>(this);
+    for(std::size_t i = 0; i < numPoints; ++i)
+    {
+        StoreResult(method->CalculateClosestPointImpl(points[i], distThreshold), i, results);
+    }
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+void IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoints(const VertType* points,
+                                                                                  std::size_t numPoints,
+                                                                                  const double* distThresholds,
+                                                                                  const ClosestPointBatchResults<VertType>& results)const
+{
+    const ProximityQueryMethod* method = static_cast<const ProximityQueryMethod*>(this);
+    for(std::size_t i = 0; i < numPoints; ++i)
+    {
+        StoreResult(method->CalculateClosestPointImpl(points[i], distThresholds[i]), i, results);
+    }
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+std::size_t IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateKClosestPoints(const VertType& point,
+                                                                                          double distThreshold,
+                                                                                          std::size_t k,
+                                                                                          ClosestPointResult<VertType>* results)const
+{
+    return static_cast<const ProximityQueryMethod*>(this)->CalculateKClosestPointsImpl(point, distThreshold, k, results);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType, typename ResultSink>
+std::size_t IProximityQueries<PolygonType, ProximityQueryMethod>::CalculatePolygonsWithinRadius(const VertType& point,
+                                                                                                double radius,
+                                                                                                ResultSink&& sink)const
+{
+    const std::function<void(const ClosestPointResult<VertType>&)> sinkFunction(std::forward<ResultSink>(sink));
+    return static_cast<const ProximityQueryMethod*>(this)->CalculatePolygonsWithinRadiusImpl(point, radius, sinkFunction);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+bool IProximityQueries<PolygonType, ProximityQueryMethod>::IsAnyPolygonWithinRadius(const VertType& point, double radius)const
+{
+    return static_cast<const ProximityQueryMethod*>(this)->IsAnyPolygonWithinRadiusImpl(point, radius);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+RayCastResult<VertType> IProximityQueries<PolygonType, ProximityQueryMethod>::CastRay(const Ray<VertType>& ray,
+                                                                                      double maxDist)const
+{
+    return static_cast<const ProximityQueryMethod*>(this)->CastRayImpl(ray, maxDist);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+bool IProximityQueries<PolygonType, ProximityQueryMethod>::IsRayBlocked(const Ray<VertType>& ray,
+                                                                        double maxDist)const
+{
+    return static_cast<const ProximityQueryMethod*>(this)->IsRayBlockedImpl(ray, maxDist);
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+void IProximityQueries<PolygonType, ProximityQueryMethod>::CastRays(const Ray<VertType>* rays,
+                                                                    std::size_t numRays,
+                                                                    double maxDist,
+                                                                    RayCastResult<VertType>* results)const
+{
+    const ProximityQueryMethod* method = static_cast<const ProximityQueryMethod*>(this);
+    for(std::size_t i = 0; i < numRays; ++i)
+    {
+        results[i] = method->CastRayImpl(rays[i], maxDist);
+    }
+}
+
+template<typename PolygonType, typename ProximityQueryMethod>
+template <typename VertType>
+void IProximityQueries<PolygonType, ProximityQueryMethod>::StoreResult(const ClosestPointResult<VertType>& res,
+                                                                       std::size_t i,
+                                                                       const ClosestPointBatchResults<VertType>& results)
 {
-	return static_cast<ProximityQueryMethod*>(this)->CalculateClosestPointImpl(point, distThreshold);
+    if(results.ClosestPoints != nullptr) results.ClosestPoints[i] = res.Point;
+    if(results.Distances != nullptr) results.Distances[i] = res.Dist;
+    if(results.FoundPoints != nullptr) results.FoundPoints[i] = res.Found();
+    if(results.PolygonIndices != nullptr) results.PolygonIndices[i] = res.PolygonIndex;
 }
 
 }
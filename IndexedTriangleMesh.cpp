@@ -0,0 +1,276 @@
+#include "IndexedTriangleMesh.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+
+    const std::size_t GRAIN_SIZE = 4096; ///< Vertices per task
+
+    const double MAX_CELL_INDEX = 4611686018427387904.0; ///< 2^62, leaves room for the neighbouring cells
+
+    /**
+    * @brief Cell of the welding grid. Without a tolerance, the bit patterns of the
+    * coordinates themselves, so that only identical vertices share a cell. Unsigned, so
+    * that stepping to a neighbouring cell wraps around instead of overflowing.
+    */
+    struct CellKey
+    {
+        uint64_t x, y, z;
+
+        bool operator==(const CellKey& other)const
+        {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    struct CellKeyHash
+    {
+        std::size_t operator()(const CellKey& key)const
+        {
+            // Large odd multipliers spread neighbouring cells over the table
+            uint64_t h = key.x*0x9E3779B97F4A7C15ull;
+            h ^= key.y*0xC2B2AE3D27D4EB4Full;
+            h ^= key.z*0x165667B19E3779F9ull;
+            return static_cast<std::size_t>(h ^ (h >> 29));
+        }
+    };
+
+    typedef std::unordered_map<CellKey, std::vector<uint32_t>, CellKeyHash> CellMap;
+
+    uint64_t CoordinateKey(double coord, double tolerance)
+    {
+        // Coordinates too far out for the grid, infinite or NaN fall back to their bit
+        // patterns. Those are more than their ulp, and thus the tolerance, apart from any
+        // other coordinate, so only identical ones can be welded anyway.
+        if(tolerance > 0.0)
+        {
+            const double cell = std::floor(coord/tolerance);
+            if(std::fabs(cell) < MAX_CELL_INDEX)
+            {
+                return static_cast<uint64_t>(static_cast<int64_t>(cell));
+            }
+        }
+
+        // Adding zero turns -0.0 into 0.0, which compares equal anyway
+        const double value = coord + 0.0;
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    CellKey KeyOf(const double* vertex, double tolerance)
+    {
+        CellKey key = {CoordinateKey(vertex[0], tolerance),
+                       CoordinateKey(vertex[1], tolerance),
+                       CoordinateKey(vertex[2], tolerance)};
+        return key;
+    }
+
+    // Runs fn(begin, end) over [0, count), on the pool if there is one
+    void ForEachRange(const std::shared_ptr<ThreadPool>& pool,
+                      std::size_t count,
+                      std::size_t grainSize,
+                      const std::function<void(std::size_t, std::size_t)>& fn)
+    {
+        if(pool)
+        {
+            pool->ParallelFor(count, grainSize, fn);
+        }
+        else
+        {
+            fn(0, count);
+        }
+    }
+}
+
+IndexedTriangleMesh::IndexedTriangleMesh(std::shared_ptr<IMeshBuildingPolicy<Tri>> buildingPolicy,
+                                         const VertexWeldParams& params)
+{
+    std::vector<double> coords;
+    buildingPolicy->VisitPolygons([&coords](const Tri& t)
+    {
+        const double values[9] = {t.P0().X(), t.P0().Y(), t.P0().Z(),
+                                  t.P1().X(), t.P1().Y(), t.P1().Z(),
+                                  t.P2().X(), t.P2().Y(), t.P2().Z()};
+        coords.insert(coords.end(), values, values + 9);
+    });
+    Weld(coords.data(), coords.size()/9, params);
+}
+
+IndexedTriangleMesh::IndexedTriangleMesh(const Mesh<Tri>& mesh, const VertexWeldParams& params)
+{
+    const std::vector<Tri>& triangles = mesh.GetPolygons();
+    std::vector<double> coords;
+    coords.reserve(triangles.size()*9);
+    for(const Tri& t : triangles)
+    {
+        const double values[9] = {t.P0().X(), t.P0().Y(), t.P0().Z(),
+                                  t.P1().X(), t.P1().Y(), t.P1().Z(),
+                                  t.P2().X(), t.P2().Y(), t.P2().Z()};
+        coords.insert(coords.end(), values, values + 9);
+    }
+    Weld(coords.data(), triangles.size(), params);
+}
+
+IndexedTriangleMesh::IndexedTriangleMesh(const double* coords,
+                                         std::size_t numTriangles,
+                                         const VertexWeldParams& params)
+{
+    Weld(coords, numTriangles, params);
+}
+
+IndexedTriangleMesh::IndexedTriangleMesh(std::vector<double> vertices, std::vector<uint32_t> indices):
+    m_vertices(std::move(vertices)),
+    m_indices(std::move(indices))
+{
+    if(m_vertices.size() % 3 != 0 || m_indices.size() % 3 != 0)
+    {
+        throw std::runtime_error("Indexed mesh needs three coordinates per vertex and three indices per triangle");
+    }
+    for(uint32_t index : m_indices)
+    {
+        if(index >= GetNumVertices())
+        {
+            throw std::runtime_error("Vertex index out of range in indexed mesh");
+        }
+    }
+}
+
+std::size_t IndexedTriangleMesh::GetMemoryUsage()const
+{
+    return m_vertices.capacity()*sizeof(double) + m_indices.capacity()*sizeof(uint32_t);
+}
+
+void IndexedTriangleMesh::Weld(const double* coords, std::size_t numTriangles, const VertexWeldParams& params)
+{
+    const std::size_t numVertices = numTriangles*3;
+    if(numVertices > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::runtime_error("Too many vertices for an indexed mesh");
+    }
+    const double tolerance = params.Tolerance;
+    const double toleranceSq = tolerance*tolerance;
+
+    // The cells are spread over shards, each of which is filled by a single task
+    const std::size_t numShards = params.Pool ? params.Pool->GetNumThreads() + 1 : 1;
+    std::vector<CellKey> keys(numVertices);
+    std::vector<uint32_t> shards(numVertices);
+    ForEachRange(params.Pool, numVertices, GRAIN_SIZE, [&](std::size_t begin, std::size_t end)
+    {
+        const CellKeyHash hash;
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            keys[i] = KeyOf(coords + 3*i, tolerance);
+            shards[i] = static_cast<uint32_t>(hash(keys[i]) % numShards);
+        }
+    });
+
+    // Counting sort the vertices by shard, keeping them in order within each shard, so
+    // that each task only walks the vertices of its own shard
+    std::vector<std::size_t> shardStart(numShards + 1, 0);
+    for(std::size_t i = 0; i < numVertices; ++i)
+    {
+        ++shardStart[shards[i] + 1];
+    }
+    for(std::size_t shard = 0; shard < numShards; ++shard)
+    {
+        shardStart[shard + 1] += shardStart[shard];
+    }
+    std::vector<uint32_t> byShard(numVertices);
+    {
+        std::vector<std::size_t> next(shardStart.begin(), shardStart.end() - 1);
+        for(std::size_t i = 0; i < numVertices; ++i)
+        {
+            byShard[next[shards[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+    std::vector<uint32_t>().swap(shards);
+
+    // Vertices are added in order, so the vertices of each cell are sorted
+    std::vector<CellMap> cells(numShards);
+    ForEachRange(params.Pool, numShards, 1, [&](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t shard = begin; shard < end; ++shard)
+        {
+            for(std::size_t k = shardStart[shard]; k < shardStart[shard + 1]; ++k)
+            {
+                const uint32_t i = byShard[k];
+                cells[shard][keys[i]].push_back(i);
+            }
+        }
+    });
+    std::vector<uint32_t>().swap(byShard);
+
+    // First vertex within the tolerance of each vertex, which may be the vertex itself
+    std::vector<uint32_t> merged(numVertices);
+    const int reach = tolerance > 0.0 ? 1 : 0;
+    ForEachRange(params.Pool, numVertices, GRAIN_SIZE, [&](std::size_t begin, std::size_t end)
+    {
+        const CellKeyHash hash;
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            const double* vertex = coords + 3*i;
+            uint32_t first = static_cast<uint32_t>(i);
+            for(int dx = -reach; dx <= reach; ++dx)
+            for(int dy = -reach; dy <= reach; ++dy)
+            for(int dz = -reach; dz <= reach; ++dz)
+            {
+                const CellKey key = {keys[i].x + static_cast<uint64_t>(dx),
+                                     keys[i].y + static_cast<uint64_t>(dy),
+                                     keys[i].z + static_cast<uint64_t>(dz)};
+                const CellMap& shard = cells[hash(key) % numShards];
+                const CellMap::const_iterator cell = shard.find(key);
+                if(cell == shard.end())
+                {
+                    continue;
+                }
+                for(uint32_t j : cell->second)
+                {
+                    if(j >= first)
+                    {
+                        break;
+                    }
+                    // Identical vertices are merged even if they are infinite
+                    const double* other = coords + 3*j;
+                    const double distX = vertex[0] - other[0];
+                    const double distY = vertex[1] - other[1];
+                    const double distZ = vertex[2] - other[2];
+                    const bool identical = vertex[0] == other[0] && vertex[1] == other[1] && vertex[2] == other[2];
+                    if(identical || distX*distX + distY*distY + distZ*distZ <= toleranceSq)
+                    {
+                        first = j;
+                        break;
+                    }
+                }
+            }
+            merged[i] = first;
+        }
+    });
+    std::vector<CellMap>().swap(cells);
+
+    // Follow chains of merges down to the first vertex. The vertex merged into always
+    // comes earlier, so it has already been resolved and numbered by the time it is needed.
+    std::vector<uint32_t> newIndex(numVertices);
+    m_vertices.clear();
+    m_indices.resize(numVertices);
+    for(std::size_t i = 0; i < numVertices; ++i)
+    {
+        merged[i] = merged[merged[i]];
+        if(merged[i] == i)
+        {
+            newIndex[i] = static_cast<uint32_t>(m_vertices.size()/3);
+            m_vertices.insert(m_vertices.end(), coords + 3*i, coords + 3*i + 3);
+        }
+        m_indices[i] = newIndex[merged[i]];
+    }
+    m_vertices.shrink_to_fit();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "IMeshBuildingPolicy.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rabbit
+{
+
+template<typename PolygonType> class Mesh;
+class ThreadPool;
+
+/**
+* @brief Parameters for welding the vertices of a triangle soup into an IndexedTriangleMesh
+*/
+struct VertexWeldParams
+{
+    VertexWeldParams(double tolerance = 0.0,
+                     std::shared_ptr<ThreadPool> threadPool = nullptr):
+        Tolerance(tolerance),
+        Pool(threadPool){}
+
+    double Tolerance; ///< Vertices at most this far apart are merged. Zero merges identical vertices only.
+    std::shared_ptr<ThreadPool> Pool; ///< If set, welding runs in parallel on this pool
+};
+
+/**
+* @brief A triangular mesh stored as an array of unique vertices and three vertex indices
+* per triangle. A vertex shared by several triangles is stored once, which takes a fraction
+* of the memory of Mesh<Triangle<Vec3>> or CompactTriangleMesh, and makes the topology of
+* the mesh available: triangles sharing a vertex index share the vertex.
+*
+* Triangle soups, such as the files read by TriangularMeshBuilingPolicy, are turned into
+* an indexed mesh by welding their vertices. Vertices are hashed into a grid whose cells
+* are as large as the tolerance, so only neighbouring cells have to be searched for vertices
+* to merge with. Each vertex is merged into the first vertex within the tolerance of it,
+* in the order of the soup, so chains of close vertices all end up in the first one. The
+* result is the same whether or not welding runs in parallel.
+*/
+class IndexedTriangleMesh : boost::noncopyable
+{
+public:
+
+    /**
+    * Loads a triangle soup with a building policy and welds its vertices
+    */
+    IndexedTriangleMesh(std::shared_ptr<IMeshBuildingPolicy<Triangle<Vec3>>> buildingPolicy,
+                        const VertexWeldParams& params = VertexWeldParams());
+
+    /**
+    * Welds the vertices of the triangles of mesh
+    */
+    IndexedTriangleMesh(const Mesh<Triangle<Vec3>>& mesh,
+                        const VertexWeldParams& params = VertexWeldParams());
+
+    /**
+    * Welds the vertices of a triangle soup
+    * @param coords numTriangles*9 coordinates, x, y and z of each vertex of each triangle
+    */
+    IndexedTriangleMesh(const double* coords,
+                        std::size_t numTriangles,
+                        const VertexWeldParams& params = VertexWeldParams());
+
+    /**
+    * Takes over a mesh which is indexed already. Throws if an index is out of range.
+    * @param vertices x, y and z of each vertex
+    * @param indices Three vertex indices per triangle
+    */
+    IndexedTriangleMesh(std::vector<double> vertices, std::vector<uint32_t> indices);
+
+    std::size_t GetNumVertices()const{return m_vertices.size()/3;}
+    std::size_t GetNumTriangles()const{return m_indices.size()/3;}
+
+    /**
+    * @return x, y and z of each vertex
+    */
+    const std::vector<double>& GetVertices()const{return m_vertices;}
+
+    /**
+    * @return Three vertex indices per triangle
+    */
+    const std::vector<uint32_t>& GetIndices()const{return m_indices;}
+
+    Vec3 GetVertex(std::size_t vertex)const;
+
+    /**
+    * @return Index of vertex id of triangle i
+    */
+    uint32_t GetVertexIndex(std::size_t i, ids id)const{return m_indices[3*i + id];}
+
+    /**
+    * @return Triangle i with its edges and normal calculated from the vertices
+    */
+    Triangle<Vec3> GetTriangle(std::size_t i)const;
+
+    /**
+    * @return Number of bytes used by the vertices and indices
+    */
+    std::size_t GetMemoryUsage()const;
+
+private:
+
+    // Welds the soup and fills m_vertices and m_indices
+    void Weld(const double* coords, std::size_t numTriangles, const VertexWeldParams& params);
+
+    std::vector<double> m_vertices; ///< x, y and z of each unique vertex
+    std::vector<uint32_t> m_indices; ///< Three indices into the vertices per triangle
+};
+
+inline Vec3 IndexedTriangleMesh::GetVertex(std::size_t vertex)const
+{
+    return Vec3(m_vertices[3*vertex], m_vertices[3*vertex + 1], m_vertices[3*vertex + 2]);
+}
+
+inline Triangle<Vec3> IndexedTriangleMesh::GetTriangle(std::size_t i)const
+{
+    return Triangle<Vec3>(GetVertex(m_indices[3*i]), GetVertex(m_indices[3*i + 1]), GetVertex(m_indices[3*i + 2]));
+}
+
+}
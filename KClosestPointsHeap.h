@@ -0,0 +1,94 @@
+#pragma once
+
+#include "IProximityQueries.h"
+#include <algorithm>
+#include <cstddef>
+
+namespace rabbit
+{
+
+/**
+* @brief Collects the k closest of the polygons handed to it in a caller provided array,
+* for implementing IProximityQueries::CalculateKClosestPoints. The array is kept as a max
+* heap on the distance while collecting, so the furthest polygon kept so far is always at
+* the front and gets replaced in O(log k) time. Once k polygons have been collected, only
+* polygons closer than the furthest one can make it in, which gives the query methods a
+* bound to prune against. Nothing is allocated.
+* @tparam VertType struct used for representing a point.
+*/
+template<typename VertType>
+class KClosestPointsHeap
+{
+public:
+
+    /**
+    * @param results Array with room for k entries
+    * @param k Maximum number of polygons to keep
+    * @param distThreshold Polygons further away than this value are not kept
+    */
+    KClosestPointsHeap(ClosestPointResult<VertType>* results, std::size_t k, double distThreshold):
+        m_results(results),
+        m_k(k),
+        m_size(0),
+        m_distThreshold(distThreshold){}
+
+    /**
+    * @return Distance a polygon has to be closer than to be kept. The threshold until
+    * k polygons have been collected, then the distance to the furthest one.
+    */
+    double GetBound()const{return m_size == m_k && m_k != 0 ? m_results[0].Dist : m_distThreshold;}
+
+    /**
+    * Keeps the polygon if it is closer than GetBound(). Of two polygons at the same
+    * distance, the one with the lower index is kept.
+    * @return true if the polygon was kept
+    */
+    bool Push(const VertType& point, double dist, int polygonIndex)
+    {
+        const ClosestPointResult<VertType> res(point, dist, polygonIndex);
+        if(m_size < m_k)
+        {
+            if(!(dist < m_distThreshold))
+            {
+                return false;
+            }
+            m_results[m_size++] = res;
+            std::push_heap(m_results, m_results + m_size, &IsCloser);
+            return true;
+        }
+
+        if(m_k == 0 || !IsCloser(res, m_results[0]))
+        {
+            return false;
+        }
+        // The heap is full here, m_size == m_k
+        std::pop_heap(m_results, m_results + m_k, &IsCloser);
+        m_results[m_k - 1] = res;
+        std::push_heap(m_results, m_results + m_k, &IsCloser);
+        return true;
+    }
+
+    /**
+    * Sorts the polygons kept by increasing distance. No more polygons can be pushed afterwards.
+    * @return Number of polygons kept
+    */
+    std::size_t Finish()
+    {
+        std::sort_heap(m_results, m_results + m_size, &IsCloser);
+        return m_size;
+    }
+
+private:
+
+    static bool IsCloser(const ClosestPointResult<VertType>& a, const ClosestPointResult<VertType>& b)
+    {
+        return a.Dist < b.Dist || (a.Dist == b.Dist && a.PolygonIndex < b.PolygonIndex);
+    }
+
+    ClosestPointResult<VertType>* m_results; ///< Heap of the polygons kept so far, furthest first
+    std::size_t m_k;                         ///< Maximum number of polygons kept
+    std::size_t m_size;                      ///< Number of polygons kept so far
+    double m_distThreshold;                  ///< Polygons have to be closer than this to be kept
+};
+
+}
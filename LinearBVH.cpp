@@ -0,0 +1,228 @@
+#include "LinearBVH.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    // Rounds a double to the nearest float that is not larger than it
+    float RoundDown(double value)
+    {
+        float f = static_cast<float>(value);
+        return f > value ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    // Rounds a double to the nearest float that is not smaller than it
+    float RoundUp(double value)
+    {
+        float f = static_cast<float>(value);
+        return f < value ? std::nextafter(f, std::numeric_limits<float>::infinity()) : f;
+    }
+
+    double SurfaceArea(const LinearBVHNode& node)
+    {
+        const double dx = double(node.BoundsMax[0]) - double(node.BoundsMin[0]);
+        const double dy = double(node.BoundsMax[1]) - double(node.BoundsMin[1]);
+        const double dz = double(node.BoundsMax[2]) - double(node.BoundsMin[2]);
+        return 2.0*(dx*dy + dy*dz + dz*dx);
+    }
+
+    const std::size_t MIN_PARALLEL_REFIT_NODES = 4096; ///< Smaller hierarchies are refitted on the calling thread
+    const std::size_t REFIT_SUBTREES_PER_THREAD = 8;   ///< Subtrees per thread refitted in parallel
+}
+
+LinearBVH::LinearBVH(const BVHTree& tree):
+    m_depth(tree.GetDepth())
+{
+    if(m_depth > BVHTree::MAX_DEPTH)
+    {
+        throw std::runtime_error("BVHTree is too deep to be flattened");
+    }
+
+    if(tree.GetRoot() != nullptr)
+    {
+        m_nodes.reserve(tree.GetNumNodes());
+        Flatten(tree.GetRoot());
+    }
+}
+
+LinearBVH::LinearBVH(std::vector<LinearBVHNode> nodes, std::vector<uint32_t> triIndices):
+    m_nodes(std::move(nodes)),
+    m_triIndices(std::move(triIndices)),
+    m_depth(0)
+{
+    // Children always come after their parent, so the depth of every node is known
+    // by the time it is reached. Ranges are checked so that Traverse stays in bounds.
+    const std::size_t numNodes = m_nodes.size();
+    std::vector<unsigned> depths(numNodes, 0);
+    if(numNodes != 0)
+    {
+        depths[0] = 1;
+    }
+    for(std::size_t i = 0; i < numNodes; ++i)
+    {
+        const LinearBVHNode& node = m_nodes[i];
+        if(depths[i] == 0 || depths[i] > BVHTree::MAX_DEPTH)
+        {
+            throw std::runtime_error("Invalid LinearBVH nodes");
+        }
+        m_depth = std::max(m_depth, depths[i]);
+
+        if(node.IsLeaf())
+        {
+            if(node.Offset > m_triIndices.size() || node.Count > m_triIndices.size() - node.Offset)
+            {
+                throw std::runtime_error("Invalid LinearBVH nodes");
+            }
+            continue;
+        }
+        if(i + 1 >= numNodes || node.Offset <= i + 1 || node.Offset >= numNodes)
+        {
+            throw std::runtime_error("Invalid LinearBVH nodes");
+        }
+        depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+        depths[node.Offset] = std::max(depths[node.Offset], depths[i] + 1);
+    }
+}
+
+void LinearBVH::Flatten(const BVHTree::Node* node)
+{
+    const Bounds b = node->Data().aabb.GetBounds();
+    const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+
+    LinearBVHNode& linearNode = m_nodes.back();
+    linearNode.BoundsMin[0] = RoundDown(b.xMin);
+    linearNode.BoundsMin[1] = RoundDown(b.yMin);
+    linearNode.BoundsMin[2] = RoundDown(b.zMin);
+    linearNode.BoundsMax[0] = RoundUp(b.xMax);
+    linearNode.BoundsMax[1] = RoundUp(b.yMax);
+    linearNode.BoundsMax[2] = RoundUp(b.zMax);
+
+    if(BVHTree::IsLeaf(node))
+    {
+        const std::vector<int>& triIndices = node->Data().triIndices;
+        linearNode.Offset = static_cast<uint32_t>(m_triIndices.size());
+        linearNode.Count = static_cast<uint32_t>(triIndices.size());
+        m_triIndices.insert(m_triIndices.end(), triIndices.begin(), triIndices.end());
+        return;
+    }
+
+    // The first child goes right after its parent, m_nodes may reallocate so the
+    // parent is looked up again by index before recording the second child.
+    Flatten(node->GetLeft());
+    m_nodes[index].Offset = static_cast<uint32_t>(m_nodes.size());
+    m_nodes[index].Count = 0;
+    Flatten(node->GetRight());
+}
+
+uint32_t LinearBVH::GetSubtreeEnd(uint32_t node)const
+{
+    // The second child comes last, and so does the second child's subtree
+    while(!m_nodes[node].IsLeaf())
+    {
+        node = m_nodes[node].Offset;
+    }
+    return node + 1;
+}
+
+void LinearBVH::RefitNode(uint32_t node, const std::function<void(const LinearBVHNode&, double*, double*)>& calcLeafBounds)
+{
+    LinearBVHNode& n = m_nodes[node];
+    if(n.IsLeaf())
+    {
+        double boundsMin[3];
+        double boundsMax[3];
+        calcLeafBounds(n, boundsMin, boundsMax);
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            n.BoundsMin[axis] = RoundDown(boundsMin[axis]);
+            n.BoundsMax[axis] = RoundUp(boundsMax[axis]);
+        }
+        return;
+    }
+
+    // Floats are combined exactly, so the children stay enclosed
+    const LinearBVHNode& first = m_nodes[node + 1];
+    const LinearBVHNode& second = m_nodes[n.Offset];
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        n.BoundsMin[axis] = std::min(first.BoundsMin[axis], second.BoundsMin[axis]);
+        n.BoundsMax[axis] = std::max(first.BoundsMax[axis], second.BoundsMax[axis]);
+    }
+}
+
+void LinearBVH::Refit(const std::function<void(const LinearBVHNode&, double*, double*)>& calcLeafBounds,
+                      const std::shared_ptr<ThreadPool>& pool)
+{
+    const uint32_t numNodes = static_cast<uint32_t>(m_nodes.size());
+    if(!pool || numNodes < MIN_PARALLEL_REFIT_NODES)
+    {
+        for(uint32_t node = numNodes; node-- > 0;)
+        {
+            RefitNode(node, calcLeafBounds);
+        }
+        return;
+    }
+
+    // Split the hierarchy breadth first into subtrees until every thread has a few
+    std::vector<uint32_t> subtrees(1, 0);
+    std::vector<uint32_t> above;
+    const std::size_t numSubtrees = REFIT_SUBTREES_PER_THREAD*(pool->GetNumThreads() + 1);
+    while(subtrees.size() < numSubtrees)
+    {
+        std::vector<uint32_t> next;
+        for(const uint32_t node : subtrees)
+        {
+            if(m_nodes[node].IsLeaf())
+            {
+                next.push_back(node);
+                continue;
+            }
+            above.push_back(node);
+            next.push_back(node + 1);
+            next.push_back(m_nodes[node].Offset);
+        }
+        if(next.size() == subtrees.size())
+        {
+            break;
+        }
+        subtrees.swap(next);
+    }
+
+    pool->ParallelFor(subtrees.size(), 1, [&](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            for(uint32_t node = GetSubtreeEnd(subtrees[i]); node-- > subtrees[i];)
+            {
+                RefitNode(node, calcLeafBounds);
+            }
+        }
+    });
+
+    // Children of the nodes above the subtrees have higher indices, so go backwards
+    std::sort(above.begin(), above.end());
+    for(auto node = above.rbegin(); node != above.rend(); ++node)
+    {
+        RefitNode(*node, calcLeafBounds);
+    }
+}
+
+double LinearBVH::CalcSAHCost(double traversalCost, double intersectionCost)const
+{
+    if(m_nodes.empty())
+    {
+        return 0.0;
+    }
+    double cost = 0.0;
+    for(const LinearBVHNode& node : m_nodes)
+    {
+        cost += SurfaceArea(node)*(node.IsLeaf() ? intersectionCost*node.Count : traversalCost);
+    }
+    const double rootArea = SurfaceArea(m_nodes[0]);
+    return rootArea > 0.0 ? cost/rootArea : cost;
+}
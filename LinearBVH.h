@@ -0,0 +1,439 @@
+#pragma once
+
+#include "BVHTree.h"
+#include "Ray.h"
+#include "Vec3.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace rabbit
+{
+
+class ThreadPool;
+
+/**
+* @brief A node of LinearBVH. Nodes are 32 bytes, so two of them share a cache line.
+* The bounds are stored in single precision, rounded outwards so that the box
+* always encloses the double precision box it was created from.
+*/
+struct LinearBVHNode
+{
+    float BoundsMin[3]; ///< Lower corner of the AABB
+    float BoundsMax[3]; ///< Upper corner of the AABB
+    uint32_t Offset;    ///< Leaves: position of the first triangle in LinearBVH::GetTriIndices()
+                        ///< Interior nodes: index of the second child. The first child is the next node.
+    uint32_t Count;     ///< Number of triangles in a leaf, zero for interior nodes
+
+    bool IsLeaf()const{return Count != 0;}
+
+    /**
+    * @return Squared distance between point and the AABB of the node, zero if the point is inside
+    */
+    double CalcShortestDistanceSqFrom(const Vec3& point)const;
+
+    /**
+    * Slab test of a ray against the AABB of the node
+    * @param origin x, y and z of the origin of the ray
+    * @param invDirection Reciprocals of the x, y and z of its direction, see LinearBVH::PrepareRay
+    * @return Distance along the ray at which it enters the AABB, zero if the origin is inside.
+    * Infinity if the ray misses the AABB or only reaches it at or beyond maxDist.
+    */
+    double CalcRayEntryDist(const double origin[3], const double invDirection[3], double maxDist)const;
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode is expected to be 32 bytes");
+
+/**
+* @brief Pointer free bounding volume hierarchy stored as one contiguous array of
+* nodes in depth first order. The first child of an interior node directly follows
+* it in the array and only the second child is referenced explicitly. The triangles
+* of a leaf are the range [Offset, Offset + Count) of a single reordered index array.
+* Traversing the hierarchy allocates no memory and mostly walks it front to back.
+*/
+class LinearBVH
+{
+public:
+
+    /**
+    * Flattens a BVHTree. The BVHTree is not referenced after construction.
+    */
+    explicit LinearBVH(const BVHTree& tree);
+
+    /**
+    * Takes over the arrays of a hierarchy flattened before, e.g. one read back from a
+    * BVHCache. Throws if the nodes do not form a hierarchy in the layout described above,
+    * or if it is deeper than BVHTree::MAX_DEPTH.
+    */
+    LinearBVH(std::vector<LinearBVHNode> nodes, std::vector<uint32_t> triIndices);
+
+    const std::vector<LinearBVHNode>& GetNodes()const{return m_nodes;}
+    const std::vector<uint32_t>& GetTriIndices()const{return m_triIndices;}
+    unsigned GetDepth()const{return m_depth;}
+
+    /**
+    * Recalculates the AABBs of all the nodes after the triangles have moved, keeping the
+    * structure of the hierarchy. Leaves are bounded by calcLeafBounds and every interior
+    * node by the union of its children, bottom up. Children always come after their
+    * parent, so this is a single backwards pass over the nodes. A subtree is a contiguous
+    * range of nodes, so given a pool, disjoint subtrees are refitted in parallel and only
+    * the few nodes above them are left to the calling thread.
+    * @param calcLeafBounds Called as calcLeafBounds(leaf, boundsMin, boundsMax) to get the
+    * double precision AABB of the triangles of a leaf. Called from several threads at once
+    * if pool is set.
+    */
+    void Refit(const std::function<void(const LinearBVHNode&, double*, double*)>& calcLeafBounds,
+               const std::shared_ptr<ThreadPool>& pool = nullptr);
+
+    /**
+    * @return The surface area heuristic cost of the hierarchy as its AABBs are now, see
+    * BVHTree::GetSAHCost. Grows as a refitted hierarchy degrades.
+    */
+    double CalcSAHCost(double traversalCost, double intersectionCost)const;
+
+    /**
+    * Visits the leaves of the hierarchy whose AABBs are closer to point than bound,
+    * nearest subtree first.
+    * @param bound Nodes at or beyond this distance are skipped. The visitor may lower it
+    * while the traversal runs, e.g. once a closer triangle has been found.
+    * @param visitor Callable as visitor(const uint32_t* triIndices, uint32_t count, double& bound)
+    */
+    template<typename LeafVisitor>
+    void Traverse(const Vec3& point, double& bound, LeafVisitor&& visitor)const;
+
+    /**
+    * Visits the leaves of the hierarchy whose AABBs are hit by the ray before maxDist,
+    * in the order the ray enters their subtrees.
+    * @param maxDist Nodes the ray enters at or beyond this distance are skipped. The visitor
+    * may lower it while the traversal runs, e.g. once a triangle has been hit.
+    * @param visitor Callable as visitor(const uint32_t* triIndices, uint32_t count, double& maxDist)
+    */
+    template<typename LeafVisitor>
+    void TraverseRay(const Ray<Vec3>& ray, double& maxDist, LeafVisitor&& visitor)const;
+
+    /**
+    * Visits the leaves whose AABBs are hit by any of a bundle of rays, each before its own
+    * maximum distance. Every node is loaded once for the whole bundle and the slab tests
+    * of all the rays are vectorised, so bundles of rays which start close together and
+    * point in similar directions, and therefore visit mostly the same nodes, are cheaper
+    * than traversing for each ray on its own.
+    * @tparam BundleSize Number of rays, at most 64. Fixed at compile time so that the loops
+    * over the rays can be fully vectorised. Bundles can be padded with rays of maximum distance zero.
+    * @param maxDists One per ray, the visitor may lower them while the traversal runs
+    * @param visitor Callable as visitor(const uint32_t* triIndices, uint32_t count, uint64_t rayMask).
+    * Bit i of rayMask is set if ray i hits the AABB of the leaf.
+    */
+    template<std::size_t BundleSize, typename LeafVisitor>
+    void TraverseRays(const Ray<Vec3>* rays, double* maxDists, LeafVisitor&& visitor)const;
+
+private:
+
+    // Origin and reciprocal direction of a ray as used by LinearBVHNode::CalcRayEntryDist.
+    // Zero components of the direction get a huge reciprocal instead of an infinite one,
+    // so that rays running within the plane of a face of an AABB do not produce NaNs.
+    static void PrepareRay(const Ray<Vec3>& ray, double origin[3], double invDirection[3]);
+
+    // Appends the subtree under node to m_nodes in depth first order
+    void Flatten(const BVHTree::Node* node);
+
+    // One past the last node of the subtree under node, whose nodes are [node, end)
+    uint32_t GetSubtreeEnd(uint32_t node)const;
+
+    // Recalculates the AABB of a node from its triangles or from its children
+    void RefitNode(uint32_t node, const std::function<void(const LinearBVHNode&, double*, double*)>& calcLeafBounds);
+
+    std::vector<LinearBVHNode> m_nodes;  ///< Nodes in depth first order, m_nodes[0] is the root
+    std::vector<uint32_t> m_triIndices; ///< Triangle indices ordered by leaf
+    unsigned m_depth;                   ///< Depth of the hierarchy
+};
+
+inline double LinearBVHNode::CalcShortestDistanceSqFrom(const Vec3& point)const
+{
+    const double px = point.X();
+    const double py = point.Y();
+    const double pz = point.Z();
+
+    const double dx = px < BoundsMin[0] ? BoundsMin[0] - px : (px > BoundsMax[0] ? px - BoundsMax[0] : 0.0);
+    const double dy = py < BoundsMin[1] ? BoundsMin[1] - py : (py > BoundsMax[1] ? py - BoundsMax[1] : 0.0);
+    const double dz = pz < BoundsMin[2] ? BoundsMin[2] - pz : (pz > BoundsMax[2] ? pz - BoundsMax[2] : 0.0);
+    return dx*dx + dy*dy + dz*dz;
+}
+
+inline double LinearBVHNode::CalcRayEntryDist(const double origin[3], const double invDirection[3], double maxDist)const
+{
+    double entry = 0.0;
+    double exit = maxDist;
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        const double t0 = (BoundsMin[axis] - origin[axis])*invDirection[axis];
+        const double t1 = (BoundsMax[axis] - origin[axis])*invDirection[axis];
+        entry = std::max(entry, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return entry <= exit && entry < maxDist ? entry : std::numeric_limits<double>::infinity();
+}
+
+inline void LinearBVH::PrepareRay(const Ray<Vec3>& ray, double origin[3], double invDirection[3])
+{
+    const double direction[3] = {ray.Direction.X(), ray.Direction.Y(), ray.Direction.Z()};
+    origin[0] = ray.Origin.X();
+    origin[1] = ray.Origin.Y();
+    origin[2] = ray.Origin.Z();
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        invDirection[axis] = direction[axis] != 0.0 ? 1.0/direction[axis] :
+                             (std::signbit(direction[axis]) ? -1.0 : 1.0)*std::numeric_limits<double>::max();
+    }
+}
+
+template<typename LeafVisitor>
+void LinearBVH::Traverse(const Vec3& point, double& bound, LeafVisitor&& visitor)const
+{
+    if(m_nodes.empty())
+    {
+        return;
+    }
+
+    // Far children still to be visited, with their squared distance at the time they were
+    // pushed. The builder guarantees at most one pending entry per level of the tree.
+    struct StackEntry
+    {
+        uint32_t node;
+        double distSq;
+    };
+    StackEntry stack[BVHTree::MAX_DEPTH];
+    unsigned stackSize = 0;
+
+    const LinearBVHNode* nodes = m_nodes.data();
+    uint32_t current = 0;
+    double currentDistSq = nodes[0].CalcShortestDistanceSqFrom(point);
+    while(true)
+    {
+        if(currentDistSq < bound*bound)
+        {
+            const LinearBVHNode& node = nodes[current];
+            if(node.IsLeaf())
+            {
+                visitor(m_triIndices.data() + node.Offset, node.Count, bound);
+            }
+            else
+            {
+                uint32_t nearChild = current + 1;
+                uint32_t farChild = node.Offset;
+                double nearDistSq = nodes[nearChild].CalcShortestDistanceSqFrom(point);
+                double farDistSq = nodes[farChild].CalcShortestDistanceSqFrom(point);
+                if(farDistSq < nearDistSq)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearDistSq, farDistSq);
+                }
+
+                if(farDistSq < bound*bound)
+                {
+                    stack[stackSize].node = farChild;
+                    stack[stackSize].distSq = farDistSq;
+                    ++stackSize;
+                }
+                current = nearChild;
+                currentDistSq = nearDistSq;
+                continue;
+            }
+        }
+
+        if(stackSize == 0)
+        {
+            break;
+        }
+        --stackSize;
+        current = stack[stackSize].node;
+        currentDistSq = stack[stackSize].distSq;
+    }
+}
+
+template<typename LeafVisitor>
+void LinearBVH::TraverseRay(const Ray<Vec3>& ray, double& maxDist, LeafVisitor&& visitor)const
+{
+    if(m_nodes.empty())
+    {
+        return;
+    }
+
+    double origin[3];
+    double invDirection[3];
+    PrepareRay(ray, origin, invDirection);
+
+    // Far children still to be visited, with the distance at which the ray enters them
+    struct StackEntry
+    {
+        uint32_t node;
+        double entryDist;
+    };
+    StackEntry stack[BVHTree::MAX_DEPTH];
+    unsigned stackSize = 0;
+
+    const LinearBVHNode* nodes = m_nodes.data();
+    uint32_t current = 0;
+    double currentEntryDist = nodes[0].CalcRayEntryDist(origin, invDirection, maxDist);
+    while(true)
+    {
+        if(currentEntryDist < maxDist)
+        {
+            const LinearBVHNode& node = nodes[current];
+            if(node.IsLeaf())
+            {
+                visitor(m_triIndices.data() + node.Offset, node.Count, maxDist);
+            }
+            else
+            {
+                uint32_t nearChild = current + 1;
+                uint32_t farChild = node.Offset;
+                double nearEntryDist = nodes[nearChild].CalcRayEntryDist(origin, invDirection, maxDist);
+                double farEntryDist = nodes[farChild].CalcRayEntryDist(origin, invDirection, maxDist);
+                if(farEntryDist < nearEntryDist)
+                {
+                    std::swap(nearChild, farChild);
+                    std::swap(nearEntryDist, farEntryDist);
+                }
+
+                if(farEntryDist < maxDist)
+                {
+                    stack[stackSize].node = farChild;
+                    stack[stackSize].entryDist = farEntryDist;
+                    ++stackSize;
+                }
+                current = nearChild;
+                currentEntryDist = nearEntryDist;
+                continue;
+            }
+        }
+
+        if(stackSize == 0)
+        {
+            break;
+        }
+        --stackSize;
+        current = stack[stackSize].node;
+        currentEntryDist = stack[stackSize].entryDist;
+    }
+}
+
+template<std::size_t BundleSize, typename LeafVisitor>
+void LinearBVH::TraverseRays(const Ray<Vec3>* rays, double* maxDists, LeafVisitor&& visitor)const
+{
+    static_assert(BundleSize > 0 && BundleSize <= 64, "Bundles hold between 1 and 64 rays");
+    if(m_nodes.empty())
+    {
+        return;
+    }
+
+    // Rays are stored axis by axis, so the slab tests of all the rays can be vectorised
+    double origins[3][BundleSize];
+    double invDirections[3][BundleSize];
+    for(std::size_t i = 0; i < BundleSize; ++i)
+    {
+        double origin[3];
+        double invDirection[3];
+        PrepareRay(rays[i], origin, invDirection);
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            origins[axis][i] = origin[axis];
+            invDirections[axis][i] = invDirection[axis];
+        }
+    }
+
+    // Rays of the bundle which hit a node, out of those in rayMask. All the rays are tested
+    // without branches, which is cheaper than skipping those not in the mask.
+    auto calcRayMask = [&](const LinearBVHNode& node, uint64_t rayMask)
+    {
+        uint8_t isHit[BundleSize];
+        for(std::size_t i = 0; i < BundleSize; ++i)
+        {
+            double entry = 0.0;
+            double exit = maxDists[i];
+            for(unsigned axis = 0; axis < 3; ++axis)
+            {
+                const double t0 = (node.BoundsMin[axis] - origins[axis][i])*invDirections[axis][i];
+                const double t1 = (node.BoundsMax[axis] - origins[axis][i])*invDirections[axis][i];
+                entry = std::max(entry, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            }
+            isHit[i] = (entry <= exit) & (entry < maxDists[i]);
+        }
+        uint64_t hits = 0;
+        for(std::size_t i = 0; i < BundleSize; ++i)
+        {
+            hits |= uint64_t(isHit[i]) << i;
+        }
+        return hits & rayMask;
+    };
+
+    // Distance at which ray i enters a node
+    auto calcEntryDist = [&](const LinearBVHNode& node, std::size_t i)
+    {
+        const double origin[3] = {origins[0][i], origins[1][i], origins[2][i]};
+        const double invDirection[3] = {invDirections[0][i], invDirections[1][i], invDirections[2][i]};
+        return node.CalcRayEntryDist(origin, invDirection, maxDists[i]);
+    };
+
+    // Far children still to be visited, with the rays which hit their parent. The rays are
+    // tested against the child itself once it is popped, as their distances may have shrunk.
+    struct StackEntry
+    {
+        uint32_t node;
+        uint64_t rayMask;
+    };
+    StackEntry stack[BVHTree::MAX_DEPTH];
+    unsigned stackSize = 0;
+
+    const LinearBVHNode* nodes = m_nodes.data();
+    uint32_t current = 0;
+    uint64_t currentRayMask = BundleSize == 64 ? ~uint64_t(0) : (uint64_t(1) << (BundleSize % 64)) - 1;
+    while(true)
+    {
+        currentRayMask = calcRayMask(nodes[current], currentRayMask);
+        if(currentRayMask != 0)
+        {
+            const LinearBVHNode& node = nodes[current];
+            if(node.IsLeaf())
+            {
+                visitor(m_triIndices.data() + node.Offset, node.Count, currentRayMask);
+            }
+            else
+            {
+                // The first ray of the bundle which hit the node decides which child is nearer
+                std::size_t first = 0;
+                while(((currentRayMask >> first) & 1) == 0)
+                {
+                    ++first;
+                }
+                uint32_t nearChild = current + 1;
+                uint32_t farChild = node.Offset;
+                if(calcEntryDist(nodes[farChild], first) < calcEntryDist(nodes[nearChild], first))
+                {
+                    std::swap(nearChild, farChild);
+                }
+
+                stack[stackSize].node = farChild;
+                stack[stackSize].rayMask = currentRayMask;
+                ++stackSize;
+                current = nearChild;
+                continue;
+            }
+        }
+
+        if(stackSize == 0)
+        {
+            break;
+        }
+        --stackSize;
+        current = stack[stackSize].node;
+        currentRayMask = stack[stackSize].rayMask;
+    }
+}
+
+}
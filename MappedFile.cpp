@@ -0,0 +1,50 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace rabbit;
+
+MappedFile::MappedFile(const std::string& fileName):
+    m_fileName(fileName),
+    m_data(nullptr),
+    m_size(0)
+{
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("Unable to open file:" + fileName);
+    }
+
+    struct stat status;
+    if(fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Unable to read the size of file:" + fileName);
+    }
+
+    m_size = static_cast<std::size_t>(status.st_size);
+    if(m_size != 0)
+    {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Unable to map file:" + fileName);
+        }
+        m_data = static_cast<const char*>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
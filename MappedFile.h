@@ -0,0 +1,37 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+#include <string>
+
+namespace rabbit
+{
+
+/**
+* @brief A read only view of a whole file mapped into memory. Pages are only read
+* from disk when they are first touched, so opening even a very large file is cheap.
+* The mapping is released when the object is destroyed.
+*/
+class MappedFile : boost::noncopyable
+{
+public:
+
+    /**
+    * Maps the file. Throws if the file can not be opened or mapped.
+    */
+    explicit MappedFile(const std::string& fileName);
+
+    ~MappedFile();
+
+    const char* GetData()const{return m_data;}
+    std::size_t GetSize()const{return m_size;}
+    const std::string& GetFileName()const{return m_fileName;}
+
+private:
+
+    std::string m_fileName;
+    const char* m_data; ///< Start of the mapping, nullptr for an empty file
+    std::size_t m_size; ///< Size of the file in bytes
+};
+
+}
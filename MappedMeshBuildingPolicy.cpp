@@ -0,0 +1,94 @@
+#include "MappedMeshBuildingPolicy.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace rabbit;
+
+MappedMeshBuildingPolicy::MappedMeshBuildingPolicy(const std::string& fileName):
+    m_file(new MappedFile(fileName)),
+    m_header(nullptr),
+    m_vertices(nullptr),
+    m_indices(nullptr)
+{
+    if(!IsLittleEndian())
+    {
+        throw std::runtime_error("Binary mesh files can only be read on little endian machines");
+    }
+
+    const std::size_t fileSize = m_file->GetSize();
+    if(fileSize < sizeof(BinaryMeshHeader) ||
+       std::memcmp(m_file->GetData(), BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC)) != 0)
+    {
+        throw std::runtime_error("Not a binary mesh file:" + fileName);
+    }
+
+    // The mapping is page aligned, so the header and blocks are suitably aligned
+    m_header = reinterpret_cast<const BinaryMeshHeader*>(m_file->GetData());
+    if(m_header->Version != BINARY_MESH_VERSION)
+    {
+        throw std::runtime_error("Unsupported binary mesh file version:" + fileName);
+    }
+
+    // Counts are checked against the file size first, so the sizes below can not overflow
+    if(m_header->NumVertices > fileSize/(3*sizeof(double)) ||
+       m_header->NumTriangles > fileSize/(3*sizeof(uint32_t)) ||
+       m_header->VertexOffset > fileSize ||
+       m_header->IndexOffset > fileSize)
+    {
+        throw std::runtime_error("Corrupt binary mesh file:" + fileName);
+    }
+
+    const uint64_t vertexBytes = m_header->NumVertices*3*sizeof(double);
+    const uint64_t indexBytes = m_header->NumTriangles*3*sizeof(uint32_t);
+    const bool indexed = m_header->IndexOffset != 0;
+    if(m_header->VertexOffset % sizeof(double) != 0 ||
+       m_header->VertexOffset + vertexBytes > fileSize ||
+       (!indexed && m_header->NumVertices != m_header->NumTriangles*3) ||
+       (indexed && (m_header->IndexOffset % sizeof(uint32_t) != 0 ||
+                    m_header->IndexOffset + indexBytes > fileSize)))
+    {
+        throw std::runtime_error("Corrupt binary mesh file:" + fileName);
+    }
+
+    m_vertices = reinterpret_cast<const double*>(m_file->GetData() + m_header->VertexOffset);
+    if(indexed)
+    {
+        m_indices = reinterpret_cast<const uint32_t*>(m_file->GetData() + m_header->IndexOffset);
+    }
+}
+
+void MappedMeshBuildingPolicy::CheckIndices()const
+{
+    if(m_indices != nullptr)
+    {
+        const uint32_t* end = m_indices + 3*GetNumTriangles();
+        for(const uint32_t* index = m_indices; index != end; ++index)
+        {
+            if(*index >= m_header->NumVertices)
+            {
+                throw std::runtime_error("Vertex index out of range in binary mesh file:" + m_file->GetFileName());
+            }
+        }
+    }
+}
+
+void MappedMeshBuildingPolicy::GeneratePolygons(std::vector<Triangle<Vec3>>& triangles)
+{
+    CheckIndices();
+    const std::size_t numTriangles = GetNumTriangles();
+    triangles.reserve(triangles.size() + numTriangles);
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        triangles.emplace_back(GetVertex(i, zero), GetVertex(i, one), GetVertex(i, two));
+    }
+}
+
+void MappedMeshBuildingPolicy::VisitPolygons(const std::function<void(const Triangle<Vec3>&)>& visitor)
+{
+    CheckIndices();
+    const std::size_t numTriangles = GetNumTriangles();
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        visitor(Triangle<Vec3>(GetVertex(i, zero), GetVertex(i, one), GetVertex(i, two)));
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "IMeshBuildingPolicy.h"
+#include "BinaryMeshFormat.h"
+#include "MappedFile.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace rabbit
+{
+
+/**
+* @brief Reads a binary mesh file (see BinaryMeshHeader) by mapping it into memory.
+* Nothing is parsed or copied on construction, apart from validating the header: the
+* vertices and indices are used in place, and only read from disk once touched.
+* GeneratePolygons builds the triangles of a Mesh from them, VisitPolygons passes them on
+* one at a time, and CompactTriangleMesh and other consumers can read the vertex and index
+* blocks directly.
+*/
+class MappedMeshBuildingPolicy : public IMeshBuildingPolicy<Triangle<Vec3>>
+{
+public:
+
+    /**
+    * Maps the file. Throws if it does not exist, is not a binary mesh file, has an
+    * unsupported version or is truncated.
+    */
+    explicit MappedMeshBuildingPolicy(const std::string& fileName);
+
+    /**
+    * Interface implementation for the base class
+    * @param triangles The triangle vector which are to be populated
+    */
+    virtual void GeneratePolygons(std::vector<Triangle<Vec3>>& triangles) override;
+
+    /**
+    * Interface implementation for the base class, without building all the triangles
+    */
+    virtual void VisitPolygons(const std::function<void(const Triangle<Vec3>&)>& visitor) override;
+
+    /**
+    * Throws unless every vertex index is in range, which GetVertex relies on
+    */
+    void CheckIndices()const;
+
+    const BinaryMeshHeader& GetHeader()const{return *m_header;}
+    std::size_t GetNumVertices()const{return static_cast<std::size_t>(m_header->NumVertices);}
+    std::size_t GetNumTriangles()const{return static_cast<std::size_t>(m_header->NumTriangles);}
+
+    /**
+    * @return x, y, z of each vertex, GetNumVertices()*3 doubles
+    */
+    const double* GetVertices()const{return m_vertices;}
+
+    /**
+    * @return Vertex indices of each triangle, GetNumTriangles()*3 of them, or
+    * nullptr if the file has no index block
+    */
+    const uint32_t* GetIndices()const{return m_indices;}
+
+    /**
+    * @return Vertex id of triangle i
+    */
+    Vec3 GetVertex(std::size_t i, ids id)const;
+
+private:
+
+    std::unique_ptr<MappedFile> m_file;
+    const BinaryMeshHeader* m_header;
+    const double* m_vertices;
+    const uint32_t* m_indices;
+};
+
+inline Vec3 MappedMeshBuildingPolicy::GetVertex(std::size_t i, ids id)const
+{
+    const std::size_t vertex = m_indices != nullptr ? m_indices[3*i + id] : 3*i + id;
+    const double* coords = m_vertices + 3*vertex;
+    return Vec3(coords[0], coords[1], coords[2]);
+}
+
+}
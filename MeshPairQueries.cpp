@@ -0,0 +1,409 @@
+#include "MeshPairQueries.h"
+#include "TriMeshProxQueryV4.h"
+#include "TriangleDistance.h"
+#include "TriangleIntersection.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace rabbit;
+namespace
+{
+    /**
+    * @brief AABB as center and half extents, which are cheaper to transform and compare
+    */
+    struct Box
+    {
+        double Center[3];
+        double HalfExtents[3];
+    };
+
+    Box BoxOf(const LinearBVHNode& node)
+    {
+        Box box;
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            box.Center[axis] = 0.5*(double(node.BoundsMin[axis]) + double(node.BoundsMax[axis]));
+            box.HalfExtents[axis] = 0.5*(double(node.BoundsMax[axis]) - double(node.BoundsMin[axis]));
+        }
+        return box;
+    }
+
+    // AABB enclosing the box of node after transforming it
+    Box TransformedBoxOf(const LinearBVHNode& node, const RigidTransform& transform)
+    {
+        const Box local = BoxOf(node);
+        const Vec3 center = transform.Apply(Vec3(local.Center[0], local.Center[1], local.Center[2]));
+        Box box;
+        box.Center[0] = center.X();
+        box.Center[1] = center.Y();
+        box.Center[2] = center.Z();
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            box.HalfExtents[i] = std::fabs(transform.Rotation[i][0])*local.HalfExtents[0] +
+                                 std::fabs(transform.Rotation[i][1])*local.HalfExtents[1] +
+                                 std::fabs(transform.Rotation[i][2])*local.HalfExtents[2];
+        }
+        return box;
+    }
+
+    double CalcDistanceSq(const Box& a, const Box& b)
+    {
+        double distSq = 0.0;
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            const double gap = std::fabs(a.Center[axis] - b.Center[axis]) - a.HalfExtents[axis] - b.HalfExtents[axis];
+            distSq += gap > 0.0 ? gap*gap : 0.0;
+        }
+        return distSq;
+    }
+
+    bool Overlap(const Box& a, const Box& b)
+    {
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            if(std::fabs(a.Center[axis] - b.Center[axis]) > a.HalfExtents[axis] + b.HalfExtents[axis])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Squared half diagonal, which unlike the volume also orders flat boxes by size
+    double CalcSizeSq(const Box& box)
+    {
+        return box.HalfExtents[0]*box.HalfExtents[0] + box.HalfExtents[1]*box.HalfExtents[1] + box.HalfExtents[2]*box.HalfExtents[2];
+    }
+
+    Box BoxOf(const Vec3 vertices[3])
+    {
+        Box box;
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            const double a = axis == 0 ? vertices[0].X() : (axis == 1 ? vertices[0].Y() : vertices[0].Z());
+            const double b = axis == 0 ? vertices[1].X() : (axis == 1 ? vertices[1].Y() : vertices[1].Z());
+            const double c = axis == 0 ? vertices[2].X() : (axis == 1 ? vertices[2].Y() : vertices[2].Z());
+            const double lo = std::min(a, std::min(b, c));
+            const double hi = std::max(a, std::max(b, c));
+            box.Center[axis] = 0.5*(lo + hi);
+            box.HalfExtents[axis] = 0.5*(hi - lo);
+        }
+        return box;
+    }
+
+    void GetVertices(const TriangleSoA& triangles, std::size_t i, Vec3 vertices[3])
+    {
+        const Vec3 p0(triangles.GetP0(0)[i], triangles.GetP0(1)[i], triangles.GetP0(2)[i]);
+        vertices[0] = p0;
+        vertices[1] = p0 + Vec3(triangles.GetP0P1(0)[i], triangles.GetP0P1(1)[i], triangles.GetP0P1(2)[i]);
+        vertices[2] = p0 + Vec3(triangles.GetP0P2(0)[i], triangles.GetP0P2(1)[i], triangles.GetP0P2(2)[i]);
+    }
+
+    /**
+    * @brief Pair of nodes still to be visited, with the squared distance between their
+    * AABBs at the time they were pushed
+    */
+    struct NodePair
+    {
+        uint32_t NodeA;
+        uint32_t NodeB;
+        Box BoxA;
+        Box BoxB; ///< In the coordinates of mesh A
+        double DistSq;
+    };
+
+    const std::size_t MIN_PARALLEL_TRIANGLES = 2048; ///< Smaller pairs of meshes are traversed on the calling thread
+    const std::size_t FRONT_SIZE_PER_THREAD = 8;     ///< Node pairs per thread the parallel traversal starts from
+}
+
+MeshDistanceResult MeshPairQueries::CalculateMinDistance(const RigidTransform& transformB, double distThreshold)const
+{
+    MeshDistanceResult result;
+    result.Dist = distThreshold;
+    const std::vector<LinearBVHNode>& nodesA = m_meshA.GetBVH().GetNodes();
+    const std::vector<LinearBVHNode>& nodesB = m_meshB.GetBVH().GetNodes();
+    if(nodesA.empty() || nodesB.empty())
+    {
+        return result;
+    }
+    const TriangleSoA& trianglesA = m_meshA.GetTriangles();
+    const TriangleSoA& trianglesB = m_meshB.GetTriangles();
+
+    // Every pair popped pushes at most two, and every split goes one level down either
+    // hierarchy, so the stack never holds more than the sum of their depths plus one
+    NodePair stack[2*BVHTree::MAX_DEPTH + 1];
+    unsigned stackSize = 0;
+    stack[stackSize].NodeA = 0;
+    stack[stackSize].NodeB = 0;
+    stack[stackSize].BoxA = BoxOf(nodesA[0]);
+    stack[stackSize].BoxB = TransformedBoxOf(nodesB[0], transformB);
+    stack[stackSize].DistSq = CalcDistanceSq(stack[0].BoxA, stack[0].BoxB);
+    ++stackSize;
+
+    double best = distThreshold;
+    std::size_t bestA = 0;
+    std::size_t bestB = 0;
+    Vec3 a[3];
+    Vec3 b[3];
+    while(stackSize != 0 && best > 0.0)
+    {
+        const NodePair pair = stack[--stackSize];
+        if(!(pair.DistSq < best*best))
+        {
+            continue;
+        }
+
+        const LinearBVHNode& nodeA = nodesA[pair.NodeA];
+        const LinearBVHNode& nodeB = nodesB[pair.NodeB];
+        if(nodeA.IsLeaf() && nodeB.IsLeaf())
+        {
+            for(uint32_t j = nodeB.Offset; j < nodeB.Offset + nodeB.Count; ++j)
+            {
+                GetVertices(trianglesB, j, b);
+                for(unsigned k = 0; k < 3; ++k)
+                {
+                    b[k] = transformB.Apply(b[k]);
+                }
+                const Box boxB = BoxOf(b);
+                for(uint32_t i = nodeA.Offset; i < nodeA.Offset + nodeA.Count; ++i)
+                {
+                    // The AABBs of the triangles are much cheaper to compare than the triangles
+                    GetVertices(trianglesA, i, a);
+                    if(!(CalcDistanceSq(BoxOf(a), boxB) < best*best))
+                    {
+                        continue;
+                    }
+                    const TriangleDistanceResult res = CalcTriangleDistance(a, b, best);
+                    if(res.Dist < best)
+                    {
+                        best = res.Dist;
+                        bestA = i;
+                        bestB = j;
+                        result.PointA = res.PointA;
+                        result.PointB = res.PointB;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Split the node with the larger box, or the one which is not a leaf
+        const bool splitA = !nodeA.IsLeaf() && (nodeB.IsLeaf() || CalcSizeSq(pair.BoxA) >= CalcSizeSq(pair.BoxB));
+        NodePair children[2] = {pair, pair};
+        if(splitA)
+        {
+            children[0].NodeA = pair.NodeA + 1;
+            children[1].NodeA = nodeA.Offset;
+            children[0].BoxA = BoxOf(nodesA[children[0].NodeA]);
+            children[1].BoxA = BoxOf(nodesA[children[1].NodeA]);
+        }
+        else
+        {
+            children[0].NodeB = pair.NodeB + 1;
+            children[1].NodeB = nodeB.Offset;
+            children[0].BoxB = TransformedBoxOf(nodesB[children[0].NodeB], transformB);
+            children[1].BoxB = TransformedBoxOf(nodesB[children[1].NodeB], transformB);
+        }
+        children[0].DistSq = CalcDistanceSq(children[0].BoxA, children[0].BoxB);
+        children[1].DistSq = CalcDistanceSq(children[1].BoxA, children[1].BoxB);
+
+        // The nearer pair goes on top, so that it is visited first
+        const unsigned nearer = children[1].DistSq < children[0].DistSq ? 1 : 0;
+        for(const unsigned c : {1 - nearer, nearer})
+        {
+            if(children[c].DistSq < best*best)
+            {
+                stack[stackSize++] = children[c];
+            }
+        }
+    }
+
+    if(best < distThreshold)
+    {
+        const std::vector<uint32_t>& triIndicesA = m_meshA.GetBVH().GetTriIndices();
+        const std::vector<uint32_t>& triIndicesB = m_meshB.GetBVH().GetTriIndices();
+        result.Dist = best;
+        result.PolygonIndexA = static_cast<int>(triIndicesA[bestA]);
+        result.PolygonIndexB = static_cast<int>(triIndicesB[bestB]);
+    }
+    return result;
+}
+
+bool MeshPairQueries::CalculateAnyOverlap(const RigidTransform& transformB)const
+{
+    std::vector<TrianglePair> pairs;
+    FindOverlaps(transformB, true, pairs);
+    return !pairs.empty();
+}
+
+std::vector<TrianglePair> MeshPairQueries::CalculateOverlaps(const RigidTransform& transformB)const
+{
+    std::vector<TrianglePair> pairs;
+    FindOverlaps(transformB, false, pairs);
+
+    // Report the triangles by their indices in the meshes
+    const std::vector<uint32_t>& triIndicesA = m_meshA.GetBVH().GetTriIndices();
+    const std::vector<uint32_t>& triIndicesB = m_meshB.GetBVH().GetTriIndices();
+    for(TrianglePair& pair : pairs)
+    {
+        pair.PolygonIndexA = static_cast<int>(triIndicesA[pair.PolygonIndexA]);
+        pair.PolygonIndexB = static_cast<int>(triIndicesB[pair.PolygonIndexB]);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+void MeshPairQueries::FindOverlaps(const RigidTransform& transformB,
+                                   bool stopAtFirst,
+                                   std::vector<TrianglePair>& pairs)const
+{
+    const std::vector<LinearBVHNode>& nodesA = m_meshA.GetBVH().GetNodes();
+    const std::vector<LinearBVHNode>& nodesB = m_meshB.GetBVH().GetNodes();
+    if(nodesA.empty() || nodesB.empty())
+    {
+        return;
+    }
+    const TriangleSoA& trianglesA = m_meshA.GetTriangles();
+    const TriangleSoA& trianglesB = m_meshB.GetTriangles();
+
+    // Splits the node with the larger box, or the one which is not a leaf, and appends the
+    // children whose boxes still overlap. Returns false for a pair of leaves.
+    auto split = [&](const NodePair& pair, std::vector<NodePair>& out)
+    {
+        const LinearBVHNode& nodeA = nodesA[pair.NodeA];
+        const LinearBVHNode& nodeB = nodesB[pair.NodeB];
+        if(nodeA.IsLeaf() && nodeB.IsLeaf())
+        {
+            return false;
+        }
+        const bool splitA = !nodeA.IsLeaf() && (nodeB.IsLeaf() || CalcSizeSq(pair.BoxA) >= CalcSizeSq(pair.BoxB));
+        for(unsigned c = 0; c < 2; ++c)
+        {
+            NodePair child = pair;
+            if(splitA)
+            {
+                child.NodeA = c == 0 ? pair.NodeA + 1 : nodeA.Offset;
+                child.BoxA = BoxOf(nodesA[child.NodeA]);
+            }
+            else
+            {
+                child.NodeB = c == 0 ? pair.NodeB + 1 : nodeB.Offset;
+                child.BoxB = TransformedBoxOf(nodesB[child.NodeB], transformB);
+            }
+            if(Overlap(child.BoxA, child.BoxB))
+            {
+                out.push_back(child);
+            }
+        }
+        return true;
+    };
+
+    NodePair root;
+    root.NodeA = 0;
+    root.NodeB = 0;
+    root.BoxA = BoxOf(nodesA[0]);
+    root.BoxB = TransformedBoxOf(nodesB[0], transformB);
+    root.DistSq = 0.0;
+    if(!Overlap(root.BoxA, root.BoxB))
+    {
+        return;
+    }
+
+    // Expand the front breadth first until every thread has a few pairs to start from
+    std::vector<NodePair> front(1, root);
+    const bool parallel = m_pool && trianglesA.Size() + trianglesB.Size() >= MIN_PARALLEL_TRIANGLES;
+    const std::size_t frontSize = parallel ? FRONT_SIZE_PER_THREAD*(m_pool->GetNumThreads() + 1) : 1;
+    while(front.size() < frontSize)
+    {
+        std::vector<NodePair> next;
+        bool expanded = false;
+        for(const NodePair& pair : front)
+        {
+            if(!split(pair, next))
+            {
+                next.push_back(pair);
+            }
+            else
+            {
+                expanded = true;
+            }
+        }
+        front.swap(next);
+        if(!expanded)
+        {
+            break;
+        }
+    }
+
+    // Every pair of the front collects its own results, which keeps the threads apart
+    std::vector<std::vector<TrianglePair>> frontPairs(front.size());
+    std::atomic<bool> found(false);
+    auto traverse = [&](std::size_t begin, std::size_t end)
+    {
+        std::vector<NodePair> stack;
+        Vec3 a[3];
+        Vec3 b[3];
+        for(std::size_t f = begin; f < end; ++f)
+        {
+            stack.assign(1, front[f]);
+            while(!stack.empty())
+            {
+                if(stopAtFirst && found.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+                const NodePair pair = stack.back();
+                stack.pop_back();
+                if(split(pair, stack))
+                {
+                    continue;
+                }
+
+                const LinearBVHNode& nodeA = nodesA[pair.NodeA];
+                const LinearBVHNode& nodeB = nodesB[pair.NodeB];
+                for(uint32_t j = nodeB.Offset; j < nodeB.Offset + nodeB.Count; ++j)
+                {
+                    GetVertices(trianglesB, j, b);
+                    for(unsigned k = 0; k < 3; ++k)
+                    {
+                        b[k] = transformB.Apply(b[k]);
+                    }
+                    const Box boxB = BoxOf(b);
+                    for(uint32_t i = nodeA.Offset; i < nodeA.Offset + nodeA.Count; ++i)
+                    {
+                        GetVertices(trianglesA, i, a);
+                        if(Overlap(BoxOf(a), boxB) && TrianglesIntersect(a, b))
+                        {
+                            frontPairs[f].push_back(TrianglePair(static_cast<int>(i), static_cast<int>(j)));
+                            if(stopAtFirst)
+                            {
+                                found.store(true, std::memory_order_relaxed);
+                                return;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    if(parallel && front.size() > 1)
+    {
+        m_pool->ParallelFor(front.size(), 1, traverse);
+    }
+    else
+    {
+        traverse(0, front.size());
+    }
+
+    for(const std::vector<TrianglePair>& p : frontPairs)
+    {
+        pairs.insert(pairs.end(), p.begin(), p.end());
+        if(stopAtFirst && !pairs.empty())
+        {
+            pairs.resize(1);
+            return;
+        }
+    }
+}
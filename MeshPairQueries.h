@@ -0,0 +1,129 @@
+#pragma once
+
+#include "RigidTransform.h"
+#include "ThreadPool.h"
+#include "Vec3.h"
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace rabbit
+{
+
+class TriMeshProxQueryV4;
+
+/**
+* @brief Result of a distance query between two meshes
+*/
+struct MeshDistanceResult
+{
+    MeshDistanceResult():Dist(0.0),PolygonIndexA(-1),PolygonIndexB(-1){}
+
+    bool Found()const{return PolygonIndexA >= 0;}
+
+    Vec3 PointA;       ///< Point of mesh A closest to mesh B. Legal only if Found()
+    Vec3 PointB;       ///< Point of mesh B closest to mesh A, in the coordinates of mesh A. Legal only if Found()
+    double Dist;       ///< Distance between PointA and PointB. Set to the distance threshold if nothing was found
+    int PolygonIndexA; ///< Index of the triangle of mesh A holding PointA, -1 if nothing was found
+    int PolygonIndexB; ///< Index of the triangle of mesh B holding PointB, -1 if nothing was found
+};
+
+/**
+* @brief Pair of intersecting triangles, one from either mesh
+*/
+struct TrianglePair
+{
+    TrianglePair():PolygonIndexA(-1),PolygonIndexB(-1){}
+    TrianglePair(int polygonIndexA, int polygonIndexB):PolygonIndexA(polygonIndexA),PolygonIndexB(polygonIndexB){}
+
+    bool operator<(const TrianglePair& other)const
+    {
+        return PolygonIndexA < other.PolygonIndexA ||
+               (PolygonIndexA == other.PolygonIndexA && PolygonIndexB < other.PolygonIndexB);
+    }
+
+    bool operator==(const TrianglePair& other)const
+    {
+        return PolygonIndexA == other.PolygonIndexA && PolygonIndexB == other.PolygonIndexB;
+    }
+
+    int PolygonIndexA; ///< Index of the triangle of mesh A
+    int PolygonIndexB; ///< Index of the triangle of mesh B
+};
+
+/**
+* @brief Proximity queries between two triangular meshes, each preprocessed by a
+* TriMeshProxQueryV4. Mesh B is placed relative to mesh A by a rigid transform, so the
+* same pair of hierarchies serves any relative position of the two meshes.
+*
+* Both hierarchies are traversed together, starting from the pair of roots. A pair of nodes
+* is skipped if their AABBs are further apart than the closest pair of triangles found so
+* far; otherwise the node with the larger AABB is split and the nearer of the two new
+* pairs is visited first. The AABBs of mesh B are transformed into the frame of mesh A on
+* the fly, as the AABBs enclosing the rotated boxes. Pairs of leaves are resolved by
+* CalcTriangleDistance, so minima between edges, or a vertex and a face, of either mesh
+* are all found.
+*
+* Overlap queries traverse both hierarchies in the same way but only descend into pairs
+* of nodes whose AABBs overlap, and test pairs of leaves with TrianglesIntersect. Given a
+* thread pool, the traversal is first expanded breadth first into a front of node pairs,
+* which are then traversed depth first in parallel.
+*
+* Queries are const, so a single object can be queried from many threads at once.
+*/
+class MeshPairQueries
+{
+public:
+
+    /**
+    * @param meshA Query method of the first mesh. Must outlive this object.
+    * @param meshB Query method of the second mesh. Must outlive this object. Can be meshA.
+    * @param pool If set, overlap queries between large meshes run in parallel on this pool
+    */
+    MeshPairQueries(const TriMeshProxQueryV4& meshA,
+                    const TriMeshProxQueryV4& meshB,
+                    std::shared_ptr<ThreadPool> pool = nullptr):
+        m_meshA(meshA),
+        m_meshB(meshB),
+        m_pool(pool){}
+
+    /**
+    * Calculates the least distance between the two meshes
+    * @param transformB Maps the coordinates of mesh B into those of mesh A
+    * @param distThreshold Pairs of triangles this far apart or further are ignored, which lets
+    * the traversal skip everything beyond it, e.g. for checking a clearance
+    * @return The closest pair of triangles. Distance zero if the meshes intersect.
+    */
+    MeshDistanceResult CalculateMinDistance(const RigidTransform& transformB = RigidTransform(),
+                                            double distThreshold = std::numeric_limits<double>::max())const;
+
+    /**
+    * Checks whether the meshes intersect, stopping at the first pair of intersecting triangles
+    * @param transformB Maps the coordinates of mesh B into those of mesh A
+    */
+    bool CalculateAnyOverlap(const RigidTransform& transformB = RigidTransform())const;
+
+    /**
+    * Finds every pair of intersecting triangles
+    * @param transformB Maps the coordinates of mesh B into those of mesh A
+    * @return The pairs of intersecting triangles, sorted by PolygonIndexA and then
+    * PolygonIndexB, so the result does not depend on the number of threads
+    */
+    std::vector<TrianglePair> CalculateOverlaps(const RigidTransform& transformB = RigidTransform())const;
+
+private:
+
+    /**
+    * Collects intersecting pairs of triangles, as indices into the triangles of the
+    * hierarchies, into pairs. With stopAtFirst set, at most one pair is collected.
+    */
+    void FindOverlaps(const RigidTransform& transformB,
+                      bool stopAtFirst,
+                      std::vector<TrianglePair>& pairs)const;
+
+    const TriMeshProxQueryV4& m_meshA; ///< Hierarchy and triangles of mesh A
+    const TriMeshProxQueryV4& m_meshB; ///< Hierarchy and triangles of mesh B
+    std::shared_ptr<ThreadPool> m_pool; ///< Threads overlap queries run on, can be null
+};
+
+}
@@ -10,7 +10,8 @@ namespace rabbit
 struct NodeData
 {
     NodeData(const AABB<Vec3>& aabb3):
-        aabb(aabb3){}
+        aabb(aabb3),
+        dist(0.0){}
 
     AABB<Vec3> aabb;
     std::vector<int> triIndices;
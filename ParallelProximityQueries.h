@@ -0,0 +1,77 @@
+#pragma once
+
+#include "IProximityQueries.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <memory>
+
+namespace rabbit
+{
+
+/**
+* @brief Runs batches of closest point queries on a ThreadPool. The batch is split into
+* chunks of grainSize points and every chunk is answered by
+* IProximityQueries::CalculateClosestPoints on whichever thread picks it up. Since every
+* query is independent and writes only its own output entries, the results do not
+* depend on the number of threads or on how the chunks were scheduled.
+* @tparam ProximityQueryMethod Any class deriving from IProximityQueries
+*/
+template<typename ProximityQueryMethod>
+class ParallelProximityQueries
+{
+public:
+
+    /**
+    * @param method Query method used to answer the queries. Must outlive this object.
+    * @param pool Thread pool the queries are run on. Can be shared with other users.
+    * @param grainSize Number of points processed as one unit of work
+    */
+    ParallelProximityQueries(const ProximityQueryMethod& method,
+                             std::shared_ptr<ThreadPool> pool,
+                             std::size_t grainSize = 256):
+        m_method(method),
+        m_pool(pool),
+        m_grainSize(grainSize){}
+
+	/**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoints
+	*/
+    template <typename VertType>
+    void CalculateClosestPoints(const VertType* points,
+                                std::size_t numPoints,
+                                double distThreshold,
+                                const ClosestPointBatchResults<VertType>& results)const
+    {
+        const ProximityQueryMethod& method = m_method;
+        m_pool->ParallelFor(numPoints, m_grainSize, [&](std::size_t begin, std::size_t end)
+        {
+            method.CalculateClosestPoints(points + begin, end - begin, distThreshold, results.Offset(begin));
+        });
+    }
+
+	/**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoints
+	*/
+    template <typename VertType>
+    void CalculateClosestPoints(const VertType* points,
+                                std::size_t numPoints,
+                                const double* distThresholds,
+                                const ClosestPointBatchResults<VertType>& results)const
+    {
+        const ProximityQueryMethod& method = m_method;
+        m_pool->ParallelFor(numPoints, m_grainSize, [&](std::size_t begin, std::size_t end)
+        {
+            method.CalculateClosestPoints(points + begin, end - begin, distThresholds + begin, results.Offset(begin));
+        });
+    }
+
+    std::size_t GetGrainSize()const{return m_grainSize;}
+    void SetGrainSize(std::size_t grainSize){m_grainSize = grainSize;}
+
+private:
+    const ProximityQueryMethod& m_method; ///< Method answering the queries
+    std::shared_ptr<ThreadPool> m_pool;   ///< Threads the queries are run on
+    std::size_t m_grainSize;              ///< Number of points per unit of work
+};
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "IProximityQueries.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <tuple>
+
+namespace rabbit
+{
+
+/**
+* @brief Counts of how often ProximityTracker could use its warm start
+*/
+struct TrackerStats
+{
+    TrackerStats():NumQueries(0), NumWarmStarts(0), NumHits(0){}
+
+    std::size_t NumQueries;    ///< Number of queries answered
+    std::size_t NumWarmStarts; ///< Queries which started from a bound given by the previous result
+    std::size_t NumHits;       ///< Warm starts which found the closest point without falling back to a full query
+
+    /**
+    * @return Fraction of the warm starts which were hits, zero if there were none
+    */
+    double GetHitRate()const{return NumWarmStarts != 0 ? double(NumHits)/NumWarmStarts : 0.0;}
+};
+
+/**
+* @brief Answers closest point queries for a point which moves a little between queries,
+* such as a probe stepping along a path. The previous closest point is a point on the mesh,
+* so the distance from the new point to it bounds the distance to the mesh from above. The
+* query is first run with that bound as its threshold, which lets the query method discard
+* almost everything straight away. If the query method was also given a way to look up the
+* triangles, the distance to the previous closest triangle is used, which is tighter still.
+*
+* Only if nothing is found within the bound, meaning the bound was too tight for rounding
+* reasons, is the query run again with the actual threshold. Either way the result is
+* the same as asking the query method directly, up to ties between triangles at the same
+* distance. Unlike the query methods a tracker has state, so each thread needs its own.
+* @tparam ProximityQueryMethod Any class deriving from IProximityQueries over Triangle<Vec3>
+*/
+template<typename ProximityQueryMethod>
+class ProximityTracker
+{
+public:
+
+    /**
+    * @param method Query method used to answer the queries. Must outlive this object.
+    * @param getTriangle Optional, returns the triangle of the mesh with the given index
+    */
+    explicit ProximityTracker(const ProximityQueryMethod& method,
+                              std::function<Triangle<Vec3>(std::size_t)> getTriangle = nullptr):
+        m_method(method),
+        m_getTriangle(getTriangle),
+        m_previous(Vec3(), 0.0, -1){}
+
+	/**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
+	*/
+    std::tuple<Vec3, double, bool> CalculateClosestPoint(const Vec3& point, double distThreshold)
+    {
+        const ClosestPointResult<Vec3> res = CalculateClosestPointImpl(point, distThreshold);
+        return std::make_tuple(res.Point, res.Dist, res.Found());
+    }
+
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point, double distThreshold)
+    {
+        ++m_stats.NumQueries;
+        if(m_previous.Found())
+        {
+            double bound = (point - m_previous.Point).magnitude();
+            if(m_getTriangle)
+            {
+                const Triangle<Vec3> t = m_getTriangle(static_cast<std::size_t>(m_previous.PolygonIndex));
+                bound = std::min(bound, t.CalcShortestDistanceFrom(point, bound).Dist);
+            }
+
+            // Query methods only accept points strictly closer than the threshold, and may
+            // not calculate the distance to the previous triangle in exactly the same way
+            bound = bound*(1.0 + WARM_START_SLACK) + WARM_START_SLACK;
+            if(bound < distThreshold)
+            {
+                ++m_stats.NumWarmStarts;
+                const ClosestPointResult<Vec3> res = m_method.CalculateClosestPointImpl(point, bound);
+                if(res.Found())
+                {
+                    ++m_stats.NumHits;
+                    m_previous = res;
+                    return res;
+                }
+            }
+        }
+
+        const ClosestPointResult<Vec3> res = m_method.CalculateClosestPointImpl(point, distThreshold);
+        m_previous = res;
+        return res;
+    }
+
+    /**
+    * Forgets the previous result, e.g. when the probe jumps to another place
+    */
+    void Reset(){m_previous = ClosestPointResult<Vec3>(Vec3(), 0.0, -1);}
+
+    const TrackerStats& GetStats()const{return m_stats;}
+    void ResetStats(){m_stats = TrackerStats();}
+
+private:
+
+    static constexpr double WARM_START_SLACK = 1e-9; ///< Relative and absolute widening of the bound
+
+    const ProximityQueryMethod& m_method;                   ///< Method answering the queries
+    std::function<Triangle<Vec3>(std::size_t)> m_getTriangle; ///< Looks up triangles, may be empty
+    ClosestPointResult<Vec3> m_previous;                    ///< Result of the previous query
+    TrackerStats m_stats;
+};
+
+template<typename ProximityQueryMethod>
+constexpr double ProximityTracker<ProximityQueryMethod>::WARM_START_SLACK;
+
+}
@@ -0,0 +1,24 @@
+#include "QueryStats.h"
+
+using namespace rabbit;
+
+thread_local std::size_t QueryStats::s_trianglesTested = 0;
+
+bool QueryStats::IsEnabled()
+{
+#if defined(RABBIT_QUERY_STATS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::size_t QueryStats::GetTrianglesTested()
+{
+    return s_trianglesTested;
+}
+
+void QueryStats::Reset()
+{
+    s_trianglesTested = 0;
+}
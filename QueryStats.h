@@ -0,0 +1,49 @@
+#pragma once
+
+#include "RabbitConfig.h"
+#include <cstddef>
+
+namespace rabbit
+{
+
+/**
+* @brief Counts the point to triangle distances calculated on the calling thread, so that
+* benchmarks can tell how many triangles a query method looks at per query. Every
+* distance calculated by Triangle::CalcShortestDistanceFrom,
+* TriangleQueryRecord::CalcShortestDistanceFrom and TriangleSoA::CalcClosestPoints is
+* counted, whichever method or algorithm asked for it.
+*
+* The count is only kept if the library is built with the CMake option RABBIT_QUERY_STATS,
+* as it costs an increment in the innermost loops. Otherwise IsEnabled returns false and
+* the count stays zero. The option is recorded in RabbitConfig.h, so code including this
+* header always agrees with the library on it.
+*/
+struct QueryStats
+{
+    /**
+    * @return true if the library was built with RABBIT_QUERY_STATS
+    */
+    static bool IsEnabled();
+
+    static void CountTrianglesTested(std::size_t count)
+    {
+#if defined(RABBIT_QUERY_STATS)
+        s_trianglesTested += count;
+#else
+        (void)count;
+#endif
+    }
+
+    /**
+    * @return Number of distances calculated on this thread since the last Reset
+    */
+    static std::size_t GetTrianglesTested();
+
+    static void Reset();
+
+private:
+
+    static thread_local std::size_t s_trianglesTested; ///< Defined in QueryStats.cpp
+};
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+namespace rabbit
+{
+
+/**
+* @brief A ray starting at Origin and running along Direction. The points of the ray are
+* Origin + Direction*t for t > 0, so distances along the ray are measured in multiples of
+* the length of Direction, which does not have to be a unit vector.
+* @tparam VertType struct used for representing a point.
+*/
+template<typename VertType>
+struct Ray
+{
+    Ray(){}
+    Ray(const VertType& origin, const VertType& direction):
+        Origin(origin),Direction(direction){}
+
+    VertType Origin;    ///< Start of the ray, not part of it
+    VertType Direction; ///< Direction of the ray
+};
+
+/**
+* @brief Result of casting a ray against a mesh
+* @tparam VertType struct used for representing a point.
+*/
+template<typename VertType>
+struct RayCastResult
+{
+    RayCastResult():Dist(0.0),PolygonIndex(-1){}
+
+    RayCastResult(const VertType& point, double dist, int polygonIndex):
+        Point(point),Dist(dist),PolygonIndex(polygonIndex){}
+
+    bool Found()const{return PolygonIndex >= 0;}
+
+    VertType Point;   ///< Point where the ray hits the mesh. Legal only if Found()
+    double Dist;      ///< Distance along the ray to Point. Set to the maximum distance if nothing was hit
+    int PolygonIndex; ///< Index of the polygon hit, -1 if nothing was hit
+};
+
+}
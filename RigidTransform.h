@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Vec3.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace rabbit
+{
+
+/**
+* @brief Rotation followed by a translation, p' = Rotation*p + Translation, e.g. for placing
+* one mesh relative to another without copying its triangles.
+*/
+struct RigidTransform
+{
+    /**
+    * Creates the identity
+    */
+    RigidTransform():Translation(0.0, 0.0, 0.0)
+    {
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            for(unsigned j = 0; j < 3; ++j)
+            {
+                Rotation[i][j] = i == j ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    /**
+    * Throws if rotation is not a rotation matrix, i.e. not orthonormal with determinant one
+    * @param rotation Row major 3x3 matrix
+    */
+    RigidTransform(const double rotation[3][3], const Vec3& translation);
+
+    /**
+    * @param axis Axis of the rotation, does not have to be a unit vector. Throws if it is zero.
+    * @param angle Counter clockwise angle of the rotation around axis, in radians
+    */
+    static RigidTransform FromAxisAngle(const Vec3& axis, double angle, const Vec3& translation);
+
+    Vec3 Apply(const Vec3& p)const{return Rotate(p) + Translation;}
+
+    /**
+    * @return v rotated but not translated, for directions
+    */
+    Vec3 Rotate(const Vec3& v)const
+    {
+        return Vec3(Rotation[0][0]*v.X() + Rotation[0][1]*v.Y() + Rotation[0][2]*v.Z(),
+                    Rotation[1][0]*v.X() + Rotation[1][1]*v.Y() + Rotation[1][2]*v.Z(),
+                    Rotation[2][0]*v.X() + Rotation[2][1]*v.Y() + Rotation[2][2]*v.Z());
+    }
+
+    RigidTransform Inverse()const;
+
+    double Rotation[3][3]; ///< Row major rotation matrix
+    Vec3 Translation;      ///< Applied after the rotation
+};
+
+inline RigidTransform::RigidTransform(const double rotation[3][3], const Vec3& translation):
+    Translation(translation)
+{
+    const double TOLERANCE = 1e-9;
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        for(unsigned j = 0; j < 3; ++j)
+        {
+            Rotation[i][j] = rotation[i][j];
+        }
+    }
+
+    // Rows have to be orthonormal and right handed
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        for(unsigned j = 0; j < 3; ++j)
+        {
+            const double dot = rotation[i][0]*rotation[j][0] + rotation[i][1]*rotation[j][1] + rotation[i][2]*rotation[j][2];
+            if(!(std::fabs(dot - (i == j ? 1.0 : 0.0)) < TOLERANCE))
+            {
+                throw std::runtime_error("Rigid transform needs an orthonormal rotation matrix");
+            }
+        }
+    }
+    const Vec3 x(rotation[0][0], rotation[0][1], rotation[0][2]);
+    const Vec3 y(rotation[1][0], rotation[1][1], rotation[1][2]);
+    const Vec3 z(rotation[2][0], rotation[2][1], rotation[2][2]);
+    if(Vec3::dotProduct(Vec3::crossProduct(x, y), z) < 0.0)
+    {
+        throw std::runtime_error("Rigid transform can not mirror");
+    }
+}
+
+inline RigidTransform RigidTransform::FromAxisAngle(const Vec3& axis, double angle, const Vec3& translation)
+{
+    // Rodrigues' rotation formula
+    const Vec3 k = axis.normalise();
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    const double t = 1.0 - c;
+    const double x = k.X(), y = k.Y(), z = k.Z();
+    const double rotation[3][3] = {{t*x*x + c,   t*x*y - s*z, t*x*z + s*y},
+                                   {t*x*y + s*z, t*y*y + c,   t*y*z - s*x},
+                                   {t*x*z - s*y, t*y*z + s*x, t*z*z + c}};
+    return RigidTransform(rotation, translation);
+}
+
+inline RigidTransform RigidTransform::Inverse()const
+{
+    RigidTransform inverse;
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        for(unsigned j = 0; j < 3; ++j)
+        {
+            inverse.Rotation[i][j] = Rotation[j][i];
+        }
+    }
+    inverse.Translation = inverse.Rotate(Translation)*(-1.0);
+    return inverse;
+}
+
+}
@@ -0,0 +1,203 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <exception>
+
+using namespace rabbit;
+
+/**
+* @brief State shared by all the tasks of one ParallelFor call. Lives on the stack
+* of the calling thread, which waits for finished before returning.
+*/
+struct ThreadPool::Job
+{
+    Job(const std::function<void(std::size_t, std::size_t)>& function,
+        std::size_t grain,
+        std::size_t count):
+        fn(function),
+        grainSize(grain),
+        remaining(count),
+        finished(false){}
+
+    const std::function<void(std::size_t, std::size_t)>& fn;
+    const std::size_t grainSize;
+    std::atomic<std::size_t> remaining; ///< Number of indices not processed yet
+
+    std::mutex mutex;               ///< Guards finished and error
+    std::condition_variable done;   ///< Signalled once finished is set
+    bool finished;
+    std::exception_ptr error;       ///< First exception thrown by fn
+};
+
+ThreadPool::ThreadPool(unsigned numThreads):
+    m_numQueuedTasks(0),
+    m_numSleeping(0),
+    m_stop(false)
+{
+    for(unsigned i = 0; i <= numThreads; ++i)
+    {
+        m_queues.emplace_back(new WorkQueue());
+    }
+
+    m_workers.reserve(numThreads);
+    for(unsigned i = 0; i < numThreads; ++i)
+    {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wakeUp.notify_all();
+    for(std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(std::size_t count,
+                             std::size_t grainSize,
+                             const std::function<void(std::size_t, std::size_t)>& fn)
+{
+    grainSize = std::max<std::size_t>(grainSize, 1);
+    if(m_workers.empty() || count <= grainSize)
+    {
+        for(std::size_t begin = 0; begin < count; begin += grainSize)
+        {
+            fn(begin, std::min(begin + grainSize, count));
+        }
+        return;
+    }
+
+    // Callers share the last queue. The calling thread helps out until there is
+    // nothing left to take and then waits for the workers to finish.
+    Job job(fn, grainSize, count);
+    const unsigned callerQueue = GetNumThreads();
+    Push(callerQueue, Task{&job, 0, count});
+
+    Task task;
+    while(job.remaining.load() != 0 && Acquire(callerQueue, task))
+    {
+        Run(callerQueue, task);
+    }
+
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&job]{return job.finished;});
+    if(job.error)
+    {
+        std::rethrow_exception(job.error);
+    }
+}
+
+void ThreadPool::WorkerLoop(unsigned queueIndex)
+{
+    Task task;
+    while(true)
+    {
+        if(Acquire(queueIndex, task))
+        {
+            Run(queueIndex, task);
+            continue;
+        }
+
+        // Announced before checking for tasks, see Push
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        ++m_numSleeping;
+        m_wakeUp.wait(lock, [this]{return m_stop || m_numQueuedTasks.load() != 0;});
+        --m_numSleeping;
+        if(m_stop)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::Push(unsigned queueIndex, const Task& task)
+{
+    // Counted before it is queued so that the count never drops below zero
+    ++m_numQueuedTasks;
+    {
+        WorkQueue& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    // A worker counts itself as sleeping before it checks m_numQueuedTasks, and the task
+    // was counted before this check, so either the worker sees the task or this sees the
+    // worker. Only then is the lock needed, to make sure it is waiting when notified.
+    if(m_numSleeping.load() != 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_wakeUp.notify_one();
+    }
+}
+
+bool ThreadPool::Acquire(unsigned queueIndex, Task& task)
+{
+    {
+        WorkQueue& queue = *m_queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty())
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            --m_numQueuedTasks;
+            return true;
+        }
+    }
+
+    const unsigned numQueues = static_cast<unsigned>(m_queues.size());
+    for(unsigned i = 1; i < numQueues && m_numQueuedTasks.load() != 0; ++i)
+    {
+        WorkQueue& victim = *m_queues[(queueIndex + i) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --m_numQueuedTasks;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Run(unsigned queueIndex, Task task)
+{
+    Job* job = task.job;
+
+    // Keep the lower half and offer the upper half to other threads
+    while(task.end - task.begin > job->grainSize)
+    {
+        const std::size_t mid = task.begin + (task.end - task.begin)/2;
+        Push(queueIndex, Task{job, mid, task.end});
+        task.end = mid;
+    }
+
+    try
+    {
+        job->fn(task.begin, task.end);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if(!job->error)
+        {
+            job->error = std::current_exception();
+        }
+    }
+
+    const std::size_t numProcessed = task.end - task.begin;
+    if(job->remaining.fetch_sub(numProcessed) == numProcessed)
+    {
+        // Notify while holding the lock, the job is destroyed as soon as the caller sees finished
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        job->done.notify_all();
+    }
+}
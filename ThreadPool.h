@@ -0,0 +1,90 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief A work stealing thread pool for data parallel loops. A loop starts out as
+* a single range of indices. Whoever runs a range larger than the grain size splits
+* off its upper half and pushes it onto its own queue, so large ranges are broken
+* up by the threads that have spare capacity. Threads take work from the back of
+* their own queue and, once that is empty, steal from the front of the other queues,
+* where the largest remaining ranges are.
+*/
+class ThreadPool : boost::noncopyable
+{
+public:
+
+    /**
+    * @param numThreads Number of worker threads. The thread calling ParallelFor works
+    * alongside them, so zero workers is legal and runs every loop on the calling thread.
+    */
+    explicit ThreadPool(unsigned numThreads = std::thread::hardware_concurrency());
+
+    ~ThreadPool();
+
+    unsigned GetNumThreads()const{return static_cast<unsigned>(m_workers.size());}
+
+    /**
+    * Calls fn(begin, end) for disjoint ranges of at most grainSize indices which together
+    * cover [0, count), and blocks until all of them have been processed. Which thread
+    * processes which range depends on scheduling, but the ranges themselves do not.
+    * If fn throws, the first exception is rethrown once the remaining ranges are done.
+    * Can be called from several threads at once.
+    */
+    void ParallelFor(std::size_t count,
+                     std::size_t grainSize,
+                     const std::function<void(std::size_t, std::size_t)>& fn);
+
+private:
+
+    struct Job;
+
+    // A range of indices of a job, waiting to be processed
+    struct Task
+    {
+        Job* job;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerLoop(unsigned queueIndex);
+
+    // Pushes a task onto the back of a queue and wakes up a sleeping worker
+    void Push(unsigned queueIndex, const Task& task);
+
+    // Takes a task from the back of the given queue or, failing that, steals one
+    // from the front of another queue. Returns false if there is no work at all.
+    bool Acquire(unsigned queueIndex, Task& task);
+
+    // Splits the task down to the grain size, runs it and reports it to the job
+    void Run(unsigned queueIndex, Task task);
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; ///< One queue per worker plus one shared by callers
+    std::atomic<std::size_t> m_numQueuedTasks;        ///< Total number of tasks in all the queues
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp; ///< Signalled when work arrives or the pool is stopping
+    std::atomic<unsigned> m_numSleeping; ///< Workers waiting on m_wakeUp, Push only signals if there are any
+    bool m_stop;
+};
+
+}
@@ -1,33 +1,231 @@
 #include "TriMeshProxQueryV1.h"
 #include "Vec3.h"
 #include "Mesh.h"
+#include "KClosestPointsHeap.h"
 namespace rabbit
 {
 
-TriMeshProxQueryV1::TriMeshProxQueryV1(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh):
-        IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV1>(mesh){}
+namespace
+{
+    /**
+    * Checks the distance to each of the triangles. distanceTo(i, point, maxDist)
+    * returns the IntersectionResult for triangle i.
+    */
+    struct ClosestPointSearch
+    {
+        ClosestPointSearch(const Vec3& p, double threshold):point(p), distThreshold(threshold){}
+
+        template<typename DistanceFunction>
+        ClosestPointResult<Vec3> operator()(std::size_t numTriangles, DistanceFunction distanceTo)const
+        {
+            Vec3 closestPoint;
+            double minDist = distThreshold;
+            int closestTri = -1;
+
+            for(std::size_t i = 0; i < numTriangles; ++i)
+            {
+                // Note the distance threshold gets updated if a single point is found.
+                IntersectionResult<Vec3> res = distanceTo(i, point, minDist);
+                if(res.Dist < minDist)
+                {
+                    minDist = res.Dist;
+                    closestPoint = res.Point;
+                    closestTri = static_cast<int>(i);
+                }
+            }
+
+            return ClosestPointResult<Vec3>(closestPoint, minDist, closestTri);
+        }
+
+        const Vec3& point;
+        double distThreshold;
+    };
+
+    /**
+    * As above, for the k closest triangles. Each triangle is only checked against the
+    * distance to the furthest of the k closest triangles found so far.
+    */
+    struct KClosestPointsSearch
+    {
+        KClosestPointsSearch(const Vec3& p, double threshold, std::size_t numResults, ClosestPointResult<Vec3>* res):
+            point(p), distThreshold(threshold), k(numResults), results(res){}
+
+        template<typename DistanceFunction>
+        std::size_t operator()(std::size_t numTriangles, DistanceFunction distanceTo)const
+        {
+            KClosestPointsHeap<Vec3> heap(results, k, distThreshold);
+            for(std::size_t i = 0; i < numTriangles && k != 0; ++i)
+            {
+                const double bound = heap.GetBound();
+                IntersectionResult<Vec3> res = distanceTo(i, point, bound);
+                if(res.Dist < bound)
+                {
+                    heap.Push(res.Point, res.Dist, static_cast<int>(i));
+                }
+            }
+            return heap.Finish();
+        }
+
+        const Vec3& point;
+        double distThreshold;
+        std::size_t k;
+        ClosestPointResult<Vec3>* results;
+    };
 
-std::tuple<Vec3,double,bool> TriMeshProxQueryV1::CalculateClosestPointImpl(const Vec3& point,double distThreshold)
+    /**
+    * Calls visitor(result) for each of the triangles closer than radius, until it returns false.
+    * Returns the number of triangles visited.
+    */
+    template<typename Visitor>
+    struct PolygonsWithinRadiusSearch
+    {
+        PolygonsWithinRadiusSearch(const Vec3& p, double r, Visitor& v):point(p), radius(r), visitor(v){}
+
+        template<typename DistanceFunction>
+        std::size_t operator()(std::size_t numTriangles, DistanceFunction distanceTo)const
+        {
+            std::size_t numFound = 0;
+            for(std::size_t i = 0; i < numTriangles; ++i)
+            {
+                IntersectionResult<Vec3> res = distanceTo(i, point, radius);
+                if(res.Dist < radius)
+                {
+                    ++numFound;
+                    if(!visitor(ClosestPointResult<Vec3>(res.Point, res.Dist, static_cast<int>(i))))
+                    {
+                        break;
+                    }
+                }
+            }
+            return numFound;
+        }
+
+        const Vec3& point;
+        double radius;
+        Visitor& visitor;
+    };
+}
+
+TriMeshProxQueryV1::TriMeshProxQueryV1(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                                       TrianglePrecomputation precomputation):
+        IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV1>(mesh)
 {
+    if(precomputation == TrianglePrecomputation::QueryRecords)
+    {
+        const std::vector<Triangle<Vec3>>& triangles = m_mesh->GetPolygons();
+        m_records.reserve(triangles.size());
+        for(const Triangle<Vec3>& t : triangles)
+        {
+            m_records.emplace_back(t);
+        }
+    }
+}
+
+TriMeshProxQueryV1::TriMeshProxQueryV1(std::shared_ptr<const CompactTriangleMesh> mesh):
+        IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV1>(nullptr),
+        m_compactMesh(mesh){}
+
+template<typename Result, typename Search>
+Result TriMeshProxQueryV1::WithDistanceKernel(const Search& search)const
+{
+    if(m_compactMesh)
+    {
+        const CompactTriangleMesh& mesh = *m_compactMesh;
+        return search(mesh.GetNumTriangles(), [&mesh](std::size_t i, const Vec3& p, double maxDist)
+        {
+            return mesh.GetTriangle(i).CalcShortestDistanceFrom(p, maxDist);
+        });
+    }
+
     const std::vector<Triangle<Vec3>>& triangles = m_mesh->GetPolygons();
-    Vec3 closestPoint;
-    double minDist = distThreshold;
-    bool foundPoint = false;
+    if(!m_records.empty())
+    {
+        const std::vector<TriangleQueryRecord<Vec3>>& records = m_records;
+        return search(triangles.size(), [&triangles, &records](std::size_t i, const Vec3& p, double maxDist)
+        {
+            return records[i].CalcShortestDistanceFrom(triangles[i], p, maxDist);
+        });
+    }
+
+    return search(triangles.size(), [&triangles](std::size_t i, const Vec3& p, double maxDist)
+    {
+        return triangles[i].CalcShortestDistanceFrom(p, maxDist);
+    });
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV1::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    return WithDistanceKernel<ClosestPointResult<Vec3>>(ClosestPointSearch(point, distThreshold));
+}
+
+std::size_t TriMeshProxQueryV1::CalculateKClosestPointsImpl(const Vec3& point,
+                                                        double distThreshold,
+                                                        std::size_t k,
+                                                        ClosestPointResult<Vec3>* results)const
+{
+    return WithDistanceKernel<std::size_t>(KClosestPointsSearch(point, distThreshold, k, results));
+}
+
+template<typename Visitor>
+std::size_t TriMeshProxQueryV1::VisitPolygonsWithinRadius(const Vec3& point, double radius, Visitor visitor)const
+{
+    return WithDistanceKernel<std::size_t>(PolygonsWithinRadiusSearch<Visitor>(point, radius, visitor));
+}
+
+std::size_t TriMeshProxQueryV1::CalculatePolygonsWithinRadiusImpl(const Vec3& point,
+                                                              double radius,
+                                                              const std::function<void(const ClosestPointResult<Vec3>&)>& sink)const
+{
+    return VisitPolygonsWithinRadius(point, radius, [&sink](const ClosestPointResult<Vec3>& res)
+    {
+        sink(res);
+        return true;
+    });
+}
 
-    // Check min distance to each triangle
-    for(const Triangle<Vec3>& t : triangles)
+bool TriMeshProxQueryV1::IsAnyPolygonWithinRadiusImpl(const Vec3& point, double radius)const
+{
+    return VisitPolygonsWithinRadius(point, radius, [](const ClosestPointResult<Vec3>&){return false;}) != 0;
+}
+
+RayCastResult<Vec3> TriMeshProxQueryV1::IntersectRay(const Ray<Vec3>& ray, double maxDist, bool anyHit)const
+{
+    RayCastResult<Vec3> result(ray.Origin, maxDist, -1);
+    auto intersect = [&](const Triangle<Vec3>& t, std::size_t i)
     {
-        // Note the distance threshold gets updated if a single point is found.
-        IntersectionResult<Vec3> res = t.CalcShortestDistanceFrom(point, minDist);
-        if(res.Dist < minDist)
+        // The distance gets updated once a triangle is hit, so only closer ones are looked at
+        const IntersectionResult<Vec3> res = t.IntersectRay(ray.Origin, ray.Direction, result.Dist);
+        if(res.Dist < result.Dist)
         {
-            minDist = res.Dist;
-            closestPoint = res.Point;
-            foundPoint = true;
+            result = RayCastResult<Vec3>(res.Point, res.Dist, static_cast<int>(i));
         }
+    };
+
+    if(m_compactMesh)
+    {
+        for(std::size_t i = 0; i < m_compactMesh->GetNumTriangles() && !(anyHit && result.Found()); ++i)
+        {
+            intersect(m_compactMesh->GetTriangle(i), i);
+        }
+        return result;
     }
 
-    return std::make_tuple(closestPoint, minDist, foundPoint);
+    const std::vector<Triangle<Vec3>>& triangles = m_mesh->GetPolygons();
+    for(std::size_t i = 0; i < triangles.size() && !(anyHit && result.Found()); ++i)
+    {
+        intersect(triangles[i], i);
+    }
+    return result;
+}
+
+RayCastResult<Vec3> TriMeshProxQueryV1::CastRayImpl(const Ray<Vec3>& ray, double maxDist)const
+{
+    return IntersectRay(ray, maxDist, false);
+}
+
+bool TriMeshProxQueryV1::IsRayBlockedImpl(const Ray<Vec3>& ray, double maxDist)const
+{
+    return IntersectRay(ray, maxDist, true).Found();
 }
 
 }
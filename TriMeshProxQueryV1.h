@@ -2,6 +2,10 @@
 #include "IProximityQueries.h"
 #include "Triangle.h"
 #include "Vec3.h"
+#include "TriangleQueryRecord.h"
+#include "CompactTriangleMesh.h"
+#include <functional>
+#include <vector>
 namespace rabbit
 {
 
@@ -15,12 +19,63 @@ template<typename PolygonType> class Mesh;
 class TriMeshProxQueryV1 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV1>
 {
 public:
-    TriMeshProxQueryV1(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh);
+    /**
+    * @param precomputation Whether to trade memory for speed by precomputing a
+    * TriangleQueryRecord for each triangle
+    */
+    TriMeshProxQueryV1(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                       TrianglePrecomputation precomputation = TrianglePrecomputation::None);
+
+    /**
+    * Queries a mesh which only stores its vertices. Every triangle is rebuilt from
+    * its vertices on every query, trading speed for memory.
+    */
+    explicit TriMeshProxQueryV1(std::shared_ptr<const CompactTriangleMesh> mesh);
 
    /**
 	*	See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
 	*/
-    std::tuple<Vec3,double,bool> CalculateClosestPointImpl(const Vec3& point,double distThreshold);
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+   /**
+	*	See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateKClosestPoints
+	*/
+    std::size_t CalculateKClosestPointsImpl(const Vec3& point,
+                                            double distThreshold,
+                                            std::size_t k,
+                                            ClosestPointResult<Vec3>* results)const;
+
+   /**
+	*	See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculatePolygonsWithinRadius
+	*/
+    std::size_t CalculatePolygonsWithinRadiusImpl(const Vec3& point,
+                                                  double radius,
+                                                  const std::function<void(const ClosestPointResult<Vec3>&)>& sink)const;
+    bool IsAnyPolygonWithinRadiusImpl(const Vec3& point, double radius)const;
+
+   /**
+	*	See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CastRay
+	*/
+    RayCastResult<Vec3> CastRayImpl(const Ray<Vec3>& ray, double maxDist)const;
+    bool IsRayBlockedImpl(const Ray<Vec3>& ray, double maxDist)const;
+
+private:
+
+    // Picks the distance calculation for the way the triangles are stored, once per query,
+    // and returns search(numTriangles, distanceTo), where distanceTo(i, point, maxDist)
+    // returns the IntersectionResult of triangle i
+    template<typename Result, typename Search>
+    Result WithDistanceKernel(const Search& search)const;
+
+    // Calls visitor(result) for each triangle closer to point than radius until it returns false
+    template<typename Visitor>
+    std::size_t VisitPolygonsWithinRadius(const Vec3& point, double radius, Visitor visitor)const;
+
+    // Intersects the ray with every triangle, stopping at the first hit if anyHit is set
+    RayCastResult<Vec3> IntersectRay(const Ray<Vec3>& ray, double maxDist, bool anyHit)const;
+
+    std::vector<TriangleQueryRecord<Vec3>> m_records; ///< One per triangle, empty unless precomputed
+    std::shared_ptr<const CompactTriangleMesh> m_compactMesh; ///< Set instead of m_mesh if constructed from one
 };
 
 }
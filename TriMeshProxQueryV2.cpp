@@ -1,6 +1,7 @@
 #include "TriMeshProxQueryV2.h"
 #include "Mesh.h"
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 using namespace std;
 
@@ -14,45 +15,63 @@ namespace
 TriMeshProxQueryV2::TriMeshProxQueryV2(std::shared_ptr<Mesh<Tri>> mesh):
         IProximityQueries<Tri, TriMeshProxQueryV2>(mesh)
 {
-    Preprocess();
+    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+    Preprocess(triangles.size(), [&triangles](std::size_t i){return triangles[i];});
 }
 
+TriMeshProxQueryV2::TriMeshProxQueryV2(const CompactTriangleMesh& mesh):
+        IProximityQueries<Tri, TriMeshProxQueryV2>(nullptr)
+{
+    Preprocess(mesh.GetNumTriangles(), [&mesh](std::size_t i){return mesh.GetTriangle(i);});
+}
 
-void TriMeshProxQueryV2::Preprocess()
+void TriMeshProxQueryV2::Preprocess(std::size_t numTriangles, const std::function<Tri(std::size_t)>& getTriangle)
 {
-    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
-    std::for_each(triangles.begin(), triangles.end(), [this](const Tri& t)
+    m_aabb.Reserve(numTriangles);
+    m_triangles.Reserve(numTriangles);
+    for(std::size_t i = 0; i < numTriangles; ++i)
     {
-        m_aabb.emplace_back(t.CalculateAABB());
-    });
+        const Tri t = getTriangle(i);
+        m_aabb.PushBack(t.CalculateAABB().GetBounds());
+        m_triangles.PushBack(t);
+    }
 }
 
-std::tuple<Vec3,double,bool> TriMeshProxQueryV2::CalculateClosestPointImpl(const Vec3& point,double distThreshold)
+ClosestPointResult<Vec3> TriMeshProxQueryV2::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
 {
-    const std::vector<Triangle<Vec3>>& triangles = m_mesh->GetPolygons();
+    static const uint64_t PACKET_MASK = (uint64_t(1) << TriangleSoA::PACKET_SIZE) - 1;
     Vec3 closestPoint;
 
-    double minDist = distThreshold;
-    bool foundPoint = false;
+    double minDistSq = distThreshold*distThreshold;
+    std::size_t closestIndex = 0;
+    bool found = false;
 
-    for(unsigned i = 0; i < m_aabb.size(); ++i)
+    const std::size_t numTriangles = m_aabb.Size();
+    for(std::size_t first = 0; first < numTriangles; first += AABBSoA::BLOCK_SIZE)
     {
-        IntRes resAABB = m_aabb[i].CalcShortestDistanceFrom(point, minDist);
-        if(resAABB.Dist < minDist)
-        {   // We only bother looking at the triangle if the distance to
-            // AABB is less than the threshold
+        // We only bother looking at the triangles whose AABBs are closer than minDist
+        const std::size_t count = std::min(AABBSoA::BLOCK_SIZE, numTriangles - first);
+        uint64_t candidates = m_aabb.CullBlock(point, minDistSq, first, count);
+        while(candidates != 0)
+        {
+            // All the candidates of the packet holding the lowest one are tested together
+            const unsigned packetStart = LowestSetBit(candidates) & ~unsigned(TriangleSoA::PACKET_SIZE - 1);
+            const unsigned laneMask = static_cast<unsigned>((candidates >> packetStart) & PACKET_MASK);
+            candidates &= ~(PACKET_MASK << packetStart);
 
-            IntersectionResult<Vec3> resTri = triangles[i].CalcShortestDistanceFrom(point, minDist);
-            if(resTri.Dist < minDist)
+            if(m_triangles.FindClosest(point, first + packetStart, laneMask, minDistSq, closestPoint, closestIndex))
             {
                 // Now that we have found atleast one point to the mesh,
-                // we update the minDist
-                minDist = resTri.Dist;
-                closestPoint = resTri.Point;
-                foundPoint = true;
+                // we drop the candidates that are now too far
+                found = true;
+                candidates &= m_aabb.CullBlock(point, minDistSq, first, count);
             }
         }
     }
 
-    return std::make_tuple(closestPoint, minDist, foundPoint);
+    if(!found)
+    {
+        return ClosestPointResult<Vec3>(closestPoint, distThreshold, -1);
+    }
+    return ClosestPointResult<Vec3>(closestPoint, sqrt(minDistSq), static_cast<int>(closestIndex));
 }
@@ -3,6 +3,10 @@
 #include "Triangle.h"
 #include "Vec3.h"
 #include "AABB.h"
+#include "AABBSoA.h"
+#include "TriangleSoA.h"
+#include "CompactTriangleMesh.h"
+#include <functional>
 namespace rabbit
 {
 
@@ -13,6 +17,9 @@ class Mesh;
 * @brief This class implements the proximity query between point and a triangular mesh
 * by calculating by first doing a check with the axis aligned bounding box for
 * the triangle which is much cheaper than calculating the distance to the triangle.
+* The boxes are kept in an AABBSoA, so blocks of boxes are culled with SIMD instructions
+* and only the triangles whose boxes pass are looked at. Those are tested a packet
+* at a time with the branch free kernel of TriangleSoA.
 * Somewhat better than TriMeshProxQueryV1, but still plenty of room for improvement
 */
 class TriMeshProxQueryV2 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV2>
@@ -20,18 +27,24 @@ class TriMeshProxQueryV2 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQ
 public:
     TriMeshProxQueryV2(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh);
 
+    /**
+    * The mesh is only needed while preprocessing, so queries are as fast as with a Mesh
+    */
+    explicit TriMeshProxQueryV2(const CompactTriangleMesh& mesh);
+
    /**
 	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
 	*/
-    std::tuple<Vec3,double,bool> CalculateClosestPointImpl(const Vec3& point,double distThreshold);
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
 
 private:
 
 	// Calculate the bounding box for all the triangles in the mesh
-    void Preprocess();
+    void Preprocess(std::size_t numTriangles, const std::function<Triangle<Vec3>(std::size_t)>& getTriangle);
 
-    std::vector<AABB<Vec3>> m_aabb; ///< vector of bounding boxes for all the triangles in the mesh.
-									  ///< These are precomputed so that no run-time costs are incurred.
+    AABBSoA m_aabb; ///< Bounding boxes for all the triangles in the mesh.
+                    ///< These are precomputed so that no run-time costs are incurred.
+    TriangleSoA m_triangles; ///< The triangles of the mesh in the same order
 };
 
 }
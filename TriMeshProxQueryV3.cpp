@@ -0,0 +1,104 @@
+#include "TriMeshProxQueryV3.h"
+#include "Mesh.h"
+#include <algorithm>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+    typedef IntersectionResult<Vec3> IntRes;
+    typedef BVHTree::Node Node;
+}
+
+TriMeshProxQueryV3::TriMeshProxQueryV3(std::shared_ptr<Mesh<Tri>> mesh,
+                                       const BVHBuildParams& params,
+                                       TrianglePrecomputation precomputation):
+        IProximityQueries<Tri, TriMeshProxQueryV3>(mesh)
+{
+    Preprocess(params, precomputation);
+}
+
+void TriMeshProxQueryV3::Preprocess(const BVHBuildParams& params, TrianglePrecomputation precomputation)
+{
+    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+    m_aabb.reserve(triangles.size());
+    std::for_each(triangles.begin(), triangles.end(), [this](const Tri& t)
+    {
+        m_aabb.emplace_back(t.CalculateAABB());
+    });
+    m_bvh.reset(new BVHTree(m_aabb, params));
+
+    if(precomputation == TrianglePrecomputation::QueryRecords)
+    {
+        m_records.reserve(triangles.size());
+        for(const Triangle<Vec3>& t : triangles)
+        {
+            m_records.emplace_back(t);
+        }
+    }
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV3::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    Vec3 closestPoint;
+    double minDist = distThreshold;
+    int closestTri = -1;
+
+    const Node* root = m_bvh->GetRoot();
+    if(root != nullptr &&
+       root->Data().aabb.CalcShortestDistanceFrom(point, minDist).Dist < minDist)
+    {
+        FindClosestPoint(root, point, minDist, closestPoint, closestTri);
+    }
+
+    return ClosestPointResult<Vec3>(closestPoint, minDist, closestTri);
+}
+
+void TriMeshProxQueryV3::FindClosestPoint(const Node* node,
+                                          const Vec3& point,
+                                          double& minDist,
+                                          Vec3& closestPoint,
+                                          int& closestTri)const
+{
+    if(BVHTree::IsLeaf(node))
+    {
+        const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+        const bool useRecords = !m_records.empty();
+        for(int i : node->Data().triIndices)
+        {
+            IntRes resTri = useRecords ?
+                    m_records[i].CalcShortestDistanceFrom(triangles[i], point, minDist) :
+                    triangles[i].CalcShortestDistanceFrom(point, minDist);
+            if(resTri.Dist < minDist)
+            {
+                minDist = resTri.Dist;
+                closestPoint = resTri.Point;
+                closestTri = i;
+            }
+        }
+        return;
+    }
+
+    // Visit the nearer child first. Finding a close point early on
+    // tightens minDist and allows more of the far subtree to be skipped.
+    const Node* nearChild = node->GetLeft();
+    const Node* farChild = node->GetRight();
+    double nearDist = nearChild->Data().aabb.CalcShortestDistanceFrom(point, minDist).Dist;
+    double farDist = farChild->Data().aabb.CalcShortestDistanceFrom(point, minDist).Dist;
+    if(farDist < nearDist)
+    {
+        std::swap(nearChild, farChild);
+        std::swap(nearDist, farDist);
+    }
+
+    if(nearDist < minDist)
+    {
+        FindClosestPoint(nearChild, point, minDist, closestPoint, closestTri);
+    }
+
+    // minDist may have shrunk while visiting the near child
+    if(farDist < minDist)
+    {
+        FindClosestPoint(farChild, point, minDist, closestPoint, closestTri);
+    }
+}
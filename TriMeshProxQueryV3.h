@@ -0,0 +1,56 @@
+#pragma once
+#include "IProximityQueries.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include "AABB.h"
+#include "BVHTree.h"
+#include "TriangleQueryRecord.h"
+namespace rabbit
+{
+
+template<typename PolygonType>
+class Mesh;
+
+/**
+* @brief This class implements the proximity query between point and a triangular mesh
+* using a bounding volume hierarchy (BVHTree) built over the axis aligned bounding boxes
+* of the triangles. The tree is traversed nearest child first and any subtree whose
+* bounding box is further away than the closest point found so far is skipped, so a
+* query only looks at a small fraction of the triangles in the mesh.
+*/
+class TriMeshProxQueryV3 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV3>
+{
+public:
+    /**
+    * @param precomputation Whether to trade memory for speed by precomputing a
+    * TriangleQueryRecord for each triangle
+    */
+    TriMeshProxQueryV3(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                       const BVHBuildParams& params = BVHBuildParams(),
+                       TrianglePrecomputation precomputation = TrianglePrecomputation::None);
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
+	*/
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+    const BVHTree& GetBVH()const{return *m_bvh;}
+
+private:
+
+	// Calculate the bounding box for all the triangles in the mesh and build the hierarchy
+    void Preprocess(const BVHBuildParams& params, TrianglePrecomputation precomputation);
+
+    // Finds the closest point to the triangles under node which is nearer than minDist
+    void FindClosestPoint(const BVHTree::Node* node,
+                          const Vec3& point,
+                          double& minDist,
+                          Vec3& closestPoint,
+                          int& closestTri)const;
+
+    std::vector<AABB<Vec3>> m_aabb; ///< vector of bounding boxes for all the triangles in the mesh.
+    std::unique_ptr<BVHTree> m_bvh; ///< Hierarchy built over m_aabb
+    std::vector<TriangleQueryRecord<Vec3>> m_records; ///< One per triangle, empty unless precomputed
+};
+
+}
@@ -0,0 +1,531 @@
+#include "TriMeshProxQueryV4.h"
+#include "Mesh.h"
+#include "KClosestPointsHeap.h"
+#include "IndexedTriangleMesh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+    typedef IntersectionResult<Vec3> IntRes;
+
+    const std::size_t RAY_BUNDLE_SIZE = 16;     ///< Number of neighbouring rays of a batch traced together
+    const std::size_t UPDATE_GRAIN_SIZE = 4096; ///< Triangles moved as one unit of work by UpdateVertices
+
+    // The stored triangles are P0 and the edges, so P0 plus an edge may be off from the
+    // vertex it was calculated from by rounding. Vertices this many units in the last place
+    // of the largest coordinate apart are welded.
+    const double WELD_TOLERANCE_ULPS = 8.0;
+}
+
+TriMeshProxQueryV4::TriMeshProxQueryV4(std::shared_ptr<Mesh<Tri>> mesh,
+                                       const BVHBuildParams& params,
+                                       std::shared_ptr<BVHCache> cache,
+                                       SignedQueryPreparation signedQueries):
+        IProximityQueries<Tri, TriMeshProxQueryV4>(mesh)
+{
+    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+    Preprocess(triangles.size(), [&triangles](std::size_t i){return triangles[i];}, params, cache, signedQueries);
+}
+
+TriMeshProxQueryV4::TriMeshProxQueryV4(const CompactTriangleMesh& mesh,
+                                       const BVHBuildParams& params,
+                                       std::shared_ptr<BVHCache> cache,
+                                       SignedQueryPreparation signedQueries):
+        IProximityQueries<Tri, TriMeshProxQueryV4>(nullptr)
+{
+    Preprocess(mesh.GetNumTriangles(), [&mesh](std::size_t i){return mesh.GetTriangle(i);}, params, cache, signedQueries);
+}
+
+void TriMeshProxQueryV4::Preprocess(std::size_t numTriangles,
+                                    const std::function<Tri(std::size_t)>& getTriangle,
+                                    const BVHBuildParams& params,
+                                    const std::shared_ptr<BVHCache>& cache,
+                                    SignedQueryPreparation signedQueries)
+{
+    uint64_t meshHash = 0;
+    if(cache)
+    {
+        meshHash = BVHCache::HashMesh(numTriangles, getTriangle);
+    }
+    if(!cache || !cache->Load(meshHash, numTriangles, params, m_bvh, m_triangles))
+    {
+        BuildBVH(numTriangles, getTriangle, params);
+        if(cache)
+        {
+            cache->TryStore(meshHash, params, *m_bvh, m_triangles);
+        }
+    }
+
+    m_params = params;
+    m_builtSAHCost = m_bvh->CalcSAHCost(params.TraversalCost, params.IntersectionCost);
+
+    if(signedQueries == SignedQueryPreparation::Eager)
+    {
+        PrepareSignedQueries();
+    }
+}
+
+void TriMeshProxQueryV4::PrepareSignedQueries()
+{
+    GetSignedDistanceData();
+}
+
+std::shared_ptr<const TriMeshProxQueryV4::SignedDistanceData> TriMeshProxQueryV4::GetSignedDistanceData()const
+{
+    std::shared_ptr<SignedDistanceData> data = std::atomic_load(&m_signedData);
+    if(data)
+    {
+        return data;
+    }
+
+    // Welding the vertices as the queries see them gives the topology the pseudonormals are
+    // calculated from, which is kept for recalculating them once the vertices have moved
+    std::vector<double> coords(9*m_triangles.Size());
+    double maxCoord = 0.0;
+    for(std::size_t i = 0; i < m_triangles.Size(); ++i)
+    {
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            // The vertices as the queries see them, P0 plus the edges
+            const double p0 = m_triangles.GetP0(axis)[i];
+            const double vertices[3] = {p0, p0 + m_triangles.GetP0P1(axis)[i], p0 + m_triangles.GetP0P2(axis)[i]};
+            for(unsigned v = 0; v < 3; ++v)
+            {
+                coords[9*i + 3*v + axis] = vertices[v];
+                maxCoord = std::max(maxCoord, std::fabs(vertices[v]));
+            }
+        }
+    }
+    const double tolerance = WELD_TOLERANCE_ULPS*std::numeric_limits<double>::epsilon()*maxCoord;
+    const IndexedTriangleMesh welded(coords.data(), m_triangles.Size(), VertexWeldParams(tolerance));
+
+    data = std::make_shared<SignedDistanceData>();
+    data->VertexIndices = welded.GetIndices();
+    data->NumVertices = welded.GetNumVertices();
+    data->Pseudonormals.Build(welded);
+
+    // Queries racing to get here build the same data, the first one to finish is kept
+    std::shared_ptr<SignedDistanceData> expected;
+    if(!std::atomic_compare_exchange_strong(&m_signedData, &expected, data))
+    {
+        return expected;
+    }
+    return data;
+}
+
+void TriMeshProxQueryV4::UpdateVertices(const CompactTriangleMesh& mesh, const std::shared_ptr<ThreadPool>& pool)
+{
+    UpdateVertices(mesh.GetNumTriangles(), [&mesh](std::size_t i, Vec3* vertices)
+    {
+        vertices[0] = mesh.GetVertex(i, zero);
+        vertices[1] = mesh.GetVertex(i, one);
+        vertices[2] = mesh.GetVertex(i, two);
+    }, pool);
+}
+
+void TriMeshProxQueryV4::UpdateVertices(const double* coords, std::size_t numTriangles, const std::shared_ptr<ThreadPool>& pool)
+{
+    UpdateVertices(numTriangles, [coords](std::size_t i, Vec3* vertices)
+    {
+        const double* c = coords + 9*i;
+        vertices[0] = Vec3(c[0], c[1], c[2]);
+        vertices[1] = Vec3(c[3], c[4], c[5]);
+        vertices[2] = Vec3(c[6], c[7], c[8]);
+    }, pool);
+}
+
+void TriMeshProxQueryV4::UpdateVertices(std::size_t numTriangles,
+                                        const std::function<void(std::size_t, Vec3*)>& getVertices,
+                                        const std::shared_ptr<ThreadPool>& pool)
+{
+    if(numTriangles != m_triangles.Size())
+    {
+        throw std::runtime_error("Number of triangles does not match the mesh");
+    }
+
+    // Every triangle is written by exactly one range, so the ranges can run in parallel
+    const std::vector<uint32_t>& triIndices = m_bvh->GetTriIndices();
+    auto update = [&](std::size_t begin, std::size_t end)
+    {
+        Vec3 vertices[3];
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            getVertices(triIndices[i], vertices);
+            m_triangles.Set(i, vertices[0], vertices[1], vertices[2]);
+        }
+    };
+    if(pool)
+    {
+        pool->ParallelFor(numTriangles, UPDATE_GRAIN_SIZE, update);
+    }
+    else
+    {
+        update(0, numTriangles);
+    }
+
+    m_bvh->Refit([this](const LinearBVHNode& leaf, double* boundsMin, double* boundsMax)
+    {
+        m_triangles.CalcBounds(leaf.Offset, leaf.Count, boundsMin, boundsMax);
+    }, pool);
+    if(m_signedData)
+    {
+        m_signedData->Pseudonormals.Update(IndexedTriangleMesh(GatherVertices(*m_signedData), m_signedData->VertexIndices));
+    }
+}
+
+std::vector<double> TriMeshProxQueryV4::GatherVertices(const SignedDistanceData& data)const
+{
+    const std::vector<uint32_t>& vertexIndices = data.VertexIndices;
+    std::vector<double> vertices(3*data.NumVertices);
+    for(std::size_t i = 0; i < m_triangles.Size(); ++i)
+    {
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            // The vertices as the queries see them, P0 plus the edges
+            const double p0 = m_triangles.GetP0(axis)[i];
+            vertices[3*vertexIndices[3*i] + axis] = p0;
+            vertices[3*vertexIndices[3*i + 1] + axis] = p0 + m_triangles.GetP0P1(axis)[i];
+            vertices[3*vertexIndices[3*i + 2] + axis] = p0 + m_triangles.GetP0P2(axis)[i];
+        }
+    }
+    return vertices;
+}
+
+double TriMeshProxQueryV4::GetRefitCostRatio()const
+{
+    const double cost = m_bvh->CalcSAHCost(m_params.TraversalCost, m_params.IntersectionCost);
+    return m_builtSAHCost > 0.0 ? cost/m_builtSAHCost : 1.0;
+}
+
+void TriMeshProxQueryV4::RebuildBVH()
+{
+    // The new hierarchy is built over the triangles in their current order, which is
+    // then mapped back to the order of the original mesh
+    std::unique_ptr<LinearBVH> oldBVH(std::move(m_bvh));
+    TriangleSoA oldTriangles;
+    std::swap(oldTriangles, m_triangles);
+    BuildBVH(oldTriangles.Size(), [&oldTriangles](std::size_t i){return oldTriangles.GetTriangle(i);}, m_params);
+
+    const std::vector<uint32_t>& order = m_bvh->GetTriIndices();
+    std::vector<uint32_t> triIndices(order.size());
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        triIndices[i] = oldBVH->GetTriIndices()[order[i]];
+    }
+    m_bvh.reset(new LinearBVH(m_bvh->GetNodes(), std::move(triIndices)));
+    m_builtSAHCost = m_bvh->CalcSAHCost(m_params.TraversalCost, m_params.IntersectionCost);
+
+    if(m_signedData)
+    {
+        const std::vector<uint32_t>& oldVertexIndices = m_signedData->VertexIndices;
+        std::vector<uint32_t> vertexIndices(oldVertexIndices.size());
+        for(std::size_t i = 0; i < order.size(); ++i)
+        {
+            std::copy(&oldVertexIndices[3*order[i]], &oldVertexIndices[3*order[i]] + 3, &vertexIndices[3*i]);
+        }
+        m_signedData->VertexIndices.swap(vertexIndices);
+        m_signedData->Pseudonormals.Build(IndexedTriangleMesh(GatherVertices(*m_signedData), m_signedData->VertexIndices));
+    }
+}
+
+void TriMeshProxQueryV4::BuildBVH(std::size_t numTriangles,
+                                  const std::function<Tri(std::size_t)>& getTriangle,
+                                  const BVHBuildParams& params)
+{
+    std::vector<AABB<Vec3>> aabbs;
+    aabbs.reserve(numTriangles);
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        aabbs.emplace_back(getTriangle(i).CalculateAABB());
+    }
+
+    // The pointer based tree is only needed until it has been flattened
+    BVHTree tree(aabbs, params);
+    m_bvh.reset(new LinearBVH(tree));
+
+    const std::vector<uint32_t>& triIndices = m_bvh->GetTriIndices();
+    m_triangles.Reserve(triIndices.size());
+    std::for_each(triIndices.begin(), triIndices.end(), [this, &getTriangle](uint32_t i)
+    {
+        m_triangles.PushBack(getTriangle(i));
+    });
+}
+
+bool TriMeshProxQueryV4::FindClosest(const Vec3& point,
+                                     double distThreshold,
+                                     Vec3& closestPoint,
+                                     double& minDist,
+                                     std::size_t& closestIndex)const
+{
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    double minDistSq = distThreshold*distThreshold;
+    bool found = false;
+    minDist = distThreshold;
+
+    m_bvh->Traverse(point, minDist, [&](const uint32_t* triIndices, uint32_t count, double& bound)
+    {
+        const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+        if(m_triangles.FindClosestInRange(point, first, count, minDistSq, closestPoint, closestIndex))
+        {
+            found = true;
+            bound = sqrt(minDistSq);
+        }
+    });
+    return found;
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV4::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    Vec3 closestPoint;
+    double minDist;
+    std::size_t closestIndex = 0;
+    if(!FindClosest(point, distThreshold, closestPoint, minDist, closestIndex))
+    {
+        return ClosestPointResult<Vec3>(closestPoint, distThreshold, -1);
+    }
+    return ClosestPointResult<Vec3>(closestPoint, minDist, static_cast<int>(m_bvh->GetTriIndices()[closestIndex]));
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV4::CalculateSignedClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    Vec3 closestPoint;
+    double minDist;
+    std::size_t closestIndex = 0;
+    if(!FindClosest(point, distThreshold, closestPoint, minDist, closestIndex))
+    {
+        return ClosestPointResult<Vec3>(closestPoint, distThreshold, -1);
+    }
+
+    // Barycentric coordinates of the closest point tell which face, edge or vertex it lies on
+    const std::size_t i = closestIndex;
+    const Vec3 p0(m_triangles.GetP0(0)[i], m_triangles.GetP0(1)[i], m_triangles.GetP0(2)[i]);
+    const Vec3 e0(m_triangles.GetP0P1(0)[i], m_triangles.GetP0P1(1)[i], m_triangles.GetP0P1(2)[i]);
+    const Vec3 e1(m_triangles.GetP0P2(0)[i], m_triangles.GetP0P2(1)[i], m_triangles.GetP0P2(2)[i]);
+    const Vec3 d = closestPoint - p0;
+    const double a = Vec3::dotProduct(e0, e0);
+    const double b = Vec3::dotProduct(e0, e1);
+    const double c = Vec3::dotProduct(e1, e1);
+    const double d0 = Vec3::dotProduct(d, e0);
+    const double d1 = Vec3::dotProduct(d, e1);
+    const double det = a*c - b*b;
+    const double s = det > 0.0 ? (c*d0 - b*d1)/det : 0.0;
+    const double t = det > 0.0 ? (a*d1 - b*d0)/det : 0.0;
+
+    const Vec3 normal = GetSignedDistanceData()->Pseudonormals.GetPseudonormal(i, s, t);
+    const double dist = Vec3::dotProduct(point - closestPoint, normal) < 0.0 ? -minDist : minDist;
+    return ClosestPointResult<Vec3>(closestPoint, dist, static_cast<int>(m_bvh->GetTriIndices()[i]));
+}
+
+std::size_t TriMeshProxQueryV4::CalculateKClosestPointsImpl(const Vec3& point,
+                                                        double distThreshold,
+                                                        std::size_t k,
+                                                        ClosestPointResult<Vec3>* results)const
+{
+    KClosestPointsHeap<Vec3> heap(results, k, distThreshold);
+    if(k == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    const unsigned fullMask = (1u << TriangleSoA::PACKET_SIZE) - 1;
+    double distSq[TriangleSoA::PACKET_SIZE];
+    double c[3][TriangleSoA::PACKET_SIZE];
+    double pruneDist = distThreshold;
+
+    // Nodes are pruned against the furthest of the k closest triangles found so far
+    m_bvh->Traverse(point, pruneDist, [&](const uint32_t* triIndices, uint32_t count, double& bound)
+    {
+        const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+        for(std::size_t offset = 0; offset < count; offset += TriangleSoA::PACKET_SIZE)
+        {
+            const std::size_t remaining = count - offset;
+            const unsigned laneMask = remaining >= TriangleSoA::PACKET_SIZE ? fullMask : (1u << remaining) - 1;
+            const double maxDist = heap.GetBound();
+            unsigned closer = m_triangles.CalcClosestPoints(point, first + offset, laneMask, maxDist*maxDist, distSq, c);
+            for(unsigned lane = 0; closer != 0; ++lane, closer >>= 1)
+            {
+                if((closer & 1) != 0)
+                {
+                    heap.Push(Vec3(c[0][lane], c[1][lane], c[2][lane]), sqrt(distSq[lane]),
+                              static_cast<int>(triIndices[offset + lane]));
+                }
+            }
+        }
+        bound = heap.GetBound();
+    });
+
+    return heap.Finish();
+}
+
+template<typename Visitor>
+std::size_t TriMeshProxQueryV4::VisitPolygonsWithinRadius(const Vec3& point, double radius, Visitor visitor)const
+{
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    const unsigned fullMask = (1u << TriangleSoA::PACKET_SIZE) - 1;
+    const double radiusSq = radius*radius;
+    double distSq[TriangleSoA::PACKET_SIZE];
+    double c[3][TriangleSoA::PACKET_SIZE];
+    std::size_t numFound = 0;
+    double pruneDist = radius;
+
+    // The bound stays at the radius unless the visitor asks to stop, then it is
+    // dropped to zero so that every remaining node is skipped
+    m_bvh->Traverse(point, pruneDist, [&](const uint32_t* triIndices, uint32_t count, double& bound)
+    {
+        const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+        for(std::size_t offset = 0; offset < count; offset += TriangleSoA::PACKET_SIZE)
+        {
+            const std::size_t remaining = count - offset;
+            const unsigned laneMask = remaining >= TriangleSoA::PACKET_SIZE ? fullMask : (1u << remaining) - 1;
+            unsigned closer = m_triangles.CalcClosestPoints(point, first + offset, laneMask, radiusSq, distSq, c);
+            for(unsigned lane = 0; closer != 0; ++lane, closer >>= 1)
+            {
+                if((closer & 1) == 0)
+                {
+                    continue;
+                }
+                ++numFound;
+                if(!visitor(ClosestPointResult<Vec3>(Vec3(c[0][lane], c[1][lane], c[2][lane]), sqrt(distSq[lane]),
+                                                     static_cast<int>(triIndices[offset + lane]))))
+                {
+                    bound = 0.0;
+                    return;
+                }
+            }
+        }
+    });
+
+    return numFound;
+}
+
+std::size_t TriMeshProxQueryV4::CalculatePolygonsWithinRadiusImpl(const Vec3& point,
+                                                              double radius,
+                                                              const std::function<void(const ClosestPointResult<Vec3>&)>& sink)const
+{
+    return VisitPolygonsWithinRadius(point, radius, [&sink](const ClosestPointResult<Vec3>& res)
+    {
+        sink(res);
+        return true;
+    });
+}
+
+bool TriMeshProxQueryV4::IsAnyPolygonWithinRadiusImpl(const Vec3& point, double radius)const
+{
+    return VisitPolygonsWithinRadius(point, radius, [](const ClosestPointResult<Vec3>&){return false;}) != 0;
+}
+
+bool TriMeshProxQueryV4::IntersectRayWithTriangles(const Ray<Vec3>& ray,
+                                                   std::size_t first,
+                                                   std::size_t count,
+                                                   double& maxDist,
+                                                   std::size_t& hitIndex)const
+{
+    const unsigned fullMask = (1u << TriangleSoA::PACKET_SIZE) - 1;
+    double dist[TriangleSoA::PACKET_SIZE];
+    bool found = false;
+    for(std::size_t offset = 0; offset < count; offset += TriangleSoA::PACKET_SIZE)
+    {
+        const std::size_t remaining = count - offset;
+        const unsigned laneMask = remaining >= TriangleSoA::PACKET_SIZE ? fullMask : (1u << remaining) - 1;
+        unsigned hits = m_triangles.IntersectRay(ray.Origin, ray.Direction, first + offset, laneMask, maxDist, dist);
+        for(unsigned lane = 0; hits != 0; ++lane, hits >>= 1)
+        {
+            if((hits & 1) != 0 && dist[lane] < maxDist)
+            {
+                maxDist = dist[lane];
+                hitIndex = first + offset + lane;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+RayCastResult<Vec3> TriMeshProxQueryV4::CastRayImpl(const Ray<Vec3>& ray, double maxDist)const
+{
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    double dist = maxDist;
+    std::size_t hitIndex = 0;
+    bool found = false;
+
+    m_bvh->TraverseRay(ray, dist, [&](const uint32_t* triIndices, uint32_t count, double& maxDist)
+    {
+        const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+        found |= IntersectRayWithTriangles(ray, first, count, maxDist, hitIndex);
+    });
+
+    if(!found)
+    {
+        return RayCastResult<Vec3>(ray.Origin, maxDist, -1);
+    }
+    return RayCastResult<Vec3>(ray.Origin + ray.Direction*dist, dist, static_cast<int>(allTriIndices[hitIndex]));
+}
+
+bool TriMeshProxQueryV4::IsRayBlockedImpl(const Ray<Vec3>& ray, double maxDist)const
+{
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    double dist = maxDist;
+    std::size_t hitIndex = 0;
+    bool found = false;
+
+    // Dropping the distance to zero skips every remaining node
+    m_bvh->TraverseRay(ray, dist, [&](const uint32_t* triIndices, uint32_t count, double& maxDist)
+    {
+        const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+        if(IntersectRayWithTriangles(ray, first, count, maxDist, hitIndex))
+        {
+            found = true;
+            maxDist = 0.0;
+        }
+    });
+    return found;
+}
+
+void TriMeshProxQueryV4::CastCoherentRays(const Ray<Vec3>* rays, std::size_t numRays, double maxDist, RayCastResult<Vec3>* results)const
+{
+    const uint32_t* allTriIndices = m_bvh->GetTriIndices().data();
+    Ray<Vec3> paddedBundle[RAY_BUNDLE_SIZE];
+    double dists[RAY_BUNDLE_SIZE];
+    std::size_t hitIndices[RAY_BUNDLE_SIZE];
+    for(std::size_t bundleStart = 0; bundleStart < numRays; bundleStart += RAY_BUNDLE_SIZE)
+    {
+        // The last bundle is padded with rays which can not hit anything
+        const Ray<Vec3>* bundle = rays + bundleStart;
+        const std::size_t bundleSize = std::min(RAY_BUNDLE_SIZE, numRays - bundleStart);
+        if(bundleSize < RAY_BUNDLE_SIZE)
+        {
+            std::copy(bundle, bundle + bundleSize, paddedBundle);
+            bundle = paddedBundle;
+        }
+        std::fill(dists, dists + bundleSize, maxDist);
+        std::fill(dists + bundleSize, dists + RAY_BUNDLE_SIZE, 0.0);
+        uint64_t found = 0;
+
+        m_bvh->TraverseRays<RAY_BUNDLE_SIZE>(bundle, dists, [&](const uint32_t* triIndices, uint32_t count, uint64_t rayMask)
+        {
+            const std::size_t first = static_cast<std::size_t>(triIndices - allTriIndices);
+            for(std::size_t i = 0; rayMask != 0; ++i, rayMask >>= 1)
+            {
+                if((rayMask & 1) != 0 && IntersectRayWithTriangles(bundle[i], first, count, dists[i], hitIndices[i]))
+                {
+                    found |= uint64_t(1) << i;
+                }
+            }
+        });
+
+        for(std::size_t i = 0; i < bundleSize; ++i)
+        {
+            const Ray<Vec3>& ray = bundle[i];
+            results[bundleStart + i] = ((found >> i) & 1) != 0 ?
+                    RayCastResult<Vec3>(ray.Origin + ray.Direction*dists[i], dists[i], static_cast<int>(allTriIndices[hitIndices[i]])) :
+                    RayCastResult<Vec3>(ray.Origin, maxDist, -1);
+        }
+    }
+}
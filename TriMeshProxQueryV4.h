@@ -0,0 +1,229 @@
+#pragma once
+#include "IProximityQueries.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include "BVHTree.h"
+#include "BVHCache.h"
+#include "LinearBVH.h"
+#include "TriangleSoA.h"
+#include "CompactTriangleMesh.h"
+#include "TrianglePseudonormals.h"
+#include <functional>
+#include <memory>
+#include <vector>
+namespace rabbit
+{
+
+template<typename PolygonType>
+class Mesh;
+class ThreadPool;
+
+/**
+* @brief When TriMeshProxQueryV4 welds the vertices of the triangles and calculates their
+* pseudonormals, which signed queries need and other queries do not
+*/
+enum class SignedQueryPreparation
+{
+    Lazy, ///< By the first signed query, which waits for it
+    Eager ///< While preprocessing, see TriMeshProxQueryV4::PrepareSignedQueries
+};
+
+/**
+* @brief This class implements the proximity query between point and a triangular mesh
+* using the same hierarchy as TriMeshProxQueryV3, flattened into a LinearBVH. The nodes
+* live in one contiguous array instead of being chased through pointers, which makes
+* the traversal considerably more cache friendly. The triangles are stored in the order
+* the leaves reference them, so those of a leaf are tested as packets by TriangleSoA.
+* Results agree with TriMeshProxQueryV3 within the tolerance documented in TriangleSoA.
+*
+* Signed queries need the vertices of the triangles welded and their angle weighted
+* pseudonormals, see TrianglePseudonormals, after which a signed query costs little more
+* than CalculateClosestPoint. By default the first call to CalculateSignedClosestPoint
+* calculates them, so objects which are never asked for signed distances do not pay for
+* them, in time or memory. With SignedQueryPreparation::Eager, or after PrepareSignedQueries,
+* the first signed query does not have to wait. Vertices are shared by triangles if they
+* coincide up to the rounding of the stored triangles.
+*
+* Given a BVHCache, the hierarchy and the reordered triangles are read back from it if
+* they were stored for the same mesh and BVHBuildParams before. Otherwise they are built
+* and stored, for the next process to pick up.
+*
+* Meshes which deform without changing their triangles are followed with UpdateVertices,
+* which refits the hierarchy instead of building it again. GetRefitCostRatio tells how
+* far the refitted hierarchy has degraded, and RebuildBVH restores it.
+*/
+class TriMeshProxQueryV4 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV4>
+{
+public:
+    /**
+    * @param cache Optional cache of hierarchies. A cache file which can not be written is
+    * no error, see BVHCache::TryStore.
+    * @param signedQueries Whether signed queries are prepared for while preprocessing
+    */
+    TriMeshProxQueryV4(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                       const BVHBuildParams& params = BVHBuildParams(),
+                       std::shared_ptr<BVHCache> cache = nullptr,
+                       SignedQueryPreparation signedQueries = SignedQueryPreparation::Lazy);
+
+    /**
+    * The mesh is only needed while preprocessing, so queries are as fast as with a Mesh
+    */
+    explicit TriMeshProxQueryV4(const CompactTriangleMesh& mesh,
+                                const BVHBuildParams& params = BVHBuildParams(),
+                                std::shared_ptr<BVHCache> cache = nullptr,
+                                SignedQueryPreparation signedQueries = SignedQueryPreparation::Lazy);
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
+	*/
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateSignedClosestPoint
+	*/
+    ClosestPointResult<Vec3> CalculateSignedClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateKClosestPoints
+	*/
+    std::size_t CalculateKClosestPointsImpl(const Vec3& point,
+                                            double distThreshold,
+                                            std::size_t k,
+                                            ClosestPointResult<Vec3>* results)const;
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculatePolygonsWithinRadius
+	*/
+    std::size_t CalculatePolygonsWithinRadiusImpl(const Vec3& point,
+                                                  double radius,
+                                                  const std::function<void(const ClosestPointResult<Vec3>&)>& sink)const;
+    bool IsAnyPolygonWithinRadiusImpl(const Vec3& point, double radius)const;
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CastRay
+	*/
+    RayCastResult<Vec3> CastRayImpl(const Ray<Vec3>& ray, double maxDist)const;
+    bool IsRayBlockedImpl(const Ray<Vec3>& ray, double maxDist)const;
+
+    /**
+    * Welds the vertices of the triangles and calculates their pseudonormals now, unless that
+    * has been done already, so that no signed query has to. Not safe to call while queries run.
+    */
+    void PrepareSignedQueries();
+
+    /**
+    * Same results as IProximityQueries<PolygonType, ProximityQueryMethod>::CastRays, but
+    * traces bundles of 16 neighbouring rays of the array through the hierarchy together,
+    * see LinearBVH::TraverseRays. This pays off for coherent rays, e.g. rays from nearby
+    * origins in similar directions, and is several times slower than CastRays for rays
+    * that are not.
+    */
+    void CastCoherentRays(const Ray<Vec3>* rays, std::size_t numRays, double maxDist, RayCastResult<Vec3>* results)const;
+
+    /**
+    * Moves the triangles of the mesh, keeping the triangles themselves and the way they
+    * share vertices, e.g. for a mesh deforming from frame to frame. The triangles are
+    * overwritten in place and the hierarchy is refitted, see LinearBVH::Refit, which is
+    * linear in the number of triangles. If signed queries have been prepared for, the
+    * pseudonormals are recalculated for the topology found then. Neither the Mesh the object
+    * was constructed from nor a BVHCache are updated. Throws if the number of triangles
+    * differs from that mesh.
+    * @param mesh Triangles at their new positions, in the order of the original mesh
+    * @param pool If set, the triangles and the hierarchy are updated in parallel on this pool
+    */
+    void UpdateVertices(const CompactTriangleMesh& mesh, const std::shared_ptr<ThreadPool>& pool = nullptr);
+
+    /**
+    * As above, for a triangle soup
+    * @param coords numTriangles*9 coordinates, x, y and z of each vertex of each triangle
+    */
+    void UpdateVertices(const double* coords, std::size_t numTriangles, const std::shared_ptr<ThreadPool>& pool = nullptr);
+
+    /**
+    * A refitted hierarchy keeps grouping the triangles it grouped when it was built. As they
+    * move away from each other, the AABBs grow and overlap, and queries test more triangles.
+    * @return SAH cost of the hierarchy at the current positions of the triangles, divided by
+    * its cost when it was last built, see LinearBVH::CalcSAHCost. One right after building.
+    * Once this has grown well beyond one, e.g. to 1.5, RebuildBVH pays off.
+    */
+    double GetRefitCostRatio()const;
+
+    /**
+    * Builds the hierarchy again for the current positions of the triangles, with the
+    * BVHBuildParams it was first built with
+    */
+    void RebuildBVH();
+
+    const LinearBVH& GetBVH()const{return *m_bvh;}
+
+    /**
+    * @return Triangles of the mesh in the order of GetBVH().GetTriIndices()
+    */
+    const TriangleSoA& GetTriangles()const{return m_triangles;}
+
+private:
+
+    // Finds the triangle closest to point within distThreshold. On success, closestIndex is
+    // its position in m_triangles and minDist the distance to closestPoint.
+    bool FindClosest(const Vec3& point,
+                     double distThreshold,
+                     Vec3& closestPoint,
+                     double& minDist,
+                     std::size_t& closestIndex)const;
+
+    // Calls visitor(result) for each triangle closer to point than radius until it returns false
+    template<typename Visitor>
+    std::size_t VisitPolygonsWithinRadius(const Vec3& point, double radius, Visitor visitor)const;
+
+    // Intersects the ray with the triangles [first, first + count) of m_triangles. If any is
+    // hit before maxDist, maxDist is lowered to the closest hit and hitIndex set to its triangle.
+    bool IntersectRayWithTriangles(const Ray<Vec3>& ray,
+                                   std::size_t first,
+                                   std::size_t count,
+                                   double& maxDist,
+                                   std::size_t& hitIndex)const;
+
+	// Build the hierarchy over the bounding boxes of the triangles and flatten it,
+	// unless the cache already has it
+    void Preprocess(std::size_t numTriangles,
+                    const std::function<Triangle<Vec3>(std::size_t)>& getTriangle,
+                    const BVHBuildParams& params,
+                    const std::shared_ptr<BVHCache>& cache,
+                    SignedQueryPreparation signedQueries);
+
+    // Fills m_bvh and m_triangles
+    void BuildBVH(std::size_t numTriangles,
+                  const std::function<Triangle<Vec3>(std::size_t)>& getTriangle,
+                  const BVHBuildParams& params);
+
+    // Overwrites the triangles with getVertices(i, vertices), i in the order of the
+    // original mesh, then refits the hierarchy and recalculates any pseudonormals
+    void UpdateVertices(std::size_t numTriangles,
+                        const std::function<void(std::size_t, Vec3*)>& getVertices,
+                        const std::shared_ptr<ThreadPool>& pool);
+
+    // Welded vertices of the triangles and their pseudonormals, needed by signed queries only
+    struct SignedDistanceData
+    {
+        TrianglePseudonormals Pseudonormals; ///< Pseudonormals in the same order as m_triangles
+        std::vector<uint32_t> VertexIndices; ///< Three welded vertex indices per triangle of m_triangles
+        std::size_t NumVertices;             ///< Number of welded vertices
+    };
+
+    // Returns m_signedData, welding the vertices of the triangles and calculating their
+    // pseudonormals first if that has not been done yet. Safe to call from several threads.
+    std::shared_ptr<const SignedDistanceData> GetSignedDistanceData()const;
+
+    // Coordinates of the welded vertices at the current positions of the triangles
+    std::vector<double> GatherVertices(const SignedDistanceData& data)const;
+
+    BVHBuildParams m_params;               ///< Parameters the hierarchy is built with
+    std::unique_ptr<LinearBVH> m_bvh;      ///< Flattened hierarchy over the triangles of the mesh
+    TriangleSoA m_triangles;               ///< Triangles in the order of LinearBVH::GetTriIndices
+    double m_builtSAHCost;                 ///< SAH cost of m_bvh when it was built
+
+    /// Set once signed queries are prepared for, swapped in atomically as queries run concurrently
+    mutable std::shared_ptr<SignedDistanceData> m_signedData;
+};
+
+}
@@ -0,0 +1,239 @@
+#include "TriMeshProxQueryV5.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+
+    const double INF = std::numeric_limits<double>::infinity();
+
+    // Flat meshes have no volume, the grid is given this fraction of their size along the flat axes
+    const double MIN_RELATIVE_EXTENT = 1e-3;
+}
+
+TriMeshProxQueryV5::TriMeshProxQueryV5(std::shared_ptr<Mesh<Tri>> mesh, const UniformGridParams& params):
+        IProximityQueries<Tri, TriMeshProxQueryV5>(mesh)
+{
+    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+    Preprocess(triangles.size(), [&triangles](std::size_t i){return triangles[i];}, params);
+}
+
+TriMeshProxQueryV5::TriMeshProxQueryV5(const CompactTriangleMesh& mesh, const UniformGridParams& params):
+        IProximityQueries<Tri, TriMeshProxQueryV5>(nullptr)
+{
+    Preprocess(mesh.GetNumTriangles(), [&mesh](std::size_t i){return mesh.GetTriangle(i);}, params);
+}
+
+void TriMeshProxQueryV5::Preprocess(std::size_t numTriangles,
+                                    const std::function<Tri(std::size_t)>& getTriangle,
+                                    const UniformGridParams& params)
+{
+    m_origin[0] = m_origin[1] = m_origin[2] = 0.0;
+    m_cellSize = 1.0;
+    m_numCells[0] = m_numCells[1] = m_numCells[2] = 0;
+    m_cellStart.assign(1, 0);
+    if(numTriangles == 0)
+    {
+        return;
+    }
+
+    // Bounds of every triangle and of the whole mesh
+    std::vector<Bounds> bounds;
+    bounds.reserve(numTriangles);
+    double lower[3] = {INF, INF, INF};
+    double upper[3] = {-INF, -INF, -INF};
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        const Bounds b = getTriangle(i).CalculateAABB().GetBounds();
+        bounds.push_back(b);
+        lower[0] = std::min(lower[0], b.xMin); upper[0] = std::max(upper[0], b.xMax);
+        lower[1] = std::min(lower[1], b.yMin); upper[1] = std::max(upper[1], b.yMax);
+        lower[2] = std::min(lower[2], b.zMin); upper[2] = std::max(upper[2], b.zMax);
+    }
+
+    // Cubic cells, as many as it takes to get the requested number of triangles per cell
+    double extent[3];
+    const double maxExtent = std::max(std::max(upper[0] - lower[0], upper[1] - lower[1]), upper[2] - lower[2]);
+    const double minExtent = maxExtent > 0.0 ? maxExtent*MIN_RELATIVE_EXTENT : 1.0;
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        extent[axis] = std::max(upper[axis] - lower[axis], minExtent);
+    }
+    const double numCellsWanted = std::max(1.0, numTriangles/std::max(params.TrisPerCell, 1e-3));
+    const unsigned maxCellsPerAxis = std::max(params.MaxCellsPerAxis, 1u);
+    m_cellSize = std::cbrt(extent[0]*extent[1]*extent[2]/numCellsWanted);
+    m_cellSize = std::max(m_cellSize, std::max(maxExtent, minExtent)/maxCellsPerAxis);
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        const double numCells = std::ceil(extent[axis]/m_cellSize);
+        m_numCells[axis] = static_cast<unsigned>(std::min(std::max(numCells, 1.0), double(maxCellsPerAxis)));
+        m_origin[axis] = lower[axis];
+    }
+
+    // Count the entries of each cell, then sort the triangles into the cells
+    const std::size_t totalCells = std::size_t(m_numCells[0])*m_numCells[1]*m_numCells[2];
+    std::vector<std::size_t> counts(totalCells + 1, 0);
+    auto forEachCell = [this](const Bounds& b, const std::function<void(std::size_t)>& fn)
+    {
+        const int x0 = CellCoord(b.xMin, 0), x1 = CellCoord(b.xMax, 0);
+        const int y0 = CellCoord(b.yMin, 1), y1 = CellCoord(b.yMax, 1);
+        const int z0 = CellCoord(b.zMin, 2), z1 = CellCoord(b.zMax, 2);
+        for(int z = z0; z <= z1; ++z)
+        for(int y = y0; y <= y1; ++y)
+        for(int x = x0; x <= x1; ++x)
+        {
+            fn((std::size_t(z)*m_numCells[1] + y)*m_numCells[0] + x);
+        }
+    };
+    for(const Bounds& b : bounds)
+    {
+        forEachCell(b, [&counts](std::size_t cell){++counts[cell + 1];});
+    }
+    for(std::size_t cell = 0; cell < totalCells; ++cell)
+    {
+        counts[cell + 1] += counts[cell];
+    }
+    if(counts.back() > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::runtime_error("Too many triangles in the cells of the grid");
+    }
+
+    m_cellStart.assign(counts.begin(), counts.end());
+    m_cellTriIndices.resize(counts.back());
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        forEachCell(bounds[i], [&](std::size_t cell){m_cellTriIndices[counts[cell]++] = static_cast<uint32_t>(i);});
+    }
+
+    m_triangles.Reserve(m_cellTriIndices.size());
+    for(uint32_t i : m_cellTriIndices)
+    {
+        m_triangles.PushBack(getTriangle(i));
+    }
+}
+
+int TriMeshProxQueryV5::CellCoord(double coord, unsigned axis)const
+{
+    const double cell = std::floor((coord - m_origin[axis])/m_cellSize);
+    if(!(cell >= 0.0))
+    {
+        return 0;
+    }
+    return cell < m_numCells[axis] ? static_cast<int>(cell) : static_cast<int>(m_numCells[axis]) - 1;
+}
+
+double TriMeshProxQueryV5::CalcShortestDistanceSqFrom(const Vec3& point, int x, int y, int z)const
+{
+    const int cell[3] = {x, y, z};
+    const double coords[3] = {point.X(), point.Y(), point.Z()};
+    double distSq = 0.0;
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        const double lower = m_origin[axis] + cell[axis]*m_cellSize;
+        const double dist = std::max(std::max(lower - coords[axis], coords[axis] - (lower + m_cellSize)), 0.0);
+        distSq += dist*dist;
+    }
+    return distSq;
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV5::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    Vec3 closestPoint;
+    double minDistSq = distThreshold*distThreshold;
+    std::size_t closestIndex = 0;
+    bool found = false;
+    if(m_numCells[0] == 0)
+    {
+        return ClosestPointResult<Vec3>(closestPoint, distThreshold, -1);
+    }
+
+    // Only the cells overlapping the sphere of radius distThreshold around the point are looked at
+    const double coords[3] = {point.X(), point.Y(), point.Z()};
+    int center[3], lower[3], upper[3];
+    const bool bounded = minDistSq < INF;
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        center[axis] = CellCoord(coords[axis], axis);
+        lower[axis] = bounded ? CellCoord(coords[axis] - distThreshold, axis) : 0;
+        upper[axis] = bounded ? CellCoord(coords[axis] + distThreshold, axis) : static_cast<int>(m_numCells[axis]) - 1;
+    }
+
+    auto visitCell = [&](int x, int y, int z)
+    {
+        const std::size_t cell = (std::size_t(z)*m_numCells[1] + y)*m_numCells[0] + x;
+        const uint32_t first = m_cellStart[cell];
+        const uint32_t count = m_cellStart[cell + 1] - first;
+        if(count != 0 && CalcShortestDistanceSqFrom(point, x, y, z) < minDistSq &&
+           m_triangles.FindClosestInRange(point, first, count, minDistSq, closestPoint, closestIndex))
+        {
+            found = true;
+        }
+    };
+
+    // Shell k holds the cells k cells away from the center along at least one axis
+    for(int k = 0; ; ++k)
+    {
+        // Every cell of the shell is at least as far away as one of the slabs k cells away
+        double shellDistSq = INF;
+        if(k == 0)
+        {
+            shellDistSq = CalcShortestDistanceSqFrom(point, center[0], center[1], center[2]);
+        }
+        for(unsigned axis = 0; axis < 3 && k != 0; ++axis)
+        {
+            for(int slab : {center[axis] - k, center[axis] + k})
+            {
+                if(slab >= lower[axis] && slab <= upper[axis])
+                {
+                    const double slabLower = m_origin[axis] + slab*m_cellSize;
+                    const double dist = std::max(std::max(slabLower - coords[axis], coords[axis] - (slabLower + m_cellSize)), 0.0);
+                    shellDistSq = std::min(shellDistSq, dist*dist);
+                }
+            }
+        }
+        if(shellDistSq == INF || shellDistSq >= minDistSq)
+        {
+            break;
+        }
+
+        const int x0 = std::max(lower[0], center[0] - k), x1 = std::min(upper[0], center[0] + k);
+        const int y0 = std::max(lower[1], center[1] - k), y1 = std::min(upper[1], center[1] + k);
+        const int z0 = std::max(lower[2], center[2] - k), z1 = std::min(upper[2], center[2] + k);
+        for(int x = x0; x <= x1; ++x)
+        {
+            for(int y = y0; y <= y1; ++y)
+            {
+                if(std::abs(x - center[0]) == k || std::abs(y - center[1]) == k)
+                {
+                    for(int z = z0; z <= z1; ++z)
+                    {
+                        visitCell(x, y, z);
+                    }
+                }
+                else
+                {
+                    // Only the two ends of the column belong to the shell
+                    if(center[2] - k >= lower[2])
+                    {
+                        visitCell(x, y, center[2] - k);
+                    }
+                    if(center[2] + k <= upper[2])
+                    {
+                        visitCell(x, y, center[2] + k);
+                    }
+                }
+            }
+        }
+    }
+
+    if(!found)
+    {
+        return ClosestPointResult<Vec3>(closestPoint, distThreshold, -1);
+    }
+    return ClosestPointResult<Vec3>(closestPoint, sqrt(minDistSq), static_cast<int>(m_cellTriIndices[closestIndex]));
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "IProximityQueries.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include "TriangleSoA.h"
+#include "CompactTriangleMesh.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+namespace rabbit
+{
+
+template<typename PolygonType>
+class Mesh;
+
+/**
+* @brief Parameters for building the grid of TriMeshProxQueryV5
+*/
+struct UniformGridParams
+{
+    explicit UniformGridParams(double trisPerCell = 2.0,
+                               unsigned maxCellsPerAxis = 256):
+        TrisPerCell(trisPerCell),
+        MaxCellsPerAxis(maxCellsPerAxis){}
+
+    double TrisPerCell;       ///< Number of triangles per cell aimed for, which sets the size of the cells
+    unsigned MaxCellsPerAxis; ///< Limits the memory taken by the grid of very flat or elongated meshes
+};
+
+/**
+* @brief This class implements the proximity query between point and a triangular mesh
+* using a uniform grid of cubic cells laid over the bounds of the mesh. Each triangle is
+* listed in every cell its bounding box overlaps, and the triangles of each cell are kept
+* together in a TriangleSoA, so a cell is tested as packets just like a leaf of
+* TriMeshProxQueryV4.
+*
+* A query visits the cells in shells of growing distance from the cell holding the point,
+* only looking at the cells overlapping the sphere of radius distThreshold and skipping
+* those further away than the closest point found so far. It stops as soon as no cell of
+* the next shell can be closer. Without a threshold, the shells simply keep expanding
+* until that happens. Queries close to the surface with a small threshold therefore only
+* look at a handful of cells, which makes the grid hard to beat for such workloads, while
+* points far from the mesh are better served by a hierarchy.
+*/
+class TriMeshProxQueryV5 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV5>
+{
+public:
+    TriMeshProxQueryV5(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                       const UniformGridParams& params = UniformGridParams());
+
+    /**
+    * The mesh is only needed while preprocessing, so queries are as fast as with a Mesh
+    */
+    explicit TriMeshProxQueryV5(const CompactTriangleMesh& mesh,
+                                const UniformGridParams& params = UniformGridParams());
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
+	*/
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+    /**
+    * @return Number of cells along axis 0, 1 or 2
+    */
+    unsigned GetNumCells(unsigned axis)const{return m_numCells[axis];}
+    double GetCellSize()const{return m_cellSize;}
+
+    /**
+    * @return Number of entries in all the cells. Triangles overlapping several cells are counted once for each.
+    */
+    std::size_t GetNumCellEntries()const{return m_cellTriIndices.size();}
+
+private:
+
+	// Lay the grid over the bounds of the mesh and sort the triangles into its cells
+    void Preprocess(std::size_t numTriangles,
+                    const std::function<Triangle<Vec3>(std::size_t)>& getTriangle,
+                    const UniformGridParams& params);
+
+    // Index of the cell which holds coord along axis, clamped to the grid
+    int CellCoord(double coord, unsigned axis)const;
+
+    // Squared distance between point and cell x, y, z
+    double CalcShortestDistanceSqFrom(const Vec3& point, int x, int y, int z)const;
+
+    double m_origin[3];      ///< Lower corner of the grid
+    double m_cellSize;       ///< Length of the edges of the cells
+    unsigned m_numCells[3];  ///< Number of cells along each axis, all zero for an empty mesh
+    std::vector<uint32_t> m_cellStart;      ///< Cell i holds the entries [m_cellStart[i], m_cellStart[i + 1])
+    std::vector<uint32_t> m_cellTriIndices; ///< Index of the triangle of each entry, ordered by cell
+    TriangleSoA m_triangles;                ///< Triangle of each entry, in the same order
+};
+
+}
@@ -0,0 +1,124 @@
+#include "TriMeshProxQueryV6.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+using namespace rabbit;
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+}
+
+TriMeshProxQueryV6::TriMeshProxQueryV6(const DynamicAABBTreeParams& params):
+        IProximityQueries<Tri, TriMeshProxQueryV6>(nullptr),
+        m_tree(params)
+{
+}
+
+TriMeshProxQueryV6::TriMeshProxQueryV6(std::shared_ptr<Mesh<Tri>> mesh, const DynamicAABBTreeParams& params):
+        IProximityQueries<Tri, TriMeshProxQueryV6>(mesh),
+        m_tree(params)
+{
+    const std::vector<Tri>& triangles = m_mesh->GetPolygons();
+    m_triangles.reserve(triangles.size());
+    for(const Tri& t : triangles)
+    {
+        AddTriangle(t);
+    }
+}
+
+TriMeshProxQueryV6::TriMeshProxQueryV6(const CompactTriangleMesh& mesh, const DynamicAABBTreeParams& params):
+        IProximityQueries<Tri, TriMeshProxQueryV6>(nullptr),
+        m_tree(params)
+{
+    m_triangles.reserve(mesh.GetNumTriangles());
+    for(std::size_t i = 0; i < mesh.GetNumTriangles(); ++i)
+    {
+        AddTriangle(mesh.GetTriangle(i));
+    }
+}
+
+void TriMeshProxQueryV6::CheckHandle(int handle)const
+{
+    if(!HasTriangle(handle))
+    {
+        throw std::runtime_error("Invalid triangle handle");
+    }
+}
+
+bool TriMeshProxQueryV6::HasTriangle(int handle)const
+{
+    return handle >= 0 &&
+           static_cast<std::size_t>(handle) < m_proxies.size() &&
+           m_proxies[handle] != DynamicAABBTree::NULL_NODE;
+}
+
+const Tri& TriMeshProxQueryV6::GetTriangle(int handle)const
+{
+    CheckHandle(handle);
+    return m_triangles[handle];
+}
+
+int TriMeshProxQueryV6::AddTriangle(const Tri& triangle)
+{
+    if(m_freeHandles.empty() && m_proxies.size() >= static_cast<std::size_t>(std::numeric_limits<int>::max()))
+    {
+        throw std::runtime_error("Too many triangles");
+    }
+
+    // Nothing changes before the tree has accepted the triangle
+    const int handle = m_freeHandles.empty() ? static_cast<int>(m_proxies.size()) : m_freeHandles.front();
+    const int proxy = m_tree.Insert(triangle.CalculateAABB().GetBounds(), handle);
+    if(m_freeHandles.empty())
+    {
+        m_triangles.push_back(triangle);
+        m_proxies.push_back(proxy);
+    }
+    else
+    {
+        std::pop_heap(m_freeHandles.begin(), m_freeHandles.end(), std::greater<int>());
+        m_freeHandles.pop_back();
+        m_triangles[handle] = triangle;
+        m_proxies[handle] = proxy;
+    }
+    return handle;
+}
+
+void TriMeshProxQueryV6::RemoveTriangle(int handle)
+{
+    CheckHandle(handle);
+    m_tree.Remove(m_proxies[handle]);
+    m_proxies[handle] = DynamicAABBTree::NULL_NODE;
+    m_freeHandles.push_back(handle);
+    std::push_heap(m_freeHandles.begin(), m_freeHandles.end(), std::greater<int>());
+}
+
+void TriMeshProxQueryV6::MoveTriangle(int handle, const Tri& triangle)
+{
+    CheckHandle(handle);
+    m_triangles[handle] = triangle;
+    m_tree.Move(m_proxies[handle], triangle.CalculateAABB().GetBounds());
+}
+
+ClosestPointResult<Vec3> TriMeshProxQueryV6::CalculateClosestPointImpl(const Vec3& point,double distThreshold)const
+{
+    Vec3 closestPoint;
+    double minDist = distThreshold;
+    int closestTri = -1;
+
+    // Lowering minDist as closer triangles are found prunes the rest of the traversal
+    m_tree.Traverse(point, minDist, [&](int handle, double& bound)
+    {
+        const IntersectionResult<Vec3> res = m_triangles[handle].CalcShortestDistanceFrom(point, bound);
+        if(res.Dist < bound)
+        {
+            bound = res.Dist;
+            closestPoint = res.Point;
+            closestTri = handle;
+        }
+    });
+
+    return ClosestPointResult<Vec3>(closestPoint, minDist, closestTri);
+}
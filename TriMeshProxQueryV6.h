@@ -0,0 +1,82 @@
+#pragma once
+#include "IProximityQueries.h"
+#include "Triangle.h"
+#include "Vec3.h"
+#include "DynamicAABBTree.h"
+#include "CompactTriangleMesh.h"
+#include <vector>
+namespace rabbit
+{
+
+template<typename PolygonType>
+class Mesh;
+
+/**
+* @brief This class implements the proximity query between point and a set of triangles
+* which changes while it is being queried, e.g. in a scene editor. The triangles are kept
+* in a DynamicAABBTree, so adding, removing and moving a triangle costs O(log N) instead of
+* building a hierarchy again, at the price of queries somewhat slower than with
+* TriMeshProxQueryV4.
+*
+* Triangles are identified by handles returned by AddTriangle, which stay valid until the
+* triangle is removed and are then reused for triangles added later. A triangle of the mesh
+* the object was constructed from has its index in the mesh as handle. PolygonIndex of the
+* query results is the handle of the closest triangle. The Mesh itself is never modified.
+*/
+class TriMeshProxQueryV6 : public IProximityQueries<Triangle<Vec3>, TriMeshProxQueryV6>
+{
+public:
+    /**
+    * Starts off without any triangles
+    */
+    explicit TriMeshProxQueryV6(const DynamicAABBTreeParams& params = DynamicAABBTreeParams());
+
+    TriMeshProxQueryV6(std::shared_ptr<Mesh<Triangle<Vec3>>> mesh,
+                       const DynamicAABBTreeParams& params = DynamicAABBTreeParams());
+
+    explicit TriMeshProxQueryV6(const CompactTriangleMesh& mesh,
+                                const DynamicAABBTreeParams& params = DynamicAABBTreeParams());
+
+   /**
+	* See documentation for IProximityQueries<PolygonType, ProximityQueryMethod>::CalculateClosestPoint
+	*/
+    ClosestPointResult<Vec3> CalculateClosestPointImpl(const Vec3& point,double distThreshold)const;
+
+    /**
+    * @return Handle of the triangle, the lowest one not in use
+    */
+    int AddTriangle(const Triangle<Vec3>& triangle);
+
+    /**
+    * Throws if handle is not the handle of a triangle
+    */
+    void RemoveTriangle(int handle);
+
+    /**
+    * Replaces a triangle, keeping its handle. Throws if handle is not the handle of a triangle.
+    */
+    void MoveTriangle(int handle, const Triangle<Vec3>& triangle);
+
+    bool HasTriangle(int handle)const;
+
+    /**
+    * Throws if handle is not the handle of a triangle
+    */
+    const Triangle<Vec3>& GetTriangle(int handle)const;
+
+    std::size_t GetNumTriangles()const{return m_tree.GetNumProxies();}
+
+    const DynamicAABBTree& GetTree()const{return m_tree;}
+
+private:
+
+    // Throws unless handle is the handle of a triangle
+    void CheckHandle(int handle)const;
+
+    DynamicAABBTree m_tree;                 ///< Proxies of the triangles, with their handles as user data
+    std::vector<Triangle<Vec3>> m_triangles; ///< Triangle of each handle, stale for unused handles
+    std::vector<int> m_proxies;             ///< Proxy of each handle in m_tree, NULL_NODE for unused handles
+    std::vector<int> m_freeHandles;         ///< Unused handles, kept as a heap with the lowest one on top
+};
+
+}
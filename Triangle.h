@@ -3,6 +3,7 @@
 #include "Polygon.h"
 #include "IntersectionResult.h"
 #include "AABB.h"
+#include "QueryStats.h"
 #include <math.h>
 
 namespace rabbit
@@ -50,6 +51,9 @@ public:
 	using Polygon<T, 3, ids>::m_verts;
 	using Polygon<T, 3, ids>::m_edges;
 
+    // Degenerate triangle at the origin, meant to be assigned to
+    Triangle(){}
+
     Triangle(const T& p0, const T& p1, const T& p2):
         Polygon<T, 3, ids>({p0, p1, p2}, {p1-p0, p2-p0, p2-p1}),
         m_normal((T::crossProduct(p1-p0,p2-p0).normalise())){}
@@ -108,6 +112,17 @@ public:
                                               const T& point)const;
 
 
+	/**
+	* Intersects the ray origin + direction*t, t > 0, with the triangle using the
+	* Moller-Trumbore algorithm, which works on the stored edges directly.
+	* Rays in the plane of the triangle do not hit it.
+	* @param maxDist Hits at t >= maxDist are ignored
+	* @return The point hit and its t, which is std::numeric_limits<double>::max() if the triangle was not hit
+	*/
+    IntersectionResult<T> IntersectRay(const T& origin,
+                                       const T& direction,
+                                       double maxDist) const;
+
     AABB<T> CalculateAABB() const;
 
     ~Triangle(){};
@@ -167,6 +182,7 @@ PointSegIntersection<T> Triangle<T>::CheckPointSegDist(const T& origin,const T&
 template<typename T>
 IntersectionResult<T> Triangle<T>::CalcShortestDistanceFrom(const T& p, double maxDist)const
 {
+    QueryStats::CountTrianglesTested(1);
     const auto projectedPointData = ProjectPointOntoShapePlane(p);
     const auto pDist = projectedPointData.Dist;
     if(pDist > maxDist)
@@ -224,6 +240,41 @@ IntersectionResult<T> Triangle<T>::CalcShortestDistanceFrom(const T& p, double m
     }
 }
 
+template<typename T>
+IntersectionResult<T> Triangle<T>::IntersectRay(const T& origin, const T& direction, double maxDist)const
+{
+    // Solve origin + direction*t = P0 + u*P0P1 + v*P0P2 by Cramer's rule
+    const T pvec = T::crossProduct(direction, m_edges[1]);
+    const double det = T::dotProduct(m_edges[0], pvec);
+    const IntersectionResult<T> miss(origin, std::numeric_limits<double>::max());
+    if(det == 0.0)
+    {
+        return miss;
+    }
+
+    const double inverseDet = 1.0/det;
+    const T tvec = origin - m_verts[0];
+    const double u = T::dotProduct(tvec, pvec)*inverseDet;
+    if(u < 0.0 || u > 1.0)
+    {
+        return miss;
+    }
+
+    const T qvec = T::crossProduct(tvec, m_edges[0]);
+    const double v = T::dotProduct(direction, qvec)*inverseDet;
+    if(v < 0.0 || u + v > 1.0)
+    {
+        return miss;
+    }
+
+    const double t = T::dotProduct(m_edges[1], qvec)*inverseDet;
+    if(!(t > 0.0 && t < maxDist))
+    {
+        return miss;
+    }
+    return IntersectionResult<T>(T(origin + direction*t), t);
+}
+
 template<typename T>
 IntersectionResult<T> Triangle<T>::ProjectPointOntoShapePlane(const T& p)const
 {
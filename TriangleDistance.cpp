@@ -0,0 +1,253 @@
+#include "TriangleDistance.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace rabbit;
+namespace
+{
+    // Closest point to p on the triangle abc, following the Voronoi regions of its features
+    // (Ericson, Real-Time Collision Detection, 5.1.5). The triangle must not be degenerate.
+    Vec3 ClosestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+    {
+        const Vec3 ab = b - a;
+        const Vec3 ac = c - a;
+        const Vec3 ap = p - a;
+        const double d1 = Vec3::dotProduct(ab, ap);
+        const double d2 = Vec3::dotProduct(ac, ap);
+        if(d1 <= 0.0 && d2 <= 0.0)
+        {
+            return a;
+        }
+
+        const Vec3 bp = p - b;
+        const double d3 = Vec3::dotProduct(ab, bp);
+        const double d4 = Vec3::dotProduct(ac, bp);
+        if(d3 >= 0.0 && d4 <= d3)
+        {
+            return b;
+        }
+
+        const double vc = d1*d4 - d3*d2;
+        if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        {
+            return a + ab*(d1/(d1 - d3));
+        }
+
+        const Vec3 cp = p - c;
+        const double d5 = Vec3::dotProduct(ab, cp);
+        const double d6 = Vec3::dotProduct(ac, cp);
+        if(d6 >= 0.0 && d5 <= d6)
+        {
+            return c;
+        }
+
+        const double vb = d5*d2 - d1*d6;
+        if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        {
+            return a + ac*(d2/(d2 - d6));
+        }
+
+        const double va = d3*d6 - d5*d4;
+        if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+        {
+            return b + (c - b)*((d4 - d3)/((d4 - d3) + (d5 - d6)));
+        }
+
+        const double denom = 1.0/(va + vb + vc);
+        return a + ab*(vb*denom) + ac*(vc*denom);
+    }
+
+    // Closest points c1 on the segment p1q1 and c2 on p2q2 (Ericson, 5.1.9), handling
+    // segments which degenerate to points and parallel segments
+    void ClosestPointsOnSegments(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Vec3& c1, Vec3& c2)
+    {
+        const Vec3 d1 = q1 - p1;
+        const Vec3 d2 = q2 - p2;
+        const Vec3 r = p1 - p2;
+        const double a = Vec3::dotProduct(d1, d1);
+        const double e = Vec3::dotProduct(d2, d2);
+        const double f = Vec3::dotProduct(d2, r);
+        double s = 0.0;
+        double t = 0.0;
+
+        if(a == 0.0 && e == 0.0)
+        {
+            c1 = p1;
+            c2 = p2;
+            return;
+        }
+        if(a == 0.0)
+        {
+            t = std::min(std::max(f/e, 0.0), 1.0);
+        }
+        else
+        {
+            const double c = Vec3::dotProduct(d1, r);
+            if(e == 0.0)
+            {
+                s = std::min(std::max(-c/a, 0.0), 1.0);
+            }
+            else
+            {
+                // Parallel segments have a zero denominator, any s gives a closest pair then
+                const double b = Vec3::dotProduct(d1, d2);
+                const double denom = a*e - b*b;
+                s = denom > 0.0 ? std::min(std::max((b*f - c*e)/denom, 0.0), 1.0) : 0.0;
+                t = (b*s + f)/e;
+                if(t < 0.0)
+                {
+                    t = 0.0;
+                    s = std::min(std::max(-c/a, 0.0), 1.0);
+                }
+                else if(t > 1.0)
+                {
+                    t = 1.0;
+                    s = std::min(std::max((b - c)/a, 0.0), 1.0);
+                }
+            }
+        }
+        c1 = p1 + d1*s;
+        c2 = p2 + d2*t;
+    }
+
+    // Signed distances of the vertices of the triangle v to the plane of a triangle, scaled
+    // by the length of the normal
+    void PlaneDistances(const Vec3& normal, const Vec3& origin, const Vec3 v[3], double dists[3])
+    {
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            dists[i] = Vec3::dotProduct(normal, v[i] - origin);
+        }
+    }
+
+    bool StraddlesPlane(const double dists[3])
+    {
+        const double lo = std::min(dists[0], std::min(dists[1], dists[2]));
+        const double hi = std::max(dists[0], std::max(dists[1], dists[2]));
+        return lo <= 0.0 && hi >= 0.0;
+    }
+
+    // Checks whether the segment pq, whose end points are at the scaled signed distances
+    // dp and dq from the plane of the triangle t with the given normal, pierces t
+    bool SegmentPiercesTriangle(const Vec3& p, const Vec3& q, double dp, double dq,
+                                const Vec3 t[3], const Vec3& normal, Vec3& hit)
+    {
+        if((dp > 0.0 && dq > 0.0) || (dp < 0.0 && dq < 0.0) || dp == dq)
+        {
+            return false;
+        }
+        hit = p + (q - p)*(dp/(dp - dq));
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            const Vec3& e0 = t[i];
+            const Vec3& e1 = t[(i + 1)%3];
+            if(Vec3::dotProduct(normal, Vec3::crossProduct(e1 - e0, hit - e0)) < 0.0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Gap between the projections of the triangles onto axis, zero if they overlap. Any
+    // axis gives a lower bound of the distance, scaled by the length of axis.
+    double ProjectedGap(const Vec3& axis, const Vec3 a[3], const Vec3 b[3])
+    {
+        const double a0 = Vec3::dotProduct(axis, a[0]);
+        const double a1 = Vec3::dotProduct(axis, a[1]);
+        const double a2 = Vec3::dotProduct(axis, a[2]);
+        const double b0 = Vec3::dotProduct(axis, b[0]);
+        const double b1 = Vec3::dotProduct(axis, b[1]);
+        const double b2 = Vec3::dotProduct(axis, b[2]);
+        const double gap = std::max(std::min(b0, std::min(b1, b2)) - std::max(a0, std::max(a1, a2)),
+                                    std::min(a0, std::min(a1, a2)) - std::max(b0, std::max(b1, b2)));
+        return std::max(gap, 0.0);
+    }
+
+    // Lowers best to the distance between pa and pb if that is smaller
+    void Update(const Vec3& pa, const Vec3& pb, TriangleDistanceResult& best)
+    {
+        const Vec3 d = pa - pb;
+        const double distSq = Vec3::dotProduct(d, d);
+        if(distSq < best.Dist)
+        {
+            best = TriangleDistanceResult(pa, pb, distSq);
+        }
+    }
+}
+
+TriangleDistanceResult rabbit::CalcTriangleDistance(const Vec3 a[3], const Vec3 b[3], double maxDist)
+{
+    const Vec3 normalA = Vec3::crossProduct(a[1] - a[0], a[2] - a[0]);
+    const Vec3 normalB = Vec3::crossProduct(b[1] - b[0], b[2] - b[0]);
+    const double normalASq = Vec3::dotProduct(normalA, normalA);
+    const double normalBSq = Vec3::dotProduct(normalB, normalB);
+    const bool degenerateA = normalASq == 0.0;
+    const bool degenerateB = normalBSq == 0.0;
+
+    // Separated along the normals or the line between the centroids by at least maxDist
+    if(maxDist < std::numeric_limits<double>::max())
+    {
+        const Vec3 centerLine = (b[0] + b[1] + b[2]) - (a[0] + a[1] + a[2]);
+        const double centerLineSq = Vec3::dotProduct(centerLine, centerLine);
+        double gap = 0.0;
+        if(!degenerateA) gap = std::max(gap, ProjectedGap(normalA, a, b)/std::sqrt(normalASq));
+        if(!degenerateB) gap = std::max(gap, ProjectedGap(normalB, a, b)/std::sqrt(normalBSq));
+        if(centerLineSq > 0.0) gap = std::max(gap, ProjectedGap(centerLine, a, b)/std::sqrt(centerLineSq));
+        if(gap >= maxDist)
+        {
+            return TriangleDistanceResult(a[0], b[0], gap);
+        }
+    }
+
+    // Intersecting triangles have an edge piercing the other triangle, unless they are
+    // coplanar, in which case their edges cross or a vertex lies inside the other triangle.
+    // A degenerate triangle has no plane, so only its own edges can pierce.
+    double distsToA[3];
+    double distsToB[3];
+    PlaneDistances(normalA, a[0], b, distsToA);
+    PlaneDistances(normalB, b[0], a, distsToB);
+    const bool straddlesA = !degenerateA && StraddlesPlane(distsToA);
+    const bool straddlesB = !degenerateB && StraddlesPlane(distsToB);
+    const bool edgesOfAPierce = straddlesB && (degenerateA || straddlesA);
+    const bool edgesOfBPierce = straddlesA && (degenerateB || straddlesB);
+    if(edgesOfAPierce || edgesOfBPierce)
+    {
+        Vec3 hit;
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            const unsigned j = (i + 1)%3;
+            if((edgesOfAPierce && SegmentPiercesTriangle(a[i], a[j], distsToB[i], distsToB[j], b, normalB, hit)) ||
+               (edgesOfBPierce && SegmentPiercesTriangle(b[i], b[j], distsToA[i], distsToA[j], a, normalA, hit)))
+            {
+                return TriangleDistanceResult(hit, hit, 0.0);
+            }
+        }
+    }
+
+    // Distances are kept squared until the end
+    TriangleDistanceResult best(a[0], b[0], std::numeric_limits<double>::infinity());
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        for(unsigned j = 0; j < 3; ++j)
+        {
+            Vec3 ca, cb;
+            ClosestPointsOnSegments(a[i], a[(i + 1)%3], b[j], b[(j + 1)%3], ca, cb);
+            Update(ca, cb, best);
+        }
+    }
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        if(!degenerateB)
+        {
+            Update(a[i], ClosestPointOnTriangle(a[i], b[0], b[1], b[2]), best);
+        }
+        if(!degenerateA)
+        {
+            Update(ClosestPointOnTriangle(b[i], a[0], a[1], a[2]), b[i], best);
+        }
+    }
+    best.Dist = std::sqrt(best.Dist);
+    return best;
+}
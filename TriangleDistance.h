@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Vec3.h"
+#include <limits>
+
+namespace rabbit
+{
+
+/**
+* @brief Result of a distance query between two triangles
+*/
+struct TriangleDistanceResult
+{
+    TriangleDistanceResult():Dist(0.0){}
+
+    TriangleDistanceResult(const Vec3& pointA, const Vec3& pointB, double dist):
+        PointA(pointA),PointB(pointB),Dist(dist){}
+
+    Vec3 PointA; ///< Point of the first triangle closest to the second one
+    Vec3 PointB; ///< Point of the second triangle closest to the first one
+    double Dist; ///< Distance between PointA and PointB, zero if the triangles intersect
+};
+
+/**
+* Calculates the least distance between two triangles. If they do not intersect, the closest
+* points lie on a pair of edges or are a vertex and its closest point on the other triangle,
+* so the kernel takes the smallest of the 9 edge to edge and 6 vertex to triangle distances.
+* Before that it checks whether an edge of either triangle pierces the other, which is only
+* possible if the vertices of each triangle are not all on the same side of the plane of the
+* other one. Degenerate triangles, whose vertices are collinear or coincide, are handled as
+* the segments between their vertices.
+*
+* Given maxDist, the projections of both triangles onto their normals and onto the line
+* between their centroids are compared first. Each gap between the projections bounds the
+* distance from below, so triangles whose projections are maxDist or more apart are
+* rejected straight away, returning that gap instead of the distance.
+* @param a Vertices of the first triangle
+* @param b Vertices of the second triangle
+* @param maxDist Pairs this far apart or further only have to be reported as such
+*/
+TriangleDistanceResult CalcTriangleDistance(const Vec3 a[3],
+                                            const Vec3 b[3],
+                                            double maxDist = std::numeric_limits<double>::max());
+
+}
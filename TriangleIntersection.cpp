@@ -0,0 +1,216 @@
+#include "TriangleIntersection.h"
+#include "TriangleDistance.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace rabbit;
+namespace
+{
+    // Plane distances below this fraction of |normal| times the extent of the vertices are
+    // rounding noise and taken to be zero, as are cross products of the normals below this
+    // fraction of the product of their lengths (Moller's USE_EPSILON_TEST)
+    const double COPLANARITY_EPSILON = 1e-12;
+
+    struct Point2
+    {
+        double U;
+        double V;
+    };
+
+    // Twice the signed area of the triangle pqr
+    double Orient(const Point2& p, const Point2& q, const Point2& r)
+    {
+        return (q.U - p.U)*(r.V - p.V) - (q.V - p.V)*(r.U - p.U);
+    }
+
+    // Whether r, known to be collinear with pq, lies within the bounding box of pq
+    bool OnSegment(const Point2& p, const Point2& q, const Point2& r)
+    {
+        return std::min(p.U, q.U) <= r.U && r.U <= std::max(p.U, q.U) &&
+               std::min(p.V, q.V) <= r.V && r.V <= std::max(p.V, q.V);
+    }
+
+    bool SegmentsIntersect(const Point2& p1, const Point2& q1, const Point2& p2, const Point2& q2)
+    {
+        const double o1 = Orient(p1, q1, p2);
+        const double o2 = Orient(p1, q1, q2);
+        const double o3 = Orient(p2, q2, p1);
+        const double o4 = Orient(p2, q2, q1);
+        if(((o1 > 0.0 && o2 < 0.0) || (o1 < 0.0 && o2 > 0.0)) &&
+           ((o3 > 0.0 && o4 < 0.0) || (o3 < 0.0 && o4 > 0.0)))
+        {
+            return true;
+        }
+        return (o1 == 0.0 && OnSegment(p1, q1, p2)) || (o2 == 0.0 && OnSegment(p1, q1, q2)) ||
+               (o3 == 0.0 && OnSegment(p2, q2, p1)) || (o4 == 0.0 && OnSegment(p2, q2, q1));
+    }
+
+    bool PointInTriangle(const Point2& p, const Point2 t[3])
+    {
+        const double o0 = Orient(t[0], t[1], p);
+        const double o1 = Orient(t[1], t[2], p);
+        const double o2 = Orient(t[2], t[0], p);
+        return (o0 >= 0.0 && o1 >= 0.0 && o2 >= 0.0) || (o0 <= 0.0 && o1 <= 0.0 && o2 <= 0.0);
+    }
+
+    // Largest absolute component of v
+    unsigned DominantAxis(const Vec3& v)
+    {
+        const double x = std::fabs(v.X());
+        const double y = std::fabs(v.Y());
+        const double z = std::fabs(v.Z());
+        return x >= y ? (x >= z ? 0 : 2) : (y >= z ? 1 : 2);
+    }
+
+    double Component(const Vec3& v, unsigned axis)
+    {
+        return axis == 0 ? v.X() : (axis == 1 ? v.Y() : v.Z());
+    }
+
+    bool CoplanarTrianglesIntersect(const Vec3& normal, const Vec3 a[3], const Vec3 b[3])
+    {
+        // Drop the axis the normal is closest to, which keeps the projection non degenerate
+        const unsigned dropped = DominantAxis(normal);
+        const unsigned u = dropped == 0 ? 1 : 0;
+        const unsigned v = dropped == 2 ? 1 : 2;
+        Point2 pa[3];
+        Point2 pb[3];
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            pa[i].U = Component(a[i], u);
+            pa[i].V = Component(a[i], v);
+            pb[i].U = Component(b[i], u);
+            pb[i].V = Component(b[i], v);
+        }
+
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            for(unsigned j = 0; j < 3; ++j)
+            {
+                if(SegmentsIntersect(pa[i], pa[(i + 1)%3], pb[j], pb[(j + 1)%3]))
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Without crossing edges, one triangle can only intersect the other by lying inside it
+        return PointInTriangle(pa[0], pb) || PointInTriangle(pb[0], pa);
+    }
+
+    /**
+    * Interval covered by a triangle along the line where the planes meet, given the
+    * projections p of its vertices onto the line and their signed distances d to the
+    * plane of the other triangle. Returns false if all the distances are zero.
+    */
+    bool ComputeInterval(const double p[3], const double d[3], double& lo, double& hi)
+    {
+        // Find the vertex which is alone on its side of the plane
+        unsigned k;
+        if(d[0]*d[1] > 0.0)
+        {
+            k = 2;
+        }
+        else if(d[0]*d[2] > 0.0)
+        {
+            k = 1;
+        }
+        else if(d[1]*d[2] > 0.0 || d[0] != 0.0)
+        {
+            k = 0;
+        }
+        else if(d[1] != 0.0)
+        {
+            k = 1;
+        }
+        else if(d[2] != 0.0)
+        {
+            k = 2;
+        }
+        else
+        {
+            return false;
+        }
+
+        const unsigned i = (k + 1)%3;
+        const unsigned j = (k + 2)%3;
+        const double t0 = p[i] + (p[k] - p[i])*(d[i]/(d[i] - d[k]));
+        const double t1 = p[j] + (p[k] - p[j])*(d[j]/(d[j] - d[k]));
+        lo = std::min(t0, t1);
+        hi = std::max(t0, t1);
+        return true;
+    }
+
+    /**
+    * Signed distances, scaled by the length of normal, of the vertices p to the plane
+    * through origin. Distances within rounding error of zero are snapped to zero, so that
+    * the outcome does not depend on how the dot products were evaluated, e.g. with FMA.
+    */
+    void CalcPlaneDistances(const Vec3& normal, const Vec3& origin, const Vec3 p[3], double d[3])
+    {
+        double maxExtentSq = 0.0;
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            const Vec3 offset = p[i] - origin;
+            d[i] = Vec3::dotProduct(normal, offset);
+            maxExtentSq = std::max(maxExtentSq, Vec3::dotProduct(offset, offset));
+        }
+
+        const double tolerance = COPLANARITY_EPSILON*std::sqrt(Vec3::dotProduct(normal, normal)*maxExtentSq);
+        for(unsigned i = 0; i < 3; ++i)
+        {
+            if(std::fabs(d[i]) <= tolerance)
+            {
+                d[i] = 0.0;
+            }
+        }
+    }
+
+    // Whether the vertices all lie strictly on the same side of the plane
+    bool OnOneSide(const double d[3])
+    {
+        return (d[0] > 0.0 && d[1] > 0.0 && d[2] > 0.0) || (d[0] < 0.0 && d[1] < 0.0 && d[2] < 0.0);
+    }
+}
+
+bool rabbit::TrianglesIntersect(const Vec3 a[3], const Vec3 b[3])
+{
+    const Vec3 normalA = Vec3::crossProduct(a[1] - a[0], a[2] - a[0]);
+    const Vec3 normalB = Vec3::crossProduct(b[1] - b[0], b[2] - b[0]);
+    if(Vec3::dotProduct(normalA, normalA) == 0.0 || Vec3::dotProduct(normalB, normalB) == 0.0)
+    {
+        return CalcTriangleDistance(a, b).Dist == 0.0;
+    }
+
+    double distsToB[3];
+    CalcPlaneDistances(normalB, b[0], a, distsToB);
+    if(OnOneSide(distsToB))
+    {
+        return false;
+    }
+
+    double distsToA[3];
+    CalcPlaneDistances(normalA, a[0], b, distsToA);
+    if(OnOneSide(distsToA))
+    {
+        return false;
+    }
+
+    // Projecting onto the coordinate axis closest to the line keeps the intervals in order.
+    // Nearly parallel planes meet along a line which rounding may point anywhere, so such
+    // triangles are taken to be coplanar.
+    const Vec3 direction = Vec3::crossProduct(normalA, normalB);
+    const double parallelTolerance = COPLANARITY_EPSILON*COPLANARITY_EPSILON*
+        Vec3::dotProduct(normalA, normalA)*Vec3::dotProduct(normalB, normalB);
+    const unsigned axis = DominantAxis(direction);
+    const double projA[3] = {Component(a[0], axis), Component(a[1], axis), Component(a[2], axis)};
+    const double projB[3] = {Component(b[0], axis), Component(b[1], axis), Component(b[2], axis)};
+    double loA, hiA, loB, hiB;
+    if(Vec3::dotProduct(direction, direction) <= parallelTolerance ||
+       !ComputeInterval(projA, distsToB, loA, hiA) ||
+       !ComputeInterval(projB, distsToA, loB, hiB))
+    {
+        return CoplanarTrianglesIntersect(normalA, a, b);
+    }
+    return loA <= hiB && loB <= hiA;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Vec3.h"
+
+namespace rabbit
+{
+
+/**
+* Checks whether two triangles intersect, following Moller, "A Fast Triangle-Triangle
+* Intersection Test". If the vertices of either triangle all lie strictly on one side of
+* the plane of the other, they are apart. Otherwise both triangles cross the line where
+* their planes meet, and they intersect iff the intervals they cover along it overlap.
+* Coplanar triangles are checked in the coordinate plane their normal is closest to, by
+* crossing edges or a vertex of one inside the other. Vertices within rounding error of a
+* plane count as lying on it, and triangles whose normals are within rounding error of
+* parallel as coplanar, so that e.g. a triangle always intersects itself. Triangles are closed, so touching
+* along an edge or at a vertex counts as intersecting. Degenerate triangles, whose vertices
+* are collinear or coincide, are resolved by CalcTriangleDistance.
+* @param a Vertices of the first triangle
+* @param b Vertices of the second triangle
+*/
+bool TrianglesIntersect(const Vec3 a[3], const Vec3 b[3]);
+
+}
@@ -0,0 +1,123 @@
+#include "TrianglePseudonormals.h"
+#include "IndexedTriangleMesh.h"
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace rabbit;
+namespace
+{
+    /**
+    * Closest points this close to an edge or vertex, in barycentric coordinates, are
+    * assigned to it. The closest point calculations have rounding errors of about this
+    * size, and near an edge the pseudonormal of the edge gives the right sign whichever
+    * of its faces the point is closest to.
+    */
+    const double FEATURE_TOLERANCE = 1e-6;
+
+    // Edges are keyed by their vertex indices, the lower one first
+    uint64_t EdgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+    }
+
+    // Angle between the vectors a and b, robust for angles close to 0 and pi
+    double Angle(const Vec3& a, const Vec3& b)
+    {
+        return std::atan2(Vec3::crossProduct(a, b).magnitude(), Vec3::dotProduct(a, b));
+    }
+
+    Vec3 NormaliseOrZero(const Vec3& v)
+    {
+        const double mag = v.magnitude();
+        return mag > 0.0 ? v/mag : v;
+    }
+}
+
+void TrianglePseudonormals::Build(const IndexedTriangleMesh& mesh)
+{
+    // Number the edges once, so that Update gets by without hashing
+    const std::size_t numTriangles = mesh.GetNumTriangles();
+    std::unordered_map<uint64_t, uint32_t> edges(3*numTriangles/2);
+    m_edgeIndices.resize(3*numTriangles);
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        for(unsigned k = 0; k < 3; ++k)
+        {
+            const uint64_t key = EdgeKey(mesh.GetVertexIndex(i, static_cast<ids>(k)),
+                                         mesh.GetVertexIndex(i, static_cast<ids>((k + 1)%3)));
+            m_edgeIndices[3*i + k] = edges.emplace(key, static_cast<uint32_t>(edges.size())).first->second;
+        }
+    }
+    m_numEdges = edges.size();
+    Update(mesh);
+}
+
+void TrianglePseudonormals::Update(const IndexedTriangleMesh& mesh)
+{
+    const std::size_t numTriangles = mesh.GetNumTriangles();
+    if(3*numTriangles != m_edgeIndices.size())
+    {
+        throw std::runtime_error("Mesh does not have the topology the pseudonormals were built for");
+    }
+    std::vector<Vec3> faceNormals(numTriangles);
+    std::vector<Vec3> vertexNormals(mesh.GetNumVertices(), Vec3(0.0, 0.0, 0.0));
+    std::vector<Vec3> edgeNormals(m_numEdges, Vec3(0.0, 0.0, 0.0));
+
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        const uint32_t v[3] = {mesh.GetVertexIndex(i, zero), mesh.GetVertexIndex(i, one), mesh.GetVertexIndex(i, two)};
+        const Vec3 p[3] = {mesh.GetVertex(v[0]), mesh.GetVertex(v[1]), mesh.GetVertex(v[2])};
+
+        // Degenerate triangles have no normal and contribute nothing
+        const Vec3 n = NormaliseOrZero(Vec3::crossProduct(p[1] - p[0], p[2] - p[0]));
+        faceNormals[i] = n;
+        for(unsigned k = 0; k < 3; ++k)
+        {
+            const unsigned next = (k + 1)%3;
+            const unsigned prev = (k + 2)%3;
+            vertexNormals[v[k]] = vertexNormals[v[k]] + n*Angle(p[next] - p[k], p[prev] - p[k]);
+            edgeNormals[m_edgeIndices[3*i + k]] = edgeNormals[m_edgeIndices[3*i + k]] + n;
+        }
+    }
+
+    m_normals.resize(FLOATS_PER_TRIANGLE*numTriangles);
+    for(std::size_t i = 0; i < numTriangles; ++i)
+    {
+        const uint32_t v[3] = {mesh.GetVertexIndex(i, zero), mesh.GetVertexIndex(i, one), mesh.GetVertexIndex(i, two)};
+        Vec3 features[NumFeatures];
+        features[Face] = faceNormals[i];
+        for(unsigned k = 0; k < 3; ++k)
+        {
+            features[EdgeP0P1 + k] = edgeNormals[m_edgeIndices[3*i + k]];
+            features[VertexP0 + k] = vertexNormals[v[k]];
+        }
+
+        float* normals = &m_normals[FLOATS_PER_TRIANGLE*i];
+        for(unsigned f = 0; f < NumFeatures; ++f)
+        {
+            const Vec3 n = NormaliseOrZero(features[f]);
+            normals[3*f] = static_cast<float>(n.X());
+            normals[3*f + 1] = static_cast<float>(n.Y());
+            normals[3*f + 2] = static_cast<float>(n.Z());
+        }
+    }
+}
+
+Vec3 TrianglePseudonormals::GetPseudonormal(std::size_t i, double s, double t)const
+{
+    const bool onP0P1 = t <= FEATURE_TOLERANCE;
+    const bool onP2P0 = s <= FEATURE_TOLERANCE;
+    const bool onP1P2 = s + t >= 1.0 - FEATURE_TOLERANCE;
+
+    unsigned feature = Face;
+    if(onP0P1 && onP2P0) feature = VertexP0;
+    else if(onP0P1 && onP1P2) feature = VertexP1;
+    else if(onP1P2 && onP2P0) feature = VertexP2;
+    else if(onP0P1) feature = EdgeP0P1;
+    else if(onP1P2) feature = EdgeP1P2;
+    else if(onP2P0) feature = EdgeP2P0;
+
+    const float* n = &m_normals[FLOATS_PER_TRIANGLE*i + 3*feature];
+    return Vec3(n[0], n[1], n[2]);
+}
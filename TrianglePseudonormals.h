@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Vec3.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rabbit
+{
+
+class IndexedTriangleMesh;
+
+/**
+* @brief Angle weighted pseudonormals of the faces, edges and vertices of each triangle of
+* a mesh, for telling whether a point is inside or outside of it (Baerentzen and Aanaes,
+* "Signed distance computation using the angle weighted pseudonormal"). The pseudonormal
+* of a face is its normal, that of an edge the sum of the normals of the two faces sharing
+* it, and that of a vertex the sum of the normals of the faces around it, each weighted by
+* the angle of the face at the vertex. A point p is inside the mesh if p - c points against
+* the pseudonormal of the face, edge or vertex holding c, the point of the mesh closest to p.
+*
+* The sign is only meaningful for closed meshes whose triangles are all wound the same way,
+* counter clockwise seen from outside. The topology is taken from the vertex indices of an
+* IndexedTriangleMesh. Pseudonormals are kept in float, 84 bytes per triangle, plus 12 bytes
+* for the edges of the triangle.
+*/
+class TrianglePseudonormals
+{
+public:
+
+    /**
+    * Creates an empty table, to be filled with Build
+    */
+    TrianglePseudonormals():m_numEdges(0){}
+
+    explicit TrianglePseudonormals(const IndexedTriangleMesh& mesh):m_numEdges(0){Build(mesh);}
+
+    /**
+    * Calculates the pseudonormals of all the triangles of mesh, replacing any calculated before
+    */
+    void Build(const IndexedTriangleMesh& mesh);
+
+    /**
+    * Recalculates the pseudonormals after the vertices of the mesh have moved. Faster than
+    * Build, as the edges shared by the triangles are known already. Throws if mesh has a
+    * different number of triangles, its indices must be those Build was called with.
+    */
+    void Update(const IndexedTriangleMesh& mesh);
+
+    std::size_t Size()const{return m_normals.size()/FLOATS_PER_TRIANGLE;}
+
+    /**
+    * @param i Index of the triangle holding the closest point
+    * @param s Barycentric coordinate of the closest point along edge P0P1 of the triangle
+    * @param t Barycentric coordinate of the closest point along edge P0P2 of the triangle
+    * @return Pseudonormal of the face, edge or vertex of triangle i the closest point lies on.
+    * Points within a small tolerance of an edge or vertex count as lying on it.
+    */
+    Vec3 GetPseudonormal(std::size_t i, double s, double t)const;
+
+    /**
+    * @return Number of bytes used by the pseudonormals and the edges
+    */
+    std::size_t GetMemoryUsage()const{return m_normals.size()*sizeof(float) + m_edgeIndices.size()*sizeof(uint32_t);}
+
+private:
+
+    // Order of the pseudonormals of a triangle
+    enum Feature : unsigned
+    {
+        Face,
+        EdgeP0P1,
+        EdgeP1P2,
+        EdgeP2P0,
+        VertexP0,
+        VertexP1,
+        VertexP2,
+        NumFeatures
+    };
+
+    static const std::size_t FLOATS_PER_TRIANGLE = 3*NumFeatures;
+
+    std::vector<float> m_normals;        ///< x, y and z of each Feature of each triangle
+    std::vector<uint32_t> m_edgeIndices; ///< Index of each edge of each triangle, in the order of the edge features
+    std::size_t m_numEdges;              ///< Number of distinct edges
+};
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "Triangle.h"
+#include "IntersectionResult.h"
+#include "QueryStats.h"
+#include <limits>
+#include <math.h>
+
+namespace rabbit
+{
+
+/**
+* @brief Whether a proximity query precomputes a TriangleQueryRecord for every
+* triangle of the mesh. Records cost 144 bytes per triangle, on top of the
+* triangles themselves, and spare each distance calculation a good deal of
+* arithmetic that only depends on the triangle.
+*/
+enum class TrianglePrecomputation
+{
+    None,        ///< Everything is calculated from the triangle on each query
+    QueryRecords ///< A TriangleQueryRecord is built for every triangle up front
+};
+
+/**
+* @brief The parts of Triangle<T>::CalcShortestDistanceFrom that do not depend on
+* the query point: the dot products and inverse determinant used for the barycentric
+* coordinates, the normalised edges with their lengths, and the offset of the plane
+* of the triangle from the origin. A record only makes sense alongside the triangle
+* it was built from.
+*/
+template<typename T>
+struct TriangleQueryRecord
+{
+    explicit TriangleQueryRecord(const Triangle<T>& t);
+
+    /**
+    * Same as Triangle<T>::CalcShortestDistanceFrom, apart from rounding.
+    * @param t The triangle this record was built from
+    */
+    IntersectionResult<T> CalcShortestDistanceFrom(const Triangle<T>& t,
+                                                   const T& point,
+                                                   double maxDist)const;
+
+    /**
+    * Same as Triangle<T>::CalcBarycentricCoords
+    */
+    BarycentricCoords CalcBarycentricCoords(const Triangle<T>& t, const T& point)const;
+
+    /**
+    * Same as Triangle<T>::CheckPointSegDist for the edge seg, whose id is edge
+    */
+    PointSegIntersection<T> CheckPointSegDist(const T& origin, const T& seg, ids edge, const T& point)const;
+
+    T UnitEdges[3];        ///< P0P1, P0P2 and P1P2 normalised
+    double EdgeLengths[3]; ///< Lengths of P0P1, P0P2 and P1P2
+    double EdgeLengthsSq[3]; ///< Squared lengths of P0P1, P0P2 and P1P2
+    double EdgeDot;        ///< Dot product of P0P1 and P0P2
+    double InverseDet;     ///< Inverse of the determinant solved for the barycentric coordinates
+    double PlaneOffset;    ///< Dot product of the normal and P0
+};
+
+template<typename T>
+TriangleQueryRecord<T>::TriangleQueryRecord(const Triangle<T>& t):
+    UnitEdges{t.P0P1().normalise(), t.P0P2().normalise(), t.P1P2().normalise()},
+    EdgeLengths{t.P0P1().magnitude(), t.P0P2().magnitude(), t.P1P2().magnitude()},
+    EdgeLengthsSq{T::dotProduct(t.P0P1(), t.P0P1()),
+                  T::dotProduct(t.P0P2(), t.P0P2()),
+                  T::dotProduct(t.P1P2(), t.P1P2())},
+    EdgeDot(T::dotProduct(t.P0P1(), t.P0P2())),
+    InverseDet(1.0/(EdgeLengthsSq[0]*EdgeLengthsSq[1] - EdgeDot*EdgeDot)),
+    PlaneOffset(T::dotProduct(t.P0(), t.Normal())){}
+
+template<typename T>
+IntersectionResult<T> TriangleQueryRecord<T>::CalcShortestDistanceFrom(const Triangle<T>& t,
+                                                                       const T& p,
+                                                                       double maxDist)const
+{
+    QueryStats::CountTrianglesTested(1);
+
+    // Project the point onto the plane of the triangle
+    const double signedDist = PlaneOffset - T::dotProduct(p, t.Normal());
+    const double pDist = std::abs(signedDist);
+    if(pDist > maxDist)
+    {
+        return IntersectionResult<T>(p, std::numeric_limits<double>::max());
+    }
+
+    const T projectedPoint = p + t.Normal()*signedDist;
+    const BarycentricCoords coords = CalcBarycentricCoords(t, projectedPoint);
+    const double tol = 0.000001;
+    if(coords.u >= -tol && coords.v >= -tol && coords.u+coords.v <= 1.0f + tol)
+    {
+        return IntersectionResult<T>(projectedPoint, pDist);
+    }
+
+    const auto P0_P1_Data = CheckPointSegDist(t.P0(), t.P0P1(), zero, projectedPoint);
+    const auto P0_P2_Data = CheckPointSegDist(t.P0(), t.P0P2(), one, projectedPoint);
+    const auto P1_P2_Data = CheckPointSegDist(t.P1(), t.P1P2(), two, projectedPoint);
+
+    // Ties are broken the same way as in Triangle<T>::CalcShortestDistanceFrom
+    const auto d0 = P0_P1_Data.IRes.Dist;
+    const auto d1 = P0_P2_Data.IRes.Dist;
+    const auto d2 = P1_P2_Data.IRes.Dist;
+    const IntersectionResult<T>& closest = d0 < d1 ? (d0 < d2 ? P0_P1_Data.IRes : P1_P2_Data.IRes)
+                                                   : (d1 < d2 ? P0_P2_Data.IRes : P1_P2_Data.IRes);
+    return IntersectionResult<T>(closest.Point, sqrt(closest.Dist*closest.Dist + pDist*pDist));
+}
+
+template<typename T>
+BarycentricCoords TriangleQueryRecord<T>::CalcBarycentricCoords(const Triangle<T>& t, const T& P)const
+{
+    // See Triangle<T>::CalcBarycentricCoords, only x and y depend on P
+    const auto P0_P = P - t.P0();
+    const auto x = T::dotProduct(t.P0P1(), P0_P);
+    const auto y = T::dotProduct(t.P0P2(), P0_P);
+
+    const auto u = InverseDet * (EdgeLengthsSq[1]*x - EdgeDot*y);
+    const auto v = InverseDet * (-EdgeDot*x + EdgeLengthsSq[0]*y);
+    return BarycentricCoords(u,v);
+}
+
+template<typename T>
+PointSegIntersection<T> TriangleQueryRecord<T>::CheckPointSegDist(const T& origin,
+                                                                  const T& seg,
+                                                                  ids edge,
+                                                                  const T& P)const
+{
+    const T& unitVecAlongSeg = UnitEdges[edge];
+    const auto origin_P = P - origin;
+    const auto alongSeg = T::dotProduct(unitVecAlongSeg, origin_P);
+
+    // Projection of P onto the seg
+    const auto Px = origin + unitVecAlongSeg*alongSeg;
+    static const double EPSILON= 1.0e-12;
+    if(alongSeg >= -EPSILON && alongSeg <= EdgeLengths[edge] + EPSILON)
+    {
+        return PointSegIntersection<T>(Px, (P-Px).magnitude(), true);
+    }
+    else if(alongSeg < 0.0)
+    {
+        return PointSegIntersection<T>(origin,origin_P.magnitude(),false);
+    }
+    else
+    {
+        const auto otherEnd = origin + seg;
+        return PointSegIntersection<T>(otherEnd, (otherEnd - P).magnitude(),false);
+    }
+}
+
+}
@@ -0,0 +1,431 @@
+#include "TriangleSoA.h"
+#include "QueryStats.h"
+#include <algorithm>
+#include <limits>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+using namespace rabbit;
+namespace
+{
+    // Minimal arithmetic on a packet of doubles. The kernel below is written once
+    // against these operations and instantiated for plain doubles and SIMD registers.
+    inline bool LessEq(double a, double b){return a <= b;}
+    inline bool GreaterEq(double a, double b){return a >= b;}
+    inline bool LessThan(double a, double b){return a < b;}
+    inline bool And(bool a, bool b){return a && b;}
+    inline double Select(bool mask, double a, double b){return mask ? a : b;}
+
+    // Number of lanes set in laneMask
+    inline unsigned CountSetBits(unsigned mask)
+    {
+        unsigned count = 0;
+        for(; mask != 0; mask &= mask - 1)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+#if defined(__AVX512F__)
+    struct Packet
+    {
+        Packet(){}
+        Packet(__m512d value):v(value){}
+        explicit Packet(double value):v(_mm512_set1_pd(value)){}
+        static Packet Load(const double* p){return Packet(_mm512_loadu_pd(p));}
+        __m512d v;
+    };
+    typedef __mmask8 PacketMask;
+
+    inline Packet operator+(const Packet& a, const Packet& b){return _mm512_add_pd(a.v, b.v);}
+    inline Packet operator-(const Packet& a, const Packet& b){return _mm512_sub_pd(a.v, b.v);}
+    inline Packet operator*(const Packet& a, const Packet& b){return _mm512_mul_pd(a.v, b.v);}
+    inline Packet operator/(const Packet& a, const Packet& b){return _mm512_div_pd(a.v, b.v);}
+    inline PacketMask LessEq(const Packet& a, const Packet& b){return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ);}
+    inline PacketMask GreaterEq(const Packet& a, const Packet& b){return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ);}
+    inline PacketMask LessThan(const Packet& a, const Packet& b){return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ);}
+    inline PacketMask And(PacketMask a, PacketMask b){return a & b;}
+    inline Packet Select(PacketMask mask, const Packet& a, const Packet& b){return _mm512_mask_blend_pd(mask, b.v, a.v);}
+    inline unsigned ToBits(PacketMask mask){return mask;}
+    inline void Store(double* p, const Packet& a){_mm512_storeu_pd(p, a.v);}
+#elif defined(__AVX2__)
+    struct Packet
+    {
+        Packet(){}
+        Packet(__m256d value):v(value){}
+        explicit Packet(double value):v(_mm256_set1_pd(value)){}
+        static Packet Load(const double* p){return Packet(_mm256_loadu_pd(p));}
+        __m256d v;
+    };
+    typedef __m256d PacketMask;
+
+    inline Packet operator+(const Packet& a, const Packet& b){return _mm256_add_pd(a.v, b.v);}
+    inline Packet operator-(const Packet& a, const Packet& b){return _mm256_sub_pd(a.v, b.v);}
+    inline Packet operator*(const Packet& a, const Packet& b){return _mm256_mul_pd(a.v, b.v);}
+    inline Packet operator/(const Packet& a, const Packet& b){return _mm256_div_pd(a.v, b.v);}
+    inline PacketMask LessEq(const Packet& a, const Packet& b){return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ);}
+    inline PacketMask GreaterEq(const Packet& a, const Packet& b){return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ);}
+    inline PacketMask LessThan(const Packet& a, const Packet& b){return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ);}
+    inline PacketMask And(PacketMask a, PacketMask b){return _mm256_and_pd(a, b);}
+    inline Packet Select(PacketMask mask, const Packet& a, const Packet& b){return _mm256_blendv_pd(b.v, a.v, mask);}
+    inline unsigned ToBits(PacketMask mask){return static_cast<unsigned>(_mm256_movemask_pd(mask));}
+    inline void Store(double* p, const Packet& a){_mm256_storeu_pd(p, a.v);}
+#endif
+
+    /**
+    * Closest point c on the triangle (a, a + ab, a + ac) to the point p and the squared
+    * distance between them. Follows the Voronoi region classification of Ericson,
+    * Real-Time Collision Detection, 5.1.5, with every region evaluated and the
+    * result picked by masks instead of branches. Regions are applied from the
+    * lowest to the highest priority, so the first matching region of the branched
+    * version wins. Lanes of regions which do not apply may divide by zero, their
+    * results are always discarded.
+    */
+    template<typename Real>
+    void ClosestPointOnTriangle(const Real p[3], const Real a[3], const Real ab[3], const Real ac[3],
+                                Real c[3], Real& distSq)
+    {
+        const Real zero(0.0);
+        const Real one(1.0);
+
+        const Real ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+        const Real d1 = ab[0]*ap[0] + ab[1]*ap[1] + ab[2]*ap[2];
+        const Real d2 = ac[0]*ap[0] + ac[1]*ap[1] + ac[2]*ap[2];
+
+        const Real bp[3] = {ap[0] - ab[0], ap[1] - ab[1], ap[2] - ab[2]};
+        const Real d3 = ab[0]*bp[0] + ab[1]*bp[1] + ab[2]*bp[2];
+        const Real d4 = ac[0]*bp[0] + ac[1]*bp[1] + ac[2]*bp[2];
+
+        const Real cp[3] = {ap[0] - ac[0], ap[1] - ac[1], ap[2] - ac[2]};
+        const Real d5 = ab[0]*cp[0] + ab[1]*cp[1] + ab[2]*cp[2];
+        const Real d6 = ac[0]*cp[0] + ac[1]*cp[1] + ac[2]*cp[2];
+
+        const Real va = d3*d6 - d5*d4;
+        const Real vb = d5*d2 - d1*d6;
+        const Real vc = d1*d4 - d3*d2;
+
+        // c = a + ab*v + ac*w. Face region first.
+        const Real denom = one/(va + vb + vc);
+        Real v = vb*denom;
+        Real w = vc*denom;
+
+        // Edge region BC
+        const Real d43 = d4 - d3;
+        const Real d56 = d5 - d6;
+        const auto inBC = And(And(LessEq(va, zero), GreaterEq(d43, zero)), GreaterEq(d56, zero));
+        const Real wBC = d43/(d43 + d56);
+        v = Select(inBC, one - wBC, v);
+        w = Select(inBC, wBC, w);
+
+        // Edge region AC
+        const auto inAC = And(And(LessEq(vb, zero), GreaterEq(d2, zero)), LessEq(d6, zero));
+        v = Select(inAC, zero, v);
+        w = Select(inAC, d2/(d2 - d6), w);
+
+        // Vertex region C
+        const auto inC = And(GreaterEq(d6, zero), LessEq(d5, d6));
+        v = Select(inC, zero, v);
+        w = Select(inC, one, w);
+
+        // Edge region AB
+        const auto inAB = And(And(LessEq(vc, zero), GreaterEq(d1, zero)), LessEq(d3, zero));
+        v = Select(inAB, d1/(d1 - d3), v);
+        w = Select(inAB, zero, w);
+
+        // Vertex region B
+        const auto inB = And(GreaterEq(d3, zero), LessEq(d4, d3));
+        v = Select(inB, one, v);
+        w = Select(inB, zero, w);
+
+        // Vertex region A
+        const auto inA = And(LessEq(d1, zero), LessEq(d2, zero));
+        v = Select(inA, zero, v);
+        w = Select(inA, zero, w);
+
+        c[0] = a[0] + ab[0]*v + ac[0]*w;
+        c[1] = a[1] + ab[1]*v + ac[1]*w;
+        c[2] = a[2] + ab[2]*v + ac[2]*w;
+
+        const Real diff[3] = {p[0] - c[0], p[1] - c[1], p[2] - c[2]};
+        distSq = diff[0]*diff[0] + diff[1]*diff[1] + diff[2]*diff[2];
+    }
+    /**
+    * Intersects the ray o + d*t, t > 0, with the triangle (a, a + ab, a + ac) using the
+    * Moller-Trumbore algorithm, the same way as Triangle::IntersectRay. Lanes of rays
+    * parallel to their triangle divide by zero, which fails the tests on u and v.
+    * @return Mask of the lanes where the ray hits the triangle before maxDist, at t
+    */
+    template<typename Real>
+    auto IntersectRayWithTriangle(const Real o[3], const Real d[3], const Real a[3], const Real ab[3], const Real ac[3],
+                                  const Real& maxDist, Real& t) -> decltype(LessThan(t, t))
+    {
+        const Real zero(0.0);
+        const Real one(1.0);
+
+        const Real pvec[3] = {d[1]*ac[2] - d[2]*ac[1], d[2]*ac[0] - d[0]*ac[2], d[0]*ac[1] - d[1]*ac[0]};
+        const Real inverseDet = one/(ab[0]*pvec[0] + ab[1]*pvec[1] + ab[2]*pvec[2]);
+
+        const Real tvec[3] = {o[0] - a[0], o[1] - a[1], o[2] - a[2]};
+        const Real u = (tvec[0]*pvec[0] + tvec[1]*pvec[1] + tvec[2]*pvec[2])*inverseDet;
+
+        const Real qvec[3] = {tvec[1]*ab[2] - tvec[2]*ab[1], tvec[2]*ab[0] - tvec[0]*ab[2], tvec[0]*ab[1] - tvec[1]*ab[0]};
+        const Real v = (d[0]*qvec[0] + d[1]*qvec[1] + d[2]*qvec[2])*inverseDet;
+        t = (ac[0]*qvec[0] + ac[1]*qvec[1] + ac[2]*qvec[2])*inverseDet;
+
+        return And(And(And(GreaterEq(u, zero), GreaterEq(v, zero)), LessEq(u + v, one)),
+                   And(LessThan(zero, t), LessThan(t, maxDist)));
+    }
+}
+
+const std::size_t TriangleSoA::PACKET_SIZE;
+
+TriangleSoA::TriangleSoA():
+    m_size(0)
+{
+    // Dummy triangles used as padding. They are well formed so the masked
+    // out lanes do not produce more NaNs than necessary.
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        m_p0[axis].assign(PACKET_SIZE, 0.0);
+        m_p0p1[axis].assign(PACKET_SIZE, axis == 0 ? 1.0 : 0.0);
+        m_p0p2[axis].assign(PACKET_SIZE, axis == 1 ? 1.0 : 0.0);
+    }
+}
+
+void TriangleSoA::Reserve(std::size_t n)
+{
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        m_p0[axis].reserve(n + PACKET_SIZE);
+        m_p0p1[axis].reserve(n + PACKET_SIZE);
+        m_p0p2[axis].reserve(n + PACKET_SIZE);
+    }
+}
+
+void TriangleSoA::PushBack(const Triangle<Vec3>& t)
+{
+    // Overwrite the first padding triangle and add a new one at the end
+    const Vec3& p0 = t.P0();
+    const Vec3& p0p1 = t.P0P1();
+    const Vec3& p0p2 = t.P0P2();
+    const double values[3][3] = {{p0.X(), p0.Y(), p0.Z()},
+                                 {p0p1.X(), p0p1.Y(), p0p1.Z()},
+                                 {p0p2.X(), p0p2.Y(), p0p2.Z()}};
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        m_p0[axis][m_size] = values[0][axis];
+        m_p0p1[axis][m_size] = values[1][axis];
+        m_p0p2[axis][m_size] = values[2][axis];
+        m_p0[axis].push_back(0.0);
+        m_p0p1[axis].push_back(axis == 0 ? 1.0 : 0.0);
+        m_p0p2[axis].push_back(axis == 1 ? 1.0 : 0.0);
+    }
+    ++m_size;
+}
+
+void TriangleSoA::Append(std::size_t n, const double* const p0[3], const double* const p0p1[3], const double* const p0p2[3])
+{
+    // Insert in front of the padding, which stays at the end
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        m_p0[axis].insert(m_p0[axis].begin() + m_size, p0[axis], p0[axis] + n);
+        m_p0p1[axis].insert(m_p0p1[axis].begin() + m_size, p0p1[axis], p0p1[axis] + n);
+        m_p0p2[axis].insert(m_p0p2[axis].begin() + m_size, p0p2[axis], p0p2[axis] + n);
+    }
+    m_size += n;
+}
+
+void TriangleSoA::Set(std::size_t i, const Vec3& p0, const Vec3& p1, const Vec3& p2)
+{
+    const Vec3 p0p1 = p1 - p0;
+    const Vec3 p0p2 = p2 - p0;
+    const double values[3][3] = {{p0.X(), p0.Y(), p0.Z()},
+                                 {p0p1.X(), p0p1.Y(), p0p1.Z()},
+                                 {p0p2.X(), p0p2.Y(), p0p2.Z()}};
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        m_p0[axis][i] = values[0][axis];
+        m_p0p1[axis][i] = values[1][axis];
+        m_p0p2[axis][i] = values[2][axis];
+    }
+}
+
+Triangle<Vec3> TriangleSoA::GetTriangle(std::size_t i)const
+{
+    const Vec3 p0(m_p0[0][i], m_p0[1][i], m_p0[2][i]);
+    const Vec3 p0p1(m_p0p1[0][i], m_p0p1[1][i], m_p0p1[2][i]);
+    const Vec3 p0p2(m_p0p2[0][i], m_p0p2[1][i], m_p0p2[2][i]);
+    const Vec3 normal = Vec3::crossProduct(p0p1, p0p2);
+    const double mag = normal.magnitude();
+    return Triangle<Vec3>(p0, p0 + p0p1, p0 + p0p2, p0p1, p0p2, p0p2 - p0p1, mag > 0.0 ? normal/mag : normal);
+}
+
+void TriangleSoA::CalcBounds(std::size_t first, std::size_t count, double boundsMin[3], double boundsMax[3])const
+{
+    for(unsigned axis = 0; axis < 3; ++axis)
+    {
+        double lo = std::numeric_limits<double>::max();
+        double hi = -std::numeric_limits<double>::max();
+        for(std::size_t i = first; i < first + count; ++i)
+        {
+            // The vertices as the queries see them, P0 plus the edges
+            const double p0 = m_p0[axis][i];
+            const double p1 = p0 + m_p0p1[axis][i];
+            const double p2 = p0 + m_p0p2[axis][i];
+            lo = std::min(lo, std::min(p0, std::min(p1, p2)));
+            hi = std::max(hi, std::max(p0, std::max(p1, p2)));
+        }
+        boundsMin[axis] = lo;
+        boundsMax[axis] = hi;
+    }
+}
+
+unsigned TriangleSoA::CalcClosestPoints(const Vec3& point,
+                                        std::size_t first,
+                                        unsigned laneMask,
+                                        double maxDistSq,
+                                        double distSq[PACKET_SIZE],
+                                        double closestPoints[3][PACKET_SIZE])const
+{
+#if defined(RABBIT_QUERY_STATS)
+    QueryStats::CountTrianglesTested(CountSetBits(laneMask));
+#endif
+    unsigned closer = 0;
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+    const Packet p[3] = {Packet(point.X()), Packet(point.Y()), Packet(point.Z())};
+    const Packet a[3] = {Packet::Load(&m_p0[0][first]), Packet::Load(&m_p0[1][first]), Packet::Load(&m_p0[2][first])};
+    const Packet ab[3] = {Packet::Load(&m_p0p1[0][first]), Packet::Load(&m_p0p1[1][first]), Packet::Load(&m_p0p1[2][first])};
+    const Packet ac[3] = {Packet::Load(&m_p0p2[0][first]), Packet::Load(&m_p0p2[1][first]), Packet::Load(&m_p0p2[2][first])};
+    Packet c[3];
+    Packet packetDistSq;
+    ClosestPointOnTriangle(p, a, ab, ac, c, packetDistSq);
+
+    closer = ToBits(LessThan(packetDistSq, Packet(maxDistSq))) & laneMask;
+    if(closer == 0)
+    {
+        return 0;
+    }
+    Store(distSq, packetDistSq);
+    Store(closestPoints[0], c[0]);
+    Store(closestPoints[1], c[1]);
+    Store(closestPoints[2], c[2]);
+#else
+    const double p[3] = {point.X(), point.Y(), point.Z()};
+    for(std::size_t lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+        if(((laneMask >> lane) & 1) == 0)
+        {
+            continue;
+        }
+        const std::size_t i = first + lane;
+        const double a[3] = {m_p0[0][i], m_p0[1][i], m_p0[2][i]};
+        const double ab[3] = {m_p0p1[0][i], m_p0p1[1][i], m_p0p1[2][i]};
+        const double ac[3] = {m_p0p2[0][i], m_p0p2[1][i], m_p0p2[2][i]};
+        double c[3];
+        ClosestPointOnTriangle(p, a, ab, ac, c, distSq[lane]);
+        closestPoints[0][lane] = c[0];
+        closestPoints[1][lane] = c[1];
+        closestPoints[2][lane] = c[2];
+        if(distSq[lane] < maxDistSq)
+        {
+            closer |= 1u << lane;
+        }
+    }
+#endif
+    return closer;
+}
+
+unsigned TriangleSoA::IntersectRay(const Vec3& origin,
+                                   const Vec3& direction,
+                                   std::size_t first,
+                                   unsigned laneMask,
+                                   double maxDist,
+                                   double dist[PACKET_SIZE])const
+{
+    unsigned hits = 0;
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+    const Packet o[3] = {Packet(origin.X()), Packet(origin.Y()), Packet(origin.Z())};
+    const Packet d[3] = {Packet(direction.X()), Packet(direction.Y()), Packet(direction.Z())};
+    const Packet a[3] = {Packet::Load(&m_p0[0][first]), Packet::Load(&m_p0[1][first]), Packet::Load(&m_p0[2][first])};
+    const Packet ab[3] = {Packet::Load(&m_p0p1[0][first]), Packet::Load(&m_p0p1[1][first]), Packet::Load(&m_p0p1[2][first])};
+    const Packet ac[3] = {Packet::Load(&m_p0p2[0][first]), Packet::Load(&m_p0p2[1][first]), Packet::Load(&m_p0p2[2][first])};
+    Packet t;
+    hits = ToBits(IntersectRayWithTriangle(o, d, a, ab, ac, Packet(maxDist), t)) & laneMask;
+    if(hits != 0)
+    {
+        Store(dist, t);
+    }
+#else
+    const double o[3] = {origin.X(), origin.Y(), origin.Z()};
+    const double d[3] = {direction.X(), direction.Y(), direction.Z()};
+    for(std::size_t lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+        if(((laneMask >> lane) & 1) == 0)
+        {
+            continue;
+        }
+        const std::size_t i = first + lane;
+        const double a[3] = {m_p0[0][i], m_p0[1][i], m_p0[2][i]};
+        const double ab[3] = {m_p0p1[0][i], m_p0p1[1][i], m_p0p1[2][i]};
+        const double ac[3] = {m_p0p2[0][i], m_p0p2[1][i], m_p0p2[2][i]};
+        if(IntersectRayWithTriangle(o, d, a, ab, ac, maxDist, dist[lane]))
+        {
+            hits |= 1u << lane;
+        }
+    }
+#endif
+    return hits;
+}
+
+bool TriangleSoA::FindClosest(const Vec3& point,
+                              std::size_t first,
+                              unsigned laneMask,
+                              double& bestDistSq,
+                              Vec3& closestPoint,
+                              std::size_t& closestIndex)const
+{
+    double distSq[PACKET_SIZE];
+    double c[3][PACKET_SIZE];
+    const unsigned closer = CalcClosestPoints(point, first, laneMask, bestDistSq, distSq, c);
+    if(closer == 0)
+    {
+        return false;
+    }
+
+    // Lowest lane with the smallest distance, to match a sequential scan
+    unsigned best = PACKET_SIZE;
+    for(unsigned lane = 0; lane < PACKET_SIZE; ++lane)
+    {
+        if(((closer >> lane) & 1) != 0 && (best == PACKET_SIZE || distSq[lane] < distSq[best]))
+        {
+            best = lane;
+        }
+    }
+
+    bestDistSq = distSq[best];
+    closestPoint = Vec3(c[0][best], c[1][best], c[2][best]);
+    closestIndex = first + best;
+    return true;
+}
+
+bool TriangleSoA::FindClosestInRange(const Vec3& point,
+                                     std::size_t first,
+                                     std::size_t count,
+                                     double& bestDistSq,
+                                     Vec3& closestPoint,
+                                     std::size_t& closestIndex)const
+{
+    const unsigned fullMask = (1u << PACKET_SIZE) - 1;
+    bool found = false;
+    for(std::size_t offset = 0; offset < count; offset += PACKET_SIZE)
+    {
+        const std::size_t remaining = count - offset;
+        const unsigned laneMask = remaining >= PACKET_SIZE ? fullMask : (1u << remaining) - 1;
+        found |= FindClosest(point, first + offset, laneMask, bestDistSq, closestPoint, closestIndex);
+    }
+    return found;
+}
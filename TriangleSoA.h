@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Triangle.h"
+#include "Vec3.h"
+#include <cstddef>
+#include <vector>
+
+namespace rabbit
+{
+
+/**
+* @brief A list of triangles stored as structure of arrays, for calculating the distance
+* from a point to a packet of triangles at once. Each triangle is kept as its vertex P0
+* and its edges P0P1 and P0P2.
+*
+* The closest point on each triangle is found by classifying the point against the
+* Voronoi regions of the triangle's vertices, edges and face without any branches,
+* using squared distances throughout and a single square root for the result. Packets
+* are 8 triangles wide with AVX-512, 4 wide with AVX2, and evaluated one lane at a time
+* by the same code otherwise (see RABBIT_USE_NATIVE_ARCH).
+*
+* Results agree with Triangle::CalcShortestDistanceFrom to within rounding, except for
+* points projecting just outside a triangle. Triangle::CalcShortestDistanceFrom treats
+* those as inside when their barycentric coordinates are within 1e-6 of the triangle,
+* so there the closest points can differ by up to 1e-6 times the length of the
+* triangle's edges, and the distances by less than that.
+*/
+class TriangleSoA
+{
+public:
+
+#if defined(__AVX512F__)
+    static const std::size_t PACKET_SIZE = 8;
+#else
+    static const std::size_t PACKET_SIZE = 4;
+#endif
+
+    TriangleSoA();
+
+    void Reserve(std::size_t n);
+    void PushBack(const Triangle<Vec3>& t);
+    std::size_t Size()const{return m_size;}
+
+    /**
+    * Appends n triangles at once, given in the layout returned by GetP0, GetP0P1 and GetP0P2
+    * @param p0 x, y and z arrays of vertex P0, n values each
+    * @param p0p1 x, y and z arrays of edge P0P1
+    * @param p0p2 x, y and z arrays of edge P0P2
+    */
+    void Append(std::size_t n, const double* const p0[3], const double* const p0p1[3], const double* const p0p2[3]);
+
+    /**
+    * Moves triangle i to the vertices p0, p1 and p2
+    */
+    void Set(std::size_t i, const Vec3& p0, const Vec3& p1, const Vec3& p2);
+
+    /**
+    * @return Triangle i, with a zero normal if it is degenerate
+    */
+    Triangle<Vec3> GetTriangle(std::size_t i)const;
+
+    /**
+    * Calculates the AABB of the triangles [first, first + count)
+    */
+    void CalcBounds(std::size_t first, std::size_t count, double boundsMin[3], double boundsMax[3])const;
+
+    /**
+    * @return The x, y or z coordinates (axis 0, 1 or 2) of vertex P0 of all the triangles
+    */
+    const double* GetP0(unsigned axis)const{return m_p0[axis].data();}
+    const double* GetP0P1(unsigned axis)const{return m_p0p1[axis].data();}
+    const double* GetP0P2(unsigned axis)const{return m_p0p2[axis].data();}
+
+    /**
+    * Calculates the closest points on the triangles [first, first + PACKET_SIZE) whose bits
+    * are set in laneMask and their squared distances from point.
+    * @param maxDistSq Triangles at least sqrt(maxDistSq) away are not reported
+    * @param distSq Squared distance to the triangle of each lane
+    * @param closestPoints x, y and z of the closest point on the triangle of each lane
+    * @return Bits of the lanes closer than sqrt(maxDistSq). Only the entries of these
+    * lanes are guaranteed to be set.
+    */
+    unsigned CalcClosestPoints(const Vec3& point,
+                               std::size_t first,
+                               unsigned laneMask,
+                               double maxDistSq,
+                               double distSq[PACKET_SIZE],
+                               double closestPoints[3][PACKET_SIZE])const;
+
+    /**
+    * Intersects the ray origin + direction*t, t > 0, with the triangles [first, first + PACKET_SIZE)
+    * whose bits are set in laneMask, see Triangle::IntersectRay.
+    * @param maxDist Hits at t >= maxDist are not reported
+    * @param dist t at which the ray hits the triangle of each lane
+    * @return Bits of the lanes whose triangle is hit. Only the entries of these lanes are
+    * guaranteed to be set.
+    */
+    unsigned IntersectRay(const Vec3& origin,
+                          const Vec3& direction,
+                          std::size_t first,
+                          unsigned laneMask,
+                          double maxDist,
+                          double dist[PACKET_SIZE])const;
+
+    /**
+    * Finds the closest of the triangles [first, first + PACKET_SIZE) whose bits are set
+    * in laneMask, provided it is closer than sqrt(bestDistSq).
+    * @param bestDistSq Square of the best distance found so far. Updated if a closer triangle is found.
+    * @param closestPoint Updated with the closest point on that triangle
+    * @param closestIndex Updated with the index of that triangle. Of several triangles at the
+    * same distance, the one with the lowest index is taken.
+    * @return true if a closer triangle was found
+    */
+    bool FindClosest(const Vec3& point,
+                     std::size_t first,
+                     unsigned laneMask,
+                     double& bestDistSq,
+                     Vec3& closestPoint,
+                     std::size_t& closestIndex)const;
+
+    /**
+    * As above, for all the triangles [first, first + count)
+    */
+    bool FindClosestInRange(const Vec3& point,
+                            std::size_t first,
+                            std::size_t count,
+                            double& bestDistSq,
+                            Vec3& closestPoint,
+                            std::size_t& closestIndex)const;
+
+private:
+
+    // The arrays always end with PACKET_SIZE well formed dummy triangles, so packets can
+    // be loaded past the last triangle. The lanes holding them are masked out.
+    std::vector<double> m_p0[3];   ///< x, y and z of vertex P0
+    std::vector<double> m_p0p1[3]; ///< x, y and z of edge P0P1
+    std::vector<double> m_p0p2[3]; ///< x, y and z of edge P0P2
+    std::size_t m_size;            ///< Number of triangles, not counting the padding
+};
+
+}
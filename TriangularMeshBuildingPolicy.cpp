@@ -1,14 +1,228 @@
 #include <fstream>
 #include <system_error>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <cstring>
+#include <locale>
+#include <locale.h>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
 #include "TriangularMeshBuildingPolicy.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
 using namespace rabbit;
 using namespace std;
 
-TriangularMeshBuilingPolicy::TriangularMeshBuilingPolicy(std::string fileName):m_fileName(fileName){}
+namespace
+{
+    typedef Triangle<Vec3> Tri;
+
+    const std::size_t MIN_CHUNK_SIZE = 1 << 20; ///< Smaller chunks are not worth a task of their own
+    const std::size_t CHUNKS_PER_THREAD = 4;    ///< Leaves room for balancing uneven chunks
+
+    /**
+    * @brief Numbers parsed from one chunk of the file
+    */
+    struct Chunk
+    {
+        Chunk():begin(0), end(0), failed(false){}
+
+        std::size_t begin;           ///< Offset of the first byte of the chunk in the file
+        std::size_t end;             ///< One past the last byte
+        std::vector<double> numbers;
+        bool failed;                 ///< true if parsing stopped at something which is not a number
+    };
+
+    bool IsSpace(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    // Characters a decimal number written by operator<< can be made of
+    bool IsNumberChar(char c)
+    {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    /**
+    * The "C" locale, whatever the locale of the process. Mesh files always have a decimal
+    * point, which strtod would not accept if e.g. setlocale picked a German locale.
+    */
+    locale_t GetCLocale()
+    {
+        static const locale_t cLocale = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+        if(cLocale == static_cast<locale_t>(0))
+        {
+            throw std::runtime_error("Unable to create the C locale");
+        }
+        return cLocale;
+    }
+
+    /**
+    * Converts one whitespace delimited token with strtod in the "C" locale, which is what
+    * operator>> of a stream imbued with the classic locale ends up calling as well. The
+    * mapped file is not null terminated, so the token is copied.
+    * @return false if the token is not entirely a number
+    */
+    bool ParseNumber(const char* begin, const char* end, double& number)
+    {
+        const std::size_t length = static_cast<std::size_t>(end - begin);
+        if(!std::all_of(begin, end, IsNumberChar))
+        {
+            return false;
+        }
+
+        char buffer[64];
+        std::string longToken;
+        const char* token = buffer;
+        if(length < sizeof(buffer))
+        {
+            std::memcpy(buffer, begin, length);
+            buffer[length] = '\0';
+        }
+        else
+        {
+            longToken.assign(begin, end);
+            token = longToken.c_str();
+        }
+
+        char* parsedEnd = nullptr;
+        number = strtod_l(token, &parsedEnd, GetCLocale());
+        return parsedEnd == token + length;
+    }
+
+    void ParseChunk(const char* data, Chunk& chunk)
+    {
+        // A rough guess, the rabbit has a number for every 10 characters
+        chunk.numbers.reserve((chunk.end - chunk.begin)/8);
+        const char* p = data + chunk.begin;
+        const char* end = data + chunk.end;
+        while(true)
+        {
+            while(p != end && IsSpace(*p))
+            {
+                ++p;
+            }
+            if(p == end)
+            {
+                return;
+            }
+
+            const char* tokenEnd = p;
+            while(tokenEnd != end && !IsSpace(*tokenEnd))
+            {
+                ++tokenEnd;
+            }
+
+            double number;
+            if(!ParseNumber(p, tokenEnd, number))
+            {
+                chunk.failed = true;
+                return;
+            }
+            chunk.numbers.push_back(number);
+            p = tokenEnd;
+        }
+    }
+
+    /**
+    * Splits [0, size) into about numChunks chunks which each end just after a line break
+    * or at the end of the file, so no number is cut in two.
+    */
+    std::vector<Chunk> SplitIntoChunks(const char* data, std::size_t size, std::size_t numChunks)
+    {
+        std::vector<Chunk> chunks;
+        const std::size_t chunkSize = size/numChunks + 1;
+        std::size_t begin = 0;
+        while(begin < size)
+        {
+            std::size_t end = std::min(begin + chunkSize, size);
+            const void* lineBreak = std::memchr(data + end - 1, '\n', size - end + 1);
+            end = lineBreak ? static_cast<const char*>(lineBreak) - data + 1 : size;
+
+            chunks.push_back(Chunk());
+            chunks.back().begin = begin;
+            chunks.back().end = end;
+            begin = end;
+        }
+        return chunks;
+    }
+
+    std::unique_ptr<MappedFile> MapMeshFile(const std::string& fileName)
+    {
+        try
+        {
+            return std::unique_ptr<MappedFile>(new MappedFile(fileName));
+        }
+        catch(const std::runtime_error&)
+        {
+            throw std::runtime_error("Unable to open mesh file:" + fileName);
+        }
+    }
+
+    /**
+    * Parses the numbers of the file in chunks on pool. Like the stream, parsing stops at
+    * the first thing which is not a number, so the chunks after it are dropped.
+    */
+    std::vector<Chunk> ParseChunks(const MappedFile& file, ThreadPool& pool)
+    {
+        const char* data = file.GetData();
+        const std::size_t size = file.GetSize();
+        const std::size_t maxChunks = (pool.GetNumThreads() + 1)*CHUNKS_PER_THREAD;
+        const std::size_t numChunks = std::max<std::size_t>(1, std::min(maxChunks, size/MIN_CHUNK_SIZE));
+        std::vector<Chunk> chunks = SplitIntoChunks(data, size, numChunks);
+
+        pool.ParallelFor(chunks.size(), 1, [data, &chunks](std::size_t begin, std::size_t end)
+        {
+            for(std::size_t i = begin; i < end; ++i)
+            {
+                ParseChunk(data, chunks[i]);
+            }
+        });
+
+        std::size_t numChunksUsed = 0;
+        while(numChunksUsed < chunks.size() && !chunks[numChunksUsed++].failed){}
+        chunks.resize(numChunksUsed);
+        return chunks;
+    }
+}
+
+TriangularMeshBuilingPolicy::TriangularMeshBuilingPolicy(std::string fileName):
+    m_fileName(fileName),
+    m_loadThroughput(0.0){}
+
+TriangularMeshBuilingPolicy::TriangularMeshBuilingPolicy(std::string fileName,
+                                                         std::shared_ptr<ThreadPool> threadPool):
+    m_fileName(fileName),
+    m_threadPool(threadPool),
+    m_loadThroughput(0.0){}
 
 void TriangularMeshBuilingPolicy::GeneratePolygons(std::vector<Triangle<Vec3>>& triangles)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t numBytes = m_threadPool ? ParseInParallel(triangles) :
+                                                ParseStream([&triangles](const Tri& t){triangles.push_back(t);});
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_loadThroughput = seconds > 0.0 ? numBytes/(1024.0*1024.0)/seconds : 0.0;
+}
+
+void TriangularMeshBuilingPolicy::VisitPolygons(const std::function<void(const Triangle<Vec3>&)>& visitor)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t numBytes = m_threadPool ? VisitInParallel(visitor) : ParseStream(visitor);
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_loadThroughput = seconds > 0.0 ? numBytes/(1024.0*1024.0)/seconds : 0.0;
+}
+
+std::size_t TriangularMeshBuilingPolicy::ParseStream(const std::function<void(const Triangle<Vec3>&)>& visitor)
 {
     ifstream infile;
+    infile.imbue(std::locale::classic());
     infile.open(m_fileName.c_str());
     if(infile.fail())
     {
@@ -20,7 +234,84 @@ void TriangularMeshBuilingPolicy::GeneratePolygons(std::vector<Triangle<Vec3>>&
                  >> P2.X() >> P2.Y() >> P2.Z()
           )
     {
-        triangles.emplace_back(P0, P1, P2);
+        visitor(Tri(P0, P1, P2));
     }
     infile.close();
+
+    infile.open(m_fileName.c_str(), ios::binary | ios::ate);
+    return static_cast<std::size_t>(infile.tellg());
+}
+
+std::size_t TriangularMeshBuilingPolicy::ParseInParallel(std::vector<Triangle<Vec3>>& triangles)
+{
+    const std::unique_ptr<MappedFile> file = MapMeshFile(m_fileName);
+    std::vector<Chunk> chunks = ParseChunks(*file, *m_threadPool);
+
+    // Index of the first number of each chunk among all the numbers
+    std::vector<std::size_t> firstNumber(chunks.size() + 1, 0);
+    for(std::size_t i = 0; i < chunks.size(); ++i)
+    {
+        firstNumber[i + 1] = firstNumber[i] + chunks[i].numbers.size();
+    }
+
+    // A trailing incomplete triangle is dropped, as by the stream
+    const std::size_t numTriangles = firstNumber.back()/9;
+    const std::size_t firstTriangle = triangles.size();
+    triangles.resize(firstTriangle + numTriangles);
+
+    // Each chunk builds the triangles starting in it, which may end in the next chunks
+    m_threadPool->ParallelFor(chunks.size(), 1, [&](std::size_t begin, std::size_t end)
+    {
+        for(std::size_t c = begin; c < end; ++c)
+        {
+            std::size_t t = (firstNumber[c] + 8)/9;
+            const std::size_t lastTriangle = std::min((firstNumber[c + 1] + 8)/9, numTriangles);
+            std::size_t chunk = c;
+            std::size_t index = 9*t - firstNumber[c];
+            for(; t < lastTriangle; ++t)
+            {
+                double coords[9];
+                for(unsigned k = 0; k < 9; ++k)
+                {
+                    while(index == chunks[chunk].numbers.size())
+                    {
+                        ++chunk;
+                        index = 0;
+                    }
+                    coords[k] = chunks[chunk].numbers[index++];
+                }
+                triangles[firstTriangle + t] = Tri(Vec3(coords[0], coords[1], coords[2]),
+                                                   Vec3(coords[3], coords[4], coords[5]),
+                                                   Vec3(coords[6], coords[7], coords[8]));
+            }
+        }
+    });
+    return file->GetSize();
+}
+
+std::size_t TriangularMeshBuilingPolicy::VisitInParallel(const std::function<void(const Triangle<Vec3>&)>& visitor)
+{
+    const std::unique_ptr<MappedFile> file = MapMeshFile(m_fileName);
+    std::vector<Chunk> chunks = ParseChunks(*file, *m_threadPool);
+
+    // The numbers of a chunk are released as soon as its triangles have been visited. A
+    // trailing incomplete triangle is dropped, as by the stream.
+    double coords[9];
+    unsigned numCoords = 0;
+    for(Chunk& chunk : chunks)
+    {
+        for(double number : chunk.numbers)
+        {
+            coords[numCoords++] = number;
+            if(numCoords == 9)
+            {
+                visitor(Tri(Vec3(coords[0], coords[1], coords[2]),
+                            Vec3(coords[3], coords[4], coords[5]),
+                            Vec3(coords[6], coords[7], coords[8])));
+                numCoords = 0;
+            }
+        }
+        std::vector<double>().swap(chunk.numbers);
+    }
+    return file->GetSize();
 }
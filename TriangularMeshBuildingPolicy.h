@@ -3,9 +3,15 @@
 #include "IMeshBuildingPolicy.h"
 #include "Triangle.h"
 #include "Vec3.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
 
 namespace rabbit
 {
+    class ThreadPool;
+
     /**
     * @brief This builder can be used to extract triangle coordinates from a plain text file.
     * Look at the file rabbit.triangles for the expected format.
@@ -20,13 +26,49 @@ namespace rabbit
         */
         TriangularMeshBuilingPolicy(std::string fileName);
 
+        /**
+        * Create a triangular mesh builder which maps the file into memory and parses
+        * it in parallel. The file is split into chunks at line breaks and each chunk
+        * is parsed on its own thread. The coordinates are exactly the same as read
+        * by the other constructor, since both end up converting each number with
+        * strtod in the "C" locale. Neither depends on the locale set for the process.
+        * @param threadPool Pool on which the chunks are parsed
+        */
+        TriangularMeshBuilingPolicy(std::string fileName, std::shared_ptr<ThreadPool> threadPool);
+
         /**
         * Interface implementation for the base class
         * @param triangles The triangle vector which are to be populated
         */
         virtual void GeneratePolygons(std::vector<Triangle<Vec3>>& triangles) override;
+
+        /**
+        * Interface implementation for the base class. Reading the stream, the triangles are
+        * visited as they are read. Parsing in parallel, the numbers of the whole file are
+        * parsed first, but no triangles are built beyond the one being visited.
+        */
+        virtual void VisitPolygons(const std::function<void(const Triangle<Vec3>&)>& visitor) override;
+
+        /**
+        * @return Size of the file divided by the time GeneratePolygons or VisitPolygons
+        * took, in MB/s. Zero until either has been called.
+        */
+        double GetLoadThroughput()const{return m_loadThroughput;}
+
     private:
 
+        // Reads the file with an ifstream, one number at a time, and calls visitor for each
+        // triangle. Returns the size of the file.
+        std::size_t ParseStream(const std::function<void(const Triangle<Vec3>&)>& visitor);
+
+        // Maps the file and parses its chunks on m_threadPool. Returns the size of the file.
+        std::size_t ParseInParallel(std::vector<Triangle<Vec3>>& triangles);
+
+        // As ParseInParallel, calling visitor for each triangle in the order of the file
+        std::size_t VisitInParallel(const std::function<void(const Triangle<Vec3>&)>& visitor);
+
         std::string m_fileName; ///< Name of the file containing the triangle coordinates comprising the mesh
+        std::shared_ptr<ThreadPool> m_threadPool; ///< Set if the file is parsed in parallel
+        double m_loadThroughput; ///< MB/s of the last call to GeneratePolygons or VisitPolygons
     };
 }
@@ -0,0 +1,634 @@
+#include <Mesh.h>
+#include <MappedMeshBuildingPolicy.h>
+#include <TriangularMeshBuildingPolicy.h>
+#include <ProximityTracker.h>
+#include <QueryStats.h>
+#include <TriMeshProxQueryV1.h>
+#include <TriMeshProxQueryV2.h>
+#include <TriMeshProxQueryV3.h>
+#include <TriMeshProxQueryV4.h>
+#include <TriMeshProxQueryV5.h>
+#include <TriMeshProxQueryV6.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+using namespace std;
+using namespace rabbit;
+
+namespace
+{
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+    typedef std::chrono::steady_clock Clock;
+
+    const double INF = std::numeric_limits<double>::infinity();
+
+    // Distances below are fractions of the diagonal of the bounds of the mesh
+    const double SHELL_WIDTH = 0.02;  ///< Near surface points are at most this far from a triangle
+    const double FAR_MIN_DIST = 2.0;  ///< Far field points are at least this far from the center of the mesh
+    const double FAR_MAX_DIST = 10.0; ///< and at most this far
+    const double WALK_STEP = 0.001;   ///< Length of each step of a random walk
+
+    const std::size_t NUM_WARMUP_QUERIES = 100; ///< Queries run before each timed run and not counted
+
+    const char* const USAGE =
+        "Usage: ProxQueryBench [options]\n"
+        "  --mesh FILE             Text (rabbit.triangles) or binary (.mesh) mesh, default rabbit.triangles\n"
+        "  --subdivisions LIST     Mesh sizes, each level splits every triangle into four, default 0,1\n"
+        "  --methods LIST          Any of V1,V2,V3,V3Records,V4,V5,V6,V4Tracker, default all\n"
+        "  --distributions LIST    Any of uniform,shell,far,walk, default all\n"
+        "  --thresholds LIST       Distance thresholds as fractions of the diagonal of the mesh,\n"
+        "                          inf for none, default inf,0.1,0.01\n"
+        "  --queries N             Queries per run, default 2000\n"
+        "  --seed N                Seed of the query points, default 1\n"
+        "  --output FILE           Where to write the JSON report, default standard output\n";
+
+    struct Options
+    {
+        Options():
+            MeshFile("rabbit.triangles"),
+            Subdivisions{0, 1},
+            Methods{"V1", "V2", "V3", "V3Records", "V4", "V5", "V6", "V4Tracker"},
+            Distributions{"uniform", "shell", "far", "walk"},
+            Thresholds{INF, 0.1, 0.01},
+            NumQueries(2000),
+            Seed(1){}
+
+        std::string MeshFile;
+        std::vector<unsigned> Subdivisions;
+        std::vector<std::string> Methods;
+        std::vector<std::string> Distributions;
+        std::vector<double> Thresholds;
+        std::size_t NumQueries;
+        unsigned Seed;
+        std::string OutputFile;
+    };
+
+    std::vector<std::string> SplitList(const std::string& list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while(std::getline(stream, item, ','))
+        {
+            if(!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        if(items.empty())
+        {
+            throw std::runtime_error("Empty list: " + list);
+        }
+        return items;
+    }
+
+    double ParseNumber(const std::string& text)
+    {
+        if(text == "inf")
+        {
+            return INF;
+        }
+        char* end = nullptr;
+        const double value = std::strtod(text.c_str(), &end);
+        if(end == text.c_str() || *end != '\0' || !(value > 0.0))
+        {
+            throw std::runtime_error("Not a positive number: " + text);
+        }
+        return value;
+    }
+
+    // Unlike std::stoul alone, rejects "0", "-1" and "2.5"
+    std::size_t ParseCount(const std::string& text)
+    {
+        std::size_t length = 0;
+        unsigned long value = 0;
+        try
+        {
+            value = std::stoul(text, &length);
+        }
+        catch(const std::logic_error&)
+        {
+            length = 0;
+        }
+        if(text.empty() || text[0] < '0' || text[0] > '9' || length != text.size() || value == 0)
+        {
+            throw std::runtime_error("Not a positive whole number: " + text);
+        }
+        return static_cast<std::size_t>(value);
+    }
+
+    Options ParseOptions(int argc, char* argv[])
+    {
+        Options options;
+        for(int i = 1; i < argc; ++i)
+        {
+            const std::string name = argv[i];
+            if(i + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value of " + name);
+            }
+            const std::string value = argv[++i];
+            if(name == "--mesh")
+            {
+                options.MeshFile = value;
+            }
+            else if(name == "--subdivisions")
+            {
+                options.Subdivisions.clear();
+                for(const std::string& level : SplitList(value))
+                {
+                    options.Subdivisions.push_back(static_cast<unsigned>(std::stoul(level)));
+                }
+            }
+            else if(name == "--methods")
+            {
+                options.Methods = SplitList(value);
+            }
+            else if(name == "--distributions")
+            {
+                options.Distributions = SplitList(value);
+            }
+            else if(name == "--thresholds")
+            {
+                options.Thresholds.clear();
+                for(const std::string& threshold : SplitList(value))
+                {
+                    options.Thresholds.push_back(ParseNumber(threshold));
+                }
+            }
+            else if(name == "--queries")
+            {
+                options.NumQueries = ParseCount(value);
+            }
+            else if(name == "--seed")
+            {
+                options.Seed = static_cast<unsigned>(std::stoul(value));
+            }
+            else if(name == "--output")
+            {
+                options.OutputFile = value;
+            }
+            else
+            {
+                throw std::runtime_error("Unknown option " + name);
+            }
+        }
+        return options;
+    }
+
+    // Hands a list of triangles to a Mesh
+    class TriangleListBuildingPolicy : public IMeshBuildingPolicy<Triangle<Vec3>>
+    {
+    public:
+        explicit TriangleListBuildingPolicy(std::vector<Triangle<Vec3>> triangles):m_triangles(std::move(triangles)){}
+
+        virtual void GeneratePolygons(std::vector<Triangle<Vec3>>& triangles) override
+        {
+            triangles.swap(m_triangles);
+        }
+
+    private:
+        std::vector<Triangle<Vec3>> m_triangles;
+    };
+
+    // Splits every triangle into four at the midpoints of its edges
+    std::vector<Triangle<Vec3>> Subdivide(const std::vector<Triangle<Vec3>>& triangles)
+    {
+        std::vector<Triangle<Vec3>> result;
+        result.reserve(4*triangles.size());
+        for(const Triangle<Vec3>& t : triangles)
+        {
+            const Vec3& p0 = t.GetVerts(zero);
+            const Vec3& p1 = t.GetVerts(one);
+            const Vec3& p2 = t.GetVerts(two);
+            const Vec3 m01 = (p0 + p1)*0.5;
+            const Vec3 m12 = (p1 + p2)*0.5;
+            const Vec3 m02 = (p0 + p2)*0.5;
+            result.emplace_back(p0, m01, m02);
+            result.emplace_back(m01, p1, m12);
+            result.emplace_back(m02, m12, p2);
+            result.emplace_back(m01, m12, m02);
+        }
+        return result;
+    }
+
+    struct MeshBounds
+    {
+        Vec3 Lower;
+        Vec3 Upper;
+        Vec3 Center()const{return (Lower + Upper)*0.5;}
+        double Diagonal()const{return (Upper - Lower).magnitude();}
+    };
+
+    MeshBounds CalcBounds(const std::vector<Triangle<Vec3>>& triangles)
+    {
+        double lower[3] = {INF, INF, INF};
+        double upper[3] = {-INF, -INF, -INF};
+        for(const Triangle<Vec3>& t : triangles)
+        {
+            const Bounds b = t.CalculateAABB().GetBounds();
+            lower[0] = std::min(lower[0], b.xMin); upper[0] = std::max(upper[0], b.xMax);
+            lower[1] = std::min(lower[1], b.yMin); upper[1] = std::max(upper[1], b.yMax);
+            lower[2] = std::min(lower[2], b.zMin); upper[2] = std::max(upper[2], b.zMax);
+        }
+        MeshBounds bounds;
+        bounds.Lower = Vec3(lower[0], lower[1], lower[2]);
+        bounds.Upper = Vec3(upper[0], upper[1], upper[2]);
+        return bounds;
+    }
+
+    // Query points of one distribution, the same for every method
+    std::vector<Vec3> GeneratePoints(const std::string& distribution,
+                                     const std::vector<Triangle<Vec3>>& triangles,
+                                     const MeshBounds& bounds,
+                                     std::size_t numPoints,
+                                     unsigned seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        auto randomInBounds = [&]()
+        {
+            return Vec3(bounds.Lower.X() + unit(rng)*(bounds.Upper.X() - bounds.Lower.X()),
+                        bounds.Lower.Y() + unit(rng)*(bounds.Upper.Y() - bounds.Lower.Y()),
+                        bounds.Lower.Z() + unit(rng)*(bounds.Upper.Z() - bounds.Lower.Z()));
+        };
+        auto randomDirection = [&]()
+        {
+            Vec3 d(normal(rng), normal(rng), normal(rng));
+            const double length = d.magnitude();
+            return length > 0.0 ? d*(1.0/length) : Vec3(1.0, 0.0, 0.0);
+        };
+        const double diagonal = bounds.Diagonal();
+
+        std::vector<Vec3> points;
+        points.reserve(numPoints);
+        if(distribution == "uniform")
+        {
+            while(points.size() < numPoints)
+            {
+                points.push_back(randomInBounds());
+            }
+        }
+        else if(distribution == "shell")
+        {
+            std::uniform_int_distribution<std::size_t> pickTriangle(0, triangles.size() - 1);
+            while(points.size() < numPoints)
+            {
+                const Triangle<Vec3>& t = triangles[pickTriangle(rng)];
+                double u = unit(rng);
+                double v = unit(rng);
+                if(u + v > 1.0)
+                {
+                    u = 1.0 - u;
+                    v = 1.0 - v;
+                }
+                const Vec3 onSurface = t.GetVerts(zero) + t.P0P1()*u + t.P0P2()*v;
+                points.push_back(onSurface + randomDirection()*(unit(rng)*SHELL_WIDTH*diagonal));
+            }
+        }
+        else if(distribution == "far")
+        {
+            while(points.size() < numPoints)
+            {
+                const double dist = (FAR_MIN_DIST + unit(rng)*(FAR_MAX_DIST - FAR_MIN_DIST))*diagonal;
+                points.push_back(bounds.Center() + randomDirection()*dist);
+            }
+        }
+        else if(distribution == "walk")
+        {
+            // Starts on a vertex of the mesh, steps leaving the bounds are mirrored back in
+            std::uniform_int_distribution<std::size_t> pickTriangle(0, triangles.size() - 1);
+            Vec3 p = triangles[pickTriangle(rng)].GetVerts(zero);
+            while(points.size() < numPoints)
+            {
+                points.push_back(p);
+                const Vec3 step = randomDirection()*(WALK_STEP*diagonal);
+                double next[3] = {p.X() + step.X(), p.Y() + step.Y(), p.Z() + step.Z()};
+                const double lower[3] = {bounds.Lower.X(), bounds.Lower.Y(), bounds.Lower.Z()};
+                const double upper[3] = {bounds.Upper.X(), bounds.Upper.Y(), bounds.Upper.Z()};
+                for(unsigned axis = 0; axis < 3; ++axis)
+                {
+                    if(next[axis] < lower[axis] || next[axis] > upper[axis])
+                    {
+                        next[axis] -= 2.0*(next[axis] - (next[axis] < lower[axis] ? lower[axis] : upper[axis]));
+                    }
+                }
+                p = Vec3(next[0], next[1], next[2]);
+            }
+        }
+        else
+        {
+            throw std::runtime_error("Unknown distribution " + distribution);
+        }
+        return points;
+    }
+
+    // A query method behind a common interface, so that all of them are timed by the same loop
+    class BenchMethod
+    {
+    public:
+        virtual ~BenchMethod(){}
+
+        // Called before each run, for methods which keep state between queries
+        virtual void Reset(){}
+
+        virtual ClosestPointResult<Vec3> Query(const Vec3& point, double distThreshold) = 0;
+    };
+
+    template<typename ProximityQueryMethod>
+    class QueryMethod : public BenchMethod
+    {
+    public:
+        explicit QueryMethod(ProximityQueryMethod* method):m_method(method){}
+
+        virtual ClosestPointResult<Vec3> Query(const Vec3& point, double distThreshold) override
+        {
+            return m_method->CalculateClosestPointImpl(point, distThreshold);
+        }
+
+    private:
+        std::unique_ptr<ProximityQueryMethod> m_method;
+    };
+
+    // ProximityTracker in front of TriMeshProxQueryV4, started afresh for every run
+    class TrackedQueryMethod : public BenchMethod
+    {
+    public:
+        explicit TrackedQueryMethod(const std::shared_ptr<TriMesh>& mesh):
+            m_method(mesh),
+            m_tracker(m_method, [mesh](std::size_t i){return mesh->GetPolygons()[i];}){}
+
+        virtual void Reset() override{m_tracker.Reset();}
+
+        virtual ClosestPointResult<Vec3> Query(const Vec3& point, double distThreshold) override
+        {
+            return m_tracker.CalculateClosestPointImpl(point, distThreshold);
+        }
+
+    private:
+        TriMeshProxQueryV4 m_method;
+        ProximityTracker<TriMeshProxQueryV4> m_tracker;
+    };
+
+    std::unique_ptr<BenchMethod> CreateMethod(const std::string& name, const std::shared_ptr<TriMesh>& mesh)
+    {
+        typedef std::unique_ptr<BenchMethod> Ptr;
+        if(name == "V1") return Ptr(new QueryMethod<TriMeshProxQueryV1>(new TriMeshProxQueryV1(mesh)));
+        if(name == "V2") return Ptr(new QueryMethod<TriMeshProxQueryV2>(new TriMeshProxQueryV2(mesh)));
+        if(name == "V3") return Ptr(new QueryMethod<TriMeshProxQueryV3>(new TriMeshProxQueryV3(mesh)));
+        if(name == "V3Records")
+        {
+            return Ptr(new QueryMethod<TriMeshProxQueryV3>(
+                new TriMeshProxQueryV3(mesh, BVHBuildParams(), TrianglePrecomputation::QueryRecords)));
+        }
+        if(name == "V4") return Ptr(new QueryMethod<TriMeshProxQueryV4>(new TriMeshProxQueryV4(mesh)));
+        if(name == "V5") return Ptr(new QueryMethod<TriMeshProxQueryV5>(new TriMeshProxQueryV5(mesh)));
+        if(name == "V6") return Ptr(new QueryMethod<TriMeshProxQueryV6>(new TriMeshProxQueryV6(mesh)));
+        if(name == "V4Tracker") return Ptr(new TrackedQueryMethod(mesh));
+        throw std::runtime_error("Unknown method " + name);
+    }
+
+    struct RunResult
+    {
+        double QueriesPerSec;
+        double P50Us;             ///< Median latency in microseconds
+        double P99Us;             ///< 99th percentile latency in microseconds
+        double TrianglesPerQuery; ///< Distances calculated per query, see QueryStats
+        double FoundFraction;     ///< Fraction of the queries which found a triangle within the threshold
+        double MeanDist;          ///< Mean distance of the queries which found a triangle
+    };
+
+    // Nearest rank percentile of sorted values
+    double Percentile(const std::vector<double>& sorted, double fraction)
+    {
+        const std::size_t rank = static_cast<std::size_t>(std::ceil(fraction*sorted.size()));
+        return sorted[std::min(std::max(rank, std::size_t(1)), sorted.size()) - 1];
+    }
+
+    RunResult Run(BenchMethod& method, const std::vector<Vec3>& points, double distThreshold)
+    {
+        method.Reset();
+        for(std::size_t i = 0; i < std::min(NUM_WARMUP_QUERIES, points.size()); ++i)
+        {
+            method.Query(points[i], distThreshold);
+        }
+        method.Reset();
+
+        // One clock reading between consecutive queries times both of them
+        std::vector<Clock::time_point> times(points.size() + 1);
+        std::size_t numFound = 0;
+        double sumDist = 0.0;
+        QueryStats::Reset();
+        times[0] = Clock::now();
+        for(std::size_t i = 0; i < points.size(); ++i)
+        {
+            const ClosestPointResult<Vec3> res = method.Query(points[i], distThreshold);
+            times[i + 1] = Clock::now();
+            if(res.Found())
+            {
+                ++numFound;
+                sumDist += res.Dist;
+            }
+        }
+        const std::size_t trianglesTested = QueryStats::GetTrianglesTested();
+
+        std::vector<double> latencies(points.size());
+        for(std::size_t i = 0; i < points.size(); ++i)
+        {
+            latencies[i] = std::chrono::duration<double, std::micro>(times[i + 1] - times[i]).count();
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        RunResult result;
+        const double totalSec = std::chrono::duration<double>(times.back() - times.front()).count();
+        result.QueriesPerSec = totalSec > 0.0 ? points.size()/totalSec : 0.0;
+        result.P50Us = Percentile(latencies, 0.5);
+        result.P99Us = Percentile(latencies, 0.99);
+        result.TrianglesPerQuery = double(trianglesTested)/points.size();
+        result.FoundFraction = double(numFound)/points.size();
+        result.MeanDist = numFound != 0 ? sumDist/numFound : 0.0;
+        return result;
+    }
+
+    // Quoted, with the characters JSON does not allow in strings escaped
+    std::string JsonString(const std::string& value)
+    {
+        std::ostringstream stream;
+        stream << '"';
+        for(const char c : value)
+        {
+            if(c == '"' || c == '\\')
+            {
+                stream << '\\' << c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                const char* hex = "0123456789abcdef";
+                stream << "\\u00" << hex[(c >> 4) & 0xf] << hex[c & 0xf];
+            }
+            else
+            {
+                stream << c;
+            }
+        }
+        stream << '"';
+        return stream.str();
+    }
+
+    // JSON has no infinity, unbounded thresholds are written as null
+    std::string JsonNumber(double value)
+    {
+        if(!std::isfinite(value))
+        {
+            return "null";
+        }
+        std::ostringstream stream;
+        stream.precision(6);
+        stream << value;
+        return stream.str();
+    }
+}
+
+// Times the closest point queries of every method over several meshes, point distributions
+// and thresholds, and writes a JSON report for comparing builds. Triangles tested per query
+// are only reported if the library was built with RABBIT_QUERY_STATS, which in turn makes
+// the queries a little slower.
+int main(int argc, char* argv[])
+{
+    if(argc == 2 && std::string(argv[1]) == "--help")
+    {
+        cout << USAGE;
+        return 0;
+    }
+
+    try
+    {
+        const Options options = ParseOptions(argc, argv);
+        if(options.NumQueries == 0)
+        {
+            throw std::runtime_error("At least one query per run is needed");
+        }
+
+        std::ofstream file;
+        if(!options.OutputFile.empty())
+        {
+            file.open(options.OutputFile);
+            if(!file)
+            {
+                throw std::runtime_error("Can not write " + options.OutputFile);
+            }
+        }
+        std::ostream& out = options.OutputFile.empty() ? cout : file;
+
+        std::shared_ptr<IMeshBuildingPolicy<Triangle<Vec3>>> policy;
+        const std::string& meshFile = options.MeshFile;
+        if(meshFile.size() > 5 && meshFile.compare(meshFile.size() - 5, 5, ".mesh") == 0)
+        {
+            policy = std::make_shared<MappedMeshBuildingPolicy>(meshFile);
+        }
+        else
+        {
+            policy = std::make_shared<TriangularMeshBuilingPolicy>(meshFile);
+        }
+        const TriMesh original(policy);
+        if(original.GetPolygons().empty())
+        {
+            throw std::runtime_error("No triangles in " + meshFile);
+        }
+
+        out << "{\n";
+        out << "  \"benchmark\": \"ProxQueryBench\",\n";
+        out << "  \"mesh\": " << JsonString(meshFile) << ",\n";
+        out << "  \"queriesPerRun\": " << options.NumQueries << ",\n";
+        out << "  \"seed\": " << options.Seed << ",\n";
+        out << "  \"queryStats\": " << (QueryStats::IsEnabled() ? "true" : "false") << ",\n";
+        out << "  \"meshes\": [";
+
+        std::vector<Triangle<Vec3>> triangles = original.GetPolygons();
+        unsigned level = 0;
+        for(std::size_t m = 0; m < options.Subdivisions.size(); ++m)
+        {
+            for(; level < options.Subdivisions[m]; ++level)
+            {
+                triangles = Subdivide(triangles);
+            }
+            if(level > options.Subdivisions[m])
+            {
+                throw std::runtime_error("Subdivision levels must be increasing");
+            }
+            auto mesh = std::make_shared<TriMesh>(std::make_shared<TriangleListBuildingPolicy>(triangles));
+            const MeshBounds bounds = CalcBounds(triangles);
+
+            std::vector<std::vector<Vec3>> points;
+            for(const std::string& distribution : options.Distributions)
+            {
+                points.push_back(GeneratePoints(distribution, triangles, bounds, options.NumQueries, options.Seed));
+            }
+
+            out << (m == 0 ? "\n" : ",\n");
+            out << "    {\n";
+            out << "      \"subdivisions\": " << level << ",\n";
+            out << "      \"triangles\": " << triangles.size() << ",\n";
+            out << "      \"diagonal\": " << JsonNumber(bounds.Diagonal()) << ",\n";
+            out << "      \"methods\": [";
+
+            for(std::size_t k = 0; k < options.Methods.size(); ++k)
+            {
+                const std::string& name = options.Methods[k];
+                cerr << "Mesh of " << triangles.size() << " triangles, " << name << endl;
+
+                const Clock::time_point start = Clock::now();
+                std::unique_ptr<BenchMethod> method = CreateMethod(name, mesh);
+                const double buildMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+                out << (k == 0 ? "\n" : ",\n");
+                out << "        {\n";
+                out << "          \"name\": " << JsonString(name) << ",\n";
+                out << "          \"buildTimeMs\": " << JsonNumber(buildMs) << ",\n";
+                out << "          \"runs\": [";
+                bool firstRun = true;
+                for(std::size_t d = 0; d < options.Distributions.size(); ++d)
+                {
+                    for(const double threshold : options.Thresholds)
+                    {
+                        const RunResult r = Run(*method, points[d], threshold*bounds.Diagonal());
+                        out << (firstRun ? "\n" : ",\n");
+                        out << "            {\"distribution\": " << JsonString(options.Distributions[d])
+                            << ", \"threshold\": " << JsonNumber(threshold)
+                            << ", \"queriesPerSec\": " << JsonNumber(r.QueriesPerSec)
+                            << ", \"p50Us\": " << JsonNumber(r.P50Us)
+                            << ", \"p99Us\": " << JsonNumber(r.P99Us)
+                            << ", \"trianglesPerQuery\": " << (QueryStats::IsEnabled() ? JsonNumber(r.TrianglesPerQuery) : "null")
+                            << ", \"foundFraction\": " << JsonNumber(r.FoundFraction)
+                            << ", \"meanDist\": " << JsonNumber(r.MeanDist) << "}";
+                        firstRun = false;
+                    }
+                }
+                out << "\n          ]\n";
+                out << "        }";
+            }
+            out << "\n      ]\n";
+            out << "    }";
+        }
+        out << "\n  ]\n";
+        out << "}\n";
+    }
+    catch(const std::exception& e)
+    {
+        cerr << e.what() << endl << USAGE;
+        return 1;
+    }
+    return 0;
+}
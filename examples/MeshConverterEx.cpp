@@ -0,0 +1,56 @@
+#include <BinaryMeshFormat.h>
+#include <MappedMeshBuildingPolicy.h>
+#include <TriangularMeshBuildingPolicy.h>
+#include <Mesh.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+using namespace std;
+using namespace rabbit;
+
+namespace
+{
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+    typedef std::chrono::steady_clock Clock;
+
+    double MillisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+}
+
+// Converts a text mesh to the binary format and compares how long the two take to load.
+// Usage: MeshConverterEx [text mesh file] [binary mesh file]
+int main(int argc, char* argv[])
+{
+    const std::string textFileName = argc > 1 ? argv[1] : "rabbit.triangles";
+    const std::string binaryFileName = argc > 2 ? argv[2] : "rabbit.mesh";
+
+    try
+    {
+        Clock::time_point start = Clock::now();
+        ConvertTextMeshToBinary(textFileName, binaryFileName);
+        cout << "Converted " << textFileName << " to " << binaryFileName
+             << " in " << MillisecondsSince(start) << " ms" << endl;
+
+        start = Clock::now();
+        TriMesh textMesh(std::make_shared<TriangularMeshBuilingPolicy>(textFileName));
+        cout << "Loaded " << textMesh.GetPolygons().size() << " triangles from text in "
+             << MillisecondsSince(start) << " ms" << endl;
+
+        start = Clock::now();
+        auto mappedPolicy = std::make_shared<MappedMeshBuildingPolicy>(binaryFileName);
+        cout << "Mapped " << mappedPolicy->GetNumTriangles() << " triangles in "
+             << MillisecondsSince(start) << " ms" << endl;
+
+        start = Clock::now();
+        TriMesh binaryMesh(mappedPolicy);
+        cout << "Built a mesh from the mapped file in " << MillisecondsSince(start) << " ms" << endl;
+    }
+    catch(const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -6,6 +6,10 @@
 #include <TriangularMeshBuildingPolicy.h>
 #include <TriMeshProxQueryV1.h>
 #include <TriMeshProxQueryV2.h>
+#include <TriMeshProxQueryV3.h>
+#include <TriMeshProxQueryV4.h>
+#include <TriMeshProxQueryV5.h>
+#include <TriMeshProxQueryV6.h>
 using namespace std;
 using namespace rabbit;
 
@@ -27,6 +31,10 @@ int main()
     std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
     TriMeshProxQueryV1 proximityQueriesV1(mesh);
     TriMeshProxQueryV2 proximityQueriesV2(mesh);
+    TriMeshProxQueryV3 proximityQueriesV3(mesh);
+    TriMeshProxQueryV4 proximityQueriesV4(mesh);
+    TriMeshProxQueryV5 proximityQueriesV5(mesh);
+    TriMeshProxQueryV6 proximityQueriesV6(mesh);
     Vec3 point;
     double dist;
     bool foundPoint;
@@ -45,5 +53,21 @@ int main()
     std::tie(point, dist, foundPoint) = proximityQueriesV2.CalculateClosestPoint(testPoint, 0.6);
     cout<<"Calculated Dist using V2:"<<dist<<endl;
 
+    // And using the bounding volume hierarchy
+    std::tie(point, dist, foundPoint) = proximityQueriesV3.CalculateClosestPoint(testPoint, 0.6);
+    cout<<"Calculated Dist using V3:"<<dist<<endl;
+
+    // Same hierarchy, flattened into a contiguous array
+    std::tie(point, dist, foundPoint) = proximityQueriesV4.CalculateClosestPoint(testPoint, 0.6);
+    cout<<"Calculated Dist using V4:"<<dist<<endl;
+
+    // And using a uniform grid instead of a hierarchy
+    std::tie(point, dist, foundPoint) = proximityQueriesV5.CalculateClosestPoint(testPoint, 0.6);
+    cout<<"Calculated Dist using V5:"<<dist<<endl;
+
+    // And using a hierarchy which triangles can be added to and removed from
+    std::tie(point, dist, foundPoint) = proximityQueriesV6.CalculateClosestPoint(testPoint, 0.6);
+    cout<<"Calculated Dist using V6:"<<dist<<endl;
+
 
 }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Mesh.h"
+#include "RigidTransform.h"
+#include "Triangle.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "Vec3.h"
+#include <ctime>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace rabbit
+{
+/**
+* Meshes and random geometry shared by the tests
+*/
+namespace test
+{
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const double PI = 3.14159265358979323846;
+
+    inline std::shared_ptr<TriMesh> GetMesh()
+    {
+        return std::make_shared<TriMesh>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    }
+
+    /**
+    * @return Random number in [-1, 1). Seeded with the time, so each run checks other cases.
+    */
+    inline double RandomReal()
+    {
+        static std::mt19937 generator(static_cast<std::mt19937::result_type>(std::time(0)));
+        return std::uniform_real_distribution<double>(-1.0, 1.0)(generator);
+    }
+
+    inline Vec3 RandomPoint(double scale)
+    {
+        const double x = RandomReal();
+        const double y = RandomReal();
+        return Vec3(scale*x, scale*y, scale*RandomReal());
+    }
+
+    /**
+    * @return Rotation about a random axis followed by a translation by distance in a random direction
+    */
+    inline RigidTransform RandomTransform(double distance)
+    {
+        return RigidTransform::FromAxisAngle(RandomPoint(1.0), PI*RandomReal(), RandomPoint(1.0).normalise()*distance);
+    }
+}
+}
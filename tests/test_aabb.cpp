@@ -1,5 +1,7 @@
 #include <vector>
 #include <iostream>
+#include <random>
+#include <functional>
 #include <AABB.h>
 #include <Mesh.h>
 #include <TriangularMeshBuildingPolicy.h>
@@ -0,0 +1,85 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include "AABB.h"
+#include "AABBSoA.h"
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV2.h"
+#define BOOST_TEST_MODULE Test_AABBSoA
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(0.0,1), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const double TOLERANCE = 1e-8; ///< TriMeshProxQueryV2 uses TriangleSoA, see its documentation
+}
+
+BOOST_AUTO_TEST_CASE(TestAABBSoA_CullBlock)
+{
+    // 150 boxes, so that the last block is only partially filled
+    std::vector<AABB<Vec3>> aabbs;
+    AABBSoA soa;
+    for(unsigned i = 0; i < 150; ++i)
+    {
+        Vec3 center(real_rand(),real_rand(),real_rand());
+        Vec3 halfExtents(real_rand()*0.1,real_rand()*0.1,real_rand()*0.1);
+        aabbs.emplace_back(center, halfExtents);
+        soa.PushBack(aabbs.back().GetBounds());
+    }
+    BOOST_CHECK(soa.Size() == aabbs.size());
+
+    for(unsigned iter = 0; iter < 100; ++iter)
+    {
+        const Vec3 point(real_rand()*2.0 - 0.5, real_rand()*2.0 - 0.5, real_rand()*2.0 - 0.5);
+        const double maxDist = real_rand()*0.5;
+        for(std::size_t first = 0; first < soa.Size(); first += AABBSoA::BLOCK_SIZE)
+        {
+            const std::size_t count = std::min(AABBSoA::BLOCK_SIZE, soa.Size() - first);
+            const uint64_t mask = soa.CullBlock(point, maxDist*maxDist, first, count);
+            for(std::size_t i = 0; i < AABBSoA::BLOCK_SIZE; ++i)
+            {
+                const bool passed = ((mask >> i) & 1) != 0;
+                if(i >= count)
+                {
+                    BOOST_CHECK(!passed);
+                    continue;
+                }
+
+                const double dist = aabbs[first + i].CalcShortestDistanceFrom(point).Dist;
+                const double distSq = soa.CalcShortestDistanceSqFrom(first + i, point);
+                BOOST_CHECK(std::abs(std::sqrt(distSq) - dist) < EPSILON);
+                BOOST_CHECK(passed == (distSq < maxDist*maxDist));
+            }
+        }
+
+        // An infinite threshold passes everything
+        const uint64_t all = soa.CullBlock(point, std::numeric_limits<double>::infinity(), 0, 10);
+        BOOST_CHECK(all == (uint64_t(1) << 10) - 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestAABBSoA_SameAsV1)
+{
+    // TriMeshProxQueryV2 culls with AABBSoA, results must not change
+    auto mesh = std::make_shared<Mesh<Triangle<Vec3>>>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+    TriMeshProxQueryV2 proximityQueriesV2(mesh);
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        const Vec3 testPoint(real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0);
+        const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+        auto resV1 = proximityQueriesV1.CalculateClosestPoint(testPoint, threshold);
+        auto resV2 = proximityQueriesV2.CalculateClosestPoint(testPoint, threshold);
+        BOOST_CHECK(std::get<2>(resV1) == std::get<2>(resV2));
+        BOOST_CHECK(std::abs(std::get<1>(resV1) - std::get<1>(resV2)) < TOLERANCE);
+        BOOST_CHECK(std::get<0>(resV1).isSameAs(std::get<0>(resV2), TOLERANCE));
+    }
+}
@@ -0,0 +1,112 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include "Mesh.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV2.h"
+#include "TriMeshProxQueryV3.h"
+#include "TriMeshProxQueryV4.h"
+#include "TriMeshProxQueryV5.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_BatchQueries
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_POINTS = 100;  ///< Number of points in a batch
+
+    /**
+    * Runs a batch of queries with a per point threshold and checks them against
+    * answering the points one at a time.
+    */
+    template<typename ProximityQueryMethod>
+    void CheckBatchAgainstSingleQueries(ProximityQueryMethod& method, const std::vector<Triangle<Vec3>>& triangles)
+    {
+        std::vector<Vec3> points(NUM_POINTS);
+        std::vector<double> thresholds(NUM_POINTS);
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            points[i] = Vec3(RandomReal(), RandomReal(), RandomReal());
+            thresholds[i] = (i % 3 == 0) ? std::numeric_limits<double>::max() : 0.05 + 0.1*(i % 5);
+        }
+
+        std::vector<Vec3> closestPoints(NUM_POINTS);
+        std::vector<double> distances(NUM_POINTS);
+        std::unique_ptr<bool[]> foundPoints(new bool[NUM_POINTS]);
+        std::vector<int> triIndices(NUM_POINTS);
+        ClosestPointBatchResults<Vec3> results(closestPoints.data(), distances.data(),
+                                               foundPoints.get(), triIndices.data());
+        method.CalculateClosestPoints(points.data(), points.size(), thresholds.data(), results);
+
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            Vec3 point;
+            double dist;
+            bool foundPoint;
+            std::tie(point, dist, foundPoint) = method.CalculateClosestPoint(points[i], thresholds[i]);
+            BOOST_CHECK(foundPoints[i] == foundPoint);
+            BOOST_CHECK(distances[i] == dist);
+            BOOST_CHECK(foundPoint == (triIndices[i] >= 0));
+            if(foundPoint)
+            {
+                BOOST_CHECK(closestPoints[i].isSameAs(point));
+
+                // The reported triangle must actually be at the reported distance
+                const auto res = triangles[triIndices[i]].CalcShortestDistanceFrom(points[i], thresholds[i]);
+                BOOST_CHECK(std::abs(res.Dist - dist) < EPSILON);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBatchQueries_PerPointThreshold)
+{
+    std::shared_ptr<TriMesh> mesh = GetMesh();
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+    TriMeshProxQueryV2 proximityQueriesV2(mesh);
+    TriMeshProxQueryV3 proximityQueriesV3(mesh);
+    TriMeshProxQueryV4 proximityQueriesV4(mesh);
+    TriMeshProxQueryV5 proximityQueriesV5(mesh);
+
+    CheckBatchAgainstSingleQueries(proximityQueriesV1, mesh->GetPolygons());
+    CheckBatchAgainstSingleQueries(proximityQueriesV2, mesh->GetPolygons());
+    CheckBatchAgainstSingleQueries(proximityQueriesV3, mesh->GetPolygons());
+    CheckBatchAgainstSingleQueries(proximityQueriesV4, mesh->GetPolygons());
+    CheckBatchAgainstSingleQueries(proximityQueriesV5, mesh->GetPolygons());
+}
+
+BOOST_AUTO_TEST_CASE(TestBatchQueries_SharedThreshold)
+{
+    std::shared_ptr<TriMesh> mesh = GetMesh();
+    TriMeshProxQueryV3 proximityQueries(mesh);
+
+    // Same reference point as used for testing the proximity query methods
+    const Vec3 testPoint = Vec3(0.5204630973461957,   0.7220916475699011,   0.0396895110889990);
+    const Vec3 expectedClosestPoint = Vec3(0.0693250000000000,   0.5797399900000000,  -0.1722300000000000);
+    const double expectedDist = 0.518362283032093;
+    const std::vector<Vec3> points(3, testPoint);
+
+    // Only ask for the distances and found flags
+    double distances[3];
+    bool foundPoints[3];
+    proximityQueries.CalculateClosestPoints(points.data(), points.size(), 0.5,
+                                            ClosestPointBatchResults<Vec3>(nullptr, distances, foundPoints));
+    BOOST_CHECK(!foundPoints[0] && !foundPoints[1] && !foundPoints[2]);
+
+    Vec3 closestPoints[3];
+    proximityQueries.CalculateClosestPoints(points.data(), points.size(), 0.6,
+                                            ClosestPointBatchResults<Vec3>(closestPoints, distances, foundPoints));
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        BOOST_CHECK(foundPoints[i]);
+        BOOST_CHECK(std::abs(distances[i] - expectedDist) < 0.000000001);
+        BOOST_CHECK(expectedClosestPoint.isSameAs(closestPoints[i]));
+    }
+
+    // An empty batch writes nothing
+    proximityQueries.CalculateClosestPoints(points.data(), 0, 0.6, ClosestPointBatchResults<Vec3>());
+}
@@ -0,0 +1,128 @@
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include "Mesh.h"
+#include "BinaryMeshFormat.h"
+#include "MappedMeshBuildingPolicy.h"
+#include "TriangularMeshBuildingPolicy.h"
+#define BOOST_TEST_MODULE Test_BinaryMesh
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const std::string BINARY_FILE_NAME = "test_binary_mesh.mesh"; ///< Written by the tests
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    bool IsEqual(const Vec3& a, const Vec3& b)
+    {
+        return a.X() == b.X() && a.Y() == b.Y() && a.Z() == b.Z();
+    }
+
+    // Overwrites part of a file
+    void Patch(const std::string& fileName, std::size_t offset, const void* data, std::size_t numBytes)
+    {
+        std::fstream file(fileName.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(offset);
+        file.write(static_cast<const char*>(data), numBytes);
+    }
+
+    template<typename Function>
+    bool Throws(Function f)
+    {
+        try
+        {
+            f();
+        }
+        catch(const std::runtime_error&)
+        {
+            return true;
+        }
+        return false;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryMesh_ConvertText)
+{
+    ConvertTextMeshToBinary(FILE_NAME, BINARY_FILE_NAME);
+    TriMesh textMesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    auto policy = std::make_shared<MappedMeshBuildingPolicy>(BINARY_FILE_NAME);
+    BOOST_CHECK(policy->GetNumTriangles() == NUM_TRIANGLES);
+    BOOST_CHECK(policy->GetNumVertices() == 3*NUM_TRIANGLES);
+    BOOST_CHECK(policy->GetIndices() == nullptr);
+    BOOST_CHECK(policy->GetHeader().Version == BINARY_MESH_VERSION);
+
+    // The binary file holds exactly the same coordinates
+    TriMesh binaryMesh(policy);
+    const std::vector<Triangle<Vec3>>& expected = textMesh.GetPolygons();
+    const std::vector<Triangle<Vec3>>& triangles = binaryMesh.GetPolygons();
+    BOOST_CHECK(triangles.size() == expected.size());
+    for(std::size_t i = 0; i < triangles.size(); ++i)
+    {
+        BOOST_CHECK(IsEqual(triangles[i].P0(), expected[i].P0()));
+        BOOST_CHECK(IsEqual(triangles[i].P1(), expected[i].P1()));
+        BOOST_CHECK(IsEqual(triangles[i].P2(), expected[i].P2()));
+        BOOST_CHECK(IsEqual(triangles[i].Normal(), expected[i].Normal()));
+    }
+
+    // Writing the triangles gives the same file as converting the text
+    WriteBinaryMesh(BINARY_FILE_NAME, expected);
+    MappedMeshBuildingPolicy written(BINARY_FILE_NAME);
+    BOOST_CHECK(std::memcmp(written.GetVertices(), policy->GetVertices(), 9*NUM_TRIANGLES*sizeof(double)) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryMesh_Indexed)
+{
+    // A square made of two triangles sharing an edge
+    const double vertices[] = {0,0,0, 1,0,0, 1,1,0, 0,1,0};
+    const uint32_t indices[] = {0,1,2, 0,2,3};
+    WriteBinaryMesh(BINARY_FILE_NAME, vertices, 4, indices, 2);
+
+    auto policy = std::make_shared<MappedMeshBuildingPolicy>(BINARY_FILE_NAME);
+    BOOST_CHECK(policy->GetNumVertices() == 4);
+    BOOST_CHECK(policy->GetNumTriangles() == 2);
+    BOOST_CHECK(policy->GetIndices() != nullptr);
+    BOOST_CHECK(policy->GetIndices()[5] == 3);
+    BOOST_CHECK(IsEqual(policy->GetVertex(1, two), Vec3(0,1,0)));
+
+    TriMesh mesh(policy);
+    BOOST_CHECK(mesh.GetPolygons().size() == 2);
+    BOOST_CHECK(IsEqual(mesh.GetPolygons()[1].P1(), Vec3(1,1,0)));
+    BOOST_CHECK(mesh.GetPolygons()[0].Normal().isSameAs(Vec3(0,0,1)));
+
+    // An index past the last vertex is rejected when the polygons are generated
+    const uint32_t badIndex = 4;
+    Patch(BINARY_FILE_NAME, policy->GetHeader().IndexOffset, &badIndex, sizeof(badIndex));
+    BOOST_CHECK(Throws([]{TriMesh badMesh(std::make_shared<MappedMeshBuildingPolicy>(BINARY_FILE_NAME));}));
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryMesh_Invalid)
+{
+    BOOST_CHECK(Throws([]{MappedMeshBuildingPolicy policy("no_such_file.mesh");}));
+
+    // A text mesh is not a binary mesh
+    BOOST_CHECK(Throws([]{MappedMeshBuildingPolicy policy(FILE_NAME);}));
+
+    // Unknown version
+    ConvertTextMeshToBinary(FILE_NAME, BINARY_FILE_NAME);
+    const uint32_t version = BINARY_MESH_VERSION + 1;
+    Patch(BINARY_FILE_NAME, offsetof(BinaryMeshHeader, Version), &version, sizeof(version));
+    BOOST_CHECK(Throws([]{MappedMeshBuildingPolicy policy(BINARY_FILE_NAME);}));
+
+    // More triangles than the file holds
+    ConvertTextMeshToBinary(FILE_NAME, BINARY_FILE_NAME);
+    const uint64_t numTriangles = NUM_TRIANGLES + 1;
+    const uint64_t numVertices = 3*numTriangles;
+    Patch(BINARY_FILE_NAME, offsetof(BinaryMeshHeader, NumTriangles), &numTriangles, sizeof(numTriangles));
+    Patch(BINARY_FILE_NAME, offsetof(BinaryMeshHeader, NumVertices), &numVertices, sizeof(numVertices));
+    BOOST_CHECK(Throws([]{MappedMeshBuildingPolicy policy(BINARY_FILE_NAME);}));
+
+    std::remove(BINARY_FILE_NAME.c_str());
+}
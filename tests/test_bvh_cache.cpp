@@ -0,0 +1,199 @@
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <functional>
+#include <cstdio>
+#include <limits>
+#include <system_error>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Mesh.h"
+#include "BVHCache.h"
+#include "CompactTriangleMesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV4.h"
+#define BOOST_TEST_MODULE Test_BVHCache
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const std::string CACHE_DIRECTORY = ".";          ///< Cache files are written next to the tests
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy()
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME);
+    }
+
+    bool IsEqual(const Vec3& a, const Vec3& b)
+    {
+        return a.X() == b.X() && a.Y() == b.Y() && a.Z() == b.Z();
+    }
+
+    uint64_t HashMesh(const CompactTriangleMesh& mesh)
+    {
+        return BVHCache::HashMesh(mesh.GetNumTriangles(), [&mesh](std::size_t i){return mesh.GetTriangle(i);});
+    }
+
+    // Both queries have to give exactly the same results
+    void CheckSameResults(const TriMeshProxQueryV4& expected, const TriMeshProxQueryV4& actual)
+    {
+        for(unsigned i = 0; i < 100; ++i)
+        {
+            const Vec3 testPoint(real_rand(), real_rand(), real_rand());
+            const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+            const ClosestPointResult<Vec3> a = expected.CalculateClosestPointImpl(testPoint, threshold);
+            const ClosestPointResult<Vec3> b = actual.CalculateClosestPointImpl(testPoint, threshold);
+            BOOST_CHECK(a.PolygonIndex == b.PolygonIndex);
+            BOOST_CHECK(a.Dist == b.Dist);
+            BOOST_CHECK(!a.Found() || IsEqual(a.Point, b.Point));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHCache_HashMesh)
+{
+    auto mesh = std::make_shared<TriMesh>(GetMeshBuildingPolicy());
+    CompactTriangleMesh compactMesh(*mesh);
+    const std::vector<Triangle<Vec3>>& triangles = mesh->GetPolygons();
+    const uint64_t hash = BVHCache::HashMesh(triangles.size(), [&triangles](std::size_t i){return triangles[i];});
+    BOOST_CHECK(hash == HashMesh(compactMesh));
+
+    // Moving a single vertex changes the hash
+    CompactTriangleMesh changedMesh;
+    for(std::size_t i = 0; i < compactMesh.GetNumTriangles(); ++i)
+    {
+        const Triangle<Vec3> t = compactMesh.GetTriangle(i);
+        const Vec3 offset = (i == NUM_TRIANGLES/2) ? Vec3(0, 0, 1e-12) : Vec3(0, 0, 0);
+        changedMesh.PushBack(t.P0(), t.P1(), t.P2() + offset);
+    }
+    BOOST_CHECK(hash != HashMesh(changedMesh));
+
+    BVHCache cache(CACHE_DIRECTORY);
+    BOOST_CHECK(cache.GetFileName(hash, BVHBuildParams()) != cache.GetFileName(hash, BVHBuildParams(2)));
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHCache_LoadAndStore)
+{
+    CompactTriangleMesh mesh(GetMeshBuildingPolicy());
+    auto cache = std::make_shared<BVHCache>(CACHE_DIRECTORY);
+    const std::string fileName = cache->GetFileName(HashMesh(mesh), BVHBuildParams());
+    std::remove(fileName.c_str());
+
+    // The first query builds the hierarchy and stores it, the second one reads it back
+    TriMeshProxQueryV4 uncached(mesh);
+    TriMeshProxQueryV4 built(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK(cache->GetNumHits() == 0 && cache->GetNumMisses() == 1);
+    BOOST_CHECK(std::ifstream(fileName.c_str()).good());
+
+    TriMeshProxQueryV4 loaded(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK(cache->GetNumHits() == 1 && cache->GetNumMisses() == 1);
+    BOOST_CHECK(loaded.GetBVH().GetNodes().size() == uncached.GetBVH().GetNodes().size());
+    BOOST_CHECK(loaded.GetBVH().GetTriIndices() == uncached.GetBVH().GetTriIndices());
+    BOOST_CHECK(loaded.GetBVH().GetDepth() == uncached.GetBVH().GetDepth());
+    CheckSameResults(uncached, built);
+    CheckSameResults(uncached, loaded);
+
+    // Other build parameters are cached separately
+    TriMeshProxQueryV4 otherParams(mesh, BVHBuildParams(8), cache);
+    BOOST_CHECK(cache->GetNumHits() == 1 && cache->GetNumMisses() == 2);
+    std::remove(cache->GetFileName(HashMesh(mesh), BVHBuildParams(8)).c_str());
+
+    // A damaged file is a miss and gets replaced
+    {
+        std::fstream file(fileName.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(sizeof(BVHCacheHeader));
+        const LinearBVHNode node = {{0, 0, 0}, {1, 1, 1}, 0, 0};
+        file.write(reinterpret_cast<const char*>(&node), sizeof(node));
+    }
+    TriMeshProxQueryV4 rebuilt(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK(cache->GetNumHits() == 1 && cache->GetNumMisses() == 3);
+    TriMeshProxQueryV4 reloaded(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK(cache->GetNumHits() == 2 && cache->GetNumMisses() == 3);
+    CheckSameResults(uncached, reloaded);
+    std::remove(fileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHCache_Errors)
+{
+    // Store throws, while the queries carry on without the cache file
+    CompactTriangleMesh mesh(GetMeshBuildingPolicy());
+    auto cache = std::make_shared<BVHCache>("no/such/directory");
+    TriMeshProxQueryV4 uncached(mesh);
+    TriMeshProxQueryV4 queries(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK_EQUAL(cache->GetNumMisses(), 1u);
+    BOOST_CHECK_EQUAL(cache->GetNumFailedStores(), 1u);
+    CheckSameResults(uncached, queries);
+    BOOST_CHECK_THROW(cache->Store(HashMesh(mesh), BVHBuildParams(), queries.GetBVH(), queries.GetTriangles()), std::runtime_error);
+    BOOST_CHECK(!cache->TryStore(HashMesh(mesh), BVHBuildParams(), queries.GetBVH(), queries.GetTriangles()));
+    BOOST_CHECK_EQUAL(cache->GetNumFailedStores(), 2u);
+    bool threw;
+
+    // Nodes have to form a hierarchy
+    const LinearBVHNode leaf = {{0, 0, 0}, {1, 1, 1}, 0, 1};
+    const LinearBVHNode interior = {{0, 0, 0}, {1, 1, 1}, 2, 0};
+    LinearBVH valid(std::vector<LinearBVHNode>{interior, leaf, leaf}, std::vector<uint32_t>{0});
+    BOOST_CHECK(valid.GetDepth() == 2);
+    for(const std::vector<LinearBVHNode>& nodes : {std::vector<LinearBVHNode>{interior, leaf},
+                                                   std::vector<LinearBVHNode>{interior, leaf, leaf, leaf},
+                                                   std::vector<LinearBVHNode>{leaf, interior}})
+    {
+        threw = false;
+        try
+        {
+            LinearBVH invalid(nodes, std::vector<uint32_t>{0});
+        }
+        catch(const std::runtime_error&)
+        {
+            threw = true;
+        }
+        BOOST_CHECK(threw);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHCache_Unwritable)
+{
+    CompactTriangleMesh mesh(GetMeshBuildingPolicy());
+    const std::string directory = "bvh_cache_read_only";
+    mkdir(directory.c_str(), 0755);
+    auto cache = std::make_shared<BVHCache>(directory);
+    const std::string fileName = cache->GetFileName(HashMesh(mesh), BVHBuildParams());
+    std::remove(fileName.c_str());
+
+    // Permissions do not keep root out, so the cache file is blocked by a directory of
+    // the same name as well, which the temporary file can not be renamed onto
+    chmod(directory.c_str(), 0555);
+    const bool readOnly = access(directory.c_str(), W_OK) != 0;
+    if(!readOnly)
+    {
+        mkdir(fileName.c_str(), 0755);
+        mkdir((fileName + "/blocker").c_str(), 0755);
+    }
+
+    TriMeshProxQueryV4 uncached(mesh);
+    TriMeshProxQueryV4 queries(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK_EQUAL(cache->GetNumMisses(), 1u);
+    BOOST_CHECK_EQUAL(cache->GetNumFailedStores(), 1u);
+    CheckSameResults(uncached, queries);
+
+    // The next process misses the cache again
+    TriMeshProxQueryV4 again(mesh, BVHBuildParams(), cache);
+    BOOST_CHECK_EQUAL(cache->GetNumHits(), 0u);
+    BOOST_CHECK_EQUAL(cache->GetNumFailedStores(), 2u);
+    CheckSameResults(uncached, again);
+
+    // No temporary files are left behind, so the directory can be removed
+    chmod(directory.c_str(), 0755);
+    rmdir((fileName + "/blocker").c_str());
+    rmdir(fileName.c_str());
+    BOOST_CHECK_EQUAL(rmdir(directory.c_str()), 0);
+}
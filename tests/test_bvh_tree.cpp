@@ -0,0 +1,97 @@
+#include <vector>
+#include <iostream>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "BVHTree.h"
+#define BOOST_TEST_MODULE Test_BVHTree
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    std::vector<AABB<Vec3>> GetTriangleAABBs()
+    {
+        Mesh<Triangle<Vec3>> mesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+        std::vector<AABB<Vec3>> aabbs;
+        for(const Triangle<Vec3>& t : mesh.GetPolygons())
+        {
+            aabbs.emplace_back(t.CalculateAABB());
+        }
+        return aabbs;
+    }
+
+    // Checks the structure of the subtree under node. Returns the number of triangles under it.
+    unsigned CheckSubtree(const BVHTree::Node* node,
+                          const std::vector<AABB<Vec3>>& aabbs,
+                          unsigned maxTrisPerLeaf,
+                          std::vector<unsigned>& counts)
+    {
+        const Bounds b = node->Data().aabb.GetBounds();
+        if(BVHTree::IsLeaf(node))
+        {
+            const std::vector<int>& indices = node->Data().triIndices;
+            BOOST_CHECK(!indices.empty());
+            BOOST_CHECK(indices.size() <= maxTrisPerLeaf);
+            for(int i : indices)
+            {
+                // The leaf box must enclose the boxes of its triangles
+                const Bounds tb = aabbs[i].GetBounds();
+                BOOST_CHECK(tb.xMin >= b.xMin && tb.xMax <= b.xMax);
+                BOOST_CHECK(tb.yMin >= b.yMin && tb.yMax <= b.yMax);
+                BOOST_CHECK(tb.zMin >= b.zMin && tb.zMax <= b.zMax);
+                ++counts[i];
+            }
+            return static_cast<unsigned>(indices.size());
+        }
+
+        BOOST_CHECK(node->Data().triIndices.empty());
+        BOOST_CHECK(node->GetRight() != nullptr);
+        return CheckSubtree(node->GetLeft(), aabbs, maxTrisPerLeaf, counts) +
+               CheckSubtree(node->GetRight(), aabbs, maxTrisPerLeaf, counts);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHTree_Empty)
+{
+    BVHTree bvh(std::vector<AABB<Vec3>>{});
+    BOOST_CHECK(bvh.GetRoot() == nullptr);
+    BOOST_CHECK(bvh.GetNumNodes() == 0);
+    BOOST_CHECK(bvh.GetSAHCost() == 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHTree_Structure)
+{
+    const std::vector<AABB<Vec3>> aabbs = GetTriangleAABBs();
+    for(BVHSplitMethod method : {BVHSplitMethod::Median, BVHSplitMethod::SAH})
+    {
+        for(unsigned leafSize : {1u, 2u, 8u})
+        {
+            BVHTree bvh(aabbs, BVHBuildParams(leafSize, method));
+            std::vector<unsigned> counts(NUM_TRIANGLES, 0);
+            BOOST_CHECK(CheckSubtree(bvh.GetRoot(), aabbs, leafSize, counts) == NUM_TRIANGLES);
+            BOOST_CHECK(std::all_of(counts.begin(), counts.end(), [](unsigned c){return c == 1;}));
+            BOOST_CHECK(bvh.GetSAHCost() > 0.0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestBVHTree_SAHCost)
+{
+    // The SAH builder should give a cheaper tree than splitting at the median
+    const std::vector<AABB<Vec3>> aabbs = GetTriangleAABBs();
+    for(unsigned numBins : {4u, 16u, 32u})
+    {
+        BVHTree median(aabbs, BVHBuildParams(4, BVHSplitMethod::Median, numBins));
+        BVHTree sah(aabbs, BVHBuildParams(4, BVHSplitMethod::SAH, numBins));
+        BOOST_CHECK(sah.GetSAHCost() < median.GetSAHCost());
+    }
+
+    // Making triangle tests more expensive relative to traversal should not give bigger leaves
+    BVHTree cheapTris(aabbs, BVHBuildParams(8, BVHSplitMethod::SAH, 16, 1.0, 0.1));
+    BVHTree expensiveTris(aabbs, BVHBuildParams(8, BVHSplitMethod::SAH, 16, 1.0, 10.0));
+    BOOST_CHECK(expensiveTris.GetNumNodes() >= cheapTris.GetNumNodes());
+}
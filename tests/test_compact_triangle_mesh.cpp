@@ -0,0 +1,182 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include <cstdio>
+#include <stdexcept>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "BinaryMeshFormat.h"
+#include "MappedMeshBuildingPolicy.h"
+#include "ThreadPool.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV2.h"
+#include "TriMeshProxQueryV4.h"
+#define BOOST_TEST_MODULE Test_CompactTriangleMesh
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const double FLOAT_TOLERANCE = 1e-6;    ///< Coordinates of the mesh rounded to float are this close
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy()
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME);
+    }
+
+    bool IsEqual(const Vec3& a, const Vec3& b)
+    {
+        return a.X() == b.X() && a.Y() == b.Y() && a.Z() == b.Z();
+    }
+
+    // Only hands out the triangles of a mesh one at a time
+    class VisitOnlyPolicy : public IMeshBuildingPolicy<Triangle<Vec3>>
+    {
+    public:
+        explicit VisitOnlyPolicy(const TriMesh& mesh):m_mesh(mesh){}
+
+        virtual void GeneratePolygons(std::vector<Triangle<Vec3>>&) override
+        {
+            throw std::runtime_error("Not supported");
+        }
+
+        virtual void VisitPolygons(const std::function<void(const Triangle<Vec3>&)>& visitor) override
+        {
+            for(const Triangle<Vec3>& t : m_mesh.GetPolygons())
+            {
+                visitor(t);
+            }
+        }
+
+    private:
+        const TriMesh& m_mesh;
+    };
+
+    bool IsSameMesh(const TriMesh& expected, const CompactTriangleMesh& mesh)
+    {
+        if(mesh.GetNumTriangles() != expected.GetPolygons().size())
+        {
+            return false;
+        }
+        for(std::size_t i = 0; i < mesh.GetNumTriangles(); ++i)
+        {
+            const Triangle<Vec3>& t = expected.GetPolygons()[i];
+            if(!IsEqual(mesh.GetVertex(i, zero), t.P0()) || !IsEqual(mesh.GetVertex(i, one), t.P1()) ||
+               !IsEqual(mesh.GetVertex(i, two), t.P2()))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactTriangleMesh_CTor)
+{
+    TriMesh mesh(GetMeshBuildingPolicy());
+    CompactTriangleMesh compactMesh(GetMeshBuildingPolicy());
+    CompactTriangleMesh floatMesh(mesh, VertexPrecision::Float);
+    BOOST_CHECK(compactMesh.GetNumTriangles() == NUM_TRIANGLES);
+    BOOST_CHECK(floatMesh.GetNumTriangles() == NUM_TRIANGLES);
+    BOOST_CHECK(compactMesh.GetPrecision() == VertexPrecision::Double);
+    BOOST_CHECK(floatMesh.GetPrecision() == VertexPrecision::Float);
+    BOOST_CHECK(compactMesh.GetMemoryUsage() == NUM_TRIANGLES*9*sizeof(double));
+    BOOST_CHECK(floatMesh.GetMemoryUsage() == NUM_TRIANGLES*9*sizeof(float));
+
+    // An empty mesh filled by hand
+    CompactTriangleMesh handMade;
+    handMade.PushBack(Vec3(0,0,0), Vec3(1,0,0), Vec3(0,1,0));
+    BOOST_CHECK(handMade.GetNumTriangles() == 1);
+    BOOST_CHECK(handMade.GetTriangle(0).Normal().isSameAs(Vec3(0,0,1)));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactTriangleMesh_BuildingPolicies)
+{
+    // Every policy gives the same triangles, none of them building all of them at once
+    TriMesh mesh(GetMeshBuildingPolicy());
+    BOOST_CHECK(IsSameMesh(mesh, CompactTriangleMesh(GetMeshBuildingPolicy())));
+    BOOST_CHECK(IsSameMesh(mesh, CompactTriangleMesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME, std::make_shared<ThreadPool>(2)))));
+    BOOST_CHECK(IsSameMesh(mesh, CompactTriangleMesh(std::make_shared<VisitOnlyPolicy>(mesh))));
+
+    const std::string binaryFileName = "compact_triangle_mesh.bin";
+    WriteBinaryMesh(binaryFileName, mesh.GetPolygons());
+    {
+        BOOST_CHECK(IsSameMesh(mesh, CompactTriangleMesh(std::make_shared<MappedMeshBuildingPolicy>(binaryFileName))));
+        CompactTriangleMesh floatMesh(std::make_shared<MappedMeshBuildingPolicy>(binaryFileName), VertexPrecision::Float);
+        BOOST_CHECK_EQUAL(floatMesh.GetMemoryUsage(), NUM_TRIANGLES*9*sizeof(float));
+    }
+    std::remove(binaryFileName.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactTriangleMesh_GetTriangle)
+{
+    TriMesh mesh(GetMeshBuildingPolicy());
+    CompactTriangleMesh compactMesh(mesh);
+    CompactTriangleMesh floatMesh(mesh, VertexPrecision::Float);
+    const std::vector<Triangle<Vec3>>& triangles = mesh.GetPolygons();
+    for(std::size_t i = 0; i < triangles.size(); ++i)
+    {
+        // In double precision the triangles are rebuilt exactly
+        const Triangle<Vec3>& expected = triangles[i];
+        const Triangle<Vec3> t = compactMesh.GetTriangle(i);
+        BOOST_CHECK(IsEqual(t.P0(), expected.P0()));
+        BOOST_CHECK(IsEqual(t.P1(), expected.P1()));
+        BOOST_CHECK(IsEqual(t.P2(), expected.P2()));
+        BOOST_CHECK(IsEqual(t.P1P2(), expected.P1P2()));
+        BOOST_CHECK(IsEqual(t.Normal(), expected.Normal()));
+
+        const AABB<Vec3> aabb = compactMesh.CalculateAABB(i);
+        BOOST_CHECK(aabb.Center().isSameAs(expected.CalculateAABB().Center()));
+        BOOST_CHECK(aabb.HalfExtents().isSameAs(expected.CalculateAABB().HalfExtents()));
+
+        const Triangle<Vec3> f = floatMesh.GetTriangle(i);
+        BOOST_CHECK(f.P0().isSameAs(expected.P0(), FLOAT_TOLERANCE));
+        BOOST_CHECK(f.P1().isSameAs(expected.P1(), FLOAT_TOLERANCE));
+        BOOST_CHECK(f.P2().isSameAs(expected.P2(), FLOAT_TOLERANCE));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestCompactTriangleMesh_ProximityQueries)
+{
+    auto mesh = std::make_shared<TriMesh>(GetMeshBuildingPolicy());
+    auto compactMesh = std::make_shared<const CompactTriangleMesh>(*mesh);
+    TriMeshProxQueryV1 queriesV1(mesh);
+    TriMeshProxQueryV1 compactV1(compactMesh);
+    TriMeshProxQueryV2 compactV2(*compactMesh);
+    TriMeshProxQueryV4 compactV4(*compactMesh);
+
+    // Everything the compact queries need was copied while preprocessing
+    CompactTriangleMesh floatMesh(*mesh, VertexPrecision::Float);
+    TriMeshProxQueryV4 floatV4(floatMesh);
+
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        const Vec3 testPoint(real_rand(), real_rand(), real_rand());
+        const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+        auto expected = queriesV1.CalculateClosestPoint(testPoint, threshold);
+        auto resV1 = compactV1.CalculateClosestPoint(testPoint, threshold);
+        auto resV2 = compactV2.CalculateClosestPoint(testPoint, threshold);
+        auto resV4 = compactV4.CalculateClosestPoint(testPoint, threshold);
+        BOOST_CHECK(std::get<2>(expected) == std::get<2>(resV1));
+        BOOST_CHECK(std::get<1>(expected) == std::get<1>(resV1));
+        BOOST_CHECK(std::abs(std::get<1>(expected) - std::get<1>(resV2)) < 1e-8);
+        BOOST_CHECK(std::abs(std::get<1>(expected) - std::get<1>(resV4)) < 1e-8);
+
+        if(i % 2 == 0)
+        {
+            auto resFloat = floatV4.CalculateClosestPoint(testPoint, threshold);
+            BOOST_CHECK(std::abs(std::get<1>(expected) - std::get<1>(resFloat)) < FLOAT_TOLERANCE);
+        }
+    }
+}
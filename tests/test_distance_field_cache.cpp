@@ -0,0 +1,150 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <cmath>
+#include <stdexcept>
+#include "Mesh.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV4.h"
+#include "DistanceFieldCache.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_DistanceFieldCache
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_POINTS = 5000; ///< Number of random points checked
+    const double VOXEL_SIZE = 0.01;   ///< Spacing of the samples, about a tenth of the rabbit
+    const double MAX_DIST = 0.5;      ///< Distance up to which samples are calculated
+
+    double ExactDistance(const TriMeshProxQueryV4& query, const Vec3& point)
+    {
+        return query.CalculateClosestPointImpl(point, MAX_DIST).Dist;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestDistanceFieldCache_WithinErrorBound)
+{
+    TriMeshProxQueryV4 query(GetMesh());
+    DistanceFieldCache<TriMeshProxQueryV4> cache(query, DistanceFieldParams(VOXEL_SIZE, MAX_DIST));
+    BOOST_CHECK_CLOSE(cache.GetMaxErrorBound(), 0.5*sqrt(3.0)*VOXEL_SIZE, 1e-9);
+
+    // Points in a small region, so that most of them land in bricks calculated before
+    auto checkPoints = [&](double maxError)
+    {
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            const Vec3 point(0.1*RandomReal(), 0.1*RandomReal(), 0.1*RandomReal());
+            const double dist = cache.CalculateDistance(point, maxError);
+            BOOST_CHECK_SMALL(dist - ExactDistance(query, point), maxError + 1e-12);
+        }
+    };
+
+    // With the largest error bound, every point is interpolated
+    checkPoints(cache.GetMaxErrorBound());
+    const DistanceFieldStats& stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.NumQueries, NUM_POINTS);
+    BOOST_CHECK_EQUAL(stats.GetNumExact(), 0u);
+    BOOST_CHECK(stats.GetHitRate() > 0.5);
+    BOOST_CHECK_EQUAL(stats.NumMisses, cache.GetNumBricks());
+    BOOST_CHECK_EQUAL(stats.NumBricksEvicted, 0u);
+
+    // With a smaller one, points far from the samples are answered exactly
+    checkPoints(0.25*VOXEL_SIZE);
+    BOOST_CHECK_EQUAL(stats.NumQueries, 2*NUM_POINTS);
+    BOOST_CHECK(stats.GetNumExact() > 0u);
+    BOOST_CHECK_EQUAL(cache.GetMemoryUsage(), cache.GetNumBricks()*8*8*8*sizeof(double));
+}
+
+BOOST_AUTO_TEST_CASE(TestDistanceFieldCache_HitsAndMisses)
+{
+    TriMeshProxQueryV4 query(GetMesh());
+    DistanceFieldCache<TriMeshProxQueryV4> cache(query, DistanceFieldParams(VOXEL_SIZE, MAX_DIST, 4));
+
+    // The first query in a brick calculates it, the next ones reuse it
+    const Vec3 point(0.0151, 0.0152, 0.0153);
+    const double first = cache.CalculateDistance(point, VOXEL_SIZE);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumMisses, 1u);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumHits, 0u);
+    BOOST_CHECK_EQUAL(cache.CalculateDistance(point, VOXEL_SIZE), first);
+    BOOST_CHECK(cache.CalculateDistance(Vec3(0.0201, 0.0202, 0.0203), VOXEL_SIZE) >= 0.0);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumMisses, 1u);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumHits, 2u);
+    BOOST_CHECK_EQUAL(cache.GetNumBricks(), 1u);
+
+    // Errors tighter than the bound of the point are answered exactly
+    BOOST_CHECK_EQUAL(cache.CalculateDistance(point, 1e-6), ExactDistance(query, point));
+    BOOST_CHECK_EQUAL(cache.GetStats().GetNumExact(), 1u);
+
+    // Samples sit on the grid, so points on them are interpolated exactly with any error
+    const Vec3 sample(0.02, 0.03, 0.01);
+    BOOST_CHECK_SMALL(cache.CalculateDistance(sample, 1e-6) - ExactDistance(query, sample), 1e-12);
+
+    // Further away than MaxDist, nothing is interpolated
+    BOOST_CHECK_EQUAL(cache.CalculateDistance(Vec3(5.0, 5.0, 5.0), 1.0), MAX_DIST);
+
+    cache.ResetStats();
+    BOOST_CHECK_EQUAL(cache.GetStats().NumQueries, 0u);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetNumBricks(), 0u);
+    BOOST_CHECK_EQUAL(cache.GetMemoryUsage(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestDistanceFieldCache_Eviction)
+{
+    TriMeshProxQueryV4 query(GetMesh());
+    const unsigned brickSize = 4;
+    const std::size_t brickMemory = brickSize*brickSize*brickSize*sizeof(double);
+    DistanceFieldCache<TriMeshProxQueryV4> cache(query, DistanceFieldParams(VOXEL_SIZE, MAX_DIST, brickSize, 3*brickMemory));
+
+    // Bricks cover 3 cells along each axis
+    const double brickLength = 3*VOXEL_SIZE;
+    auto inBrick = [brickLength](unsigned i){return Vec3((i + 0.5)*brickLength, 0.5*brickLength, 0.5*brickLength);};
+    for(unsigned i = 0; i < 3; ++i)
+    {
+        cache.CalculateDistance(inBrick(i), VOXEL_SIZE);
+    }
+    BOOST_CHECK_EQUAL(cache.GetNumBricks(), 3u);
+
+    // Touch brick 0, so that brick 1 is the least recently used one
+    cache.CalculateDistance(inBrick(0), VOXEL_SIZE);
+    cache.CalculateDistance(inBrick(3), VOXEL_SIZE);
+    BOOST_CHECK_EQUAL(cache.GetNumBricks(), 3u);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumBricksEvicted, 1u);
+    BOOST_CHECK(cache.GetMemoryUsage() <= 3*brickMemory);
+
+    const std::size_t misses = cache.GetStats().NumMisses;
+    cache.CalculateDistance(inBrick(0), VOXEL_SIZE);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumMisses, misses);
+    cache.CalculateDistance(inBrick(1), VOXEL_SIZE);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumMisses, misses + 1);
+    BOOST_CHECK_EQUAL(cache.GetStats().NumBricksEvicted, 2u);
+
+    // A cap below a single brick disables the cache
+    DistanceFieldCache<TriMeshProxQueryV4> tiny(query, DistanceFieldParams(VOXEL_SIZE, MAX_DIST, brickSize, brickMemory - 1));
+    BOOST_CHECK_EQUAL(tiny.CalculateDistance(inBrick(0), VOXEL_SIZE), ExactDistance(query, inBrick(0)));
+    BOOST_CHECK_EQUAL(tiny.GetNumBricks(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestDistanceFieldCache_AnyQueryMethod)
+{
+    // Negative coordinates and another query method
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 queryV1(mesh);
+    TriMeshProxQueryV4 queryV4(mesh);
+    DistanceFieldCache<TriMeshProxQueryV1> cache(queryV1, DistanceFieldParams(0.02, MAX_DIST, 5));
+    for(unsigned i = 0; i < NUM_POINTS/10; ++i)
+    {
+        const Vec3 point(0.1*RandomReal(), 0.1*RandomReal(), 0.1*RandomReal());
+        BOOST_CHECK_SMALL(cache.CalculateDistance(point, cache.GetMaxErrorBound()) - ExactDistance(queryV4, point),
+                          cache.GetMaxErrorBound() + 1e-9);
+    }
+    BOOST_CHECK(cache.GetStats().NumHits > 0u);
+
+    BOOST_CHECK_THROW(DistanceFieldCache<TriMeshProxQueryV4>(queryV4, DistanceFieldParams(0.0, MAX_DIST)), std::runtime_error);
+    BOOST_CHECK_THROW(DistanceFieldCache<TriMeshProxQueryV4>(queryV4, DistanceFieldParams(VOXEL_SIZE, MAX_DIST, 1)), std::runtime_error);
+}
@@ -0,0 +1,248 @@
+#include <vector>
+#include <map>
+#include <random>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV6.h"
+#define BOOST_TEST_MODULE Test_DynamicAABBTree
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const double TOLERANCE = 1e-12;
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    Vec3 RandomPoint(double scale)
+    {
+        return Vec3(scale*real_rand(), scale*real_rand(), scale*real_rand());
+    }
+
+    // Small triangle somewhere in the unit cube
+    Triangle<Vec3> RandomTriangle()
+    {
+        const Vec3 center = RandomPoint(1.0);
+        return Triangle<Vec3>(center + RandomPoint(0.05), center + RandomPoint(0.05), center + RandomPoint(0.05));
+    }
+
+    bool Contains(const Bounds& outer, const Bounds& inner)
+    {
+        return outer.xMin <= inner.xMin && inner.xMax <= outer.xMax &&
+               outer.yMin <= inner.yMin && inner.yMax <= outer.yMax &&
+               outer.zMin <= inner.zMin && inner.zMax <= outer.zMax;
+    }
+
+    // Compares the queries with checking every triangle that is left
+    void CheckSameAsBruteForce(const TriMeshProxQueryV6& query, const std::map<int, Triangle<Vec3>>& triangles)
+    {
+        BOOST_REQUIRE_EQUAL(query.GetNumTriangles(), triangles.size());
+        for(unsigned i = 0; i < 100; ++i)
+        {
+            const Vec3 testPoint = RandomPoint(1.5);
+            const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+
+            double expectedDist = threshold;
+            for(const auto& t : triangles)
+            {
+                expectedDist = std::min(expectedDist, t.second.CalcShortestDistanceFrom(testPoint, expectedDist).Dist);
+            }
+
+            const ClosestPointResult<Vec3> res = query.CalculateClosestPointImpl(testPoint, threshold);
+            BOOST_CHECK_EQUAL(res.Found(), expectedDist < threshold);
+            BOOST_CHECK_SMALL(res.Dist - expectedDist, TOLERANCE);
+            if(res.Found())
+            {
+                BOOST_REQUIRE(triangles.count(res.PolygonIndex) == 1);
+                const Triangle<Vec3>& t = triangles.at(res.PolygonIndex);
+                BOOST_CHECK_SMALL(t.CalcShortestDistanceFrom(testPoint, threshold).Dist - res.Dist, TOLERANCE);
+            }
+        }
+    }
+
+    // The tree stays of logarithmic height, about 1.3*log2(n) for these sets
+    void CheckHeight(const DynamicAABBTree& tree)
+    {
+        const double n = static_cast<double>(tree.GetNumProxies());
+        BOOST_CHECK(tree.GetHeight() <= 2 + 1.6*std::log2(std::max(n, 1.0)));
+        BOOST_CHECK(tree.GetMaxBalance() < tree.GetHeight() || n == 0.0);
+        BOOST_CHECK(tree.GetAreaRatio() >= 1.0 || n == 0.0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestDynamicAABBTree_Tree)
+{
+    DynamicAABBTree tree;
+    BOOST_CHECK_EQUAL(tree.GetHeight(), 0);
+    BOOST_CHECK_EQUAL(tree.GetNumProxies(), 0u);
+
+    std::vector<int> proxies;
+    std::vector<Bounds> bounds;
+    for(int i = 0; i < 1000; ++i)
+    {
+        const Vec3 center = RandomPoint(1.0);
+        bounds.push_back(Bounds(center, Vec3(0.01, 0.02, 0.03)));
+        proxies.push_back(tree.Insert(bounds.back(), i));
+    }
+    BOOST_CHECK_EQUAL(tree.GetNumProxies(), 1000u);
+    CheckHeight(tree);
+    for(int i = 0; i < 1000; ++i)
+    {
+        BOOST_CHECK_EQUAL(tree.GetUserData(proxies[i]), i);
+        BOOST_CHECK(Contains(tree.GetFatBounds(proxies[i]), bounds[i]));
+    }
+
+    // Small moves stay within the fat AABBs, large ones do not
+    Bounds nudged = bounds[0];
+    nudged.xMin += 0.001;
+    nudged.xMax += 0.001;
+    BOOST_CHECK(!tree.Move(proxies[0], nudged));
+    const Bounds moved(Vec3(5.0, 5.0, 5.0), Vec3(0.01, 0.02, 0.03));
+    BOOST_CHECK(tree.Move(proxies[0], moved));
+    BOOST_CHECK(Contains(tree.GetFatBounds(proxies[0]), moved));
+
+    // Only the moved proxy is near its new position
+    std::vector<int> visited;
+    double bound = 1.0;
+    tree.Traverse(Vec3(5.0, 5.0, 5.0), bound, [&visited](int userData, double&){visited.push_back(userData);});
+    BOOST_REQUIRE_EQUAL(visited.size(), 1u);
+    BOOST_CHECK_EQUAL(visited[0], 0);
+
+    for(int i = 0; i < 1000; i += 2)
+    {
+        tree.Remove(proxies[i]);
+    }
+    BOOST_CHECK_EQUAL(tree.GetNumProxies(), 500u);
+    CheckHeight(tree);
+    BOOST_CHECK_THROW(tree.Remove(proxies[0]), std::runtime_error);
+    BOOST_CHECK_THROW(tree.Move(proxies[0], moved), std::runtime_error);
+    BOOST_CHECK_THROW(tree.Remove(-1), std::runtime_error);
+
+    tree.Clear();
+    BOOST_CHECK_EQUAL(tree.GetHeight(), 0);
+    BOOST_CHECK_EQUAL(tree.GetNumProxies(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestDynamicAABBTree_AddRemove)
+{
+    TriMeshProxQueryV6 query;
+    std::map<int, Triangle<Vec3>> triangles;
+    CheckSameAsBruteForce(query, triangles);
+
+    // Grow the set while removing and moving some of the triangles
+    for(unsigned round = 0; round < 5; ++round)
+    {
+        for(unsigned i = 0; i < 400; ++i)
+        {
+            const Triangle<Vec3> t = RandomTriangle();
+            const int handle = query.AddTriangle(t);
+            BOOST_REQUIRE(triangles.count(handle) == 0);
+            triangles[handle] = t;
+        }
+        for(unsigned i = 0; i < 150; ++i)
+        {
+            auto it = triangles.begin();
+            std::advance(it, static_cast<std::size_t>((real_rand() + 1.0)*0.5*(triangles.size() - 1)));
+            query.RemoveTriangle(it->first);
+            triangles.erase(it);
+        }
+        for(unsigned i = 0; i < 50; ++i)
+        {
+            auto it = triangles.begin();
+            std::advance(it, static_cast<std::size_t>((real_rand() + 1.0)*0.5*(triangles.size() - 1)));
+            it->second = RandomTriangle();
+            query.MoveTriangle(it->first, it->second);
+        }
+
+        CheckSameAsBruteForce(query, triangles);
+        CheckHeight(query.GetTree());
+        for(const auto& t : triangles)
+        {
+            BOOST_CHECK(query.HasTriangle(t.first));
+        }
+    }
+
+    // Remove everything
+    for(const auto& t : triangles)
+    {
+        query.RemoveTriangle(t.first);
+    }
+    triangles.clear();
+    BOOST_CHECK_EQUAL(query.GetTree().GetHeight(), 0);
+    CheckSameAsBruteForce(query, triangles);
+}
+
+BOOST_AUTO_TEST_CASE(TestDynamicAABBTree_Handles)
+{
+    TriMeshProxQueryV6 query;
+    for(int i = 0; i < 10; ++i)
+    {
+        BOOST_CHECK_EQUAL(query.AddTriangle(RandomTriangle()), i);
+    }
+
+    // Freed handles are handed out again, lowest first
+    query.RemoveTriangle(7);
+    query.RemoveTriangle(3);
+    BOOST_CHECK(!query.HasTriangle(3));
+    BOOST_CHECK_THROW(query.RemoveTriangle(3), std::runtime_error);
+    BOOST_CHECK_THROW(query.GetTriangle(7), std::runtime_error);
+    BOOST_CHECK_THROW(query.MoveTriangle(7, RandomTriangle()), std::runtime_error);
+    BOOST_CHECK_THROW(query.RemoveTriangle(10), std::runtime_error);
+    BOOST_CHECK_THROW(query.RemoveTriangle(-1), std::runtime_error);
+    BOOST_CHECK_EQUAL(query.AddTriangle(RandomTriangle()), 3);
+    BOOST_CHECK_EQUAL(query.AddTriangle(RandomTriangle()), 7);
+    BOOST_CHECK_EQUAL(query.AddTriangle(RandomTriangle()), 10);
+    BOOST_CHECK_EQUAL(query.GetNumTriangles(), 11u);
+
+    const Triangle<Vec3> t(Vec3(2.0, 0.0, 0.0), Vec3(3.0, 0.0, 0.0), Vec3(2.0, 1.0, 0.0));
+    query.MoveTriangle(5, t);
+    BOOST_CHECK(query.GetTriangle(5).GetVerts(zero).isSameAs(t.GetVerts(zero), TOLERANCE));
+    const ClosestPointResult<Vec3> res = query.CalculateClosestPointImpl(Vec3(2.2, 0.2, 0.5), 0.6);
+    BOOST_CHECK_EQUAL(res.PolygonIndex, 5);
+    BOOST_CHECK_SMALL(res.Dist - 0.5, TOLERANCE);
+}
+
+BOOST_AUTO_TEST_CASE(TestDynamicAABBTree_SameAsV1)
+{
+    auto buildingPolicy = std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+    TriMeshProxQueryV6 proximityQueriesV6(mesh);
+    BOOST_CHECK_EQUAL(proximityQueriesV6.GetNumTriangles(), NUM_TRIANGLES);
+    CheckHeight(proximityQueriesV6.GetTree());
+
+    // Handles are the indices into the mesh
+    for(unsigned i = 0; i < 200; ++i)
+    {
+        const Vec3 testPoint = RandomPoint(0.5);
+        const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.05;
+        const ClosestPointResult<Vec3> resV1 = proximityQueriesV1.CalculateClosestPointImpl(testPoint, threshold);
+        const ClosestPointResult<Vec3> resV6 = proximityQueriesV6.CalculateClosestPointImpl(testPoint, threshold);
+        BOOST_CHECK_EQUAL(resV1.Found(), resV6.Found());
+        BOOST_CHECK_SMALL(resV1.Dist - resV6.Dist, TOLERANCE);
+        if(resV6.Found())
+        {
+            BOOST_CHECK_SMALL(mesh->GetPolygons()[resV6.PolygonIndex].CalcShortestDistanceFrom(testPoint, threshold).Dist - resV6.Dist, TOLERANCE);
+        }
+    }
+
+    // Same answers through the base interface as well
+    Vec3 point;
+    double dist;
+    bool found;
+    std::tie(point, dist, found) = proximityQueriesV6.CalculateClosestPoint(Vec3(0.5204630973461957, 0.7220916475699011, 0.0396895110889990), 0.6);
+    BOOST_CHECK(found);
+    BOOST_CHECK_SMALL(dist - 0.518362283032093, 1e-6);
+}
@@ -0,0 +1,166 @@
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include <system_error>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "IndexedTriangleMesh.h"
+#include "ThreadPool.h"
+#include "TriangularMeshBuildingPolicy.h"
+#define BOOST_TEST_MODULE Test_IndexedTriangleMesh
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1e-3,1e-3), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy()
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME);
+    }
+
+    bool IsEqual(const Vec3& a, const Vec3& b)
+    {
+        return a.X() == b.X() && a.Y() == b.Y() && a.Z() == b.Z();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_Weld)
+{
+    TriMesh mesh(GetMeshBuildingPolicy());
+    IndexedTriangleMesh indexedMesh(GetMeshBuildingPolicy());
+    BOOST_CHECK(indexedMesh.GetNumTriangles() == NUM_TRIANGLES);
+
+    // A closed mesh has about half as many vertices as triangles
+    BOOST_CHECK(indexedMesh.GetNumVertices() < NUM_TRIANGLES);
+    BOOST_CHECK(indexedMesh.GetNumVertices() > NUM_TRIANGLES/4);
+
+    // Welding without a tolerance moves no vertex
+    const std::vector<Triangle<Vec3>>& triangles = mesh.GetPolygons();
+    for(std::size_t i = 0; i < triangles.size(); ++i)
+    {
+        const Triangle<Vec3> t = indexedMesh.GetTriangle(i);
+        BOOST_CHECK(IsEqual(t.P0(), triangles[i].P0()));
+        BOOST_CHECK(IsEqual(t.P1(), triangles[i].P1()));
+        BOOST_CHECK(IsEqual(t.P2(), triangles[i].P2()));
+        BOOST_CHECK(IsEqual(t.Normal(), triangles[i].Normal()));
+    }
+
+    // Every vertex is used, and the vertices are unique
+    std::vector<bool> used(indexedMesh.GetNumVertices(), false);
+    for(uint32_t index : indexedMesh.GetIndices())
+    {
+        used[index] = true;
+    }
+    BOOST_CHECK(std::find(used.begin(), used.end(), false) == used.end());
+    IndexedTriangleMesh rewelded(indexedMesh.GetVertices().data(), indexedMesh.GetNumVertices()/3);
+    BOOST_CHECK(rewelded.GetNumVertices() == indexedMesh.GetNumVertices() - indexedMesh.GetNumVertices() % 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_Parallel)
+{
+    TriMesh mesh(GetMeshBuildingPolicy());
+    auto threadPool = std::make_shared<ThreadPool>(3);
+    for(double tolerance : {0.0, 1e-3})
+    {
+        IndexedTriangleMesh serial(mesh, VertexWeldParams(tolerance));
+        IndexedTriangleMesh parallel(mesh, VertexWeldParams(tolerance, threadPool));
+        BOOST_CHECK(serial.GetVertices() == parallel.GetVertices());
+        BOOST_CHECK(serial.GetIndices() == parallel.GetIndices());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_Tolerance)
+{
+    // Two triangles sharing an edge whose vertices are a little apart
+    const double shift = 1e-6;
+    const double coords[18] = {0,0,0, 1,0,0, 0,1,0,
+                               1 + shift,0,0, 0,1 - shift,0, 1,1,0};
+    IndexedTriangleMesh exact(coords, 2);
+    IndexedTriangleMesh welded(coords, 2, VertexWeldParams(1e-5));
+    IndexedTriangleMesh tooClose(coords, 2, VertexWeldParams(1e-7));
+    BOOST_CHECK(exact.GetNumVertices() == 6);
+    BOOST_CHECK(tooClose.GetNumVertices() == 6);
+    BOOST_CHECK(welded.GetNumVertices() == 4);
+
+    // Merged vertices take the position of the first one
+    BOOST_CHECK(welded.GetVertexIndex(1, zero) == welded.GetVertexIndex(0, one));
+    BOOST_CHECK(welded.GetVertexIndex(1, one) == welded.GetVertexIndex(0, two));
+    BOOST_CHECK(IsEqual(welded.GetTriangle(1).P0(), Vec3(1,0,0)));
+
+    // Random jitter below the tolerance is welded away, whichever cell the vertices fall into
+    TriMesh mesh(GetMeshBuildingPolicy());
+    IndexedTriangleMesh indexedMesh(mesh);
+    std::vector<double> jittered;
+    for(uint32_t index : indexedMesh.GetIndices())
+    {
+        const Vec3 v = indexedMesh.GetVertex(index);
+        jittered.push_back(v.X() + real_rand()*1e-4);
+        jittered.push_back(v.Y() + real_rand()*1e-4);
+        jittered.push_back(v.Z() + real_rand()*1e-4);
+    }
+    IndexedTriangleMesh jitteredMesh(jittered.data(), NUM_TRIANGLES, VertexWeldParams(1e-6));
+    BOOST_CHECK(jitteredMesh.GetNumVertices() == indexedMesh.GetNumVertices());
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_FarOut)
+{
+    // Coordinates whose cells do not fit the grid are welded if they are identical
+    const double far = 1e300;
+    const double inf = std::numeric_limits<double>::infinity();
+    const double coords[27] = {far,0,0, -far,0,0, 0,far,1,
+                               -far,0,0, far,0,0, 0,0,inf,
+                               0,0,inf, 0,far,1, 0,far + 1e290,1};
+    for(const std::shared_ptr<ThreadPool>& pool : {std::shared_ptr<ThreadPool>(), std::make_shared<ThreadPool>(2)})
+    {
+        IndexedTriangleMesh welded(coords, 3, VertexWeldParams(1e-3, pool));
+        BOOST_CHECK_EQUAL(welded.GetNumVertices(), 5u);
+        BOOST_CHECK_EQUAL(welded.GetVertexIndex(1, zero), welded.GetVertexIndex(0, one));
+        BOOST_CHECK_EQUAL(welded.GetVertexIndex(1, one), welded.GetVertexIndex(0, zero));
+        BOOST_CHECK_EQUAL(welded.GetVertexIndex(2, zero), welded.GetVertexIndex(1, two));
+        BOOST_CHECK_EQUAL(welded.GetVertexIndex(2, one), welded.GetVertexIndex(0, two));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_Indexed)
+{
+    std::vector<double> vertices = {0,0,0, 1,0,0, 0,1,0, 1,1,0};
+    IndexedTriangleMesh quad(vertices, std::vector<uint32_t>{0,1,2, 2,1,3});
+    BOOST_CHECK(quad.GetNumVertices() == 4);
+    BOOST_CHECK(quad.GetNumTriangles() == 2);
+    BOOST_CHECK(IsEqual(quad.GetTriangle(1).P2(), Vec3(1,1,0)));
+
+    bool threw = false;
+    try
+    {
+        IndexedTriangleMesh broken(vertices, std::vector<uint32_t>{0,1,4});
+    }
+    catch(const std::runtime_error&)
+    {
+        threw = true;
+    }
+    BOOST_CHECK(threw);
+}
+
+BOOST_AUTO_TEST_CASE(TestIndexedTriangleMesh_MemoryUsage)
+{
+    TriMesh mesh(GetMeshBuildingPolicy());
+    CompactTriangleMesh compactMesh(mesh);
+    IndexedTriangleMesh indexedMesh(mesh);
+
+    // Each vertex is shared by about six triangles, but the indices take up half the memory
+    const std::size_t meshMemory = mesh.GetPolygons().size()*sizeof(Triangle<Vec3>);
+    BOOST_CHECK(indexedMesh.GetMemoryUsage()*2 < compactMesh.GetMemoryUsage());
+    BOOST_CHECK(indexedMesh.GetMemoryUsage()*5 < meshMemory);
+}
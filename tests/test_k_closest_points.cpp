@@ -0,0 +1,158 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <cmath>
+#include "Mesh.h"
+#include "KClosestPointsHeap.h"
+#include "CompactTriangleMesh.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV4.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_KClosestPoints
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const double SOA_TOLERANCE = 1e-6;      ///< TriangleSoA and Triangle may differ by this much, see TriangleSoA
+
+    // Distances to all the triangles within the threshold, sorted
+    std::vector<std::pair<double, int>> GetSortedDistances(const TriMesh& mesh, const Vec3& point, double distThreshold)
+    {
+        std::vector<std::pair<double, int>> distances;
+        const std::vector<Triangle<Vec3>>& triangles = mesh.GetPolygons();
+        for(std::size_t i = 0; i < triangles.size(); ++i)
+        {
+            const double dist = triangles[i].CalcShortestDistanceFrom(point, distThreshold).Dist;
+            if(dist < distThreshold)
+            {
+                distances.push_back(std::make_pair(dist, static_cast<int>(i)));
+            }
+        }
+        std::sort(distances.begin(), distances.end());
+        return distances;
+    }
+
+    // Checks results against the distances to all the triangles, up to the given tolerance
+    void CheckResults(const TriMesh& mesh,
+                      const std::vector<std::pair<double, int>>& expected,
+                      std::size_t k,
+                      const std::vector<ClosestPointResult<Vec3>>& results,
+                      std::size_t numFound,
+                      const Vec3& point,
+                      double tolerance)
+    {
+        BOOST_CHECK(numFound == std::min(k, expected.size()));
+        std::set<int> indices;
+        for(std::size_t i = 0; i < numFound; ++i)
+        {
+            const ClosestPointResult<Vec3>& res = results[i];
+            BOOST_CHECK(res.Found());
+            BOOST_CHECK(indices.insert(res.PolygonIndex).second);
+            BOOST_CHECK(i == 0 || results[i - 1].Dist <= res.Dist);
+            BOOST_CHECK(std::abs(res.Dist - expected[i].first) <= tolerance);
+            BOOST_CHECK(std::abs(res.Dist - (res.Point - point).magnitude()) <= 1e-12);
+
+            const Triangle<Vec3>& t = mesh.GetPolygons()[res.PolygonIndex];
+            const double dist = t.CalcShortestDistanceFrom(point, std::numeric_limits<double>::max()).Dist;
+            BOOST_CHECK(std::abs(res.Dist - dist) <= tolerance);
+        }
+    }
+
+    template<typename ProximityQueryMethod>
+    void CheckKClosestPoints(const TriMesh& mesh, const ProximityQueryMethod& method, double tolerance)
+    {
+        for(unsigned i = 0; i < 100; ++i)
+        {
+            const Vec3 testPoint(RandomReal(), RandomReal(), RandomReal());
+            for(double distThreshold : {std::numeric_limits<double>::max(), 0.05})
+            {
+                const std::vector<std::pair<double, int>> expected = GetSortedDistances(mesh, testPoint, distThreshold);
+                for(std::size_t k : {std::size_t(1), std::size_t(4), std::size_t(16)})
+                {
+                    std::vector<ClosestPointResult<Vec3>> results(k);
+                    const std::size_t numFound = method.CalculateKClosestPoints(testPoint, distThreshold, k, results.data());
+                    CheckResults(mesh, expected, k, results, numFound, testPoint, tolerance);
+
+                    // The closest of them is the closest point
+                    const ClosestPointResult<Vec3> closest = method.CalculateClosestPointImpl(testPoint, distThreshold);
+                    BOOST_CHECK(closest.Found() == (numFound != 0));
+                    BOOST_CHECK(!closest.Found() || closest.Dist == results[0].Dist);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestKClosestPoints_Heap)
+{
+    std::vector<ClosestPointResult<Vec3>> results(3);
+    KClosestPointsHeap<Vec3> heap(results.data(), results.size(), 10.0);
+    BOOST_CHECK(heap.GetBound() == 10.0);
+    BOOST_CHECK(!heap.Push(Vec3(), 10.0, 0));
+    BOOST_CHECK(heap.Push(Vec3(), 5.0, 1));
+    BOOST_CHECK(heap.Push(Vec3(), 3.0, 2));
+    BOOST_CHECK(heap.GetBound() == 10.0);
+    BOOST_CHECK(heap.Push(Vec3(), 7.0, 3));
+    BOOST_CHECK(heap.GetBound() == 7.0);
+    BOOST_CHECK(!heap.Push(Vec3(), 8.0, 4));
+    BOOST_CHECK(heap.Push(Vec3(), 1.0, 5));
+    BOOST_CHECK(heap.GetBound() == 5.0);
+
+    // Ties go to the lower index
+    BOOST_CHECK(heap.Push(Vec3(), 5.0, 0));
+    BOOST_CHECK(!heap.Push(Vec3(), 5.0, 6));
+    BOOST_CHECK(heap.Finish() == 3);
+    BOOST_CHECK(results[0].PolygonIndex == 5 && results[1].PolygonIndex == 2 && results[2].PolygonIndex == 0);
+
+    KClosestPointsHeap<Vec3> empty(nullptr, 0, 10.0);
+    BOOST_CHECK(!empty.Push(Vec3(), 1.0, 0));
+    BOOST_CHECK(empty.Finish() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestKClosestPoints_V1)
+{
+    auto mesh = GetMesh();
+    BOOST_CHECK(mesh->GetPolygons().size() == NUM_TRIANGLES);
+    CheckKClosestPoints(*mesh, TriMeshProxQueryV1(mesh), 0.0);
+    CheckKClosestPoints(*mesh, TriMeshProxQueryV1(mesh, TrianglePrecomputation::QueryRecords), SOA_TOLERANCE);
+    CheckKClosestPoints(*mesh, TriMeshProxQueryV1(std::make_shared<CompactTriangleMesh>(*mesh)), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestKClosestPoints_V4)
+{
+    auto mesh = GetMesh();
+    CheckKClosestPoints(*mesh, TriMeshProxQueryV4(mesh), SOA_TOLERANCE);
+    CheckKClosestPoints(*mesh, TriMeshProxQueryV4(CompactTriangleMesh(*mesh), BVHBuildParams(1)), SOA_TOLERANCE);
+}
+
+BOOST_AUTO_TEST_CASE(TestKClosestPoints_MoreThanInRange)
+{
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 v1(mesh);
+    TriMeshProxQueryV4 v4(mesh);
+    const std::size_t k = NUM_TRIANGLES + 10;
+    std::vector<ClosestPointResult<Vec3>> results(k);
+    for(unsigned i = 0; i < 10; ++i)
+    {
+        const Vec3 testPoint(RandomReal(), RandomReal(), RandomReal());
+        for(double distThreshold : {std::numeric_limits<double>::max(), 0.1})
+        {
+            const std::vector<std::pair<double, int>> expected = GetSortedDistances(*mesh, testPoint, distThreshold);
+            BOOST_CHECK(distThreshold < 1.0 || expected.size() == NUM_TRIANGLES);
+            CheckResults(*mesh, expected, k, results, v1.CalculateKClosestPoints(testPoint, distThreshold, k, results.data()),
+                         testPoint, 0.0);
+            CheckResults(*mesh, expected, k, results, v4.CalculateKClosestPoints(testPoint, distThreshold, k, results.data()),
+                         testPoint, SOA_TOLERANCE);
+        }
+        BOOST_CHECK(v1.CalculateKClosestPoints(testPoint, 1.0, 0, results.data()) == 0);
+        BOOST_CHECK(v4.CalculateKClosestPoints(testPoint, 1.0, 0, results.data()) == 0);
+    }
+}
@@ -0,0 +1,109 @@
+#include <vector>
+#include <iostream>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "LinearBVH.h"
+#define BOOST_TEST_MODULE Test_LinearBVH
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    std::vector<AABB<Vec3>> GetTriangleAABBs()
+    {
+        Mesh<Triangle<Vec3>> mesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+        std::vector<AABB<Vec3>> aabbs;
+        for(const Triangle<Vec3>& t : mesh.GetPolygons())
+        {
+            aabbs.emplace_back(t.CalculateAABB());
+        }
+        return aabbs;
+    }
+
+    bool Encloses(const LinearBVHNode& node, const Bounds& b)
+    {
+        return node.BoundsMin[0] <= b.xMin && node.BoundsMax[0] >= b.xMax &&
+               node.BoundsMin[1] <= b.yMin && node.BoundsMax[1] >= b.yMax &&
+               node.BoundsMin[2] <= b.zMin && node.BoundsMax[2] >= b.zMax;
+    }
+
+    // Walks the pointer based tree and the flattened one side by side. Returns the
+    // index of the node following the subtree in the flattened layout.
+    uint32_t CompareSubtree(const BVHTree::Node* node, const LinearBVH& linear, uint32_t index)
+    {
+        const LinearBVHNode& linearNode = linear.GetNodes()[index];
+        BOOST_CHECK(Encloses(linearNode, node->Data().aabb.GetBounds()));
+        if(BVHTree::IsLeaf(node))
+        {
+            BOOST_CHECK(linearNode.IsLeaf());
+            const std::vector<int>& triIndices = node->Data().triIndices;
+            BOOST_CHECK(linearNode.Count == triIndices.size());
+            for(uint32_t i = 0; i < linearNode.Count; ++i)
+            {
+                BOOST_CHECK(linear.GetTriIndices()[linearNode.Offset + i] == static_cast<uint32_t>(triIndices[i]));
+            }
+            return index + 1;
+        }
+
+        BOOST_CHECK(!linearNode.IsLeaf());
+        const uint32_t next = CompareSubtree(node->GetLeft(), linear, index + 1);
+        BOOST_CHECK(linearNode.Offset == next);
+        return CompareSubtree(node->GetRight(), linear, next);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestLinearBVH_Empty)
+{
+    BVHTree tree(std::vector<AABB<Vec3>>{});
+    LinearBVH linear(tree);
+    BOOST_CHECK(linear.GetNodes().empty());
+
+    double bound = std::numeric_limits<double>::max();
+    bool visited = false;
+    linear.Traverse(Vec3(), bound, [&visited](const uint32_t*, uint32_t, double&){visited = true;});
+    BOOST_CHECK(!visited);
+}
+
+BOOST_AUTO_TEST_CASE(TestLinearBVH_Flatten)
+{
+    const std::vector<AABB<Vec3>> aabbs = GetTriangleAABBs();
+    for(BVHSplitMethod method : {BVHSplitMethod::Median, BVHSplitMethod::SAH})
+    {
+        BVHTree tree(aabbs, BVHBuildParams(4, method));
+        LinearBVH linear(tree);
+        BOOST_CHECK(linear.GetNodes().size() == tree.GetNumNodes());
+        BOOST_CHECK(linear.GetTriIndices().size() == NUM_TRIANGLES);
+        BOOST_CHECK(linear.GetDepth() == tree.GetDepth());
+        BOOST_CHECK(CompareSubtree(tree.GetRoot(), linear, 0) == tree.GetNumNodes());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestLinearBVH_Traverse)
+{
+    // With an infinite bound that is never lowered, every leaf is visited exactly once
+    const std::vector<AABB<Vec3>> aabbs = GetTriangleAABBs();
+    BVHTree tree(aabbs);
+    LinearBVH linear(tree);
+
+    std::vector<unsigned> counts(NUM_TRIANGLES, 0);
+    double bound = std::numeric_limits<double>::max();
+    linear.Traverse(Vec3(0.1, 0.2, 0.3), bound, [&counts](const uint32_t* triIndices, uint32_t count, double&)
+    {
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            ++counts[triIndices[i]];
+        }
+    });
+    BOOST_CHECK(std::all_of(counts.begin(), counts.end(), [](unsigned c){return c == 1;}));
+
+    // Leaves further away than the bound are never visited
+    const Vec3 farPoint(10.0, 10.0, 10.0);
+    bound = 1.0;
+    bool visited = false;
+    linear.Traverse(farPoint, bound, [&visited](const uint32_t*, uint32_t, double&){visited = true;});
+    BOOST_CHECK(!visited);
+}
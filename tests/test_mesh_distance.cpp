@@ -0,0 +1,243 @@
+#include <vector>
+#include <array>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <stdexcept>
+#include "Mesh.h"
+#include "TriMeshProxQueryV4.h"
+#include "TriangleDistance.h"
+#include "RigidTransform.h"
+#include "MeshPairQueries.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_MeshDistance
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_TRIANGLE_PAIRS = 50; ///< Number of random pairs of triangles checked
+    const unsigned NUM_SAMPLES = 30;        ///< Samples along each edge of a triangle
+    const double TOLERANCE = 1e-12;
+
+    void GetVertices(const Triangle<Vec3>& t, Vec3 vertices[3])
+    {
+        vertices[0] = t.P0();
+        vertices[1] = t.P1();
+        vertices[2] = t.P2();
+    }
+
+    // Points spread evenly over the triangle, including its vertices and edges
+    std::vector<Vec3> SampleTriangle(const Vec3 t[3])
+    {
+        std::vector<Vec3> samples;
+        for(unsigned i = 0; i <= NUM_SAMPLES; ++i)
+        {
+            for(unsigned j = 0; i + j <= NUM_SAMPLES; ++j)
+            {
+                const double u = double(i)/NUM_SAMPLES;
+                const double v = double(j)/NUM_SAMPLES;
+                samples.push_back(t[0] + (t[1] - t[0])*u + (t[2] - t[0])*v);
+            }
+        }
+        return samples;
+    }
+
+    // Checks that the point lies on the triangle
+    void CheckOnTriangle(const Vec3& p, const Vec3 t[3])
+    {
+        const Triangle<Vec3> tri(t[0], t[1], t[2]);
+        BOOST_CHECK_SMALL(tri.CalcShortestDistanceFrom(p, 1.0).Dist, 1e-9);
+    }
+
+    // Smallest distance between any two triangles of the meshes, testing every pair
+    double BruteForceMinDistance(const TriMesh& meshA, const TriMesh& meshB, const RigidTransform& transformB)
+    {
+        std::vector<std::array<Vec3, 3>> trianglesB;
+        for(const auto& t : meshB.GetPolygons())
+        {
+            trianglesB.push_back({{transformB.Apply(t.P0()), transformB.Apply(t.P1()), transformB.Apply(t.P2())}});
+        }
+        double minDist = std::numeric_limits<double>::max();
+        Vec3 a[3];
+        for(const auto& t : meshA.GetPolygons())
+        {
+            GetVertices(t, a);
+            for(const auto& b : trianglesB)
+            {
+                minDist = std::min(minDist, CalcTriangleDistance(a, b.data()).Dist);
+            }
+        }
+        return minDist;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshDistance_TriangleDistance)
+{
+    const Vec3 a[3] = {Vec3(-1.0, 0.0, 0.0), Vec3(1.0, 0.0, 0.0), Vec3(0.0, -1.0, 0.0)};
+
+    // Parallel triangles, face to face
+    const Vec3 above[3] = {a[0] + Vec3(0.0, 0.0, 2.0), a[1] + Vec3(0.0, 0.0, 2.0), a[2] + Vec3(0.0, 0.0, 2.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, above).Dist - 2.0, TOLERANCE);
+
+    // Edge across edge, the closest points are inside both edges
+    const Vec3 crossing[3] = {Vec3(0.0, -1.0, 1.0), Vec3(0.0, 1.0, 1.0), Vec3(0.0, 0.0, 2.0)};
+    const Vec3 skew[3] = {Vec3(0.5, 1.0, 1.0), Vec3(0.5, -1.0, 1.0), Vec3(0.5, 0.0, 2.0)};
+    const TriangleDistanceResult edgeEdge = CalcTriangleDistance(a, skew);
+    BOOST_CHECK_SMALL(edgeEdge.Dist - 1.0, TOLERANCE);
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, crossing).Dist - 1.0, TOLERANCE);
+
+    // Vertex above the face
+    const Vec3 vertexFace[3] = {Vec3(0.0, -0.3, 0.5), Vec3(1.0, 1.0, 3.0), Vec3(-1.0, 1.0, 3.0)};
+    const TriangleDistanceResult vf = CalcTriangleDistance(a, vertexFace);
+    BOOST_CHECK_SMALL(vf.Dist - 0.5, TOLERANCE);
+    BOOST_CHECK(vf.PointA.isSameAs(Vec3(0.0, -0.3, 0.0), TOLERANCE));
+    BOOST_CHECK(vf.PointB.isSameAs(vertexFace[0], TOLERANCE));
+
+    // Piercing and touching triangles
+    const Vec3 piercing[3] = {Vec3(0.0, -0.3, -1.0), Vec3(0.0, -0.3, 1.0), Vec3(5.0, 5.0, 5.0)};
+    const TriangleDistanceResult pierced = CalcTriangleDistance(a, piercing);
+    BOOST_CHECK_EQUAL(pierced.Dist, 0.0);
+    BOOST_CHECK(pierced.PointA.isSameAs(pierced.PointB, TOLERANCE));
+    CheckOnTriangle(pierced.PointA, a);
+    CheckOnTriangle(pierced.PointA, piercing);
+    BOOST_CHECK_EQUAL(CalcTriangleDistance(piercing, a).Dist, 0.0);
+    const Vec3 touching[3] = {Vec3(0.0, -0.3, 0.0), Vec3(0.0, -0.3, 1.0), Vec3(1.0, 0.0, 1.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, touching).Dist, TOLERANCE);
+
+    // Coplanar triangles, overlapping and apart
+    const Vec3 coplanar[3] = {Vec3(0.0, -0.5, 0.0), Vec3(3.0, -0.5, 0.0), Vec3(3.0, 2.0, 0.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, coplanar).Dist, TOLERANCE);
+    const Vec3 beside[3] = {Vec3(2.0, 0.0, 0.0), Vec3(3.0, 0.0, 0.0), Vec3(3.0, 2.0, 0.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, beside).Dist - 1.0, TOLERANCE);
+
+    // Degenerate triangles act as segments and points
+    const Vec3 segment[3] = {Vec3(0.0, 0.0, 1.0), Vec3(0.0, 0.0, 3.0), Vec3(0.0, 0.0, 2.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(a, segment).Dist - 1.0, TOLERANCE);
+    const Vec3 point[3] = {Vec3(0.0, -0.5, 2.0), Vec3(0.0, -0.5, 2.0), Vec3(0.0, -0.5, 2.0)};
+    BOOST_CHECK_SMALL(CalcTriangleDistance(point, a).Dist - 2.0, TOLERANCE);
+    const Vec3 piercingSegment[3] = {Vec3(0.0, -0.2, -1.0), Vec3(0.0, -0.2, 1.0), Vec3(0.0, -0.2, 1.0)};
+    BOOST_CHECK_EQUAL(CalcTriangleDistance(a, piercingSegment).Dist, 0.0);
+    BOOST_CHECK_EQUAL(CalcTriangleDistance(piercingSegment, a).Dist, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshDistance_TriangleDistanceRandom)
+{
+    for(unsigned n = 0; n < NUM_TRIANGLE_PAIRS; ++n)
+    {
+        const Vec3 offset = RandomPoint(1.0);
+        const Vec3 a[3] = {RandomPoint(1.0), RandomPoint(1.0), RandomPoint(1.0)};
+        const Vec3 b[3] = {RandomPoint(1.0) + offset, RandomPoint(1.0) + offset, RandomPoint(1.0) + offset};
+        const TriangleDistanceResult res = CalcTriangleDistance(a, b);
+        BOOST_CHECK_SMALL(res.Dist - CalcTriangleDistance(b, a).Dist, 1e-9);
+        BOOST_CHECK_SMALL(res.Dist - (res.PointA - res.PointB).magnitude(), 1e-9);
+        CheckOnTriangle(res.PointA, a);
+        CheckOnTriangle(res.PointB, b);
+
+        // Given a bound, pairs beyond it are either resolved or reported beyond it
+        for(const double maxDist : {0.5*res.Dist, res.Dist, 2.0*res.Dist})
+        {
+            const double bounded = CalcTriangleDistance(a, b, maxDist).Dist;
+            BOOST_CHECK(bounded >= maxDist || std::fabs(bounded - res.Dist) < 1e-12);
+            BOOST_CHECK(bounded <= res.Dist + 1e-12);
+        }
+
+        // No pair of samples is closer, and the closest samples are about as close
+        double sampledMin = std::numeric_limits<double>::max();
+        const std::vector<Vec3> samplesA = SampleTriangle(a);
+        const std::vector<Vec3> samplesB = SampleTriangle(b);
+        for(const Vec3& pa : samplesA)
+        {
+            for(const Vec3& pb : samplesB)
+            {
+                sampledMin = std::min(sampledMin, (pa - pb).magnitude());
+            }
+        }
+        BOOST_CHECK(res.Dist <= sampledMin + 1e-9);
+        BOOST_CHECK(sampledMin - res.Dist < 4.0*2.0*sqrt(12.0)/NUM_SAMPLES);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshDistance_RigidTransform)
+{
+    const RigidTransform transform = RandomTransform(2.0);
+    const RigidTransform inverse = transform.Inverse();
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        const Vec3 p = RandomPoint(1.0);
+        BOOST_CHECK(inverse.Apply(transform.Apply(p)).isSameAs(p, 1e-12));
+    }
+    BOOST_CHECK(RigidTransform().Apply(Vec3(1.0, 2.0, 3.0)).isSameAs(Vec3(1.0, 2.0, 3.0), 1e-15));
+
+    const double scaled[3][3] = {{2.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+    BOOST_CHECK_THROW(RigidTransform(scaled, Vec3()), std::runtime_error);
+    const double mirrored[3][3] = {{-1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+    BOOST_CHECK_THROW(RigidTransform(mirrored, Vec3()), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshDistance_SameAsBruteForce)
+{
+    auto mesh = GetMesh();
+    const TriMeshProxQueryV4 query(mesh);
+    const MeshPairQueries pair(query, query);
+
+    // The rabbit is about 1.5 across, so these range from overlapping to well apart
+    for(const double distance : {1.0, 1.6, 2.2})
+    {
+        const RigidTransform transform = RandomTransform(distance);
+        const MeshDistanceResult res = pair.CalculateMinDistance(transform);
+        BOOST_CHECK(res.Found());
+        BOOST_CHECK_SMALL(res.Dist - BruteForceMinDistance(*mesh, *mesh, transform), TOLERANCE);
+        BOOST_CHECK_SMALL(res.Dist - (res.PointA - res.PointB).magnitude(), 1e-9);
+
+        // The triangles reported hold the closest points
+        Vec3 a[3];
+        Vec3 b[3];
+        GetVertices(mesh->GetPolygons()[res.PolygonIndexA], a);
+        GetVertices(mesh->GetPolygons()[res.PolygonIndexB], b);
+        for(unsigned k = 0; k < 3; ++k)
+        {
+            b[k] = transform.Apply(b[k]);
+        }
+        BOOST_CHECK_SMALL(CalcTriangleDistance(a, b).Dist - res.Dist, TOLERANCE);
+        CheckOnTriangle(res.PointA, a);
+        CheckOnTriangle(res.PointB, b);
+
+        // Distances from the vertices of B alone can only be larger
+        double vertexMin = std::numeric_limits<double>::max();
+        for(const auto& t : mesh->GetPolygons())
+        {
+            vertexMin = std::min(vertexMin, std::get<1>(query.CalculateClosestPoint(transform.Apply(t.P0()), 10.0)));
+        }
+        BOOST_CHECK(res.Dist <= vertexMin + TOLERANCE);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshDistance_Threshold)
+{
+    auto mesh = GetMesh();
+    const TriMeshProxQueryV4 query(mesh);
+    const MeshPairQueries pair(query, query);
+
+    const RigidTransform transform = RandomTransform(2.5);
+    const MeshDistanceResult res = pair.CalculateMinDistance(transform);
+    BOOST_CHECK(res.Found());
+
+    const MeshDistanceResult within = pair.CalculateMinDistance(transform, res.Dist*1.01);
+    BOOST_CHECK(within.Found());
+    BOOST_CHECK_EQUAL(within.Dist, res.Dist);
+
+    const MeshDistanceResult beyond = pair.CalculateMinDistance(transform, res.Dist*0.99);
+    BOOST_CHECK(!beyond.Found());
+    BOOST_CHECK_EQUAL(beyond.Dist, res.Dist*0.99);
+    BOOST_CHECK_EQUAL(beyond.PolygonIndexA, -1);
+
+    // Without a transform, a mesh intersects itself
+    const MeshDistanceResult self = pair.CalculateMinDistance();
+    BOOST_CHECK(self.Found());
+    BOOST_CHECK_EQUAL(self.Dist, 0.0);
+}
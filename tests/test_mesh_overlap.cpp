@@ -0,0 +1,221 @@
+#include <cmath>
+#include <vector>
+#include <array>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <memory>
+#include "Mesh.h"
+#include "TriMeshProxQueryV4.h"
+#include "TriangleDistance.h"
+#include "TriangleIntersection.h"
+#include "RigidTransform.h"
+#include "MeshPairQueries.h"
+#include "ThreadPool.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_MeshOverlap
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_TRIANGLE_PAIRS = 10000; ///< Number of random pairs of triangles checked
+
+    // Every pair of intersecting triangles, testing every pair
+    std::vector<TrianglePair> BruteForceOverlaps(const TriMesh& meshA, const TriMesh& meshB, const RigidTransform& transformB)
+    {
+        std::vector<std::array<Vec3, 3>> trianglesB;
+        for(const auto& t : meshB.GetPolygons())
+        {
+            trianglesB.push_back({{transformB.Apply(t.P0()), transformB.Apply(t.P1()), transformB.Apply(t.P2())}});
+        }
+        std::vector<TrianglePair> pairs;
+        for(std::size_t i = 0; i < meshA.GetPolygons().size(); ++i)
+        {
+            const auto& t = meshA.GetPolygons()[i];
+            const Vec3 a[3] = {t.P0(), t.P1(), t.P2()};
+            for(std::size_t j = 0; j < trianglesB.size(); ++j)
+            {
+                if(TrianglesIntersect(a, trianglesB[j].data()))
+                {
+                    pairs.push_back(TrianglePair(static_cast<int>(i), static_cast<int>(j)));
+                }
+            }
+        }
+        return pairs;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_TriangleIntersection)
+{
+    const Vec3 a[3] = {Vec3(0.0, 0.0, 0.0), Vec3(1.0, 0.0, 0.0), Vec3(0.0, 1.0, 0.0)};
+
+    const Vec3 above[3] = {Vec3(0.0, 0.0, 1.0), Vec3(1.0, 0.0, 1.0), Vec3(0.0, 1.0, 1.0)};
+    BOOST_CHECK(!TrianglesIntersect(a, above));
+    const Vec3 piercing[3] = {Vec3(0.2, 0.2, -1.0), Vec3(0.2, 0.2, 1.0), Vec3(0.3, 0.6, 1.0)};
+    BOOST_CHECK(TrianglesIntersect(a, piercing));
+    BOOST_CHECK(TrianglesIntersect(piercing, a));
+
+    // Crosses the plane of a, but beside a
+    const Vec3 beside[3] = {Vec3(2.0, 2.0, -1.0), Vec3(2.0, 2.0, 1.0), Vec3(3.0, 2.0, 1.0)};
+    BOOST_CHECK(!TrianglesIntersect(a, beside));
+
+    // Closed triangles, so touching counts
+    const Vec3 vertexTouch[3] = {Vec3(1.0, 0.0, 0.0), Vec3(2.0, 0.0, 1.0), Vec3(2.0, 1.0, 1.0)};
+    BOOST_CHECK(TrianglesIntersect(a, vertexTouch));
+    const Vec3 edgeTouch[3] = {Vec3(0.0, 0.0, 0.0), Vec3(1.0, 0.0, 0.0), Vec3(0.0, 0.0, 1.0)};
+    BOOST_CHECK(TrianglesIntersect(a, edgeTouch));
+
+    // Coplanar, crossing edges, one inside the other and apart
+    const Vec3 crossing[3] = {Vec3(0.5, -0.5, 0.0), Vec3(0.5, 0.5, 0.0), Vec3(1.5, 0.0, 0.0)};
+    BOOST_CHECK(TrianglesIntersect(a, crossing));
+    const Vec3 inside[3] = {Vec3(0.1, 0.1, 0.0), Vec3(0.3, 0.1, 0.0), Vec3(0.1, 0.3, 0.0)};
+    BOOST_CHECK(TrianglesIntersect(a, inside));
+    BOOST_CHECK(TrianglesIntersect(inside, a));
+    const Vec3 apart[3] = {Vec3(1.0, 1.0, 0.0), Vec3(2.0, 1.0, 0.0), Vec3(1.0, 2.0, 0.0)};
+    BOOST_CHECK(!TrianglesIntersect(a, apart));
+
+    // Degenerate triangles
+    const Vec3 segment[3] = {Vec3(0.2, 0.2, -1.0), Vec3(0.2, 0.2, 1.0), Vec3(0.2, 0.2, 1.0)};
+    BOOST_CHECK(TrianglesIntersect(a, segment));
+    const Vec3 point[3] = {Vec3(0.2, 0.2, 1.0), Vec3(0.2, 0.2, 1.0), Vec3(0.2, 0.2, 1.0)};
+    BOOST_CHECK(!TrianglesIntersect(point, a));
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_TriangleIntersectionSelf)
+{
+    // Every triangle intersects itself, whichever vertex the planes are taken through, and
+    // however the rounding of the plane distances comes out
+    const auto mesh = GetMesh();
+    const RigidTransform transform = RandomTransform(100.0);
+    for(const auto& t : mesh->GetPolygons())
+    {
+        const Vec3 a[3] = {t.P0(), t.P1(), t.P2()};
+        const Vec3 rotated[3] = {t.P1(), t.P2(), t.P0()};
+        const Vec3 reversed[3] = {t.P2(), t.P1(), t.P0()};
+        BOOST_CHECK(TrianglesIntersect(a, a));
+        BOOST_CHECK(TrianglesIntersect(a, rotated));
+        BOOST_CHECK(TrianglesIntersect(reversed, a));
+
+        const Vec3 moved[3] = {transform.Apply(t.P0()), transform.Apply(t.P1()), transform.Apply(t.P2())};
+        const Vec3 movedRotated[3] = {moved[1], moved[2], moved[0]};
+        BOOST_CHECK(TrianglesIntersect(moved, moved));
+        BOOST_CHECK(TrianglesIntersect(moved, movedRotated));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_TriangleIntersectionNearlyCoplanar)
+{
+    // Copies of a triangle nudged by a few ulps, as contracting the plane distances into fused
+    // multiply-adds would round them, still intersect it, while copies moved off its plane by
+    // far more than rounding do not
+    const auto mesh = GetMesh();
+    for(const auto& t : mesh->GetPolygons())
+    {
+        const Vec3 a[3] = {t.P0(), t.P1(), t.P2()};
+        for(unsigned ulps = 1; ulps <= 4; ++ulps)
+        {
+            Vec3 nudged[3];
+            for(unsigned i = 0; i < 3; ++i)
+            {
+                double coords[3] = {a[i].X(), a[i].Y(), a[i].Z()};
+                for(unsigned j = 0; j < 3; ++j)
+                {
+                    const double towards = (i + j + ulps) % 2 == 0 ? HUGE_VAL : -HUGE_VAL;
+                    for(unsigned n = 0; n < ulps; ++n)
+                    {
+                        coords[j] = std::nextafter(coords[j], towards);
+                    }
+                }
+                nudged[i] = Vec3(coords[0], coords[1], coords[2]);
+            }
+            const Vec3 nudgedRotated[3] = {nudged[1], nudged[2], nudged[0]};
+            BOOST_CHECK(TrianglesIntersect(a, nudged));
+            BOOST_CHECK(TrianglesIntersect(nudged, a));
+            BOOST_CHECK(TrianglesIntersect(nudgedRotated, a));
+        }
+
+        const Vec3 normal = Vec3::crossProduct(a[1] - a[0], a[2] - a[0]);
+        const double lengthSq = Vec3::dotProduct(normal, normal);
+        if(lengthSq > 0.0)
+        {
+            const Vec3 offset = normal*(1e-6/std::sqrt(lengthSq));
+            const Vec3 lifted[3] = {a[0] + offset, a[1] + offset, a[2] + offset};
+            BOOST_CHECK(!TrianglesIntersect(a, lifted));
+            BOOST_CHECK(!TrianglesIntersect(lifted, a));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_TriangleIntersectionRandom)
+{
+    // Agrees with the distance between the triangles, except for pairs which nearly touch
+    unsigned numIntersecting = 0;
+    for(unsigned n = 0; n < NUM_TRIANGLE_PAIRS; ++n)
+    {
+        const Vec3 offset = RandomPoint(1.0);
+        const Vec3 a[3] = {RandomPoint(1.0), RandomPoint(1.0), RandomPoint(1.0)};
+        const Vec3 b[3] = {RandomPoint(1.0) + offset, RandomPoint(1.0) + offset, RandomPoint(1.0) + offset};
+        const double dist = CalcTriangleDistance(a, b).Dist;
+        if(dist > 1e-9)
+        {
+            BOOST_CHECK(!TrianglesIntersect(a, b));
+            BOOST_CHECK(!TrianglesIntersect(b, a));
+        }
+        else if(dist == 0.0)
+        {
+            BOOST_CHECK(TrianglesIntersect(a, b));
+            BOOST_CHECK(TrianglesIntersect(b, a));
+            ++numIntersecting;
+        }
+    }
+    BOOST_CHECK(numIntersecting > 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_SameAsBruteForce)
+{
+    auto mesh = GetMesh();
+    const TriMeshProxQueryV4 query(mesh);
+    const MeshPairQueries serial(query, query);
+    const MeshPairQueries parallel(query, query, std::make_shared<ThreadPool>(3));
+
+    // The rabbit is about 1.5 across, so these overlap
+    for(const double distance : {0.2, 0.6, 1.0})
+    {
+        const RigidTransform transform = RandomTransform(distance);
+        const std::vector<TrianglePair> expected = BruteForceOverlaps(*mesh, *mesh, transform);
+        const std::vector<TrianglePair> pairs = serial.CalculateOverlaps(transform);
+        BOOST_CHECK(pairs == expected);
+        BOOST_CHECK(parallel.CalculateOverlaps(transform) == expected);
+        BOOST_CHECK_EQUAL(serial.CalculateAnyOverlap(transform), !expected.empty());
+        BOOST_CHECK_EQUAL(parallel.CalculateAnyOverlap(transform), !expected.empty());
+
+        // Overlapping meshes are at distance zero
+        if(!expected.empty())
+        {
+            BOOST_CHECK_EQUAL(serial.CalculateMinDistance(transform).Dist, 0.0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestMeshOverlap_Apart)
+{
+    auto mesh = GetMesh();
+    const TriMeshProxQueryV4 query(mesh);
+    const MeshPairQueries pair(query, query, std::make_shared<ThreadPool>(3));
+
+    const RigidTransform transform = RandomTransform(3.0);
+    BOOST_CHECK(!pair.CalculateAnyOverlap(transform));
+    BOOST_CHECK(pair.CalculateOverlaps(transform).empty());
+
+    // Without a transform, every triangle touches itself and its neighbours
+    BOOST_CHECK(pair.CalculateAnyOverlap());
+    const std::vector<TrianglePair> self = pair.CalculateOverlaps();
+    BOOST_CHECK(self.size() > mesh->GetPolygons().size());
+    for(std::size_t i = 0; i < mesh->GetPolygons().size(); ++i)
+    {
+        BOOST_CHECK(std::binary_search(self.begin(), self.end(), TrianglePair(static_cast<int>(i), static_cast<int>(i))));
+    }
+}
@@ -0,0 +1,116 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV2.h"
+#include "TriMeshProxQueryV4.h"
+#include "ParallelProximityQueries.h"
+#define BOOST_TEST_MODULE Test_ParallelProximityQueries
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_POINTS = 5000;  ///< Number of points in a batch
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    struct BatchResults
+    {
+        BatchResults():
+            closestPoints(NUM_POINTS),
+            distances(NUM_POINTS),
+            foundPoints(new bool[NUM_POINTS]),
+            triIndices(NUM_POINTS){}
+
+        ClosestPointBatchResults<Vec3> Get()
+        {
+            return ClosestPointBatchResults<Vec3>(closestPoints.data(), distances.data(),
+                                                  foundPoints.get(), triIndices.data());
+        }
+
+        std::vector<Vec3> closestPoints;
+        std::vector<double> distances;
+        std::unique_ptr<bool[]> foundPoints;
+        std::vector<int> triIndices;
+    };
+
+    // Results must be bit for bit the same as answering the batch on a single thread
+    void CheckSame(const BatchResults& a, const BatchResults& b)
+    {
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            BOOST_CHECK(a.foundPoints[i] == b.foundPoints[i]);
+            BOOST_CHECK(a.distances[i] == b.distances[i]);
+            BOOST_CHECK(a.triIndices[i] == b.triIndices[i]);
+            BOOST_CHECK(a.closestPoints[i].X() == b.closestPoints[i].X() &&
+                        a.closestPoints[i].Y() == b.closestPoints[i].Y() &&
+                        a.closestPoints[i].Z() == b.closestPoints[i].Z());
+        }
+    }
+
+    template<typename ProximityQueryMethod>
+    void CheckParallelQueries(const ProximityQueryMethod& method)
+    {
+        std::vector<Vec3> points(NUM_POINTS);
+        std::vector<double> thresholds(NUM_POINTS);
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            points[i] = Vec3(real_rand(), real_rand(), real_rand());
+            thresholds[i] = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+        }
+
+        BatchResults serial;
+        method.CalculateClosestPoints(points.data(), points.size(), thresholds.data(), serial.Get());
+
+        for(unsigned numThreads : {0u, 1u, 4u})
+        {
+            auto pool = std::make_shared<ThreadPool>(numThreads);
+            for(std::size_t grainSize : {1u, 64u, 100000u})
+            {
+                ParallelProximityQueries<ProximityQueryMethod> parallel(method, pool, grainSize);
+                BatchResults results;
+                parallel.CalculateClosestPoints(points.data(), points.size(), thresholds.data(), results.Get());
+                CheckSame(serial, results);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelProximityQueries_SameAsSerial)
+{
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    const TriMeshProxQueryV2 proximityQueriesV2(mesh);
+    const TriMeshProxQueryV4 proximityQueriesV4(mesh);
+    CheckParallelQueries(proximityQueriesV2);
+    CheckParallelQueries(proximityQueriesV4);
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelProximityQueries_SharedThreshold)
+{
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    const TriMeshProxQueryV4 proximityQueries(mesh);
+    ParallelProximityQueries<TriMeshProxQueryV4> parallel(proximityQueries, std::make_shared<ThreadPool>(2), 16);
+
+    // Same reference point as used for testing the proximity query methods
+    const Vec3 testPoint = Vec3(0.5204630973461957,   0.7220916475699011,   0.0396895110889990);
+    const double expectedDist = 0.518362283032093;
+    const std::vector<Vec3> points(100, testPoint);
+
+    std::vector<double> distances(points.size());
+    std::unique_ptr<bool[]> foundPoints(new bool[points.size()]);
+    parallel.CalculateClosestPoints(points.data(), points.size(), 0.6,
+                                    ClosestPointBatchResults<Vec3>(nullptr, distances.data(), foundPoints.get()));
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        BOOST_CHECK(foundPoints[i]);
+        BOOST_CHECK(std::abs(distances[i] - expectedDist) < 0.000000001);
+    }
+}
@@ -0,0 +1,93 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include "Mesh.h"
+#include "ProximityTracker.h"
+#include "TriMeshProxQueryV3.h"
+#include "TriMeshProxQueryV4.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_ProximityTracker
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_STEPS = 1000;  ///< Number of steps along the path of the probe
+    const double STEP_SIZE = 1e-3;    ///< Length of each step
+
+    // A random walk with small steps, starting somewhere in the box around the rabbit
+    std::vector<Vec3> GetProbePath()
+    {
+        std::vector<Vec3> path(1, Vec3(0.5*RandomReal(), 0.5*RandomReal(), 0.5*RandomReal()));
+        for(unsigned i = 1; i < NUM_STEPS; ++i)
+        {
+            const Vec3 direction = Vec3(RandomReal(), RandomReal(), RandomReal()) + Vec3(0.5, 0.0, 0.0);
+            path.push_back(path.back() + direction.normalise()*STEP_SIZE);
+        }
+        return path;
+    }
+
+    // The tracker has to give the same results as the method it uses
+    template<typename ProximityQueryMethod>
+    void CheckSameResults(const ProximityQueryMethod& method,
+                          ProximityTracker<ProximityQueryMethod>& tracker,
+                          const std::vector<Vec3>& path,
+                          double distThreshold)
+    {
+        for(const Vec3& point : path)
+        {
+            const ClosestPointResult<Vec3> expected = method.CalculateClosestPointImpl(point, distThreshold);
+            const ClosestPointResult<Vec3> res = tracker.CalculateClosestPointImpl(point, distThreshold);
+            BOOST_CHECK(expected.Found() == res.Found());
+            BOOST_CHECK(expected.Dist == res.Dist);
+            BOOST_CHECK(expected.Point.isSameAs(res.Point));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestProximityTracker_SameResults)
+{
+    std::shared_ptr<TriMesh> mesh = GetMesh();
+    TriMeshProxQueryV4 proximityQueries(mesh);
+    const std::vector<Vec3> path = GetProbePath();
+
+    ProximityTracker<TriMeshProxQueryV4> tracker(proximityQueries);
+    CheckSameResults(proximityQueries, tracker, path, std::numeric_limits<double>::max());
+
+    // Small steps keep the previous closest point close to the new one
+    const TrackerStats& stats = tracker.GetStats();
+    BOOST_CHECK(stats.NumQueries == NUM_STEPS);
+    BOOST_CHECK(stats.NumWarmStarts == NUM_STEPS - 1);
+    BOOST_CHECK(stats.GetHitRate() > 0.9);
+
+    // The bound is never used when it is looser than the threshold
+    tracker.Reset();
+    tracker.ResetStats();
+    CheckSameResults(proximityQueries, tracker, path, 0.01);
+    BOOST_CHECK(stats.NumQueries == NUM_STEPS);
+    BOOST_CHECK(stats.NumHits <= stats.NumWarmStarts);
+}
+
+BOOST_AUTO_TEST_CASE(TestProximityTracker_PreviousTriangle)
+{
+    std::shared_ptr<TriMesh> mesh = GetMesh();
+    TriMeshProxQueryV3 proximityQueries(mesh);
+    const std::vector<Vec3> path = GetProbePath();
+    const std::vector<Triangle<Vec3>>& triangles = mesh->GetPolygons();
+
+    ProximityTracker<TriMeshProxQueryV3> tracker(proximityQueries, [&triangles](std::size_t i){return triangles[i];});
+    CheckSameResults(proximityQueries, tracker, path, std::numeric_limits<double>::max());
+    BOOST_CHECK(tracker.GetStats().GetHitRate() > 0.9);
+
+    // Without a previous result there is nothing to start from
+    tracker.Reset();
+    tracker.ResetStats();
+    tracker.CalculateClosestPoint(path.front(), std::numeric_limits<double>::max());
+    BOOST_CHECK(tracker.GetStats().NumQueries == 1);
+    BOOST_CHECK(tracker.GetStats().NumWarmStarts == 0);
+    BOOST_CHECK(tracker.GetStats().GetHitRate() == 0.0);
+}
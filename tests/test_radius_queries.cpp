@@ -0,0 +1,104 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include <map>
+#include <cmath>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV4.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_RadiusQueries
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const double SOA_TOLERANCE = 1e-6;      ///< TriangleSoA and Triangle may differ by this much, see TriangleSoA
+
+    // Checks the results of a radius query against the distances to all the triangles. Triangles
+    // within the tolerance of the radius may or may not be found.
+    template<typename ProximityQueryMethod>
+    void CheckRadiusQuery(const TriMesh& mesh,
+                          const ProximityQueryMethod& method,
+                          const Vec3& point,
+                          double radius,
+                          double tolerance)
+    {
+        std::map<int, ClosestPointResult<Vec3>> found;
+        const std::size_t numFound = method.CalculatePolygonsWithinRadius(point, radius, [&found](const ClosestPointResult<Vec3>& res)
+        {
+            BOOST_CHECK(found.insert(std::make_pair(res.PolygonIndex, res)).second);
+        });
+        BOOST_CHECK(numFound == found.size());
+
+        const std::vector<Triangle<Vec3>>& triangles = mesh.GetPolygons();
+        for(std::size_t i = 0; i < triangles.size(); ++i)
+        {
+            const IntersectionResult<Vec3> expected = triangles[i].CalcShortestDistanceFrom(point, std::numeric_limits<double>::max());
+            auto it = found.find(static_cast<int>(i));
+            if(it == found.end())
+            {
+                BOOST_CHECK(expected.Dist >= radius - tolerance);
+                continue;
+            }
+            BOOST_CHECK(it->second.Dist < radius);
+            BOOST_CHECK(std::abs(it->second.Dist - expected.Dist) <= tolerance);
+            BOOST_CHECK(std::abs(it->second.Dist - (it->second.Point - point).magnitude()) <= 1e-12);
+        }
+
+        // Stops at the first triangle, which exists if the closest one is within the radius
+        const ClosestPointResult<Vec3> closest = method.CalculateClosestPointImpl(point, radius);
+        BOOST_CHECK(method.IsAnyPolygonWithinRadius(point, radius) == closest.Found());
+        BOOST_CHECK(closest.Found() == (numFound != 0));
+    }
+
+    template<typename ProximityQueryMethod>
+    void CheckRadiusQueries(const TriMesh& mesh, const ProximityQueryMethod& method, double tolerance)
+    {
+        for(unsigned i = 0; i < 100; ++i)
+        {
+            const Vec3 testPoint(0.2*RandomReal(), 0.2*RandomReal(), 0.2*RandomReal());
+            for(double radius : {0.0, 0.01, 0.05, 0.2, std::numeric_limits<double>::max()})
+            {
+                CheckRadiusQuery(mesh, method, testPoint, radius, tolerance);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRadiusQueries_V1)
+{
+    auto mesh = GetMesh();
+    CheckRadiusQueries(*mesh, TriMeshProxQueryV1(mesh), 0.0);
+    CheckRadiusQueries(*mesh, TriMeshProxQueryV1(mesh, TrianglePrecomputation::QueryRecords), SOA_TOLERANCE);
+    CheckRadiusQueries(*mesh, TriMeshProxQueryV1(std::make_shared<CompactTriangleMesh>(*mesh)), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRadiusQueries_V4)
+{
+    auto mesh = GetMesh();
+    CheckRadiusQueries(*mesh, TriMeshProxQueryV4(mesh), SOA_TOLERANCE);
+    CheckRadiusQueries(*mesh, TriMeshProxQueryV4(CompactTriangleMesh(*mesh), BVHBuildParams(1)), SOA_TOLERANCE);
+}
+
+BOOST_AUTO_TEST_CASE(TestRadiusQueries_AllTriangles)
+{
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 v1(mesh);
+    TriMeshProxQueryV4 v4(mesh);
+    const Vec3 testPoint(RandomReal(), RandomReal(), RandomReal());
+    const double radius = std::numeric_limits<double>::max();
+    std::vector<int> counts(mesh->GetPolygons().size(), 0);
+    auto count = [&counts](const ClosestPointResult<Vec3>& res){++counts[res.PolygonIndex];};
+    BOOST_CHECK(v1.CalculatePolygonsWithinRadius(testPoint, radius, count) == counts.size());
+    BOOST_CHECK(v4.CalculatePolygonsWithinRadius(testPoint, radius, count) == counts.size());
+    for(int n : counts)
+    {
+        BOOST_CHECK(n == 2);
+    }
+}
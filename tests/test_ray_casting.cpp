@@ -0,0 +1,182 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include "Mesh.h"
+#include "Ray.h"
+#include "CompactTriangleMesh.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV4.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_RayCasting
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    const unsigned NUM_RAYS = 1000;   ///< Number of random rays checked
+    const double TOLERANCE = 1e-9;    ///< Both kernels round differently
+
+    Vec3 RandomDirection()
+    {
+        return Vec3(RandomReal(), RandomReal(), RandomReal()).normalise();
+    }
+
+    // Rays from random points through random points near the rabbit, so most of them hit
+    std::vector<Ray<Vec3>> GetRandomRays()
+    {
+        std::vector<Ray<Vec3>> rays;
+        for(unsigned i = 0; i < NUM_RAYS; ++i)
+        {
+            const Vec3 origin(RandomReal(), RandomReal(), RandomReal());
+            const Vec3 target(0.1*RandomReal(), 0.1*RandomReal(), 0.1*RandomReal());
+            rays.push_back(Ray<Vec3>(origin, target - origin));
+        }
+        return rays;
+    }
+
+    // Bundles of rays from a common origin within a narrow cone
+    std::vector<Ray<Vec3>> GetCoherentRays()
+    {
+        std::vector<Ray<Vec3>> rays;
+        for(unsigned bundle = 0; bundle < NUM_RAYS/50; ++bundle)
+        {
+            const Vec3 origin = RandomDirection()*0.5;
+            const Vec3 axis = origin*(-1.0);
+            for(unsigned i = 0; i < 50; ++i)
+            {
+                rays.push_back(Ray<Vec3>(origin, axis + RandomDirection()*0.1));
+            }
+        }
+        return rays;
+    }
+
+    bool IsSameHit(const RayCastResult<Vec3>& expected, const RayCastResult<Vec3>& actual)
+    {
+        if(expected.Found() != actual.Found())
+        {
+            return false;
+        }
+        if(!expected.Found())
+        {
+            return expected.Dist == actual.Dist;
+        }
+        // Rays hitting a shared edge may report either triangle
+        return std::abs(expected.Dist - actual.Dist) <= TOLERANCE*expected.Dist &&
+               (expected.PolygonIndex == actual.PolygonIndex || std::abs(expected.Dist - actual.Dist) <= TOLERANCE) &&
+               expected.Point.isSameAs(actual.Point, TOLERANCE);
+    }
+
+    template<typename ProximityQueryMethod>
+    void CheckRays(const TriMeshProxQueryV1& reference,
+                   const ProximityQueryMethod& method,
+                   const std::vector<Ray<Vec3>>& rays)
+    {
+        const double maxDist = std::numeric_limits<double>::max();
+        std::vector<RayCastResult<Vec3>> results(rays.size());
+        method.CastRays(rays.data(), rays.size(), maxDist, results.data());
+        unsigned numHits = 0;
+        for(std::size_t i = 0; i < rays.size(); ++i)
+        {
+            const RayCastResult<Vec3> expected = reference.CastRay(rays[i]);
+            const RayCastResult<Vec3> res = method.CastRay(rays[i], maxDist);
+            BOOST_CHECK(IsSameHit(expected, res));
+            BOOST_CHECK(IsSameHit(expected, results[i]));
+            BOOST_CHECK(method.IsRayBlocked(rays[i], maxDist) == expected.Found());
+            if(!expected.Found())
+            {
+                continue;
+            }
+            ++numHits;
+
+            // Hits exactly at the maximum distance are ignored
+            const Vec3 hitPoint = rays[i].Origin + rays[i].Direction*res.Dist;
+            BOOST_CHECK(res.Point.isSameAs(hitPoint, TOLERANCE));
+            BOOST_CHECK(!method.CastRay(rays[i], res.Dist).Found());
+            BOOST_CHECK(method.CastRay(rays[i], res.Dist*(1.0 + TOLERANCE)).Found());
+        }
+        BOOST_CHECK(numHits > rays.size()/4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRayCasting_Triangle)
+{
+    const Triangle<Vec3> t(Vec3(0, 0, 0), Vec3(1, 0, 0), Vec3(0, 1, 0));
+    const double maxDist = std::numeric_limits<double>::max();
+
+    // Straight down onto the triangle, from either side
+    IntersectionResult<Vec3> res = t.IntersectRay(Vec3(0.25, 0.25, 2.0), Vec3(0, 0, -1), maxDist);
+    BOOST_CHECK(res.Dist == 2.0);
+    BOOST_CHECK(res.Point.isSameAs(Vec3(0.25, 0.25, 0.0), 1e-15));
+    res = t.IntersectRay(Vec3(0.25, 0.25, -1.0), Vec3(0, 0, 4), maxDist);
+    BOOST_CHECK(res.Dist == 0.25);
+
+    // Misses beside the triangle, behind the origin, in its plane and beyond maxDist
+    BOOST_CHECK(t.IntersectRay(Vec3(0.75, 0.75, 1.0), Vec3(0, 0, -1), maxDist).Dist == maxDist);
+    BOOST_CHECK(t.IntersectRay(Vec3(0.25, 0.25, 1.0), Vec3(0, 0, 1), maxDist).Dist == maxDist);
+    BOOST_CHECK(t.IntersectRay(Vec3(-1.0, 0.25, 0.0), Vec3(1, 0, 0), maxDist).Dist == maxDist);
+    BOOST_CHECK(t.IntersectRay(Vec3(0.25, 0.25, 1.0), Vec3(0, 0, -1), 1.0).Dist == maxDist);
+    BOOST_CHECK(t.IntersectRay(Vec3(0.25, 0.25, 1.0), Vec3(0, 0, -1), 1.5).Dist == 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRayCasting_V1)
+{
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 reference(mesh);
+    CheckRays(reference, TriMeshProxQueryV1(std::make_shared<CompactTriangleMesh>(*mesh)), GetRandomRays());
+}
+
+BOOST_AUTO_TEST_CASE(TestRayCasting_V4)
+{
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 reference(mesh);
+    for(const std::vector<Ray<Vec3>>& rays : {GetRandomRays(), GetCoherentRays()})
+    {
+        CheckRays(reference, TriMeshProxQueryV4(mesh), rays);
+        CheckRays(reference, TriMeshProxQueryV4(CompactTriangleMesh(*mesh), BVHBuildParams(1)), rays);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRayCasting_CoherentRays)
+{
+    auto mesh = GetMesh();
+    TriMeshProxQueryV4 queries(mesh);
+    for(const std::vector<Ray<Vec3>>& rays : {GetRandomRays(), GetCoherentRays()})
+    {
+        // Batches which do not fill the last bundle, down to a single ray
+        for(std::size_t numRays : {rays.size(), std::size_t(17), std::size_t(1)})
+        {
+            for(double maxDist : {std::numeric_limits<double>::max(), 0.5})
+            {
+                std::vector<RayCastResult<Vec3>> expected(numRays);
+                std::vector<RayCastResult<Vec3>> results(numRays);
+                queries.CastRays(rays.data(), numRays, maxDist, expected.data());
+                queries.CastCoherentRays(rays.data(), numRays, maxDist, results.data());
+                for(std::size_t i = 0; i < numRays; ++i)
+                {
+                    BOOST_CHECK(IsSameHit(expected[i], results[i]));
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRayCasting_TowardsClosestPoint)
+{
+    // Nothing can be hit before the closest point on the mesh, as that point would be closer
+    auto mesh = GetMesh();
+    TriMeshProxQueryV4 queries(mesh);
+    for(unsigned i = 0; i < NUM_RAYS; ++i)
+    {
+        const Vec3 testPoint(RandomReal(), RandomReal(), RandomReal());
+        const ClosestPointResult<Vec3> closest = queries.CalculateClosestPointImpl(testPoint, std::numeric_limits<double>::max());
+        const Ray<Vec3> ray(testPoint, closest.Point - testPoint);
+        BOOST_CHECK(!queries.IsRayBlocked(ray, 1.0 - 1e-6));
+        const RayCastResult<Vec3> hit = queries.CastRay(ray, 2.0);
+        BOOST_CHECK(!hit.Found() || hit.Dist >= 1.0 - 1e-6);
+    }
+}
@@ -0,0 +1,213 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV4.h"
+#include "ThreadPool.h"
+#define BOOST_TEST_MODULE Test_RefitBVH
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_POINTS = 1000; ///< Number of random points checked
+    const double TOLERANCE = 1e-12;
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    Vec3 RandomPoint(double scale)
+    {
+        return Vec3(scale*real_rand(), scale*real_rand(), scale*real_rand());
+    }
+
+    // Bends and stretches the mesh. Shared vertices move alike, so the topology is kept.
+    Vec3 Deform(const Vec3& p, double amount)
+    {
+        const double angle = amount*p.Y()*3.0;
+        const double c = std::cos(angle);
+        const double s = std::sin(angle);
+        return Vec3(c*p.X() - s*p.Z(), p.Y()*(1.0 + amount), s*p.X() + c*p.Z());
+    }
+
+    // Copy of mesh with every vertex deformed
+    void DeformMesh(const CompactTriangleMesh& mesh, double amount, CompactTriangleMesh& deformed)
+    {
+        deformed.Reserve(mesh.GetNumTriangles());
+        for(std::size_t i = 0; i < mesh.GetNumTriangles(); ++i)
+        {
+            deformed.PushBack(Deform(mesh.GetVertex(i, zero), amount),
+                              Deform(mesh.GetVertex(i, one), amount),
+                              Deform(mesh.GetVertex(i, two), amount));
+        }
+    }
+
+    // Flat sheet in the xy plane, two triangles per cell
+    void AddGrid(CompactTriangleMesh& mesh, unsigned n)
+    {
+        for(unsigned i = 0; i < n; ++i)
+        {
+            for(unsigned j = 0; j < n; ++j)
+            {
+                const Vec3 a(double(i)/n, double(j)/n, 0.0);
+                const Vec3 b(double(i + 1)/n, double(j)/n, 0.0);
+                const Vec3 c(double(i + 1)/n, double(j + 1)/n, 0.0);
+                const Vec3 d(double(i)/n, double(j + 1)/n, 0.0);
+                mesh.PushBack(a, b, c);
+                mesh.PushBack(a, c, d);
+            }
+        }
+    }
+
+    // Every leaf encloses its triangles and every interior node its children
+    void CheckEnclosing(const TriMeshProxQueryV4& query)
+    {
+        const std::vector<LinearBVHNode>& nodes = query.GetBVH().GetNodes();
+        const TriangleSoA& triangles = query.GetTriangles();
+        for(std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            const LinearBVHNode& node = nodes[i];
+            if(node.IsLeaf())
+            {
+                double boundsMin[3];
+                double boundsMax[3];
+                triangles.CalcBounds(node.Offset, node.Count, boundsMin, boundsMax);
+                for(unsigned axis = 0; axis < 3; ++axis)
+                {
+                    BOOST_CHECK(node.BoundsMin[axis] <= boundsMin[axis]);
+                    BOOST_CHECK(node.BoundsMax[axis] >= boundsMax[axis]);
+                }
+                continue;
+            }
+            for(const LinearBVHNode* child : {&nodes[i + 1], &nodes[node.Offset]})
+            {
+                for(unsigned axis = 0; axis < 3; ++axis)
+                {
+                    BOOST_CHECK(node.BoundsMin[axis] <= child->BoundsMin[axis]);
+                    BOOST_CHECK(node.BoundsMax[axis] >= child->BoundsMax[axis]);
+                }
+            }
+        }
+    }
+
+    // Same closest points and signed distances as a query built from scratch
+    void CheckSameAsBuilt(const TriMeshProxQueryV4& refitted, const CompactTriangleMesh& mesh)
+    {
+        const TriMeshProxQueryV4 built(mesh);
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            const Vec3 p = RandomPoint(1.5);
+            const ClosestPointResult<Vec3> expected = built.CalculateSignedClosestPoint(p, 10.0);
+            const ClosestPointResult<Vec3> res = refitted.CalculateSignedClosestPoint(p, 10.0);
+            BOOST_CHECK_SMALL(res.Dist - expected.Dist, TOLERANCE);
+            BOOST_CHECK(res.Point.isSameAs(expected.Point, 1e-9));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRefitBVH_UpdateVertices)
+{
+    const CompactTriangleMesh mesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    TriMeshProxQueryV4 query(mesh);
+    BOOST_CHECK_SMALL(query.GetRefitCostRatio() - 1.0, TOLERANCE);
+
+    // Follow the mesh over a few frames
+    for(const double amount : {0.1, 0.3, 0.6})
+    {
+        CompactTriangleMesh deformed;
+        DeformMesh(mesh, amount, deformed);
+        query.UpdateVertices(deformed);
+        CheckEnclosing(query);
+        CheckSameAsBuilt(query, deformed);
+    }
+
+    // And back to where it started
+    query.UpdateVertices(mesh);
+    CheckSameAsBuilt(query, mesh);
+    BOOST_CHECK_SMALL(query.GetRefitCostRatio() - 1.0, TOLERANCE);
+
+    CompactTriangleMesh smaller;
+    smaller.PushBack(Vec3(0.0, 0.0, 0.0), Vec3(1.0, 0.0, 0.0), Vec3(0.0, 1.0, 0.0));
+    BOOST_CHECK_THROW(query.UpdateVertices(smaller), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestRefitBVH_Soup)
+{
+    const CompactTriangleMesh mesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    TriMeshProxQueryV4 query(mesh);
+
+    CompactTriangleMesh deformed;
+    DeformMesh(mesh, 0.2, deformed);
+    std::vector<double> coords;
+    for(std::size_t i = 0; i < deformed.GetNumTriangles(); ++i)
+    {
+        for(const ids id : {zero, one, two})
+        {
+            const Vec3 p = deformed.GetVertex(i, id);
+            coords.insert(coords.end(), {p.X(), p.Y(), p.Z()});
+        }
+    }
+    query.UpdateVertices(coords.data(), deformed.GetNumTriangles());
+    CheckSameAsBuilt(query, deformed);
+}
+
+BOOST_AUTO_TEST_CASE(TestRefitBVH_Parallel)
+{
+    // Large enough for the hierarchy to be refitted in parallel
+    CompactTriangleMesh mesh;
+    AddGrid(mesh, 100);
+    CompactTriangleMesh deformed;
+    DeformMesh(mesh, 0.5, deformed);
+
+    TriMeshProxQueryV4 serial(mesh);
+    TriMeshProxQueryV4 parallel(mesh);
+    serial.UpdateVertices(deformed);
+    parallel.UpdateVertices(deformed, std::make_shared<ThreadPool>(3));
+    CheckEnclosing(parallel);
+
+    const std::vector<LinearBVHNode>& expected = serial.GetBVH().GetNodes();
+    const std::vector<LinearBVHNode>& nodes = parallel.GetBVH().GetNodes();
+    BOOST_REQUIRE_EQUAL(nodes.size(), expected.size());
+    for(std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        BOOST_CHECK(std::equal(nodes[i].BoundsMin, nodes[i].BoundsMin + 3, expected[i].BoundsMin));
+        BOOST_CHECK(std::equal(nodes[i].BoundsMax, nodes[i].BoundsMax + 3, expected[i].BoundsMax));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestRefitBVH_Rebuild)
+{
+    const CompactTriangleMesh mesh(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    TriMeshProxQueryV4 query(mesh);
+
+    // Twisting the mesh hard pulls apart the triangles the hierarchy grouped together
+    CompactTriangleMesh deformed;
+    DeformMesh(mesh, 2.0, deformed);
+    query.UpdateVertices(deformed);
+    const double degraded = query.GetRefitCostRatio();
+    BOOST_CHECK(degraded > 1.0);
+
+    query.RebuildBVH();
+    BOOST_CHECK_SMALL(query.GetRefitCostRatio() - 1.0, TOLERANCE);
+    CheckEnclosing(query);
+    CheckSameAsBuilt(query, deformed);
+
+    // Polygon indices still refer to the original mesh
+    for(unsigned i = 0; i < NUM_POINTS; ++i)
+    {
+        const Vec3 p = RandomPoint(1.5);
+        const ClosestPointResult<Vec3> res = query.CalculateClosestPointImpl(p, 10.0);
+        const Triangle<Vec3> t = deformed.GetTriangle(res.PolygonIndex);
+        BOOST_CHECK_SMALL(t.CalcShortestDistanceFrom(p, 10.0).Dist - res.Dist, 1e-9);
+    }
+}
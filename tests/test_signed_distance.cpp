@@ -0,0 +1,278 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "IndexedTriangleMesh.h"
+#include "TrianglePseudonormals.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV4.h"
+#define BOOST_TEST_MODULE Test_SignedDistance
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_POINTS = 2000; ///< Number of random points checked
+    const double TOLERANCE = 1e-9;    ///< Distances closer to the surface than this have no reliable sign
+    const double PI = 3.14159265358979323846;
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    // Cube of side 2 around the origin, two triangles per face wound counter clockwise seen from outside
+    void AddCube(CompactTriangleMesh& mesh)
+    {
+        for(unsigned axis = 0; axis < 3; ++axis)
+        {
+            for(double side : {-1.0, 1.0})
+            {
+                double corners[4][3];
+                const double u[4] = {-1.0, 1.0, 1.0, -1.0};
+                const double v[4] = {-1.0, -1.0, 1.0, 1.0};
+                for(unsigned k = 0; k < 4; ++k)
+                {
+                    corners[k][axis] = side;
+                    corners[k][(axis + 1)%3] = side*u[k];
+                    corners[k][(axis + 2)%3] = v[k];
+                }
+                const Vec3 c[4] = {Vec3(corners[0][0], corners[0][1], corners[0][2]),
+                                   Vec3(corners[1][0], corners[1][1], corners[1][2]),
+                                   Vec3(corners[2][0], corners[2][1], corners[2][2]),
+                                   Vec3(corners[3][0], corners[3][1], corners[3][2])};
+                mesh.PushBack(c[0], c[1], c[2]);
+                mesh.PushBack(c[0], c[2], c[3]);
+            }
+        }
+    }
+
+    // Torus around the z axis, which has concave edges and vertices on its inner side
+    void AddTorus(CompactTriangleMesh& mesh, double R, double r, unsigned numU, unsigned numV)
+    {
+        auto vertex = [=](unsigned i, unsigned j)
+        {
+            const double u = 2.0*PI*(i%numU)/numU;
+            const double v = 2.0*PI*(j%numV)/numV;
+            return Vec3((R + r*cos(v))*cos(u), (R + r*cos(v))*sin(u), r*sin(v));
+        };
+        for(unsigned i = 0; i < numU; ++i)
+        {
+            for(unsigned j = 0; j < numV; ++j)
+            {
+                mesh.PushBack(vertex(i, j), vertex(i + 1, j), vertex(i + 1, j + 1));
+                mesh.PushBack(vertex(i, j), vertex(i + 1, j + 1), vertex(i, j + 1));
+            }
+        }
+    }
+
+    // Generalised winding number of the mesh around point: 1 inside a closed mesh, 0 outside
+    double WindingNumber(const CompactTriangleMesh& mesh, const Vec3& point)
+    {
+        double solidAngle = 0.0;
+        for(std::size_t i = 0; i < mesh.GetNumTriangles(); ++i)
+        {
+            const Vec3 a = mesh.GetVertex(i, zero) - point;
+            const Vec3 b = mesh.GetVertex(i, one) - point;
+            const Vec3 c = mesh.GetVertex(i, two) - point;
+            const double la = a.magnitude(), lb = b.magnitude(), lc = c.magnitude();
+            const double num = Vec3::dotProduct(a, Vec3::crossProduct(b, c));
+            const double den = la*lb*lc + Vec3::dotProduct(a, b)*lc + Vec3::dotProduct(a, c)*lb + Vec3::dotProduct(b, c)*la;
+            solidAngle += 2.0*atan2(num, den);
+        }
+        return solidAngle/(4.0*PI);
+    }
+
+    // Checks the signs of the distances to random points against the winding number
+    void CheckSigns(const CompactTriangleMesh& mesh, double scale)
+    {
+        TriMeshProxQueryV4 query(mesh);
+        unsigned numInside = 0;
+        for(unsigned i = 0; i < NUM_POINTS; ++i)
+        {
+            const Vec3 point(scale*real_rand(), scale*real_rand(), scale*real_rand());
+            const ClosestPointResult<Vec3> res = query.CalculateSignedClosestPoint(point, 10.0*scale);
+            BOOST_CHECK(res.Found());
+            if(fabs(res.Dist) < TOLERANCE)
+            {
+                continue;
+            }
+            const bool inside = WindingNumber(mesh, point) > 0.5;
+            BOOST_CHECK_EQUAL(res.Dist < 0.0, inside);
+            numInside += inside ? 1 : 0;
+        }
+        BOOST_CHECK(numInside > 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_Cube)
+{
+    CompactTriangleMesh mesh;
+    AddCube(mesh);
+    TriMeshProxQueryV4 query(mesh);
+
+    // Exact signed distance to the box, with points closest to faces, edges and corners
+    for(unsigned i = 0; i < NUM_POINTS; ++i)
+    {
+        const Vec3 point(2.0*real_rand(), 2.0*real_rand(), 2.0*real_rand());
+        const double q[3] = {fabs(point.X()) - 1.0, fabs(point.Y()) - 1.0, fabs(point.Z()) - 1.0};
+        const double outside = Vec3(std::max(q[0], 0.0), std::max(q[1], 0.0), std::max(q[2], 0.0)).magnitude();
+        const double expected = outside + std::min(std::max(q[0], std::max(q[1], q[2])), 0.0);
+
+        const ClosestPointResult<Vec3> res = query.CalculateSignedClosestPoint(point, 10.0);
+        BOOST_CHECK(res.Found());
+        BOOST_CHECK_SMALL(res.Dist - expected, 1e-9);
+    }
+
+    // Just off the corners and edges, where the face normals disagree about the sign
+    BOOST_CHECK(query.CalculateSignedClosestPoint(Vec3(1.1, 1.1, 1.1), 10.0).Dist > 0.0);
+    BOOST_CHECK(query.CalculateSignedClosestPoint(Vec3(1.1, 1.1, 0.3), 10.0).Dist > 0.0);
+    BOOST_CHECK(query.CalculateSignedClosestPoint(Vec3(0.99, 0.98, 0.995), 10.0).Dist < 0.0);
+
+    // Nothing within the threshold, the distance is the threshold
+    const ClosestPointResult<Vec3> none = query.CalculateSignedClosestPoint(Vec3(5.0, 0.0, 0.0), 1.0);
+    BOOST_CHECK(!none.Found());
+    BOOST_CHECK_EQUAL(none.Dist, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_FlatTetrahedron)
+{
+    // Neighbouring faces of a flat tetrahedron point almost opposite ways, so points off its
+    // edges get the wrong sign from the normal of either face alone. The vertices are rounded
+    // when stored as P0 plus the edges, yet are still shared by the faces meeting there. The
+    // first signed queries run on several threads at once.
+    const Vec3 centre(0.1, 0.7, 0.3);
+    const Vec3 v[4] = {centre + Vec3(-1.0, -0.6, -0.1), centre + Vec3(1.0, -0.6, -0.1),
+                       centre + Vec3(0.0, 1.1, -0.1), centre + Vec3(0.1, 0.0, 0.15)};
+    CompactTriangleMesh mesh;
+    mesh.PushBack(v[0], v[2], v[1]);
+    mesh.PushBack(v[0], v[1], v[3]);
+    mesh.PushBack(v[1], v[2], v[3]);
+    mesh.PushBack(v[2], v[0], v[3]);
+    const TriMeshProxQueryV4 query(mesh);
+
+    std::vector<Vec3> points(NUM_POINTS);
+    for(Vec3& point : points)
+    {
+        point = centre + Vec3(1.5*real_rand(), 1.5*real_rand(), 0.5*real_rand());
+    }
+    std::vector<int> numWrong(4, 0);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < numWrong.size(); ++t)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for(const Vec3& point : points)
+            {
+                const ClosestPointResult<Vec3> res = query.CalculateSignedClosestPoint(point, 10.0);
+                if(fabs(res.Dist) >= TOLERANCE && (res.Dist < 0.0) != (WindingNumber(mesh, point) > 0.5))
+                {
+                    ++numWrong[t];
+                }
+            }
+        });
+    }
+    for(std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    for(int n : numWrong)
+    {
+        BOOST_CHECK_EQUAL(n, 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_Torus)
+{
+    CompactTriangleMesh mesh;
+    AddTorus(mesh, 1.0, 0.4, 48, 24);
+    CheckSigns(mesh, 1.5);
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_TwoTori)
+{
+    // The sign is right for meshes with several closed components
+    CompactTriangleMesh mesh;
+    AddTorus(mesh, 1.0, 0.4, 32, 16);
+    AddTorus(mesh, 0.5, 0.1, 16, 8);
+    CheckSigns(mesh, 1.5);
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_Eager)
+{
+    // Preparing for signed queries up front, or before the first one, gives the same distances
+    CompactTriangleMesh mesh;
+    AddTorus(mesh, 1.0, 0.4, 48, 24);
+    const TriMeshProxQueryV4 lazy(mesh);
+    const TriMeshProxQueryV4 eager(mesh, BVHBuildParams(), nullptr, SignedQueryPreparation::Eager);
+    TriMeshProxQueryV4 prepared(mesh);
+    prepared.PrepareSignedQueries();
+    prepared.PrepareSignedQueries();
+    for(unsigned i = 0; i < NUM_POINTS; ++i)
+    {
+        const Vec3 point(1.5*real_rand(), 1.5*real_rand(), 1.5*real_rand());
+        const double expected = lazy.CalculateSignedClosestPoint(point, 10.0).Dist;
+        BOOST_CHECK_EQUAL(eager.CalculateSignedClosestPoint(point, 10.0).Dist, expected);
+        BOOST_CHECK_EQUAL(prepared.CalculateSignedClosestPoint(point, 10.0).Dist, expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_MagnitudeMatchesUnsigned)
+{
+    // The rabbit is not closed, but the magnitude and closest point never depend on that
+    TriMeshProxQueryV4 query(std::make_shared<TriMesh>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME)));
+    for(unsigned i = 0; i < NUM_POINTS; ++i)
+    {
+        const Vec3 point(real_rand(), real_rand(), real_rand());
+        const ClosestPointResult<Vec3> unsignedRes = query.CalculateClosestPointImpl(point, 0.5);
+        const ClosestPointResult<Vec3> signedRes = query.CalculateSignedClosestPoint(point, 0.5);
+        BOOST_CHECK_EQUAL(signedRes.Found(), unsignedRes.Found());
+        BOOST_CHECK_EQUAL(signedRes.PolygonIndex, unsignedRes.PolygonIndex);
+        BOOST_CHECK_EQUAL(fabs(signedRes.Dist), unsignedRes.Dist);
+        BOOST_CHECK(signedRes.Point.isSameAs(unsignedRes.Point, 1e-12));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestSignedDistance_Pseudonormals)
+{
+    // Pseudonormals of a cube point along the faces, edges and corners
+    CompactTriangleMesh compact;
+    AddCube(compact);
+    std::vector<double> coords;
+    for(std::size_t i = 0; i < compact.GetNumTriangles(); ++i)
+    {
+        for(ids id : {zero, one, two})
+        {
+            const Vec3 p = compact.GetVertex(i, id);
+            coords.insert(coords.end(), {p.X(), p.Y(), p.Z()});
+        }
+    }
+    const IndexedTriangleMesh mesh(coords.data(), compact.GetNumTriangles());
+    BOOST_CHECK_EQUAL(mesh.GetNumVertices(), 8u);
+
+    const TrianglePseudonormals normals(mesh);
+    BOOST_CHECK_EQUAL(normals.Size(), 12u);
+    BOOST_CHECK(normals.GetMemoryUsage() > 0u);
+    for(std::size_t i = 0; i < mesh.GetNumTriangles(); ++i)
+    {
+        const Triangle<Vec3> t = mesh.GetTriangle(i);
+        const double third = 1.0/3.0;
+        const Vec3 faceNormal = normals.GetPseudonormal(i, third, third);
+        BOOST_CHECK(faceNormal.isSameAs(Vec3::crossProduct(t.P0P1(), t.P0P2()).normalise(), 1e-6));
+
+        // Edge pseudonormals are diagonal, vertex pseudonormals point at the corners
+        const Vec3 edgeMid = t.P0() + t.P0P1()*0.5;
+        const Vec3 edgeNormal = normals.GetPseudonormal(i, 0.5, 0.0);
+        const double edgeCos = Vec3::dotProduct(edgeNormal, edgeMid)/edgeMid.magnitude();
+        BOOST_CHECK_SMALL(edgeCos - 1.0, 1e-6);
+        const Vec3 corner = normals.GetPseudonormal(i, 0.0, 1.0);
+        BOOST_CHECK(corner.isSameAs(t.P2()*(1.0/sqrt(3.0)), 1e-6));
+    }
+}
@@ -0,0 +1,100 @@
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <stdexcept>
+#include "ThreadPool.h"
+#define BOOST_TEST_MODULE Test_ThreadPool
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+
+BOOST_AUTO_TEST_CASE(TestThreadPool_ParallelFor)
+{
+    // Every index must be processed exactly once, in chunks no larger than the grain size
+    for(unsigned numThreads : {0u, 1u, 4u})
+    {
+        ThreadPool pool(numThreads);
+        BOOST_CHECK(pool.GetNumThreads() == numThreads);
+        for(std::size_t count : {0u, 1u, 7u, 1000u, 100003u})
+        {
+            for(std::size_t grainSize : {1u, 16u, 1024u})
+            {
+                std::vector<std::atomic<unsigned>> visits(count);
+                for(auto& v : visits) v = 0;
+
+                // Boost.Test may only be called from the main thread
+                std::atomic<unsigned> badChunks(0);
+                pool.ParallelFor(count, grainSize, [&](std::size_t begin, std::size_t end)
+                {
+                    if(!(begin < end && end - begin <= grainSize && end <= count))
+                    {
+                        ++badChunks;
+                        return;
+                    }
+                    for(std::size_t i = begin; i < end; ++i)
+                    {
+                        ++visits[i];
+                    }
+                });
+
+                BOOST_CHECK_EQUAL(badChunks.load(), 0u);
+                for(auto& v : visits)
+                {
+                    BOOST_CHECK(v == 1);
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPool_ConcurrentCallers)
+{
+    // Several threads can share the pool
+    ThreadPool pool(3);
+    std::atomic<std::size_t> sum(0);
+    std::vector<std::thread> callers;
+    for(unsigned i = 0; i < 4; ++i)
+    {
+        callers.emplace_back([&pool, &sum]
+        {
+            pool.ParallelFor(10000, 64, [&sum](std::size_t begin, std::size_t end)
+            {
+                sum += end - begin;
+            });
+        });
+    }
+    for(std::thread& caller : callers)
+    {
+        caller.join();
+    }
+    BOOST_CHECK(sum == 40000);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadPool_Exception)
+{
+    ThreadPool pool(2);
+    std::atomic<std::size_t> processed(0);
+    bool caught = false;
+    try
+    {
+        pool.ParallelFor(1000, 10, [&processed](std::size_t begin, std::size_t end)
+        {
+            processed += end - begin;
+            if(begin == 500)
+            {
+                throw std::runtime_error("Failed");
+            }
+        });
+    }
+    catch(const std::runtime_error&)
+    {
+        caught = true;
+    }
+    BOOST_CHECK(caught);
+
+    // All the other chunks still ran, and the pool is still usable
+    BOOST_CHECK(processed == 1000);
+    pool.ParallelFor(100, 10, [&processed](std::size_t begin, std::size_t end){processed += end - begin;});
+    BOOST_CHECK(processed == 1100);
+}
@@ -0,0 +1,114 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV3.h"
+#define BOOST_TEST_MODULE Test_TriMeshQueryV3
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy(std::string fileName)
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(fileName);
+    }
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    // Checks that every triangle index appears in exactly one leaf of the tree
+    void CountLeafTriangles(const BVHTree::Node* node, std::vector<unsigned>& counts)
+    {
+        if(BVHTree::IsLeaf(node))
+        {
+            for(int i : node->Data().triIndices)
+            {
+                ++counts[i];
+            }
+            return;
+        }
+        BOOST_CHECK(node->GetLeft()->GetParent() == node);
+        BOOST_CHECK(node->GetRight()->GetParent() == node);
+        CountLeafTriangles(node->GetLeft(), counts);
+        CountLeafTriangles(node->GetRight(), counts);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV3_CTor)
+{
+    // Test if the object can be constructed
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV3 proximityQueries(mesh);
+
+    const BVHTree& bvh = proximityQueries.GetBVH();
+    BOOST_CHECK(bvh.GetRoot() != nullptr);
+    BOOST_CHECK(bvh.GetRoot()->GetParent() == nullptr);
+
+    std::vector<unsigned> counts(NUM_TRIANGLES, 0);
+    CountLeafTriangles(bvh.GetRoot(), counts);
+    BOOST_CHECK(std::all_of(counts.begin(), counts.end(), [](unsigned c){return c == 1;}));
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV3_ClosestPoint)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV3 proximityQueries(mesh);
+    Vec3 point;
+    double dist;
+    bool foundPoint;
+
+    // Same reference point as used for testing TriMeshProxQueryV1 and TriMeshProxQueryV2
+    Vec3 testPoint = Vec3(0.5204630973461957,   0.7220916475699011,   0.0396895110889990);
+    Vec3 expectedClosestPoint = Vec3(0.0693250000000000,   0.5797399900000000,  -0.1722300000000000);
+    double expectedDist = 0.518362283032093;
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.5);
+    BOOST_CHECK(foundPoint == false);
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.6);
+    BOOST_CHECK(foundPoint);
+    BOOST_CHECK(std::abs(dist-expectedDist) < 0.000000001);
+    BOOST_CHECK(expectedClosestPoint.isSameAs(point));
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV3_SameAsV1)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+
+    // Check a few different leaf sizes, including one triangle per leaf
+    for(unsigned leafSize : {1u, 4u, 16u})
+    {
+        TriMeshProxQueryV3 proximityQueriesV3(mesh, BVHBuildParams(leafSize));
+        for(unsigned i = 0; i < 200; ++i)
+        {
+            const Vec3 testPoint(real_rand(), real_rand(), real_rand());
+            const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+
+            Vec3 pointV1, pointV3;
+            double distV1, distV3;
+            bool foundV1, foundV3;
+            std::tie(pointV1, distV1, foundV1) = proximityQueriesV1.CalculateClosestPoint(testPoint, threshold);
+            std::tie(pointV3, distV3, foundV3) = proximityQueriesV3.CalculateClosestPoint(testPoint, threshold);
+
+            BOOST_CHECK(foundV1 == foundV3);
+            BOOST_CHECK(std::abs(distV1 - distV3) < EPSILON);
+            if(foundV1)
+            {
+                BOOST_CHECK(pointV1.isSameAs(pointV3));
+            }
+        }
+    }
+}
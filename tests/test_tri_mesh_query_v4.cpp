@@ -0,0 +1,114 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include "Mesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV3.h"
+#include "TriMeshProxQueryV4.h"
+#define BOOST_TEST_MODULE Test_TriMeshQueryV4
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const double TOLERANCE = 1e-8; ///< TriMeshProxQueryV4 uses TriangleSoA, see its documentation
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy(std::string fileName)
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(fileName);
+    }
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV4_CTor)
+{
+    // Test if the object can be constructed
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV4 proximityQueries(mesh);
+
+    const LinearBVH& bvh = proximityQueries.GetBVH();
+    BOOST_CHECK(!bvh.GetNodes().empty());
+    BOOST_CHECK(bvh.GetTriIndices().size() == NUM_TRIANGLES);
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV4_ClosestPoint)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV4 proximityQueries(mesh);
+    Vec3 point;
+    double dist;
+    bool foundPoint;
+
+    // Same reference point as used for testing the other proximity query methods
+    Vec3 testPoint = Vec3(0.5204630973461957,   0.7220916475699011,   0.0396895110889990);
+    Vec3 expectedClosestPoint = Vec3(0.0693250000000000,   0.5797399900000000,  -0.1722300000000000);
+    double expectedDist = 0.518362283032093;
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.5);
+    BOOST_CHECK(foundPoint == false);
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.6);
+    BOOST_CHECK(foundPoint);
+    BOOST_CHECK(std::abs(dist-expectedDist) < 0.000000001);
+    BOOST_CHECK(expectedClosestPoint.isSameAs(point));
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV4_SameAsV3)
+{
+    // Both layouts of the same hierarchy visit the triangles in the same order,
+    // but V4 tests them with the packet kernel of TriangleSoA
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV3 proximityQueriesV3(mesh);
+    TriMeshProxQueryV4 proximityQueriesV4(mesh);
+    for(unsigned i = 0; i < 200; ++i)
+    {
+        const Vec3 testPoint(real_rand(), real_rand(), real_rand());
+        auto resV3 = proximityQueriesV3.CalculateClosestPoint(testPoint, std::numeric_limits<double>::max());
+        auto resV4 = proximityQueriesV4.CalculateClosestPoint(testPoint, std::numeric_limits<double>::max());
+        BOOST_CHECK(std::abs(std::get<1>(resV3) - std::get<1>(resV4)) < TOLERANCE);
+        BOOST_CHECK(std::get<0>(resV3).isSameAs(std::get<0>(resV4), TOLERANCE));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV4_SameAsV1)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+
+    // Check a few different leaf sizes, including one triangle per leaf
+    for(unsigned leafSize : {1u, 4u, 16u})
+    {
+        TriMeshProxQueryV4 proximityQueriesV4(mesh, BVHBuildParams(leafSize));
+        for(unsigned i = 0; i < 200; ++i)
+        {
+            const Vec3 testPoint(real_rand(), real_rand(), real_rand());
+            const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+
+            Vec3 pointV1, pointV4;
+            double distV1, distV4;
+            bool foundV1, foundV4;
+            std::tie(pointV1, distV1, foundV1) = proximityQueriesV1.CalculateClosestPoint(testPoint, threshold);
+            std::tie(pointV4, distV4, foundV4) = proximityQueriesV4.CalculateClosestPoint(testPoint, threshold);
+
+            BOOST_CHECK(foundV1 == foundV4);
+            BOOST_CHECK(std::abs(distV1 - distV4) < TOLERANCE);
+            if(foundV1)
+            {
+                BOOST_CHECK(pointV1.isSameAs(pointV4, TOLERANCE));
+            }
+        }
+    }
+}
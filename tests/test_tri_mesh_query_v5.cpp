@@ -0,0 +1,153 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include "Mesh.h"
+#include "CompactTriangleMesh.h"
+#include "TriangularMeshBuildingPolicy.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV5.h"
+#define BOOST_TEST_MODULE Test_TriMeshQueryV5
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const double TOLERANCE = 1e-8; ///< TriMeshProxQueryV5 uses TriangleSoA, see its documentation
+
+    std::shared_ptr<TriangularMeshBuilingPolicy> GetMeshBuildingPolicy(std::string fileName)
+    {
+        return std::make_shared<TriangularMeshBuilingPolicy>(fileName);
+    }
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(-1.0,1.0), mt19937(seed));
+
+    template<typename ProximityQueries>
+    void CheckSameAsV1(const TriMeshProxQueryV1& proximityQueriesV1,
+                       const ProximityQueries& proximityQueries,
+                       double scale)
+    {
+        for(unsigned i = 0; i < 200; ++i)
+        {
+            const Vec3 testPoint(scale*real_rand(), scale*real_rand(), scale*real_rand());
+            const double threshold = (i % 3 == 0) ? std::numeric_limits<double>::max() : ((i % 3 == 1) ? 0.1 : 0.01);
+
+            Vec3 pointV1, pointV5;
+            double distV1, distV5;
+            bool foundV1, foundV5;
+            std::tie(pointV1, distV1, foundV1) = proximityQueriesV1.CalculateClosestPoint(testPoint, threshold);
+            std::tie(pointV5, distV5, foundV5) = proximityQueries.CalculateClosestPoint(testPoint, threshold);
+
+            BOOST_CHECK(foundV1 == foundV5);
+            BOOST_CHECK(std::abs(distV1 - distV5) < TOLERANCE);
+            if(foundV1)
+            {
+                BOOST_CHECK(pointV1.isSameAs(pointV5, TOLERANCE));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV5_CTor)
+{
+    // Test if the object can be constructed
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV5 proximityQueries(mesh);
+
+    // Each triangle is in at least one cell, and the cells cover the mesh
+    const std::size_t numCells = std::size_t(proximityQueries.GetNumCells(0))*
+                                 proximityQueries.GetNumCells(1)*proximityQueries.GetNumCells(2);
+    BOOST_CHECK(numCells > 1);
+    BOOST_CHECK(numCells <= NUM_TRIANGLES);
+    BOOST_CHECK(proximityQueries.GetNumCellEntries() >= NUM_TRIANGLES);
+    BOOST_CHECK(proximityQueries.GetCellSize() > 0.0);
+
+    // Coarser grids have fewer cells
+    TriMeshProxQueryV5 coarse(mesh, UniformGridParams(64.0));
+    BOOST_CHECK(coarse.GetCellSize() > proximityQueries.GetCellSize());
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV5_ClosestPoint)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV5 proximityQueries(mesh);
+    Vec3 point;
+    double dist;
+    bool foundPoint;
+
+    // Same reference point as used for testing the other proximity query methods
+    Vec3 testPoint = Vec3(0.5204630973461957,   0.7220916475699011,   0.0396895110889990);
+    Vec3 expectedClosestPoint = Vec3(0.0693250000000000,   0.5797399900000000,  -0.1722300000000000);
+    double expectedDist = 0.518362283032093;
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.5);
+    BOOST_CHECK(foundPoint == false);
+
+    std::tie(point, dist, foundPoint) = proximityQueries.CalculateClosestPoint(testPoint, 0.6);
+    BOOST_CHECK(foundPoint);
+    BOOST_CHECK(std::abs(dist-expectedDist) < 0.000000001);
+    BOOST_CHECK(expectedClosestPoint.isSameAs(point));
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV5_SameAsV1)
+{
+    auto buildingPolicy = GetMeshBuildingPolicy(FILE_NAME);
+    std::shared_ptr<TriMesh> mesh = std::make_shared<TriMesh>(buildingPolicy);
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+
+    // Check a few different cell sizes, including a single cell, with points
+    // inside the grid and far outside of it
+    for(double trisPerCell : {0.5, 2.0, 16.0, 1e6})
+    {
+        TriMeshProxQueryV5 proximityQueriesV5(mesh, UniformGridParams(trisPerCell));
+        CheckSameAsV1(proximityQueriesV1, proximityQueriesV5, 1.0);
+        CheckSameAsV1(proximityQueriesV1, proximityQueriesV5, 5.0);
+    }
+
+    // Points on the surface, which is where the grid is supposed to shine
+    TriMeshProxQueryV5 proximityQueriesV5(mesh);
+    for(const Triangle<Vec3>& t : mesh->GetPolygons())
+    {
+        const Vec3 testPoint = t.P0();
+        auto resV1 = proximityQueriesV1.CalculateClosestPoint(testPoint, 0.001);
+        auto resV5 = proximityQueriesV5.CalculateClosestPoint(testPoint, 0.001);
+        BOOST_CHECK(std::get<2>(resV1) && std::get<2>(resV5));
+        BOOST_CHECK(std::abs(std::get<1>(resV1) - std::get<1>(resV5)) < TOLERANCE);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriMeshQueryV5_CompactMesh)
+{
+    auto mesh = std::make_shared<TriMesh>(GetMeshBuildingPolicy(FILE_NAME));
+    TriMeshProxQueryV1 proximityQueriesV1(mesh);
+    CompactTriangleMesh compactMesh(*mesh);
+    TriMeshProxQueryV5 proximityQueriesV5(compactMesh);
+    CheckSameAsV1(proximityQueriesV1, proximityQueriesV5, 1.0);
+
+    // A flat mesh still gets a grid
+    CompactTriangleMesh flatMesh;
+    flatMesh.PushBack(Vec3(0,0,0), Vec3(1,0,0), Vec3(0,1,0));
+    flatMesh.PushBack(Vec3(1,0,0), Vec3(1,1,0), Vec3(0,1,0));
+    TriMeshProxQueryV5 flatQueries(flatMesh);
+    Vec3 point;
+    double dist;
+    bool foundPoint;
+    std::tie(point, dist, foundPoint) = flatQueries.CalculateClosestPoint(Vec3(0.75, 0.75, 2.0), 3.0);
+    BOOST_CHECK(foundPoint);
+    BOOST_CHECK(std::abs(dist - 2.0) < TOLERANCE);
+    BOOST_CHECK(point.isSameAs(Vec3(0.75, 0.75, 0.0), TOLERANCE));
+
+    // And an empty one finds nothing
+    CompactTriangleMesh emptyMesh;
+    TriMeshProxQueryV5 emptyQueries(emptyMesh);
+    std::tie(point, dist, foundPoint) = emptyQueries.CalculateClosestPoint(Vec3(0, 0, 0), 1.0);
+    BOOST_CHECK(!foundPoint);
+}
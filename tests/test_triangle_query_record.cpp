@@ -0,0 +1,119 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include "Mesh.h"
+#include "TriangleQueryRecord.h"
+#include "TriMeshProxQueryV1.h"
+#include "TriMeshProxQueryV3.h"
+#include "TestHelpers.h"
+#define BOOST_TEST_MODULE Test_TriangleQueryRecord
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+using namespace rabbit::test;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(0.0,1.0), mt19937(seed));
+
+    const unsigned NUM_ITERATIONS = 20;
+
+    typedef Triangle<Vec3> Tri;
+
+    /**
+    * Point somewhere in the plane around the triangle, pushed off along the normal.
+    * Covers the inside of the triangle as well as the regions of its edges and vertices.
+    */
+    Vec3 GeneratePointNearTriangle(const Tri& t)
+    {
+        const double u = real_rand()*3.0 - 1.0;
+        const double v = real_rand()*3.0 - 1.0;
+        const double h = real_rand()*2.0 - 1.0;
+        return t.P0() + t.P0P1()*u + t.P0P2()*v + t.Normal()*h;
+    }
+
+    /**
+    * Barycentric coordinates solve a 2x2 system with the dot products of the edges. Their
+    * rounding errors grow with its condition number, which is large for slivers, and with
+    * the distance of the point from the triangle, so each way of calculating them may
+    * differ by that much.
+    */
+    double BarycentricTolerance(const Tri& t, const BarycentricCoords& coords)
+    {
+        const double a = Vec3::dotProduct(t.P0P1(), t.P0P1());
+        const double b = Vec3::dotProduct(t.P0P2(), t.P0P2());
+        const Vec3 cross = Vec3::crossProduct(t.P0P1(), t.P0P2());
+        const double crossSq = Vec3::dotProduct(cross, cross);
+        const double condition = (a + b)*(a + b)/crossSq;
+        return EPSILON*condition*(1.0 + std::abs(coords.u) + std::abs(coords.v));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleQueryRecord_CTor)
+{
+    const Tri t(Vec3(0,0,0), Vec3(2,0,0), Vec3(0,1,1));
+    const TriangleQueryRecord<Vec3> record(t);
+    BOOST_CHECK(record.UnitEdges[zero].isSameAs(Vec3(1,0,0)));
+    BOOST_CHECK(std::abs(record.EdgeLengths[zero] - 2.0) < EPSILON);
+    BOOST_CHECK(std::abs(record.EdgeLengthsSq[one] - 2.0) < EPSILON);
+    BOOST_CHECK(std::abs(record.EdgeLengthsSq[two] - 6.0) < EPSILON);
+    BOOST_CHECK(std::abs(record.EdgeDot) < EPSILON);
+    BOOST_CHECK(std::abs(record.InverseDet - 0.125) < EPSILON);
+    BOOST_CHECK(std::abs(record.PlaneOffset) < EPSILON);
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleQueryRecord_SameAsTriangle)
+{
+    auto mesh = GetMesh();
+    for(const Tri& t : mesh->GetPolygons())
+    {
+        const TriangleQueryRecord<Vec3> record(t);
+        for(unsigned i = 0; i < NUM_ITERATIONS; ++i)
+        {
+            const Vec3 point = GeneratePointNearTriangle(t);
+            const auto expected = t.CalcBarycentricCoords(point);
+            const auto coords = record.CalcBarycentricCoords(t, point);
+            const double tolerance = BarycentricTolerance(t, expected);
+            BOOST_CHECK(std::abs(expected.u - coords.u) < tolerance);
+            BOOST_CHECK(std::abs(expected.v - coords.v) < tolerance);
+
+            const auto expectedRes = t.CalcShortestDistanceFrom(point, std::numeric_limits<double>::max());
+            const auto res = record.CalcShortestDistanceFrom(t, point, std::numeric_limits<double>::max());
+            BOOST_CHECK(std::abs(expectedRes.Dist - res.Dist) < EPSILON);
+            BOOST_CHECK(expectedRes.Point.isSameAs(res.Point));
+
+            // Beyond the threshold nothing is reported
+            const auto far = record.CalcShortestDistanceFrom(t, t.P0() + t.Normal()*2.0, 1.0);
+            BOOST_CHECK(far.Dist == std::numeric_limits<double>::max());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleQueryRecord_ProximityQueries)
+{
+    // Queries with and without the records must find the same points
+    auto mesh = GetMesh();
+    TriMeshProxQueryV1 queriesV1(mesh);
+    TriMeshProxQueryV1 queriesV1Records(mesh, TrianglePrecomputation::QueryRecords);
+    TriMeshProxQueryV3 queriesV3Records(mesh, BVHBuildParams(), TrianglePrecomputation::QueryRecords);
+    for(unsigned i = 0; i < 100; ++i)
+    {
+        const Vec3 testPoint(real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0);
+        const double threshold = (i % 2 == 0) ? std::numeric_limits<double>::max() : 0.1;
+        auto res = queriesV1.CalculateClosestPoint(testPoint, threshold);
+        auto resV1 = queriesV1Records.CalculateClosestPoint(testPoint, threshold);
+        auto resV3 = queriesV3Records.CalculateClosestPoint(testPoint, threshold);
+        BOOST_CHECK(std::get<2>(res) == std::get<2>(resV1));
+        BOOST_CHECK(std::get<2>(res) == std::get<2>(resV3));
+        BOOST_CHECK(std::abs(std::get<1>(res) - std::get<1>(resV1)) < EPSILON);
+        BOOST_CHECK(std::abs(std::get<1>(res) - std::get<1>(resV3)) < EPSILON);
+        if(std::get<2>(res))
+        {
+            BOOST_CHECK(std::get<0>(res).isSameAs(std::get<0>(resV1)));
+            BOOST_CHECK(std::get<0>(res).isSameAs(std::get<0>(resV3)));
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include <vector>
+#include <iostream>
+#include <random>
+#include <functional>
+#include <limits>
+#include "Mesh.h"
+#include "TriangleSoA.h"
+#include "TriangularMeshBuildingPolicy.h"
+#define BOOST_TEST_MODULE Test_TriangleSoA
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    mt19937::result_type seed = time(0);
+    auto real_rand = std::bind(std::uniform_real_distribution<double>(0.0,1.0), mt19937(seed));
+
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const double TOLERANCE = 1e-8; ///< See the documentation of TriangleSoA
+
+    typedef Triangle<Vec3> Tri;
+
+    /**
+    * Point near the triangle: somewhere in the plane around it, pushed off along the normal
+    */
+    Vec3 GeneratePointNearTriangle(const Tri& t)
+    {
+        const double u = real_rand()*3.0 - 1.0;
+        const double v = real_rand()*3.0 - 1.0;
+        const double h = real_rand()*0.2 - 0.1;
+        return t.P0() + t.P0P1()*u + t.P0P2()*v + t.Normal()*h;
+    }
+
+    /**
+    * Checks a single triangle against Triangle::CalcShortestDistanceFrom
+    */
+    void CheckSameAsTriangle(const Tri& t, const Vec3& point)
+    {
+        TriangleSoA soa;
+        soa.PushBack(t);
+
+        double distSq = std::numeric_limits<double>::max();
+        Vec3 closestPoint;
+        std::size_t closestIndex = 1;
+        BOOST_CHECK(soa.FindClosest(point, 0, 1, distSq, closestPoint, closestIndex));
+        BOOST_CHECK(closestIndex == 0);
+
+        const IntersectionResult<Vec3> res = t.CalcShortestDistanceFrom(point, std::numeric_limits<double>::max());
+        BOOST_CHECK(std::abs(std::sqrt(distSq) - res.Dist) < TOLERANCE);
+        BOOST_CHECK(closestPoint.isSameAs(res.Point, TOLERANCE));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleSoA_Regions)
+{
+    // One point in each of the Voronoi regions of a simple triangle
+    const Tri t(Vec3(0,0,0), Vec3(1,0,0), Vec3(0,1,0));
+    const Vec3 points[] = {Vec3(0.2, 0.2, 1.0),     // face
+                           Vec3(-1.0, -1.0, 0.5),   // vertex P0
+                           Vec3(2.0, -0.5, -0.5),   // vertex P1
+                           Vec3(-0.5, 2.0, 0.0),    // vertex P2
+                           Vec3(0.5, -1.0, 0.3),    // edge P0P1
+                           Vec3(-1.0, 0.5, -0.3),   // edge P0P2
+                           Vec3(1.0, 1.0, 2.0)};    // edge P1P2
+    for(const Vec3& point : points)
+    {
+        CheckSameAsTriangle(t, point);
+    }
+
+    // A point on the triangle is at distance zero
+    TriangleSoA soa;
+    soa.PushBack(t);
+    double distSq = 1.0;
+    Vec3 closestPoint;
+    std::size_t closestIndex;
+    BOOST_CHECK(soa.FindClosest(Vec3(0.25, 0.25, 0), 0, 1, distSq, closestPoint, closestIndex));
+    BOOST_CHECK(distSq < TOLERANCE);
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleSoA_SameAsTriangle)
+{
+    auto mesh = std::make_shared<Mesh<Tri>>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    for(const Tri& t : mesh->GetPolygons())
+    {
+        CheckSameAsTriangle(t, GeneratePointNearTriangle(t));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangleSoA_FindClosestInRange)
+{
+    auto mesh = std::make_shared<Mesh<Tri>>(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    const std::vector<Tri>& triangles = mesh->GetPolygons();
+    TriangleSoA soa;
+    soa.Reserve(triangles.size());
+    for(const Tri& t : triangles)
+    {
+        soa.PushBack(t);
+    }
+    BOOST_CHECK(soa.Size() == triangles.size());
+
+    for(unsigned i = 0; i < 50; ++i)
+    {
+        const Vec3 point(real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0, real_rand()*2.0 - 1.0);
+
+        // Ranges that do not start or end on a packet boundary
+        const std::size_t first = static_cast<std::size_t>(real_rand()*100.0);
+        const std::size_t count = 1 + static_cast<std::size_t>(real_rand()*(triangles.size() - first - 1));
+
+        double expectedDist = std::numeric_limits<double>::max();
+        for(std::size_t j = first; j < first + count; ++j)
+        {
+            expectedDist = std::min(expectedDist, triangles[j].CalcShortestDistanceFrom(point, expectedDist).Dist);
+        }
+
+        double distSq = std::numeric_limits<double>::max();
+        Vec3 closestPoint;
+        std::size_t closestIndex = 0;
+        BOOST_CHECK(soa.FindClosestInRange(point, first, count, distSq, closestPoint, closestIndex));
+        BOOST_CHECK(closestIndex >= first && closestIndex < first + count);
+        BOOST_CHECK(std::abs(std::sqrt(distSq) - expectedDist) < TOLERANCE);
+
+        // Nothing is closer than what has already been found
+        BOOST_CHECK(!soa.FindClosestInRange(point, first, count, distSq, closestPoint, closestIndex));
+    }
+}
@@ -0,0 +1,155 @@
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <locale>
+#include <clocale>
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include "TriangularMeshBuildingPolicy.h"
+#define BOOST_TEST_MODULE Test_TriangularMeshBuildingPolicy
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace rabbit;
+namespace
+{
+    const std::string FILE_NAME = "rabbit.triangles"; ///< File with the triangulated mesh
+    const std::string LARGE_FILE_NAME = "test_large.triangles"; ///< Written by the tests
+    const unsigned NUM_TRIANGLES = 2204;    ///< Number of triangles in the mesh
+    const unsigned NUM_COPIES = 20;         ///< Copies of the mesh in the large file, about 4 MB
+
+    typedef Mesh<Triangle<Vec3>> TriMesh;
+
+    bool IsEqual(const Vec3& a, const Vec3& b)
+    {
+        return a.X() == b.X() && a.Y() == b.Y() && a.Z() == b.Z();
+    }
+
+    // German style numbers, 1.234,5
+    struct CommaNumpunct : public std::numpunct<char>
+    {
+    protected:
+        virtual char do_decimal_point()const override{return ',';}
+        virtual char do_thousands_sep()const override{return '.';}
+        virtual std::string do_grouping()const override{return "\3";}
+    };
+
+    void CheckSameTriangles(const TriMesh& expected, const TriMesh& mesh)
+    {
+        const std::vector<Triangle<Vec3>>& expectedTriangles = expected.GetPolygons();
+        const std::vector<Triangle<Vec3>>& triangles = mesh.GetPolygons();
+        BOOST_CHECK(triangles.size() == expectedTriangles.size());
+        for(std::size_t i = 0; i < triangles.size(); ++i)
+        {
+            BOOST_CHECK(IsEqual(triangles[i].P0(), expectedTriangles[i].P0()));
+            BOOST_CHECK(IsEqual(triangles[i].P1(), expectedTriangles[i].P1()));
+            BOOST_CHECK(IsEqual(triangles[i].P2(), expectedTriangles[i].P2()));
+            BOOST_CHECK(IsEqual(triangles[i].Normal(), expectedTriangles[i].Normal()));
+        }
+    }
+
+    // Both policies must produce bit for bit the same triangles
+    void CheckSameTriangles(const std::string& fileName, std::shared_ptr<ThreadPool> threadPool)
+    {
+        TriMesh expected(std::make_shared<TriangularMeshBuilingPolicy>(fileName));
+        auto parallelPolicy = std::make_shared<TriangularMeshBuilingPolicy>(fileName, threadPool);
+        TriMesh mesh(parallelPolicy);
+        BOOST_CHECK(parallelPolicy->GetLoadThroughput() > 0.0);
+        CheckSameTriangles(expected, mesh);
+    }
+
+    // Writes NUM_COPIES copies of the rabbit followed by tail
+    void WriteLargeFile(const std::string& tail)
+    {
+        std::ifstream infile(FILE_NAME.c_str());
+        const std::string text((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+        std::ofstream outfile(LARGE_FILE_NAME.c_str());
+        for(unsigned i = 0; i < NUM_COPIES; ++i)
+        {
+            outfile << text << "\n";
+        }
+        outfile << tail;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangularMeshBuildingPolicy_Stream)
+{
+    auto policy = std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME);
+    BOOST_CHECK(policy->GetLoadThroughput() == 0.0);
+    TriMesh mesh(policy);
+    BOOST_CHECK(mesh.GetPolygons().size() == NUM_TRIANGLES);
+    BOOST_CHECK(policy->GetLoadThroughput() > 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangularMeshBuildingPolicy_Parallel)
+{
+    auto threadPool = std::make_shared<ThreadPool>(3);
+    CheckSameTriangles(FILE_NAME, threadPool);
+
+    // Large enough to be split into several chunks
+    WriteLargeFile("");
+    CheckSameTriangles(LARGE_FILE_NAME, threadPool);
+
+    // An incomplete triangle at the end, without a final line break
+    WriteLargeFile("0.1 0.2 0.3\n0.4 0.5");
+    CheckSameTriangles(LARGE_FILE_NAME, threadPool);
+
+    // Parsing stops at the first thing which is not a number
+    WriteLargeFile("0.1 0.2 0.3\n0.4 0.5 0.6\n0.7 0.8 abc\n1 2 3\n4 5 6\n7 8 9\n");
+    CheckSameTriangles(LARGE_FILE_NAME, threadPool);
+    TriMesh mesh(std::make_shared<TriangularMeshBuilingPolicy>(LARGE_FILE_NAME, threadPool));
+    BOOST_CHECK(mesh.GetPolygons().size() == NUM_COPIES*NUM_TRIANGLES);
+
+    // Runs on the calling thread alone as well
+    CheckSameTriangles(LARGE_FILE_NAME, std::make_shared<ThreadPool>(0));
+    std::remove(LARGE_FILE_NAME.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangularMeshBuildingPolicy_Locale)
+{
+    // Mesh files have a decimal point whatever the locale of the process
+    TriMesh expected(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+
+    std::locale::global(std::locale(std::locale::classic(), new CommaNumpunct()));
+    bool germanCLocale = false;
+    for(const char* name : {"de_DE.UTF-8", "de_DE.utf8", "de_DE", "German"})
+    {
+        if(std::setlocale(LC_ALL, name))
+        {
+            germanCLocale = true;
+            break;
+        }
+    }
+    if(!germanCLocale)
+    {
+        BOOST_TEST_MESSAGE("No German locale installed, only the C++ locale uses a decimal comma");
+    }
+
+    TriMesh stream(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME));
+    TriMesh parallel(std::make_shared<TriangularMeshBuilingPolicy>(FILE_NAME, std::make_shared<ThreadPool>(2)));
+    std::setlocale(LC_ALL, "C");
+    std::locale::global(std::locale::classic());
+
+    BOOST_CHECK_EQUAL(stream.GetPolygons().size(), NUM_TRIANGLES);
+    BOOST_CHECK_EQUAL(parallel.GetPolygons().size(), NUM_TRIANGLES);
+    CheckSameTriangles(expected, stream);
+    CheckSameTriangles(expected, parallel);
+}
+
+BOOST_AUTO_TEST_CASE(TestTriangularMeshBuildingPolicy_MissingFile)
+{
+    bool thrown = false;
+    try
+    {
+        TriMesh mesh(std::make_shared<TriangularMeshBuilingPolicy>("no_such_file.triangles",
+                                                                   std::make_shared<ThreadPool>(1)));
+    }
+    catch(const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    BOOST_CHECK(thrown);
+}
@@ -1,5 +1,7 @@
 #include "Vec3.h"
 #include <iostream>
+#include <random>
+#include <functional>
 #define BOOST_TEST_MODULE Test_Vec3
 #include <boost/test/unit_test.hpp>
 